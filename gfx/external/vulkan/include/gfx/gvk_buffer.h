@@ -26,6 +26,7 @@
 #include <gfx/compiler.h>
 #include <gfx/vulkan.h>
 #include <gfx/gvk_commandpool.h>
+#include <gfx/gvk_memory_allocator.h>
 
 #include <cassert>
 
@@ -40,8 +41,14 @@ class GX_API GVkBuffer
 CLASS_DEF(GVkBuffer)
 
 public:
+    /**
+     * 创建Buffer
+     * 传入allocator时从其内存块中子分配，否则单独分配一块设备内存
+     */
     void create(GVkDevice *device, VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags,
-                VkSharingMode sharingMode = VK_SHARING_MODE_EXCLUSIVE, VkDeviceSize size = 0, void *data = nullptr);
+                VkSharingMode sharingMode = VK_SHARING_MODE_EXCLUSIVE, VkDeviceSize size = 0, void *data = nullptr,
+                GVkMemoryAllocator *allocator = nullptr,
+                GVkMemoryAllocator::Strategy strategy = GVkMemoryAllocator::General);
 
     void destroy();
 
@@ -54,14 +61,33 @@ public:
 
     VkDeviceMemory vkDeviceMemory() const;
 
+    /**
+     * Buffer在设备内存中的偏移
+     */
+    VkDeviceSize memoryOffset() const;
+
     VkDeviceSize size() const;
 
+    /**
+     * 设备内存的实际分配大小(包含对齐)
+     */
+    VkDeviceSize memorySize() const;
+
+    uint32_t memoryTypeIndex() const;
+
+    /**
+     * 设备内存的分配信息，未使用allocator时block为空
+     */
+    const GVkMemoryAllocation &allocation() const;
+
     VkDescriptorBufferInfo *descriptor(uint64_t offset = 0, uint64_t range = VK_WHOLE_SIZE);
 
     void *map(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
 
     VkResult flush(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
 
+    VkResult invalidate(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
+
     void unmap();
 
     bool isMapped() const;
@@ -77,8 +103,9 @@ public:
 private:
     GVkDevice *mDevice = nullptr;
     VkBuffer mHandle = VK_NULL_HANDLE;
-    VkDeviceMemory mMemory = VK_NULL_HANDLE;
     VkDeviceSize mSize = 0;
+    GVkMemoryAllocator *mAllocator = nullptr;
+    GVkMemoryAllocation mAllocation;
     VkMemoryPropertyFlags mMemoryPropertyFlags{};
     void *mMapped = nullptr;
 
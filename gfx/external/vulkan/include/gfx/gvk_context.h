@@ -44,7 +44,8 @@ CLASS_DEF(GVkContext)
 public:
     bool create(GVkInstance *instance, const VkPhysicalDeviceFeatures &features,
                 const std::vector<const char *> &enabledDeviceExtensions, uint32_t gpuIndex,
-                VkQueueFlags queueFlags = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_TRANSFER_BIT | VK_QUEUE_COMPUTE_BIT);
+                VkQueueFlags queueFlags = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_TRANSFER_BIT | VK_QUEUE_COMPUTE_BIT,
+                const void *pNextFeatures = nullptr);
 
     void destroy();
 
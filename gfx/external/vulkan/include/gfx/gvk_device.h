@@ -42,6 +42,8 @@ struct DeviceRequirements
     VkPhysicalDeviceFeatures features = {};
     VkSurfaceKHR surface = VK_NULL_HANDLE;
     std::vector<const char *> extensions;
+    // 扩展特性链(VkPhysicalDeviceXXXFeatures)，会挂到VkDeviceCreateInfo::pNext上
+    const void *pNextFeatures = nullptr;
 };
 
 bool queryDevice(GVkInstance *instance, VkPhysicalDevice device, const DeviceRequirements &requirements);
@@ -25,6 +25,7 @@
 
 #include <gfx/compiler.h>
 #include <gfx/vulkan.h>
+#include <gfx/gvk_memory_allocator.h>
 
 #include <cassert>
 
@@ -44,6 +45,10 @@ class GX_API GVkImage
 CLASS_DEF(GVkImage)
 
 public:
+    /**
+     * 创建图像
+     * 传入allocator时从其内存块中子分配，否则单独分配一块设备内存
+     */
     void create(GVkDevice *device,
                 VkImageType imageType,
                 VkFormat format,
@@ -58,7 +63,8 @@ public:
                 VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED,
                 uint32_t mipLevels = 1,
                 uint32_t arrayLayers = 1,
-                VkFlags imageFlag = 0);
+                VkFlags imageFlag = 0,
+                GVkMemoryAllocator *allocator = nullptr);
 
     /**
      * 使用托管模式创建
@@ -96,6 +102,18 @@ public:
                             const VkImageSubresourceRange &subResRange,
                             bool computeUsage);
 
+    /**
+     * 只生成Barrier信息而不录制，用于批量提交Barrier
+     * 调用者负责在录制后调用setLayout(imageBarrier.newLayout)
+     */
+    void getImageMemoryBarrier(VkImageLayout srcLayout,
+                               VkImageLayout dstLayout,
+                               const VkImageSubresourceRange &subResRange,
+                               bool computeUsage,
+                               VkImageMemoryBarrier &imageBarrier,
+                               VkPipelineStageFlags &srcStage,
+                               VkPipelineStageFlags &dstStage);
+
 public:
     uint32_t width() const;
 
@@ -105,6 +123,8 @@ public:
 
     uint64_t size() const;
 
+    uint32_t memoryTypeIndex() const;
+
     uint32_t mipLevels() const;
 
     uint32_t arrayLayers() const;
@@ -145,7 +165,8 @@ private:
     VkImageAspectFlags mAspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 
     VkMemoryRequirements mMemReqs{};
-    VkDeviceMemory mMemory = VK_NULL_HANDLE;
+    GVkMemoryAllocator *mAllocator = nullptr;
+    GVkMemoryAllocation mAllocation;
 };
 
 }
@@ -0,0 +1,180 @@
+/*
+ * Copyright (c) 2023 Gxin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef GFX_GVK_MEMORY_ALLOCATOR_H
+#define GFX_GVK_MEMORY_ALLOCATOR_H
+
+#include <gfx/compiler.h>
+#include <gfx/vulkan.h>
+
+#include <gx/gmutex.h>
+
+#include <vector>
+
+
+namespace gfx
+{
+
+class GVkDevice;
+
+/**
+ * 一次设备内存分配
+ */
+struct GVkMemoryAllocation
+{
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
+    uint32_t memoryTypeIndex = 0;
+
+    /// 主机可见内存的映射地址(已加上offset)，内存块创建时即被持久映射
+    void *mapped = nullptr;
+
+    /// 所属内存块，为nullptr时独占一个VkDeviceMemory
+    void *block = nullptr;
+
+    /// 在内存块中的节点编号
+    uint32_t node = 0;
+};
+
+/**
+ * 设备内存块分配器
+ * 按内存类型分配大块VkDeviceMemory，再在块内进行子分配，避免每个资源单独调用vkAllocateMemory
+ * General策略使用TLSF(两级分离适配)在O(1)时间内分配和合并空闲区间；Linear策略在块内线性递增分配，
+ * 块内的分配全部释放后整体回收，适用于短期使用的暂存内存
+ * Buffer和optimal图像使用不同的内存块，无需处理bufferImageGranularity
+ * 超过内存块一半大小的请求单独分配VkDeviceMemory
+ */
+class GX_API GVkMemoryAllocator
+{
+CLASS_DEF(GVkMemoryAllocator)
+
+public:
+    enum Strategy
+    {
+        General = 0,
+        Linear = 1
+    };
+
+    static constexpr VkDeviceSize DEFAULT_BLOCK_SIZE = 64ull * 1024 * 1024;
+
+public:
+    /**
+     * @param device
+     * @param blockSize 内存块大小，较小的内存堆使用堆大小的1/8
+     */
+    void create(GVkDevice *device, VkDeviceSize blockSize = DEFAULT_BLOCK_SIZE);
+
+    void destroy();
+
+public:
+    bool isCreated() const;
+
+    GVkDevice *device() const;
+
+    /**
+     * 分配设备内存
+     *
+     * @param requirements  资源的内存需求
+     * @param properties    需要的内存属性
+     * @param isImage       是否为optimal图像
+     * @param strategy
+     * @param allocation    分配结果
+     * @return 分配失败时返回对应的VkResult
+     */
+    VkResult allocate(const VkMemoryRequirements &requirements, VkMemoryPropertyFlags properties,
+                      bool isImage, Strategy strategy, GVkMemoryAllocation &allocation);
+
+    void free(GVkMemoryAllocation &allocation);
+
+    /**
+     * 刷新主机写入的内存区间，区间会按nonCoherentAtomSize对齐
+     *
+     * @param allocation
+     * @param offset    相对分配起点的偏移
+     * @param size      VK_WHOLE_SIZE表示到分配结尾
+     * @return
+     */
+    VkResult flush(const GVkMemoryAllocation &allocation, VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE);
+
+    VkResult invalidate(const GVkMemoryAllocation &allocation, VkDeviceSize offset = 0,
+                        VkDeviceSize size = VK_WHOLE_SIZE);
+
+    /**
+     * 在一次vkFlushMappedMemoryRanges中刷新多个分配上的区间，一致性内存上的区间会被跳过
+     *
+     * @param count
+     * @param allocations
+     * @param offsets       相对各自分配起点的偏移
+     * @param sizes
+     * @return
+     */
+    VkResult flush(uint32_t count, const GVkMemoryAllocation *const *allocations,
+                   const VkDeviceSize *offsets, const VkDeviceSize *sizes);
+
+    /**
+     * 内存类型上的VkDeviceMemory数量(内存块和单独分配)
+     *
+     * @param memoryTypeIndex
+     * @return
+     */
+    uint32_t deviceMemoryCount(uint32_t memoryTypeIndex);
+
+    /**
+     * 内存类型上的VkDeviceMemory总字节数
+     *
+     * @param memoryTypeIndex
+     * @return
+     */
+    VkDeviceSize deviceMemoryBytes(uint32_t memoryTypeIndex);
+
+private:
+    struct Block;
+
+    Block *createBlock(uint32_t memoryTypeIndex, VkDeviceSize size, bool isImage, Strategy strategy);
+
+    void destroyBlock(Block *block);
+
+    VkResult allocateDedicated(const VkMemoryRequirements &requirements, uint32_t memoryTypeIndex,
+                               GVkMemoryAllocation &allocation);
+
+    VkDeviceSize blockSizeOf(uint32_t memoryTypeIndex) const;
+
+    bool isNonCoherent(uint32_t memoryTypeIndex) const;
+
+    VkMappedMemoryRange mappedRange(const GVkMemoryAllocation &allocation, VkDeviceSize offset,
+                                    VkDeviceSize size) const;
+
+private:
+    GVkDevice *mDevice = nullptr;
+    VkDeviceSize mBlockSize = DEFAULT_BLOCK_SIZE;
+    VkDeviceSize mNonCoherentAtomSize = 1;
+
+    GMutex mMutex;
+    std::vector<Block *> mBlocks[VK_MAX_MEMORY_TYPES];
+    uint32_t mDedicatedCount[VK_MAX_MEMORY_TYPES]{};
+    VkDeviceSize mDedicatedBytes[VK_MAX_MEMORY_TYPES]{};
+};
+
+}
+
+#endif //GFX_GVK_MEMORY_ALLOCATOR_H
@@ -42,10 +42,24 @@ class GX_API GVkSurfaceSwapChain : public GVkBaseSwapChain
 CLASS_DEF(GVkSurfaceSwapChain)
 
 public:
-    void create(GVkDevice *device, VkSurfaceKHR surface, uint32_t width, uint32_t height, bool vsync);
+    /**
+     * 创建或重建交换链
+     *
+     * @param retireOld 重建时是否保留旧交换链，为true时旧交换链及其图像需由destroyRetired销毁
+     */
+    void create(GVkDevice *device, VkSurfaceKHR surface, uint32_t width, uint32_t height, bool vsync,
+                bool retireOld = false);
 
     void destroy() override;
 
+    /**
+     * 销毁重建时保留下来的旧交换链
+     * 调用前需确保引用旧交换链的指令和呈现都已经完成
+     */
+    void destroyRetired();
+
+    bool hasRetired() const;
+
     bool isCreated() const;
 public:
     VkResult acquireNextImage(uint32_t *bufferIndex) override;
@@ -65,7 +79,9 @@ public:
     uint32_t height() override;
 
 private:
-    void init();
+    void init(bool retireOld);
+
+    void destroyBuffers(std::vector<GVkSwapChainBuffer> &buffers);
 
 private:
     GVkDevice *mDevice = nullptr;
@@ -82,6 +98,15 @@ private:
     uint32_t mImageCount = 0;
     std::vector<GVkSwapChainBuffer> mBuffers;
     GVkSemaphore mImageAvailableSemaphore;
+
+    struct RetiredSwapChain
+    {
+        VkSwapchainKHR handle;
+        std::vector<GVkSwapChainBuffer> buffers;
+        GVkSemaphore imageAvailableSemaphore;
+    };
+
+    std::vector<RetiredSwapChain> mRetiredSwapChains;
 };
 
 }
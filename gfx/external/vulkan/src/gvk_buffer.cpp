@@ -34,7 +34,8 @@ namespace gfx
 {
 
 void GVkBuffer::create(GVkDevice *device, VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags,
-                       VkSharingMode sharingMode, VkDeviceSize size, void *data)
+                       VkSharingMode sharingMode, VkDeviceSize size, void *data,
+                       GVkMemoryAllocator *allocator, GVkMemoryAllocator::Strategy strategy)
 {
     GX_ASSERT_S(!isCreated(), "GVkBuffer::create is created");
     if (isCreated()) {
@@ -50,12 +51,26 @@ void GVkBuffer::create(GVkDevice *device, VkBufferUsageFlags usageFlags, VkMemor
     VK_CHECK_RESULT(vkCreateBuffer(*device, &bufCreateInfo, nullptr, &mHandle));
 
     VkMemoryRequirements memReqs;
-    VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
     vkGetBufferMemoryRequirements(*device, mHandle, &memReqs);
-    memAlloc.allocationSize = memReqs.size;
 
-    memAlloc.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, memoryPropertyFlags);
-    VK_CHECK_RESULT(vkAllocateMemory(*device, &memAlloc, nullptr, &mMemory));
+    if (allocator) {
+        GX_ASSERT(allocator->device() == device);
+        VkResult result = allocator->allocate(memReqs, memoryPropertyFlags, false, strategy, mAllocation);
+        if (result != VK_SUCCESS) {
+            Log("GVkBuffer::create allocate memory failure: %d", result);
+            vkDestroyBuffer(*device, mHandle, nullptr);
+            mHandle = VK_NULL_HANDLE;
+            return;
+        }
+        mAllocator = allocator;
+    } else {
+        VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+        memAlloc.allocationSize = memReqs.size;
+        memAlloc.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, memoryPropertyFlags);
+        VK_CHECK_RESULT(vkAllocateMemory(*device, &memAlloc, nullptr, &mAllocation.memory));
+        mAllocation.size = memAlloc.allocationSize;
+        mAllocation.memoryTypeIndex = memAlloc.memoryTypeIndex;
+    }
 
     mMemoryPropertyFlags = memoryPropertyFlags;
     mSize = size;
@@ -64,20 +79,23 @@ void GVkBuffer::create(GVkDevice *device, VkBufferUsageFlags usageFlags, VkMemor
         copyToBuffer(data, size);
     }
 
-    VK_CHECK_RESULT(vkBindBufferMemory(*mDevice, mHandle, mMemory, 0));
+    VK_CHECK_RESULT(vkBindBufferMemory(*mDevice, mHandle, mAllocation.memory, mAllocation.offset));
 }
 
 void GVkBuffer::destroy()
 {
     if (mHandle != VK_NULL_HANDLE) {
         unmap();
-        if (mMemory != VK_NULL_HANDLE) {
-            vkFreeMemory(*mDevice, mMemory, nullptr);
-        }
         vkDestroyBuffer(*mDevice, mHandle, nullptr);
+        if (mAllocator) {
+            mAllocator->free(mAllocation);
+        } else if (mAllocation.memory != VK_NULL_HANDLE) {
+            vkFreeMemory(*mDevice, mAllocation.memory, nullptr);
+        }
     }
     mHandle = VK_NULL_HANDLE;
-    mMemory = VK_NULL_HANDLE;
+    mAllocator = nullptr;
+    mAllocation = {};
 }
 
 bool GVkBuffer::isCreated() const
@@ -97,7 +115,12 @@ VkBuffer GVkBuffer::vkBuffer() const
 
 VkDeviceMemory GVkBuffer::vkDeviceMemory() const
 {
-    return mMemory;
+    return mAllocation.memory;
+}
+
+VkDeviceSize GVkBuffer::memoryOffset() const
+{
+    return mAllocation.offset;
 }
 
 VkDeviceSize GVkBuffer::size() const
@@ -105,6 +128,21 @@ VkDeviceSize GVkBuffer::size() const
     return mSize;
 }
 
+VkDeviceSize GVkBuffer::memorySize() const
+{
+    return mAllocation.size;
+}
+
+uint32_t GVkBuffer::memoryTypeIndex() const
+{
+    return mAllocation.memoryTypeIndex;
+}
+
+const GVkMemoryAllocation &GVkBuffer::allocation() const
+{
+    return mAllocation;
+}
+
 VkDescriptorBufferInfo *GVkBuffer::descriptor(uint64_t offset, uint64_t range)
 {
     mDescriptor.buffer = mHandle;
@@ -119,24 +157,48 @@ void *GVkBuffer::map(VkDeviceSize size, VkDeviceSize offset)
     if (mMapped) {
         return mMapped;
     }
-    VK_CHECK_RESULT(vkMapMemory(*mDevice, mMemory, offset, size, 0, &mMapped));
+    if (mAllocator) {
+        // 子分配的内存块在创建时已持久映射
+        GX_ASSERT_S(mAllocation.mapped, "GVkBuffer::map memory is not host visible");
+        mMapped = mAllocation.mapped ? (uint8_t *) mAllocation.mapped + offset : nullptr;
+        return mMapped;
+    }
+    VK_CHECK_RESULT(vkMapMemory(*mDevice, mAllocation.memory, offset, size, 0, &mMapped));
     return mMapped;
 }
 
 VkResult GVkBuffer::flush(VkDeviceSize size, VkDeviceSize offset)
 {
+    if (mAllocator) {
+        return mAllocator->flush(mAllocation, offset, size);
+    }
     VkMappedMemoryRange mappedRange = {};
     mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-    mappedRange.memory = mMemory;
+    mappedRange.memory = mAllocation.memory;
     mappedRange.offset = offset;
     mappedRange.size = size;
     return vkFlushMappedMemoryRanges(*mDevice, 1, &mappedRange);
 }
 
+VkResult GVkBuffer::invalidate(VkDeviceSize size, VkDeviceSize offset)
+{
+    if (mAllocator) {
+        return mAllocator->invalidate(mAllocation, offset, size);
+    }
+    VkMappedMemoryRange mappedRange = {};
+    mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+    mappedRange.memory = mAllocation.memory;
+    mappedRange.offset = offset;
+    mappedRange.size = size;
+    return vkInvalidateMappedMemoryRanges(*mDevice, 1, &mappedRange);
+}
+
 void GVkBuffer::unmap()
 {
     if (mMapped) {
-        vkUnmapMemory(*mDevice, mMemory);
+        if (!mAllocator) {
+            vkUnmapMemory(*mDevice, mAllocation.memory);
+        }
         mMapped = nullptr;
     }
 }
@@ -34,7 +34,7 @@ namespace gfx
 
 bool GVkContext::create(GVkInstance *instance, const VkPhysicalDeviceFeatures &features,
                         const std::vector<const char *> &enabledDeviceExtensions,
-                        uint32_t gpuIndex, VkQueueFlags queueFlags)
+                        uint32_t gpuIndex, VkQueueFlags queueFlags, const void *pNextFeatures)
 {
     Log("GVkContext create");
 
@@ -54,6 +54,7 @@ bool GVkContext::create(GVkInstance *instance, const VkPhysicalDeviceFeatures &f
         }
     }
     requirements.features = features;
+    requirements.pNextFeatures = pNextFeatures;
     requirements.extensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
 
 #ifdef VK_KHR_get_memory_requirements2
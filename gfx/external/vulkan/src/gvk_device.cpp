@@ -266,6 +266,7 @@ void GVkDevice::createLogicalDevice(const DeviceRequirements &requirements)
 
     VkDeviceCreateInfo info = {};
     info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    info.pNext = requirements.pNextFeatures;
     info.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
     info.pQueueCreateInfos = queueCreateInfos.data();
 
@@ -38,7 +38,8 @@ void GVkImage::create(GVkDevice *device, VkImageType imageType, VkFormat format,
                       VkSampleCountFlagBits samples, VkImageTiling tiling, VkImageUsageFlags usage,
                       VkImageAspectFlags aspectMask,
                       VkSharingMode sharingMode, VkImageLayout layout,
-                      uint32_t mipLevels, uint32_t arrayLayers, VkFlags imageFlag)
+                      uint32_t mipLevels, uint32_t arrayLayers, VkFlags imageFlag,
+                      GVkMemoryAllocator *allocator)
 {
     GX_ASSERT_S(!isCreated(), "GVkImage::create is created");
     if (isCreated()) {
@@ -76,21 +77,44 @@ void GVkImage::create(GVkDevice *device, VkImageType imageType, VkFormat format,
 
     VK_CHECK_RESULT(vkCreateImage(*device, &imageCreateInfo, nullptr, &mHandle));
 
-    VkMemoryAllocateInfo memAllocInfo{};
-    memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-
     vkGetImageMemoryRequirements(*mDevice, mHandle, &mMemReqs);
-    memAllocInfo.allocationSize = mMemReqs.size;
+
+    VkMemoryPropertyFlags memoryProperties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
     if (tiling == VK_IMAGE_TILING_LINEAR) {
-        memAllocInfo.memoryTypeIndex = mDevice->getMemoryType(mMemReqs.memoryTypeBits,
-                                                              VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-                                                              VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        memoryProperties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    } else if (usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT) {
+        // 瞬态附件优先使用延迟分配的内存，设备不支持时退回普通的设备本地内存
+        VkBool32 found = VK_FALSE;
+        mDevice->getMemoryType(mMemReqs.memoryTypeBits,
+                               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT,
+                               &found);
+        if (found) {
+            memoryProperties |= VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+        }
+    }
+
+    if (allocator) {
+        GX_ASSERT(allocator->device() == device);
+        // linear图像与Buffer共用内存块，optimal图像使用单独的内存块
+        VkResult result = allocator->allocate(mMemReqs, memoryProperties, tiling == VK_IMAGE_TILING_OPTIMAL,
+                                              GVkMemoryAllocator::General, mAllocation);
+        if (result != VK_SUCCESS) {
+            Log("GVkImage::create allocate memory failure: %d", result);
+            vkDestroyImage(*mDevice, mHandle, nullptr);
+            mHandle = VK_NULL_HANDLE;
+            return;
+        }
+        mAllocator = allocator;
     } else {
-        memAllocInfo.memoryTypeIndex = mDevice->getMemoryType(mMemReqs.memoryTypeBits,
-                                                              VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        VkMemoryAllocateInfo memAllocInfo{};
+        memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        memAllocInfo.allocationSize = mMemReqs.size;
+        memAllocInfo.memoryTypeIndex = mDevice->getMemoryType(mMemReqs.memoryTypeBits, memoryProperties);
+        VK_CHECK_RESULT(vkAllocateMemory(*mDevice, &memAllocInfo, nullptr, &mAllocation.memory));
+        mAllocation.size = memAllocInfo.allocationSize;
+        mAllocation.memoryTypeIndex = memAllocInfo.memoryTypeIndex;
     }
-    VK_CHECK_RESULT(vkAllocateMemory(*mDevice, &memAllocInfo, nullptr, &mMemory));
-    VK_CHECK_RESULT(vkBindImageMemory(*mDevice, mHandle, mMemory, 0));
+    VK_CHECK_RESULT(vkBindImageMemory(*mDevice, mHandle, mAllocation.memory, mAllocation.offset));
 }
 
 void GVkImage::create(GVkDevice *device, VkImage vkImage, VkFormat format,
@@ -118,10 +142,15 @@ void GVkImage::destroy()
 {
     if (mDevice && !mIsHostedImage && mHandle != VK_NULL_HANDLE) {
         vkDestroyImage(*mDevice, mHandle, nullptr);
-        vkFreeMemory(*mDevice, mMemory, nullptr);
+        if (mAllocator) {
+            mAllocator->free(mAllocation);
+        } else {
+            vkFreeMemory(*mDevice, mAllocation.memory, nullptr);
+        }
     }
     mHandle = VK_NULL_HANDLE;
-    mMemory = VK_NULL_HANDLE;
+    mAllocator = nullptr;
+    mAllocation = {};
     mDevice = nullptr;
 }
 
@@ -144,14 +173,32 @@ void GVkImage::imageMemoryBarrier(VkCommandBuffer cmdBuffer, VkImageLayout srcLa
                                   const VkImageSubresourceRange &subResRange, bool computeUsage)
 {
     VkImageMemoryBarrier imageBarrier{};
+    VkPipelineStageFlags srcStage = 0;
+    VkPipelineStageFlags dstStage = 0;
+    getImageMemoryBarrier(srcLayout, dstLayout, subResRange, computeUsage, imageBarrier, srcStage, dstStage);
+
+    vkCmdPipelineBarrier(cmdBuffer, srcStage, dstStage, 0,
+                         0, nullptr,
+                         0, nullptr,
+                         1, &imageBarrier);
+
+    setLayout(imageBarrier.newLayout);
+}
+
+void GVkImage::getImageMemoryBarrier(VkImageLayout srcLayout, VkImageLayout dstLayout,
+                                     const VkImageSubresourceRange &subResRange, bool computeUsage,
+                                     VkImageMemoryBarrier &imageBarrier,
+                                     VkPipelineStageFlags &srcStage, VkPipelineStageFlags &dstStage)
+{
+    imageBarrier = {};
     imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
     imageBarrier.image = mHandle;
     imageBarrier.subresourceRange = subResRange;
     imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
     imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
 
-    VkPipelineStageFlags srcStage = 0;
-    VkPipelineStageFlags dstStage = 0;
+    srcStage = 0;
+    dstStage = 0;
     setImageBarrierInfo(srcLayout, dstLayout, imageBarrier, srcStage, dstStage, computeUsage);
 
     if (srcLayout == VK_IMAGE_LAYOUT_PRESENT_SRC_KHR) {
@@ -159,13 +206,6 @@ void GVkImage::imageMemoryBarrier(VkCommandBuffer cmdBuffer, VkImageLayout srcLa
     } else if (dstLayout == VK_IMAGE_LAYOUT_PRESENT_SRC_KHR) {
         dstStage = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
     }
-
-    vkCmdPipelineBarrier(cmdBuffer, srcStage, dstStage, 0,
-                         0, nullptr,
-                         0, nullptr,
-                         1, &imageBarrier);
-
-    setLayout(imageBarrier.newLayout);
 }
 
 uint32_t GVkImage::width() const
@@ -188,6 +228,11 @@ uint64_t GVkImage::size() const
     return mMemReqs.size;
 }
 
+uint32_t GVkImage::memoryTypeIndex() const
+{
+    return mAllocation.memoryTypeIndex;
+}
+
 uint32_t GVkImage::mipLevels() const
 {
     return mMipLevels;
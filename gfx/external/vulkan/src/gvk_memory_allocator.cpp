@@ -0,0 +1,662 @@
+/*
+ * Copyright (c) 2023 Gxin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "gfx/gvk_memory_allocator.h"
+
+#include <gfx/gvk_device.h>
+#include <gfx/gvk_tools.h>
+
+#include <gx/debug.h>
+
+#include <algorithm>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+
+namespace gfx
+{
+
+namespace
+{
+
+constexpr uint32_t TLSF_SL_BITS = 4;
+constexpr uint32_t TLSF_SL_COUNT = 1u << TLSF_SL_BITS;
+constexpr uint32_t TLSF_FL_COUNT = 64 - TLSF_SL_BITS + 1;
+constexpr uint32_t TLSF_NULL = UINT32_MAX;
+
+inline uint32_t bitScanReverse(uint64_t v)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanReverse64(&index, v);
+    return (uint32_t) index;
+#else
+    return 63 - (uint32_t) __builtin_clzll(v);
+#endif
+}
+
+inline uint32_t bitScanForward(uint64_t v)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward64(&index, v);
+    return (uint32_t) index;
+#else
+    return (uint32_t) __builtin_ctzll(v);
+#endif
+}
+
+inline VkDeviceSize alignUp(VkDeviceSize v, VkDeviceSize alignment)
+{
+    return (v + alignment - 1) / alignment * alignment;
+}
+
+inline VkDeviceSize alignDown(VkDeviceSize v, VkDeviceSize alignment)
+{
+    return v / alignment * alignment;
+}
+
+/**
+ * TLSF(两级分离适配)区间分配器，只管理偏移，不访问内存本身
+ * 第一级按大小的最高位分级，第二级将每一级再等分为 TLSF_SL_COUNT 份，每份一个空闲链表
+ * 物理相邻的空闲区间在释放时立即合并
+ */
+class Tlsf
+{
+public:
+    void init(VkDeviceSize size)
+    {
+        mNodes.clear();
+        mFreeNodeIds.clear();
+        mFlBitmap = 0;
+        std::fill(std::begin(mSlBitmap), std::end(mSlBitmap), 0);
+        for (auto &heads : mHeads) {
+            std::fill(std::begin(heads), std::end(heads), TLSF_NULL);
+        }
+        mUsedCount = 0;
+
+        uint32_t root = newNode();
+        mNodes[root].offset = 0;
+        mNodes[root].size = size;
+        insertFree(root);
+    }
+
+    bool allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize &offset, uint32_t &node)
+    {
+        // 多申请alignment - 1保证对齐后仍放得下
+        uint32_t fl, sl;
+        mappingSearch(size + alignment - 1, fl, sl);
+        uint32_t index = findFree(fl, sl);
+        if (index == TLSF_NULL) {
+            return false;
+        }
+        removeFree(index);
+
+        VkDeviceSize aligned = alignUp(mNodes[index].offset, alignment);
+        VkDeviceSize pad = aligned - mNodes[index].offset;
+        GX_ASSERT(pad + size <= mNodes[index].size);
+
+        // 对齐产生的前部空隙作为独立的空闲区间，其前一个区间一定不是空闲的
+        if (pad > 0) {
+            uint32_t front = newNode();
+            Node &cur = mNodes[index];
+            Node &frontNode = mNodes[front];
+            frontNode.offset = cur.offset;
+            frontNode.size = pad;
+            frontNode.prevPhys = cur.prevPhys;
+            frontNode.nextPhys = index;
+            if (cur.prevPhys != TLSF_NULL) {
+                mNodes[cur.prevPhys].nextPhys = front;
+            }
+            cur.prevPhys = front;
+            cur.offset = aligned;
+            cur.size -= pad;
+            insertFree(front);
+        }
+        if (mNodes[index].size > size) {
+            uint32_t tail = newNode();
+            Node &cur = mNodes[index];
+            Node &tailNode = mNodes[tail];
+            tailNode.offset = cur.offset + size;
+            tailNode.size = cur.size - size;
+            tailNode.prevPhys = index;
+            tailNode.nextPhys = cur.nextPhys;
+            if (cur.nextPhys != TLSF_NULL) {
+                mNodes[cur.nextPhys].prevPhys = tail;
+            }
+            cur.nextPhys = tail;
+            cur.size = size;
+            insertFree(tail);
+        }
+
+        mNodes[index].isFree = false;
+        mUsedCount++;
+        offset = aligned;
+        node = index;
+        return true;
+    }
+
+    void free(uint32_t index)
+    {
+        GX_ASSERT(index < mNodes.size() && !mNodes[index].isFree);
+        mNodes[index].isFree = true;
+        mUsedCount--;
+
+        uint32_t prev = mNodes[index].prevPhys;
+        if (prev != TLSF_NULL && mNodes[prev].isFree) {
+            removeFree(prev);
+            mergeNext(prev);
+            index = prev;
+        }
+        uint32_t next = mNodes[index].nextPhys;
+        if (next != TLSF_NULL && mNodes[next].isFree) {
+            removeFree(next);
+            mergeNext(index);
+        }
+        insertFree(index);
+    }
+
+    bool isEmpty() const
+    {
+        return mUsedCount == 0;
+    }
+
+private:
+    struct Node
+    {
+        VkDeviceSize offset = 0;
+        VkDeviceSize size = 0;
+        uint32_t prevPhys = TLSF_NULL;
+        uint32_t nextPhys = TLSF_NULL;
+        uint32_t prevFree = TLSF_NULL;
+        uint32_t nextFree = TLSF_NULL;
+        bool isFree = true;
+    };
+
+    static void mappingInsert(VkDeviceSize size, uint32_t &fl, uint32_t &sl)
+    {
+        if (size < TLSF_SL_COUNT) {
+            fl = 0;
+            sl = (uint32_t) size;
+        } else {
+            uint32_t msb = bitScanReverse(size);
+            fl = msb - TLSF_SL_BITS + 1;
+            sl = (uint32_t) (size >> (msb - TLSF_SL_BITS)) ^ TLSF_SL_COUNT;
+        }
+    }
+
+    /**
+     * 向上取整到下一个分级，保证该分级中的任意空闲区间都能满足请求
+     */
+    static void mappingSearch(VkDeviceSize size, uint32_t &fl, uint32_t &sl)
+    {
+        if (size >= TLSF_SL_COUNT) {
+            size += (1ull << (bitScanReverse(size) - TLSF_SL_BITS)) - 1;
+        }
+        mappingInsert(size, fl, sl);
+    }
+
+    uint32_t findFree(uint32_t fl, uint32_t sl) const
+    {
+        if (fl >= TLSF_FL_COUNT) {
+            return TLSF_NULL;
+        }
+        uint32_t slMap = mSlBitmap[fl] & (~0u << sl);
+        if (slMap == 0) {
+            uint64_t flMap = mFlBitmap & (~0ull << (fl + 1));
+            if (flMap == 0) {
+                return TLSF_NULL;
+            }
+            fl = bitScanForward(flMap);
+            slMap = mSlBitmap[fl];
+        }
+        sl = bitScanForward(slMap);
+        return mHeads[fl][sl];
+    }
+
+    void insertFree(uint32_t index)
+    {
+        uint32_t fl, sl;
+        mappingInsert(mNodes[index].size, fl, sl);
+
+        Node &node = mNodes[index];
+        node.isFree = true;
+        node.prevFree = TLSF_NULL;
+        node.nextFree = mHeads[fl][sl];
+        if (node.nextFree != TLSF_NULL) {
+            mNodes[node.nextFree].prevFree = index;
+        }
+        mHeads[fl][sl] = index;
+        mFlBitmap |= 1ull << fl;
+        mSlBitmap[fl] |= 1u << sl;
+    }
+
+    void removeFree(uint32_t index)
+    {
+        uint32_t fl, sl;
+        mappingInsert(mNodes[index].size, fl, sl);
+
+        Node &node = mNodes[index];
+        if (node.prevFree != TLSF_NULL) {
+            mNodes[node.prevFree].nextFree = node.nextFree;
+        }
+        if (node.nextFree != TLSF_NULL) {
+            mNodes[node.nextFree].prevFree = node.prevFree;
+        }
+        if (mHeads[fl][sl] == index) {
+            mHeads[fl][sl] = node.nextFree;
+            if (mHeads[fl][sl] == TLSF_NULL) {
+                mSlBitmap[fl] &= ~(1u << sl);
+                if (mSlBitmap[fl] == 0) {
+                    mFlBitmap &= ~(1ull << fl);
+                }
+            }
+        }
+        node.prevFree = TLSF_NULL;
+        node.nextFree = TLSF_NULL;
+    }
+
+    /**
+     * 将index之后物理相邻的区间并入index
+     */
+    void mergeNext(uint32_t index)
+    {
+        uint32_t next = mNodes[index].nextPhys;
+        mNodes[index].size += mNodes[next].size;
+        mNodes[index].nextPhys = mNodes[next].nextPhys;
+        if (mNodes[next].nextPhys != TLSF_NULL) {
+            mNodes[mNodes[next].nextPhys].prevPhys = index;
+        }
+        mFreeNodeIds.push_back(next);
+    }
+
+    uint32_t newNode()
+    {
+        if (!mFreeNodeIds.empty()) {
+            uint32_t index = mFreeNodeIds.back();
+            mFreeNodeIds.pop_back();
+            mNodes[index] = Node{};
+            return index;
+        }
+        mNodes.emplace_back();
+        return (uint32_t) (mNodes.size() - 1);
+    }
+
+private:
+    std::vector<Node> mNodes;
+    std::vector<uint32_t> mFreeNodeIds;
+
+    uint64_t mFlBitmap = 0;
+    uint32_t mSlBitmap[TLSF_FL_COUNT]{};
+    uint32_t mHeads[TLSF_FL_COUNT][TLSF_SL_COUNT]{};
+
+    uint32_t mUsedCount = 0;
+};
+
+}
+
+struct GVkMemoryAllocator::Block
+{
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize size = 0;
+    uint32_t memoryTypeIndex = 0;
+    bool isImage = false;
+    Strategy strategy = General;
+    void *mapped = nullptr;
+
+    Tlsf tlsf;                          // General
+    VkDeviceSize linearOffset = 0;      // Linear
+    uint32_t allocationCount = 0;
+
+    bool allocate(VkDeviceSize allocSize, VkDeviceSize alignment, GVkMemoryAllocation &allocation)
+    {
+        VkDeviceSize offset = 0;
+        uint32_t node = 0;
+        if (strategy == Linear) {
+            offset = alignUp(linearOffset, alignment);
+            if (offset + allocSize > size) {
+                return false;
+            }
+            linearOffset = offset + allocSize;
+        } else if (!tlsf.allocate(allocSize, alignment, offset, node)) {
+            return false;
+        }
+        allocationCount++;
+
+        allocation.memory = memory;
+        allocation.offset = offset;
+        allocation.size = allocSize;
+        allocation.memoryTypeIndex = memoryTypeIndex;
+        allocation.mapped = mapped ? (uint8_t *) mapped + offset : nullptr;
+        allocation.block = this;
+        allocation.node = node;
+        return true;
+    }
+
+    void free(uint32_t node)
+    {
+        GX_ASSERT(allocationCount > 0);
+        allocationCount--;
+        if (strategy == Linear) {
+            // 线性块只有在全部释放后才能复用
+            if (allocationCount == 0) {
+                linearOffset = 0;
+            }
+        } else {
+            tlsf.free(node);
+        }
+    }
+};
+
+void GVkMemoryAllocator::create(GVkDevice *device, VkDeviceSize blockSize)
+{
+    GX_ASSERT_S(!isCreated(), "GVkMemoryAllocator::create is created");
+    mDevice = device;
+    mBlockSize = blockSize;
+    mNonCoherentAtomSize = std::max<VkDeviceSize>(device->deviceProperties().limits.nonCoherentAtomSize, 1);
+}
+
+void GVkMemoryAllocator::destroy()
+{
+    GLockerGuard locker(mMutex);
+    for (auto &blocks : mBlocks) {
+        for (Block *block : blocks) {
+            if (block->allocationCount > 0) {
+                Log("GVkMemoryAllocator::destroy block still has %u allocations", block->allocationCount);
+            }
+            destroyBlock(block);
+        }
+        blocks.clear();
+    }
+    mDevice = nullptr;
+}
+
+bool GVkMemoryAllocator::isCreated() const
+{
+    return mDevice != nullptr;
+}
+
+GVkDevice *GVkMemoryAllocator::device() const
+{
+    return mDevice;
+}
+
+VkResult GVkMemoryAllocator::allocate(const VkMemoryRequirements &requirements, VkMemoryPropertyFlags properties,
+                                      bool isImage, Strategy strategy, GVkMemoryAllocation &allocation)
+{
+    GX_ASSERT(isCreated());
+
+    VkBool32 found = VK_FALSE;
+    uint32_t memoryTypeIndex = mDevice->getMemoryType(requirements.memoryTypeBits, properties, &found);
+    if (!found && (properties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)) {
+        // 没有主机可见的设备本地内存时退回到普通的主机可见内存
+        memoryTypeIndex = mDevice->getMemoryType(requirements.memoryTypeBits,
+                                                 properties & ~VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &found);
+    }
+    if (!found) {
+        return VK_ERROR_FEATURE_NOT_PRESENT;
+    }
+
+    VkDeviceSize size = requirements.size;
+    VkDeviceSize alignment = std::max<VkDeviceSize>(requirements.alignment, 1);
+    if (isNonCoherent(memoryTypeIndex)) {
+        // 保证flush/invalidate按nonCoherentAtomSize对齐后不会越过相邻的分配
+        alignment = std::max(alignment, mNonCoherentAtomSize);
+        size = alignUp(size, mNonCoherentAtomSize);
+    }
+
+    VkDeviceSize blockSize = blockSizeOf(memoryTypeIndex);
+    if (size > blockSize / 2) {
+        return allocateDedicated(requirements, memoryTypeIndex, allocation);
+    }
+
+    GLockerGuard locker(mMutex);
+    for (Block *block : mBlocks[memoryTypeIndex]) {
+        if (block->isImage == isImage && block->strategy == strategy
+            && block->allocate(size, alignment, allocation)) {
+            return VK_SUCCESS;
+        }
+    }
+
+    Block *block = createBlock(memoryTypeIndex, blockSize, isImage, strategy);
+    if (!block) {
+        return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+    }
+    mBlocks[memoryTypeIndex].push_back(block);
+
+    bool ok = block->allocate(size, alignment, allocation);
+    GX_ASSERT(ok);
+    return ok ? VK_SUCCESS : VK_ERROR_OUT_OF_DEVICE_MEMORY;
+}
+
+void GVkMemoryAllocator::free(GVkMemoryAllocation &allocation)
+{
+    if (allocation.memory == VK_NULL_HANDLE) {
+        return;
+    }
+
+    if (allocation.block == nullptr) {
+        if (allocation.mapped) {
+            vkUnmapMemory(*mDevice, allocation.memory);
+        }
+        vkFreeMemory(*mDevice, allocation.memory, nullptr);
+
+        GLockerGuard locker(mMutex);
+        mDedicatedCount[allocation.memoryTypeIndex]--;
+        mDedicatedBytes[allocation.memoryTypeIndex] -= allocation.size;
+        allocation = {};
+        return;
+    }
+
+    GLockerGuard locker(mMutex);
+    auto *block = (Block *) allocation.block;
+    block->free(allocation.node);
+
+    // 每种内存块最多保留一个空块，避免反复分配和释放设备内存
+    if (block->allocationCount == 0) {
+        auto &blocks = mBlocks[allocation.memoryTypeIndex];
+        auto it = std::find_if(blocks.begin(), blocks.end(), [block](Block *b) {
+            return b != block && b->allocationCount == 0
+                   && b->isImage == block->isImage && b->strategy == block->strategy;
+        });
+        if (it != blocks.end()) {
+            blocks.erase(std::find(blocks.begin(), blocks.end(), block));
+            destroyBlock(block);
+        }
+    }
+    allocation = {};
+}
+
+VkResult GVkMemoryAllocator::flush(const GVkMemoryAllocation &allocation, VkDeviceSize offset, VkDeviceSize size)
+{
+    if (allocation.memory == VK_NULL_HANDLE || !isNonCoherent(allocation.memoryTypeIndex)) {
+        return VK_SUCCESS;
+    }
+    VkMappedMemoryRange range = mappedRange(allocation, offset, size);
+    return vkFlushMappedMemoryRanges(*mDevice, 1, &range);
+}
+
+VkResult GVkMemoryAllocator::flush(uint32_t count, const GVkMemoryAllocation *const *allocations,
+                                   const VkDeviceSize *offsets, const VkDeviceSize *sizes)
+{
+    std::vector<VkMappedMemoryRange> ranges;
+    ranges.reserve(count);
+    for (uint32_t i = 0; i < count; i++) {
+        const GVkMemoryAllocation &allocation = *allocations[i];
+        if (allocation.memory == VK_NULL_HANDLE || !isNonCoherent(allocation.memoryTypeIndex)) {
+            continue;
+        }
+        ranges.push_back(mappedRange(allocation, offsets[i], sizes[i]));
+    }
+    if (ranges.empty()) {
+        return VK_SUCCESS;
+    }
+    return vkFlushMappedMemoryRanges(*mDevice, (uint32_t) ranges.size(), ranges.data());
+}
+
+VkResult GVkMemoryAllocator::invalidate(const GVkMemoryAllocation &allocation, VkDeviceSize offset,
+                                        VkDeviceSize size)
+{
+    if (allocation.memory == VK_NULL_HANDLE || !isNonCoherent(allocation.memoryTypeIndex)) {
+        return VK_SUCCESS;
+    }
+    VkMappedMemoryRange range = mappedRange(allocation, offset, size);
+    return vkInvalidateMappedMemoryRanges(*mDevice, 1, &range);
+}
+
+uint32_t GVkMemoryAllocator::deviceMemoryCount(uint32_t memoryTypeIndex)
+{
+    if (memoryTypeIndex >= VK_MAX_MEMORY_TYPES) {
+        return 0;
+    }
+    GLockerGuard locker(mMutex);
+    return (uint32_t) mBlocks[memoryTypeIndex].size() + mDedicatedCount[memoryTypeIndex];
+}
+
+VkDeviceSize GVkMemoryAllocator::deviceMemoryBytes(uint32_t memoryTypeIndex)
+{
+    if (memoryTypeIndex >= VK_MAX_MEMORY_TYPES) {
+        return 0;
+    }
+    GLockerGuard locker(mMutex);
+    VkDeviceSize bytes = mDedicatedBytes[memoryTypeIndex];
+    for (Block *block : mBlocks[memoryTypeIndex]) {
+        bytes += block->size;
+    }
+    return bytes;
+}
+
+GVkMemoryAllocator::Block *GVkMemoryAllocator::createBlock(uint32_t memoryTypeIndex, VkDeviceSize size,
+                                                           bool isImage, Strategy strategy)
+{
+    VkMemoryAllocateInfo memAllocInfo{};
+    memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    memAllocInfo.allocationSize = size;
+    memAllocInfo.memoryTypeIndex = memoryTypeIndex;
+
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkResult result = vkAllocateMemory(*mDevice, &memAllocInfo, nullptr, &memory);
+    if (result != VK_SUCCESS) {
+        Log("GVkMemoryAllocator::createBlock allocate %llu bytes failure: %d", (unsigned long long) size, result);
+        return nullptr;
+    }
+
+    auto *block = new Block();
+    block->memory = memory;
+    block->size = size;
+    block->memoryTypeIndex = memoryTypeIndex;
+    block->isImage = isImage;
+    block->strategy = strategy;
+    if (strategy == General) {
+        block->tlsf.init(size);
+    }
+
+    const auto &memProperties = mDevice->deviceMemoryProperties();
+    if (memProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+        VK_CHECK_RESULT(vkMapMemory(*mDevice, memory, 0, VK_WHOLE_SIZE, 0, &block->mapped));
+    }
+    return block;
+}
+
+void GVkMemoryAllocator::destroyBlock(Block *block)
+{
+    if (block->mapped) {
+        vkUnmapMemory(*mDevice, block->memory);
+    }
+    vkFreeMemory(*mDevice, block->memory, nullptr);
+    delete block;
+}
+
+VkResult GVkMemoryAllocator::allocateDedicated(const VkMemoryRequirements &requirements, uint32_t memoryTypeIndex,
+                                               GVkMemoryAllocation &allocation)
+{
+    VkDeviceSize size = requirements.size;
+    if (isNonCoherent(memoryTypeIndex)) {
+        size = alignUp(size, mNonCoherentAtomSize);
+    }
+
+    VkMemoryAllocateInfo memAllocInfo{};
+    memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    memAllocInfo.allocationSize = size;
+    memAllocInfo.memoryTypeIndex = memoryTypeIndex;
+
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkResult result = vkAllocateMemory(*mDevice, &memAllocInfo, nullptr, &memory);
+    if (result != VK_SUCCESS) {
+        return result;
+    }
+
+    void *mapped = nullptr;
+    const auto &memProperties = mDevice->deviceMemoryProperties();
+    if (memProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+        VK_CHECK_RESULT(vkMapMemory(*mDevice, memory, 0, VK_WHOLE_SIZE, 0, &mapped));
+    }
+
+    allocation.memory = memory;
+    allocation.offset = 0;
+    allocation.size = size;
+    allocation.memoryTypeIndex = memoryTypeIndex;
+    allocation.mapped = mapped;
+    allocation.block = nullptr;
+    allocation.node = 0;
+
+    GLockerGuard locker(mMutex);
+    mDedicatedCount[memoryTypeIndex]++;
+    mDedicatedBytes[memoryTypeIndex] += size;
+    return VK_SUCCESS;
+}
+
+VkDeviceSize GVkMemoryAllocator::blockSizeOf(uint32_t memoryTypeIndex) const
+{
+    const auto &memProperties = mDevice->deviceMemoryProperties();
+    uint32_t heapIndex = memProperties.memoryTypes[memoryTypeIndex].heapIndex;
+    return std::min(mBlockSize, memProperties.memoryHeaps[heapIndex].size / 8);
+}
+
+bool GVkMemoryAllocator::isNonCoherent(uint32_t memoryTypeIndex) const
+{
+    VkMemoryPropertyFlags flags = mDevice->deviceMemoryProperties().memoryTypes[memoryTypeIndex].propertyFlags;
+    return (flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) && !(flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+}
+
+VkMappedMemoryRange GVkMemoryAllocator::mappedRange(const GVkMemoryAllocation &allocation, VkDeviceSize offset,
+                                                    VkDeviceSize size) const
+{
+    VkDeviceSize allocEnd = allocation.offset + allocation.size;
+    VkDeviceSize begin = std::min(allocation.offset + offset, allocEnd);
+    VkDeviceSize end = size == VK_WHOLE_SIZE ? allocEnd : std::min(begin + size, allocEnd);
+
+    // 分配的起点和大小已按nonCoherentAtomSize对齐，扩展后的区间不会越过本次分配
+    begin = alignDown(begin, mNonCoherentAtomSize);
+    end = alignUp(end, mNonCoherentAtomSize);
+
+    VkMappedMemoryRange range{};
+    range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+    range.memory = allocation.memory;
+    range.offset = begin;
+    range.size = end - begin;
+    return range;
+}
+
+}
@@ -32,7 +32,7 @@ namespace gfx
 {
 
 void GVkSurfaceSwapChain::create(GVkDevice *device, VkSurfaceKHR surface, uint32_t width, uint32_t height,
-                                 bool vsync)
+                                 bool vsync, bool retireOld)
 {
     mDevice = device;
     mSurface = surface;
@@ -41,19 +41,15 @@ void GVkSurfaceSwapChain::create(GVkDevice *device, VkSurfaceKHR surface, uint32
     mHeight = height;
     mVsync = vsync;
 
-    init();
+    init(retireOld);
 }
 
 void GVkSurfaceSwapChain::destroy()
 {
+    destroyRetired();
+
     if (mHandle != VK_NULL_HANDLE) {
-        for (uint32_t i = 0; i < mImageCount; i++) {
-            if (mBuffers[i].gvkImage) {
-                mBuffers[i].gvkImage->destroy();
-                GX_DELETE(mBuffers[i].gvkImage);
-            }
-            vkDestroyImageView(*mDevice, mBuffers[i].view, nullptr);
-        }
+        destroyBuffers(mBuffers);
     }
     if (mSurface != VK_NULL_HANDLE) {
         vkDestroySwapchainKHR(*mDevice, mHandle, nullptr);
@@ -70,6 +66,21 @@ bool GVkSurfaceSwapChain::isCreated() const
     return mHandle != VK_NULL_HANDLE;
 }
 
+void GVkSurfaceSwapChain::destroyRetired()
+{
+    for (auto &retired : mRetiredSwapChains) {
+        destroyBuffers(retired.buffers);
+        vkDestroySwapchainKHR(*mDevice, retired.handle, nullptr);
+        retired.imageAvailableSemaphore.destroy();
+    }
+    mRetiredSwapChains.clear();
+}
+
+bool GVkSurfaceSwapChain::hasRetired() const
+{
+    return !mRetiredSwapChains.empty();
+}
+
 VkResult GVkSurfaceSwapChain::acquireNextImage(uint32_t *bufferIndex)
 {
     VkResult result = vkAcquireNextImageKHR(*mDevice, mHandle, UINT64_MAX, mImageAvailableSemaphore,
@@ -124,11 +135,17 @@ uint32_t GVkSurfaceSwapChain::height()
     return mHeight;
 }
 
-void GVkSurfaceSwapChain::init()
+void GVkSurfaceSwapChain::init(bool retireOld)
 {
     mColorFormat = VK_FORMAT_B8G8R8_UNORM;
 
-    mImageAvailableSemaphore.destroy();
+    // 保留旧交换链时，旧的信号量可能仍被未完成的提交等待
+    retireOld = retireOld && mHandle != VK_NULL_HANDLE;
+    GVkSemaphore oldImageAvailableSemaphore = mImageAvailableSemaphore;
+    if (!retireOld) {
+        mImageAvailableSemaphore.destroy();
+    }
+    mImageAvailableSemaphore = GVkSemaphore();
     mImageAvailableSemaphore.create(*mDevice);
 
     uint32_t formatCount;
@@ -282,14 +299,14 @@ void GVkSurfaceSwapChain::init()
     // If an existing swap chain is re-created, destroy the old swap chain
     // This also cleans up all the presentable images
     if (oldSwapchain != VK_NULL_HANDLE) {
-        for (uint32_t i = 0; i < mImageCount; i++) {
-            if (mBuffers[i].gvkImage) {
-                mBuffers[i].gvkImage->destroy();
-                GX_DELETE(mBuffers[i].gvkImage);
-            }
-            vkDestroyImageView(*mDevice, mBuffers[i].view, nullptr);
+        if (retireOld) {
+            // 旧交换链的图像可能仍在使用中，交由destroyRetired销毁
+            mRetiredSwapChains.push_back({oldSwapchain, std::move(mBuffers), oldImageAvailableSemaphore});
+            mBuffers.clear();
+        } else {
+            destroyBuffers(mBuffers);
+            vkDestroySwapchainKHR(*mDevice, oldSwapchain, nullptr);
         }
-        vkDestroySwapchainKHR(*mDevice, oldSwapchain, nullptr);
     }
     VK_CHECK_RESULT(vkGetSwapchainImagesKHR(*mDevice, mHandle, &mImageCount, nullptr));
 
@@ -333,4 +350,16 @@ void GVkSurfaceSwapChain::init()
     }
 }
 
-}
\ No newline at end of file
+void GVkSurfaceSwapChain::destroyBuffers(std::vector<GVkSwapChainBuffer> &buffers)
+{
+    for (auto &buffer : buffers) {
+        if (buffer.gvkImage) {
+            buffer.gvkImage->destroy();
+            GX_DELETE(buffer.gvkImage);
+        }
+        vkDestroyImageView(*mDevice, buffer.view, nullptr);
+    }
+    buffers.clear();
+}
+
+}
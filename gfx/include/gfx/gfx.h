@@ -25,5 +25,8 @@
 
 #include <gfx/gfx_def.h>
 #include <gfx/gfx_core.h>
+#include <gfx/gfx_frame_graph.h>
+#include <gfx/gfx_capture.h>
+#include <gfx/gfx_profiler.h>
 
 #endif //GX_GFX_H
@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2023 Gxin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef GX_GFX_CAPTURE_H
+#define GX_GFX_CAPTURE_H
+
+#include <gfx/gfx_core.h>
+
+
+namespace gfx
+{
+
+/**
+ * 指令流捕获
+ * 捕获期间提交的指令流、指令流引用的元素的创建参数和Buffer首次被引用时的内容写入捕获文件，
+ * 用于离线回放分析性能
+ *
+ * @note
+ * 上下文需要以CreateContextInfo::enableCapture创建
+ * 纹理内容不会被捕获，回放时纹理内容未定义
+ * Frame的交换链渲染目标在回放时使用相同格式的离屏纹理代替
+ */
+
+/**
+ * 开始捕获，之后提交的指令写入path
+ *
+ * @param context
+ * @param path
+ * @return
+ */
+GX_API bool beginCapture(Context context, const std::string &path);
+
+/**
+ * 结束捕获并关闭捕获文件
+ *
+ * @param context
+ * @return
+ */
+GX_API bool endCapture(Context context);
+
+GX_API bool isCapturing(Context context);
+
+struct CaptureReplayInfo
+{
+    /// 所有捕获的帧重复回放的次数
+    uint32_t loopCount = 1;
+};
+
+struct CaptureReplayResult
+{
+    uint32_t frameCount = 0;            // 捕获文件中的帧数
+    uint32_t submitCount = 0;           // 捕获文件中的提交次数
+    uint32_t elementCount = 0;          // 回放时创建的元素数量
+
+    uint64_t loadTime = 0;              // 加载捕获文件并创建元素的耗时(微秒)
+    uint64_t compileTime = 0;           // 编译所有指令缓冲的耗时(微秒)
+    std::vector<uint64_t> frameTimes;   // 每次回放一帧的耗时(微秒)，包括提交和等待GPU执行完成
+};
+
+/**
+ * 在context中回放捕获文件
+ * 指令缓冲在计时前全部编译，每帧的所有提交执行完成后才开始下一帧
+ *
+ * @param context
+ * @param path
+ * @param info
+ * @param result
+ * @return
+ */
+GX_API bool replayCapture(Context context, const std::string &path,
+                          const CaptureReplayInfo &info, CaptureReplayResult &result);
+
+}
+
+#endif //GX_GFX_CAPTURE_H
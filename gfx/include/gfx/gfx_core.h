@@ -124,6 +124,14 @@ GX_API Instance createInstance(const CreateInstanceInfo &createInfo);
 GX_API void destroyInstance(Instance);
 
 
+/**
+ * 内存堆超出预算的回调
+ *
+ * @param heapIndex 超出预算的内存堆编号
+ * @param heap      该内存堆当前的统计
+ */
+using MemoryBudgetCallback = std::function<void(uint32_t heapIndex, const MemoryHeapStatistics &heap)>;
+
 /**
  * Gfx 上下文
  */
@@ -289,6 +297,7 @@ GFX_API(Context)
 
     /**
      * 等待设备结束
+     * 同时销毁所有延迟销毁队列中的对象
      */
     GFX_API_FUNC(void waitIdle());
 
@@ -323,12 +332,40 @@ GFX_API(Context)
      * @return
      */
     GFX_API_FUNC(std::string dumpCommandBuffer(CommandBuffer commandBuffer));
+
+    /**
+     * 获取自Context创建起的累计统计信息
+     * 每帧的统计见Frame::getFrameStatistics()
+     *
+     * @return
+     */
+    GFX_API_FUNC(ContextStatistics getStatistics());
+
+    /**
+     * 获取设备内存的使用统计，包括各内存堆的预算和占用
+     *
+     * @return
+     */
+    GFX_API_FUNC(MemoryStatistics getMemoryStatistics());
+
+    /**
+     * 设置内存堆超出预算的回调
+     * 内存堆的占用超过 budget * threshold 时触发一次，回落到阈值以下后才会再次触发
+     * 回调可能在任意创建资源的线程或beginFrame()中调用
+     *
+     * @param callback
+     * @param threshold 触发阈值，相对于预算的比例
+     */
+    GFX_API_FUNC(void setMemoryBudgetCallback(const MemoryBudgetCallback &callback, float threshold = 1.0f));
 };
 
 struct CreateContextInfo
 {
     uint32_t deviceIndex;
     std::vector<DeviceEXT> exts;
+
+    /// 为true时允许捕获指令流(见gfx_capture.h)，会保留着色器代码并为所有Buffer开启回读
+    bool enableCapture = false;
 };
 
 GX_API Context createContext(Instance instance, const CreateContextInfo &createInfo);
@@ -470,6 +507,13 @@ GFX_API(Frame)
      * @return
      */
     GFX_API_FUNC(uint64_t getFrameTime());
+
+    /**
+     * 获取最近一帧的统计信息
+     *
+     * @return
+     */
+    GFX_API_FUNC(FrameStatistics getFrameStatistics());
 };
 
 /**
@@ -549,7 +593,13 @@ struct CreateRenderTargetInfo
  */
 GX_API RenderTarget createRenderTarget(Context, const CreateRenderTargetInfo &);
 
-GX_API void destroyRenderTarget(RenderTarget);
+/**
+ * 销毁渲染目标
+ *
+ * @param renderTarget
+ * @param deferred      为true时不立即销毁，待GPU执行完此前提交的指令后在beginFrame中销毁
+ */
+GX_API void destroyRenderTarget(RenderTarget renderTarget, bool deferred = false);
 
 
 /**
@@ -576,6 +626,32 @@ GFX_API(Buffer)
      */
     GFX_API_FUNC(void flush());
 
+    /**
+     * 只同步指定区间的数据，非一致性内存上只刷新该区间
+     *
+     * @param offset
+     * @param size      接受GFX_WHOLE_SIZE
+     */
+    GFX_API_FUNC(void flush(uint64_t offset, uint64_t size));
+
+    /**
+     * 使GPU写入的指定区间对主机端可见，读取GpuToCpu的Buffer前调用
+     *
+     * @param offset
+     * @param size      接受GFX_WHOLE_SIZE
+     */
+    GFX_API_FUNC(void invalidate(uint64_t offset = 0, uint64_t size = GFX_WHOLE_SIZE));
+
+    /**
+     * 标记主机端写入的区间
+     * 启用BufferMapFlag::DirtyTracking时只记录区间，在下次提交指令时合并相邻的区间后统一刷新，
+     * 否则等同于flush(offset, size)
+     *
+     * @param offset
+     * @param size      接受GFX_WHOLE_SIZE
+     */
+    GFX_API_FUNC(void markDirty(uint64_t offset, uint64_t size));
+
     /**
      * 解除映射
      */
@@ -587,11 +663,18 @@ struct CreateBufferInfo
     BufferTypeFlags type;
     BufferMemoryUsage::Enum memoryUsage;
     uint64_t size;
+    BufferMapFlags mapFlags = BufferMapFlag::None;
 };
 
 GX_API Buffer createBuffer(Context context, const CreateBufferInfo &createInfo);
 
-GX_API void destroyBuffer(Buffer buffer);
+/**
+ * 销毁Buffer
+ *
+ * @param buffer
+ * @param deferred  为true时不立即销毁，待GPU执行完此前提交的指令后在beginFrame中销毁
+ */
+GX_API void destroyBuffer(Buffer buffer, bool deferred = false);
 
 /**
  * 纹理对象
@@ -624,7 +707,7 @@ GFX_API(Texture)
     GFX_API_FUNC(uint64_t size());
 
     /**
-     * 填充数据
+     * 填充数据，只填充第0层的mip 0，其余内容保持不变
      * 数据的像素格式，大小需匹配
      *
      * @param data
@@ -633,6 +716,60 @@ GFX_API(Texture)
      */
     GFX_API_FUNC(void setData(const void *data, uint64_t size, Fence fence = GFX_NULL_HANDLE));
 
+    /**
+     * 填充一个mip等级的数据，该mip等级必须已驻留
+     * 数据按层紧密排列，大小需匹配该mip等级的尺寸
+     *
+     * @param mipLevel
+     * @param baseLayer
+     * @param layerCount
+     * @param data
+     * @param size
+     * @param fence 当用户控制同步时，传用户创建的值，上传在后台完成
+     */
+    GFX_API_FUNC(void setMipData(uint32_t mipLevel, uint32_t baseLayer, uint32_t layerCount,
+                                 const void *data, uint64_t size, Fence fence = GFX_NULL_HANDLE));
+
+    /**
+     * 更新纹理的多个区域，区域之外的内容保持不变
+     * 所有区域的数据位于同一块内存中，通过一个暂存缓冲和一个指令缓冲上传
+     *
+     * @param data
+     * @param size      data的大小
+     * @param regions   更新的区域，mip等级必须已驻留
+     * @param fence     当用户控制同步时，传用户创建的值，上传在后台完成
+     */
+    GFX_API_FUNC(void updateRegions(const void *data, uint64_t size,
+                                    const std::vector<TextureUpdateRegion> &regions,
+                                    Fence fence = GFX_NULL_HANDLE));
+
+    /**
+     * 当前驻留的最高精度mip等级
+     * 只有[residentBaseMip, mipLevels)范围内的mip占用显存，绑定和采样时更高精度的mip被截断到该等级
+     *
+     * @return
+     */
+    GFX_API_FUNC(uint32_t residentBaseMip());
+
+    /**
+     * 估算驻留[baseMip, mipLevels)所需的内存大小，用于对照内存预算决定驻留范围
+     *
+     * @param baseMip
+     * @return
+     */
+    GFX_API_FUNC(uint64_t residentSize(uint32_t baseMip));
+
+    /**
+     * 调整驻留的mip范围
+     * 重新分配只包含[baseMip, mipLevels)的图像并拷贝新旧范围共有的mip，新增的mip需通过setMipData填充
+     * 旧图像在此前提交的指令执行完成后释放，引用该纹理的指令缓冲需要重新录制
+     *
+     * @param baseMip
+     * @param fence 当用户控制同步时，传用户创建的值
+     * @return
+     */
+    GFX_API_FUNC(bool setResidentBaseMip(uint32_t baseMip, Fence fence = GFX_NULL_HANDLE));
+
     /**
      * 创建Mipmap
      * 在创建Texture时填写正确的mipLevels, 根据mipLevels创建Mipmap
@@ -667,6 +804,8 @@ struct CreateTextureInfo
     uint32_t arrayLayers;
     //! 颜色通道调换配置
     TextureSwizzleMapping swizzle;
+    //! 流式纹理创建时驻留的mip数量，从最低精度的mip开始计算，0表示全部驻留
+    uint32_t residentMipLevels = 0;
 };
 
 /**
@@ -679,7 +818,13 @@ struct CreateTextureInfo
  */
 GX_API Texture createTexture(Context context, const CreateTextureInfo &createInfo);
 
-GX_API void destroyTexture(Texture texture);
+/**
+ * 销毁纹理
+ *
+ * @param texture
+ * @param deferred  为true时不立即销毁，待GPU执行完此前提交的指令后在beginFrame中销毁
+ */
+GX_API void destroyTexture(Texture texture, bool deferred = false);
 
 
 GFX_API(Sampler)
@@ -728,6 +873,14 @@ struct CreateSamplerInfo
      */
 };
 
+/**
+ * 创建采样器
+ * 参数相同的采样器共享同一个对象(返回相同的句柄)，以引用计数管理，每次createSampler都需要对应一次destroySampler
+ *
+ * @param context
+ * @param createInfo
+ * @return
+ */
 GX_API Sampler createSampler(Context context, const CreateSamplerInfo &createInfo = {});
 
 GX_API void destroySampler(Sampler sampler);
@@ -777,8 +930,21 @@ GFX_API(ResourceBinder)
 
 GX_API ResourceBinder createResourceBinder(Context context, const ResourceLayoutInfo &layoutInfo);
 
-GX_API void destroyResourceBinder(ResourceBinder binder);
+/**
+ * 销毁资源绑定器
+ *
+ * @param binder
+ * @param deferred  为true时不立即销毁，待GPU执行完此前提交的指令后在beginFrame中销毁
+ */
+GX_API void destroyResourceBinder(ResourceBinder binder, bool deferred = false);
+
+
+/**
+ * 指令缓冲中可修补参数的句柄
+ */
+typedef uint32_t CommandPatch;
 
+#define COMMAND_PATCH_INVALID UINT32_MAX
 
 GFX_API(CommandBuffer)
 {
@@ -989,9 +1155,32 @@ GFX_API(CommandBuffer)
      */
     GFX_API_FUNC(CommandBuffer dispatchIndirect(Buffer buffer, uint32_t offset));
 
+    /**
+     * 开始无序绘制区间
+     * 区间内的绘制不保证按录制顺序执行，endSortedDraws时按管线状态、资源绑定、顶点/索引缓冲排序，
+     * 减少管线查找和绑定次数，适用于不透明物体、阴影贴图等与绘制顺序无关的场景。
+     * 需在RenderPass(或继承RenderPass的Secondary指令缓冲)中调用，区间内只能录制状态设置、资源绑定和绘制指令，
+     * 录制了其他指令时该区间按录制顺序执行
+     *
+     * @return
+     */
+    GFX_API_FUNC(CommandBuffer beginSortedDraws());
+
+    /**
+     * 结束无序绘制区间
+     * 区间结束后的绑定状态与按录制顺序执行时相同
+     *
+     * @return
+     */
+    GFX_API_FUNC(CommandBuffer endSortedDraws());
+
     /**
      * 提交次级指令
-     * 将会被提交的次级指令按提交顺序插入到当前指令缓冲区中
+     * Primary级别的指令缓冲，其指令按提交顺序插入到当前指令缓冲区中
+     * Secondary级别的指令缓冲，在当前指令缓冲编译时继承当前的RenderPass、Subpass和帧缓冲进行编译，
+     * 同一次调用中的多个Secondary指令缓冲会并行编译。
+     * 在RenderPass中执行Secondary指令缓冲时，该Subpass中只能包含executeCommands，
+     * Secondary指令缓冲的bufferCount需与当前指令缓冲相同，否则不会继承帧缓冲
      *
      * @param secondaryCmdBuffers
      * @return
@@ -1232,14 +1421,66 @@ GFX_API(CommandBuffer)
     GFX_API_FUNC(CommandBuffer copyQueryResults(Query query, uint32_t firstQuery, uint32_t queryCount,
                                                       Buffer dstBuffer, uint64_t dstOffset,
                                                       QueryResultFlags resultFlags = 0));
+
+    //! =============== Bundle =============== !//
+
+    /**
+     * 将上一条录制的指令标记为可修补
+     * 支持bindResources(动态偏移)、bindIndexBuffer、drawIndirect、drawIndexedIndirect和dispatchIndirect
+     *
+     * @return 修补句柄，上一条指令不支持修补时返回COMMAND_PATCH_INVALID
+     */
+    GFX_API_FUNC(CommandPatch markPatch());
+
+    /**
+     * 修补bindResources的动态偏移
+     * 修补后无需重新录制，下一次提交时由已录制的指令流重新编译，修补前需确保该指令缓冲已执行完成
+     *
+     * @param patch
+     * @param dynamicOffsets    数量需与录制时相同
+     */
+    GFX_API_FUNC(void patchDynamicOffsets(CommandPatch patch, const std::vector<uint32_t> &dynamicOffsets));
+
+    /**
+     * 修补bindIndexBuffer、间接绘制或间接调度指令使用的Buffer和偏移
+     * 修补后无需重新录制，下一次提交时由已录制的指令流重新编译，修补前需确保该指令缓冲已执行完成
+     *
+     * @param patch
+     * @param buffer
+     * @param offset
+     */
+    GFX_API_FUNC(void patchBuffer(CommandPatch patch, Buffer buffer, uint32_t offset));
+
+    /**
+     * 判断录制的指令是否仍然可用
+     * bundle指令缓冲引用的资源被销毁或重建(如Frame reset)后返回false，需要重新录制
+     *
+     * @return
+     */
+    GFX_API_FUNC(bool isValid());
 };
 
 struct CreateCommandBufferInfo
 {
     QueueType::Enum queueType;
     uint32_t bufferCount;
+    CommandBufferLevel::Enum level = CommandBufferLevel::Primary;
+
+    /// 为true时作为可复用的指令包(bundle)，记录引用的资源用于isValid检查，录制一次后在多帧中重复提交
+    bool bundle = false;
+
+    /// 为true时end()后立即在后台线程开始编译，提交时只在编译未完成时等待，仅对Primary有效
+    bool asyncCompile = false;
 };
 
+/**
+ * 创建指令缓冲
+ * 每个指令缓冲拥有独立的指令池，不同的指令缓冲可以在不同线程中同时录制和编译
+ *
+ * @param context
+ * @param createInfo
+ * @return
+ */
 GX_API CommandBuffer createCommandBuffer(Context context, const CreateCommandBufferInfo &createInfo);
 
 GX_API void destroyCommandBuffer(CommandBuffer obj);
@@ -1255,6 +1496,19 @@ GFX_API(Query)
      * @param flags     更多获取结果时的控制要求
      */
     GFX_API_FUNC(void getQueryResults(std::vector<uint64_t> &results, QueryResultFlags flags = 0));
+
+    /**
+     * 获取[firstQuery, firstQuery + queryCount)范围内的查询结果
+     * 不带QueryResultFlag::Wait时不会阻塞，未完成的查询结果未定义；
+     * 带QueryResultFlag::WithAvailability时每个查询返回两个值：结果和可用性(非0为可用)
+     *
+     * @param results       结果通过该容器返回，容器原本的数据会被覆盖
+     * @param firstQuery
+     * @param queryCount    QueryType为PipelineStatistics时忽略，总是返回全部统计值
+     * @param flags         更多获取结果时的控制要求
+     */
+    GFX_API_FUNC(void getQueryResults(std::vector<uint64_t> &results, uint32_t firstQuery, uint32_t queryCount,
+                                      QueryResultFlags flags = 0));
 };
 
 struct CreateQueryInfo
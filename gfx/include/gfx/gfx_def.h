@@ -59,6 +59,7 @@ struct TargetApiType
     enum Enum : uint8_t
     {
         Vulkan = 0,
+        Null,           // 不调用任何图形API，用于无GPU环境下的测试和前端CPU开销测量
 
         Count
     };
@@ -443,6 +444,8 @@ struct TextureUsage
         Storage = 0x02,            // 用于着色器可读写资源
         Attachment = 0x04,         // 资源附件，用于渲染目标（帧缓冲区，渲染结果输出）
         InputAttachment = 0x08,    // 输入附件，用于subpassInput
+        Transient = 0x10,          // 瞬态附件，需与Attachment同时使用，内容只在RenderPass内有效，不能被采样、
+                                   // 读写或拷贝，设备支持时使用延迟分配的内存(tile-based GPU上不占用实际显存)
     };
 };
 
@@ -568,6 +571,21 @@ struct BufferMemoryUsage
     };
 };
 
+/**
+ * Buffer的映射方式
+ */
+struct BufferMapFlag
+{
+    enum Enum : uint8_t
+    {
+        None = 0x00,
+        Persistent = 0x01,       // 创建时映射并保持到销毁，unmap不会解除映射
+        DirtyTracking = 0x02,    // markDirty只记录写入区间，在下次提交指令时合并后统一刷新
+    };
+};
+
+typedef uint8_t BufferMapFlags;
+
 /**
  * 渲染目标附件枚举，
  * 目前主流GPU能接受的最大颜色附件数量为8，日常使用也不会超出这个数量
@@ -609,6 +627,15 @@ struct QueueType
     };
 };
 
+struct CommandBufferLevel
+{
+    enum Enum : uint8_t
+    {
+        Primary = 0,        // 主指令缓冲，可直接提交
+        Secondary,          // 次级指令缓冲，只能通过主指令缓冲的executeCommands执行
+    };
+};
+
 struct ShaderType
 {
     enum Enum : uint8_t
@@ -1106,8 +1133,9 @@ struct SubPassInfo
 
 struct RenderPassInfo
 {
-    RenderTargetAttachmentFlags clear = RenderTargetAttachmentFlag::None;
-    RenderTargetAttachmentFlags discard = RenderTargetAttachmentFlag::None;
+    RenderTargetAttachmentFlags clear = RenderTargetAttachmentFlag::None;      // 开始时清除
+    RenderTargetAttachmentFlags discard = RenderTargetAttachmentFlag::None;    // 开始时丢弃原内容
+    RenderTargetAttachmentFlags discardEnd = RenderTargetAttachmentFlag::None; // 结束时丢弃内容，不写回内存
 
     SubPassInfo subPassInfo{};
 };
@@ -1523,6 +1551,30 @@ struct BufferImageCopyInfo
     TextureAspectFlags aspectMask;
 };
 
+/**
+ * 纹理局部更新的区域
+ */
+struct TextureUpdateRegion
+{
+    //! 区域数据在源数据中的偏移
+    uint64_t dataOffset;
+    //! 源数据每行的像素数，0表示按width紧密排列
+    uint32_t rowLength;
+    //! 源数据每层的行数，0表示按height紧密排列
+    uint32_t imageHeight;
+    uint32_t mipLevel;
+    uint32_t baseArrayLayer;
+    //! 0表示1层
+    uint32_t layerCount;
+    int32_t offsetX;
+    int32_t offsetY;
+    int32_t offsetZ;
+    uint32_t width;
+    uint32_t height;
+    //! 0表示1
+    uint32_t depth;
+};
+
 /**
  * Texture(Image)间拷贝的参数
  */
@@ -1626,6 +1678,171 @@ struct DispatchIndirectCommand
     uint32_t z;
 };
 
+/**
+ * 帧统计信息
+ * 由Frame在每次beginFrame()时结算上一帧的数据
+ */
+struct FrameStatistics
+{
+    /// 提交的指令缓冲数量
+    uint32_t submitCount;
+
+    /// 录制的Barrier指令数量(合并前)
+    uint32_t barrierCommandCount;
+
+    /// 实际生成的Barrier调用数量(合并后)
+    uint32_t barrierCount;
+
+    /// 录制或编译时因与已生效状态相同而被消除的状态指令数量
+    uint32_t redundantStateCount;
+
+    /// 编译时合并到多重间接绘制中的绘制指令数量(不含每组的第一个)
+    uint32_t mergedDrawCount;
+
+    /// 提交的指令缓冲中的指令数量，合并的绘制按合并前的数量计
+    uint32_t commandCount;
+
+    /// 提交的指令缓冲中的绘制指令数量
+    uint32_t drawCount;
+
+    /// 提交的指令缓冲中的计算调度指令数量
+    uint32_t dispatchCount;
+
+    /// 提交的指令缓冲在编译时实际绑定管线的次数
+    uint32_t pipelineBindCount;
+
+    /// 提交的指令缓冲中的RenderPass数量
+    uint32_t renderPassCount;
+
+    /// 以下为本帧期间Context上的计数，含义与ContextStatistics相同
+    uint32_t compileCount;
+    uint64_t compileTime;
+    uint32_t pipelineCacheHitCount;
+    uint32_t pipelineCacheMissCount;
+    uint64_t pipelineCreateTime;
+    uint32_t descriptorSetUpdateCount;
+    uint32_t descriptorSetAllocCount;
+    uint64_t uploadBytes;
+};
+
+/**
+ * Context的累计统计信息，自Context创建起累计
+ */
+struct ContextStatistics
+{
+    /// 向队列提交的指令缓冲数量
+    uint64_t submitCount;
+
+    /// 编译主指令缓冲的次数(二级指令缓冲的编译耗时计入所属主指令缓冲)
+    uint64_t compileCount;
+
+    /// 编译指令缓冲的耗时，单位: 微秒(us)
+    uint64_t compileTime;
+
+    /// 编译时查找管线命中缓存的次数
+    uint64_t pipelineCacheHitCount;
+
+    /// 编译时查找管线未命中缓存的次数
+    uint64_t pipelineCacheMissCount;
+
+    /// 未命中时创建管线的耗时，单位: 微秒(us)
+    uint64_t pipelineCreateTime;
+
+    /// 更新描述符集的次数
+    uint64_t descriptorSetUpdateCount;
+
+    /// 分配描述符集的次数
+    uint64_t descriptorSetAllocCount;
+
+    /// 通过Buffer::flush()和Texture::setData()上传的字节数
+    uint64_t uploadBytes;
+};
+
+/**
+ * 一类资源占用的内存
+ */
+struct MemoryResourceStatistics
+{
+    /// 资源数量
+    uint64_t count;
+
+    /// 资源占用的内存字节数(按实际分配大小，包含对齐)
+    uint64_t bytes;
+};
+
+/**
+ * 设备内存类型的分配统计
+ */
+struct MemoryTypeStatistics
+{
+    /// 所属内存堆编号
+    uint32_t heapIndex;
+
+    bool deviceLocal;
+    bool hostVisible;
+    bool hostCoherent;
+    bool hostCached;
+
+    /// 从该类型分配出的资源数量
+    uint64_t allocationCount;
+
+    /// 从该类型分配出的资源字节数
+    uint64_t allocationBytes;
+};
+
+/**
+ * 设备内存堆的使用统计
+ */
+struct MemoryHeapStatistics
+{
+    /// 内存堆总大小
+    uint64_t size;
+
+    /// 当前进程可用的内存预算，超出后可能出现性能下降或设备丢失
+    uint64_t budget;
+
+    /// 当前进程在该堆上的内存占用
+    uint64_t usage;
+
+    /// 从该堆分配出的资源数量
+    uint64_t allocationCount;
+
+    /// 从该堆分配出的资源字节数
+    uint64_t allocationBytes;
+
+    /// 在该堆上的设备内存对象(VkDeviceMemory)数量，资源从中子分配
+    uint64_t deviceMemoryCount;
+
+    /// 在该堆上的设备内存对象总字节数
+    uint64_t deviceMemoryBytes;
+
+    bool deviceLocal;
+};
+
+/**
+ * Context的内存使用统计
+ */
+struct MemoryStatistics
+{
+    std::vector<MemoryHeapStatistics> heaps;
+    std::vector<MemoryTypeStatistics> types;
+
+    /// 按内存用途区分的Buffer(Staging类型除外)
+    MemoryResourceStatistics buffers[BufferMemoryUsage::Count];
+
+    /// 非附件用途的纹理
+    MemoryResourceStatistics textures;
+
+    /// 附件用途的纹理，包括RenderTarget和Frame内部创建的附件
+    MemoryResourceStatistics attachments;
+
+    /// Staging类型的Buffer，以及内部使用的上传缓冲(如间接绘制参数缓冲)
+    MemoryResourceStatistics staging;
+
+    /// 为true时预算和占用来自驱动(VK_EXT_memory_budget)，否则为按已分配资源的估算值
+    bool budgetFromDriver;
+};
+
 }
 
 #endif //GX_GFX_DEF_H
@@ -0,0 +1,252 @@
+/*
+ * Copyright (c) 2023 Gxin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef GX_GFX_FRAME_GRAPH_H
+#define GX_GFX_FRAME_GRAPH_H
+
+#include <gfx/gfx_core.h>
+
+
+namespace gfx
+{
+
+/**
+ * 帧图(Render graph)
+ * 由Pass声明读写的资源，编译时自动剔除无用Pass、推导附件的clear/discard、插入Barrier，
+ * 并从纹理池中为临时纹理分配(生命周期不重叠的临时纹理共用同一纹理)
+ */
+GFX_API_DEFINE(FrameGraph);
+
+/**
+ * 帧图中的虚拟资源句柄
+ */
+typedef uint32_t FrameGraphResource;
+
+/**
+ * 帧图中的Pass句柄
+ */
+typedef uint32_t FrameGraphPass;
+
+#define FRAME_GRAPH_INVALID_ID UINT32_MAX
+
+/**
+ * Pass类型
+ */
+struct FrameGraphPassType
+{
+    enum Enum : uint8_t
+    {
+        Graphics = 0,       // 图形Pass，由帧图负责开始和结束RenderPass
+        Compute,            // 计算Pass
+        Transfer,           // 转移Pass
+
+        Count
+    };
+};
+
+/**
+ * Pass对资源的访问方式
+ */
+struct FrameGraphAccess
+{
+    enum Enum : uint8_t
+    {
+        Sampled = 0,                // 着色器采样
+        Storage,                    // 着色器读写
+        TransferSrc,                // 转移源
+        TransferDst,                // 转移目标
+        ColorAttachment,            // 颜色附件，使用writeColor声明
+        DepthStencilAttachment,     // 深度模板附件，使用writeDepthStencil声明
+
+        Count
+    };
+};
+
+/**
+ * Pass的录制回调
+ * Graphics类型的Pass在回调时已经处于RenderPass中
+ */
+using FrameGraphExecuteCallback = std::function<void(FrameGraph graph, CommandBuffer cmdBuffer)>;
+
+struct FrameGraphPassInfo
+{
+    /// Pass名称，同时作为Debug label
+    std::string name;
+
+    /// Pass类型
+    FrameGraphPassType::Enum type = FrameGraphPassType::Graphics;
+
+    /// 有外部副作用(如写入Buffer、回读数据)的Pass不会被剔除
+    bool sideEffect = false;
+
+    /// 清理颜色附件使用的颜色
+    ClearColor clearColor{0.0f, 0.0f, 0.0f, 0.0f};
+
+    /// 清理深度模板附件使用的值
+    float clearDepth = 1.0f;
+    uint32_t clearStencil = 0;
+};
+
+/**
+ * 帧图
+ *
+ * @note
+ * 每帧的使用流程：reset() -> 声明资源和Pass -> compile() -> execute()
+ * 资源在Pass之间的依赖关系按Pass的添加顺序确定
+ */
+GFX_API(FrameGraph)
+{
+    /**
+     * 创建临时纹理
+     * 实际纹理在compile时从纹理池中分配，仅在本帧内有效
+     *
+     * @param name
+     * @param createInfo
+     * @return
+     */
+    GFX_API_FUNC(FrameGraphResource createTexture(const std::string &name, const CreateTextureInfo &createInfo));
+
+    /**
+     * 导入外部纹理
+     * 写入导入纹理的Pass不会被剔除，执行结束后纹理会被还原到layout
+     *
+     * @param name
+     * @param texture
+     * @param layout    纹理在帧图外所处的布局
+     * @return
+     */
+    GFX_API_FUNC(FrameGraphResource importTexture(const std::string &name, Texture texture,
+                                                  ImageLayout::Enum layout));
+
+    /**
+     * 导入帧控制器的渲染目标
+     * 写入该资源的Pass不会被剔除，布局由Frame自行管理
+     *
+     * @param name
+     * @param frame
+     * @return
+     */
+    GFX_API_FUNC(FrameGraphResource importFrame(const std::string &name, Frame frame));
+
+    /**
+     * 添加Pass
+     *
+     * @param passInfo
+     * @param execute
+     * @return
+     */
+    GFX_API_FUNC(FrameGraphPass addPass(const FrameGraphPassInfo &passInfo, const FrameGraphExecuteCallback &execute));
+
+    /**
+     * 声明Pass读取资源
+     *
+     * @param pass
+     * @param resource
+     * @param access    Sampled、Storage或TransferSrc
+     */
+    GFX_API_FUNC(void read(FrameGraphPass pass, FrameGraphResource resource, FrameGraphAccess::Enum access));
+
+    /**
+     * 声明Pass写入资源
+     * 写入会保留资源原有内容，所以之前写入该资源的Pass也会被保留
+     *
+     * @param pass
+     * @param resource
+     * @param access    Storage或TransferDst
+     */
+    GFX_API_FUNC(void write(FrameGraphPass pass, FrameGraphResource resource, FrameGraphAccess::Enum access));
+
+    /**
+     * 声明Graphics Pass写入颜色附件
+     *
+     * @param pass
+     * @param resource
+     * @param index     颜色附件编号，同一Pass的编号需连续
+     * @param clear     是否在开始时清理，清理时不依赖之前的内容
+     */
+    GFX_API_FUNC(void writeColor(FrameGraphPass pass, FrameGraphResource resource, uint8_t index, bool clear));
+
+    /**
+     * 声明Graphics Pass写入深度模板附件
+     *
+     * @param pass
+     * @param resource
+     * @param clear     是否在开始时清理，清理时不依赖之前的内容
+     */
+    GFX_API_FUNC(void writeDepthStencil(FrameGraphPass pass, FrameGraphResource resource, bool clear));
+
+    /**
+     * 编译帧图
+     * 剔除Pass、分配临时纹理、推导RenderPass信息和Barrier
+     *
+     * @return
+     */
+    GFX_API_FUNC(bool compile());
+
+    /**
+     * 将编译后的帧图录制到指令缓冲
+     * cmdBuffer需要处于begin状态
+     *
+     * @param cmdBuffer
+     * @param parallel  为true时各Pass的录制回调在上下文的工作线程上并行执行，
+     *                  Graphics Pass的回调收到继承该RenderPass的Secondary指令缓冲
+     */
+    GFX_API_FUNC(void execute(CommandBuffer cmdBuffer, bool parallel = false));
+
+    /**
+     * 清空声明的资源和Pass
+     * 纹理池和渲染目标缓存会被保留
+     */
+    GFX_API_FUNC(void reset());
+
+    /**
+     * 获取资源对应的实际纹理
+     * 临时纹理仅在compile之后有效
+     *
+     * @param resource
+     * @return
+     */
+    GFX_API_FUNC(Texture getTexture(FrameGraphResource resource));
+
+    /**
+     * 判断Pass是否在编译时被剔除
+     *
+     * @param pass
+     * @return
+     */
+    GFX_API_FUNC(bool isPassCulled(FrameGraphPass pass));
+
+    /**
+     * 将编译结果输出为调试字符串
+     *
+     * @return
+     */
+    GFX_API_FUNC(std::string dump());
+};
+
+GX_API FrameGraph createFrameGraph(Context context);
+
+GX_API void destroyFrameGraph(FrameGraph graph);
+
+}
+
+#endif //GX_GFX_FRAME_GRAPH_H
@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2023 Gxin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef GX_GFX_PROFILER_H
+#define GX_GFX_PROFILER_H
+
+#include <gfx/gfx_core.h>
+
+
+namespace gfx
+{
+
+/**
+ * 性能分析器
+ * 记录CPU区间和GPU时间戳区间，用于线上统计每个Pass的GPU耗时或导出Chrome trace分析
+ *
+ * @note
+ * GPU区间由指令缓冲中的beginDebugLabel/endDebugLabel生成，只对主指令缓冲有效；
+ * 每个编译后的VkCommandBuffer持有独立的查询池，查询池分为latency+1段按帧轮转，
+ * 开启GPU采样时VkCommandBuffer在段变化的帧重新录制，以帧缓冲区数量创建的指令缓冲通常不需要重新录制；
+ * 提交latency帧之后以非阻塞方式读取结果，未执行完成的结果会被继续保留直到下次读取，不会等待GPU；
+ * GPU时间以提交时的CPU时间为起点对齐，只用于观察GPU区间的长度和相对顺序
+ */
+
+struct ProfilerInfo
+{
+    /// 是否采样GPU时间戳，设备不支持时间戳查询时忽略
+    bool gpuTimestamps = true;
+
+    /// 提交多少帧之后读取GPU时间戳结果
+    uint32_t latency = 3;
+
+    /// 缓存的最大事件数量，超出时丢弃最早的事件
+    uint32_t maxEvents = 65536;
+};
+
+struct ProfilerTrack
+{
+    enum Enum : uint8_t
+    {
+        Cpu = 0,
+        Gpu,
+    };
+};
+
+struct ProfilerEvent
+{
+    std::string name;
+    ProfilerTrack::Enum track;
+    uint32_t threadId;      // CPU区间所在的线程编号，GPU区间为0
+    uint32_t depth;         // 嵌套深度
+    uint64_t frame;         // 所在帧序号，每次Frame::beginFrame()递增
+    uint64_t beginNs;
+    uint64_t endNs;
+};
+
+/**
+ * 开启性能分析
+ * 开启前已编译的指令缓冲会在下次提交时重新编译
+ *
+ * @param context
+ * @param info
+ * @return
+ */
+GX_API bool enableProfiler(Context context, const ProfilerInfo &info = {});
+
+GX_API void disableProfiler(Context context);
+
+GX_API bool isProfilerEnabled(Context context);
+
+/**
+ * 开始当前线程的一个CPU区间，与endProfileZone成对出现
+ *
+ * @param context
+ * @param name
+ */
+GX_API void beginProfileZone(Context context, const char *name);
+
+GX_API void endProfileZone(Context context);
+
+/**
+ * 取出已收集的事件，取出后分析器中不再保留
+ * 同时以非阻塞方式读取已执行完成的GPU时间戳
+ *
+ * @param context
+ * @param events
+ */
+GX_API void takeProfilerEvents(Context context, std::vector<ProfilerEvent> &events);
+
+/**
+ * 将事件以Chrome trace(JSON)格式写入path，可在chrome://tracing或Perfetto中打开
+ *
+ * @param events
+ * @param path
+ * @return
+ */
+GX_API bool writeChromeTrace(const std::vector<ProfilerEvent> &events, const std::string &path);
+
+/**
+ * 作用域内的CPU区间
+ */
+class ProfileZone
+{
+public:
+    ProfileZone(Context context, const char *name)
+            : mContext(context)
+    {
+        beginProfileZone(mContext, name);
+    }
+
+    ~ProfileZone()
+    {
+        endProfileZone(mContext);
+    }
+
+    ProfileZone(const ProfileZone &) = delete;
+
+    ProfileZone &operator=(const ProfileZone &) = delete;
+
+private:
+    Context mContext;
+};
+
+}
+
+#endif //GX_GFX_PROFILER_H
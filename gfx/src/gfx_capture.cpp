@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2023 Gxin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <gfx/gfx_capture.h>
+#include "gfx_context.h"
+
+#include <gx/debug.h>
+
+
+namespace gfx
+{
+
+bool beginCapture(Context context, const std::string &path)
+{
+    auto *contextT = dynamic_cast<Context_T *>(context);
+    GX_ASSERT(contextT);
+    return contextT->contextP()->beginCapture(path);
+}
+
+bool endCapture(Context context)
+{
+    auto *contextT = dynamic_cast<Context_T *>(context);
+    GX_ASSERT(contextT);
+    return contextT->contextP()->endCapture();
+}
+
+bool isCapturing(Context context)
+{
+    auto *contextT = dynamic_cast<Context_T *>(context);
+    GX_ASSERT(contextT);
+    return contextT->contextP()->isCapturing();
+}
+
+bool replayCapture(Context context, const std::string &path,
+                   const CaptureReplayInfo &info, CaptureReplayResult &result)
+{
+    auto *contextT = dynamic_cast<Context_T *>(context);
+    GX_ASSERT(contextT);
+    return contextT->contextP()->replayCapture(path, info, result);
+}
+
+}
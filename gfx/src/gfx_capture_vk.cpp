@@ -0,0 +1,877 @@
+/*
+ * Copyright (c) 2023 Gxin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "gfx_capture_vk.h"
+#include "gfx_p_vk.h"
+#include "gfx_context.h"
+
+#include <gx/debug.h>
+
+#include <unordered_map>
+
+
+namespace gfx
+{
+namespace vk
+{
+
+CaptureVk::CaptureVk(ContextVk *context)
+        : mContext(context)
+{
+}
+
+CaptureVk::~CaptureVk()
+{
+    end();
+}
+
+bool CaptureVk::begin(const std::string &path)
+{
+    GLockerGuard locker(mMutex);
+
+    if (mActive) {
+        Log("CaptureVk::begin capture is already in progress");
+        return false;
+    }
+    mFile = fopen(path.c_str(), "wb");
+    if (mFile == nullptr) {
+        Log("CaptureVk::begin open %s failure", path.c_str());
+        return false;
+    }
+
+    mStream.init(&mContext->commandArena());
+    mStream.write((uint32_t) GFX_CAPTURE_MAGIC);
+    mStream.write((uint32_t) GFX_CAPTURE_VERSION);
+    flush();
+
+    mWrittenElements.clear();
+    mActive = true;
+    return true;
+}
+
+bool CaptureVk::end()
+{
+    GLockerGuard locker(mMutex);
+
+    if (!mActive) {
+        return false;
+    }
+    mActive = false;
+
+    mStream.write((uint8_t) CaptureChunk::End);
+    flush();
+    mStream.destroy();
+
+    fclose(mFile);
+    mFile = nullptr;
+    mWrittenElements.clear();
+    return true;
+}
+
+bool CaptureVk::isActive() const
+{
+    return mActive;
+}
+
+void CaptureVk::recordSubmit(CommandBufferVk *cmdBuffer, uint32_t bufferIndex)
+{
+    GLockerGuard locker(mMutex);
+
+    if (!mActive) {
+        return;
+    }
+
+    mDeviceIdle = false;
+    std::unordered_set<GfxIdxTy> writtenCmdBuffers;
+    writeCommandBuffer(cmdBuffer, writtenCmdBuffers);
+
+    mStream.write((uint8_t) CaptureChunk::Submit);
+    mStream.write(cmdBuffer->idx());
+    mStream.writeVarint(bufferIndex);
+    flush();
+}
+
+void CaptureVk::recordFrameEnd()
+{
+    GLockerGuard locker(mMutex);
+
+    if (!mActive) {
+        return;
+    }
+    mStream.write((uint8_t) CaptureChunk::FrameEnd);
+    flush();
+}
+
+void CaptureVk::writeElement(GfxIdxTy idx)
+{
+    if (mWrittenElements.count(idx) > 0) {
+        return;
+    }
+
+    switch (getElementTypeIdx(idx)) {
+        case ElementType::Buffer:
+            writeBuffer(dynamic_cast<BufferVk *>(mContext->findBufferP(idx)));
+            break;
+        case ElementType::Texture:
+            writeTexture(dynamic_cast<TextureVk *>(mContext->findTextureP(idx)));
+            break;
+        case ElementType::Sampler:
+            writeSampler(dynamic_cast<SamplerVk *>(mContext->findSamplerP(idx)));
+            break;
+        case ElementType::Shader:
+            writeShader(dynamic_cast<ShaderVk *>(mContext->findShaderP(idx)));
+            break;
+        case ElementType::Query:
+            writeQuery(dynamic_cast<QueryVk *>(mContext->findQueryP(idx)));
+            break;
+        case ElementType::RenderTarget:
+            writeRenderTarget(dynamic_cast<RenderTargetVk *>(mContext->findRenderTargetP(idx)));
+            break;
+        case ElementType::ResourceBinder:
+            writeResourceBinder(dynamic_cast<ResourceBinderVk *>(mContext->findResourceBinderP(idx)));
+            break;
+        default:
+            Log("CaptureVk::writeElement unsupported element type %d", getElementTypeIdx(idx));
+            break;
+    }
+    mWrittenElements.insert(idx);
+}
+
+void CaptureVk::writeHandle(ElementHandle *obj)
+{
+    mStream.write(obj != nullptr);
+    if (obj != nullptr) {
+        mStream.write(obj->idx());
+    }
+}
+
+void CaptureVk::writeBuffer(BufferVk *buffer)
+{
+    GX_ASSERT(buffer);
+    std::vector<uint8_t> data;
+    bool hasData = readBufferContents(buffer, data);
+
+    mStream.write((uint8_t) CaptureChunk::Buffer);
+    mStream.write(buffer->idx());
+    mStream.write(buffer->mType);
+    mStream.write((uint8_t) buffer->mMemoryUsage);
+    mStream.write(buffer->mSize);
+    mStream.write(hasData);
+    if (hasData) {
+        mStream.write(data.data(), data.size());
+    }
+}
+
+void CaptureVk::writeTexture(TextureVk *texture)
+{
+    GX_ASSERT(texture);
+    CreateTextureInfo createInfo{};
+    createInfo.type = texture->mType;
+    createInfo.format = texture->mFormat;
+    createInfo.usage = texture->mUsage;
+    createInfo.aspect = texture->mAspect;
+    createInfo.width = texture->mWidth;
+    createInfo.height = texture->mHeight;
+    createInfo.depth = texture->mDepth;
+    createInfo.mipLevels = texture->mMipLevels;
+    createInfo.arrayLayers = texture->mLayerCount;
+    createInfo.swizzle = texture->mSwizzleMapping;
+    // 按捕获时的驻留范围创建，指令中的mip等级在回放时才能对应到驻留的图像
+    createInfo.residentMipLevels = texture->mStreaming ? texture->mMipLevels - texture->mResidentBaseMip : 0;
+
+    mStream.write((uint8_t) CaptureChunk::Texture);
+    mStream.write(texture->idx());
+    mStream.write(createInfo);
+    mStream.write((uint8_t) texture->mSample);
+}
+
+void CaptureVk::writeSampler(SamplerVk *sampler)
+{
+    GX_ASSERT(sampler);
+    mStream.write((uint8_t) CaptureChunk::Sampler);
+    mStream.write(sampler->idx());
+    mStream.write(sampler->mCreateInfo.t);
+}
+
+void CaptureVk::writeShader(ShaderVk *shader)
+{
+    GX_ASSERT(shader);
+    GX_ASSERT_S(!shader->mCode.empty(), "CaptureVk::writeShader shader code is not retained");
+
+    mStream.write((uint8_t) CaptureChunk::Shader);
+    mStream.write(shader->idx());
+    mStream.write((uint8_t) shader->mType);
+    mStream.write(shader->mTag);
+    mStream.writeVarint((uint32_t) shader->mCode.size());
+    mStream.write(shader->mCode.data(), shader->mCode.size());
+}
+
+void CaptureVk::writeQuery(QueryVk *query)
+{
+    GX_ASSERT(query);
+    mStream.write((uint8_t) CaptureChunk::Query);
+    mStream.write(query->idx());
+    mStream.write((uint8_t) query->mQueryType);
+    mStream.write(query->mQueryCount);
+    mStream.write(query->mPipelineStatistics);
+}
+
+void CaptureVk::writeRenderTarget(RenderTargetVk *renderTarget)
+{
+    GX_ASSERT(renderTarget);
+
+    // 附件纹理先于渲染目标写入
+    for (auto &frameColors : renderTarget->mAttachColors) {
+        for (auto &attach : frameColors) {
+            writeElement(dynamic_cast<TextureVk *>(attach.texture)->idx());
+        }
+    }
+    if (renderTarget->mHasDepth) {
+        writeElement(dynamic_cast<TextureVk *>(renderTarget->mAttachDepth.texture)->idx());
+    }
+
+    auto writeAttachment = [this](const Attachment &attach) {
+        mStream.write(dynamic_cast<TextureVk *>(attach.texture)->idx());
+        mStream.write(attach.mipLevel);
+        mStream.write(attach.layer);
+    };
+
+    mStream.write((uint8_t) CaptureChunk::RenderTarget);
+    mStream.write(renderTarget->idx());
+    mStream.write((uint8_t) renderTarget->mSample);
+    mStream.writeVarint((uint32_t) renderTarget->mAttachColors.size());
+    mStream.writeVarint((uint32_t) renderTarget->mColorCount);
+    for (auto &frameColors : renderTarget->mAttachColors) {
+        for (auto &attach : frameColors) {
+            writeAttachment(attach);
+        }
+    }
+    mStream.write(renderTarget->mHasDepth);
+    if (renderTarget->mHasDepth) {
+        writeAttachment(renderTarget->mAttachDepth);
+    }
+}
+
+void CaptureVk::writeResourceBinder(ResourceBinderVk *binder)
+{
+    GX_ASSERT(binder);
+
+    // 绑定的资源先于绑定器写入
+    for (auto &info : binder->mBindDescInfo) {
+        std::visit([this](auto &bindInfo) {
+            using T = std::decay_t<decltype(bindInfo)>;
+            if constexpr (std::is_same_v<T, ResourceBinderVk::BindSamplerInfo>) {
+                if (bindInfo.texture) {
+                    writeElement(dynamic_cast<TextureVk *>(bindInfo.texture)->idx());
+                }
+                if (bindInfo.sampler) {
+                    writeElement(dynamic_cast<SamplerVk *>(bindInfo.sampler)->idx());
+                }
+            } else {
+                if (bindInfo.buffer) {
+                    writeElement(dynamic_cast<BufferVk *>(bindInfo.buffer)->idx());
+                }
+            }
+        }, info);
+    }
+
+    const ResourceLayoutInfo &layoutInfo = binder->mDescLayoutInfo;
+
+    mStream.write((uint8_t) CaptureChunk::ResourceBinder);
+    mStream.write(binder->idx());
+    mStream.writeVarint((uint32_t) layoutInfo.bindingInfos.size());
+    mStream.write(layoutInfo.bindingInfos.data(), sizeof(ResourceLayoutBindingInfo) * layoutInfo.bindingInfos.size());
+    mStream.writeVarint((uint32_t) binder->mBindDescInfo.size());
+    for (auto &info : binder->mBindDescInfo) {
+        mStream.write((uint8_t) info.index());
+        std::visit([this](auto &bindInfo) {
+            using T = std::decay_t<decltype(bindInfo)>;
+            mStream.write((uint8_t) bindInfo.type);
+            if constexpr (std::is_same_v<T, ResourceBinderVk::BindSamplerInfo>) {
+                writeHandle(dynamic_cast<TextureVk *>(bindInfo.texture));
+                writeHandle(dynamic_cast<SamplerVk *>(bindInfo.sampler));
+                mStream.write(bindInfo.range);
+            } else {
+                writeHandle(dynamic_cast<BufferVk *>(bindInfo.buffer));
+                mStream.write(bindInfo.offset);
+                mStream.write(bindInfo.range);
+                if constexpr (std::is_same_v<T, ResourceBinderVk::BindTexelBufferInfo>) {
+                    mStream.write((uint32_t) bindInfo.format);
+                }
+            }
+        }, info);
+    }
+}
+
+void CaptureVk::writeCommandBuffer(CommandBufferVk *cmdBuffer, std::unordered_set<GfxIdxTy> &writtenCmdBuffers)
+{
+    if (!writtenCmdBuffers.insert(cmdBuffer->idx()).second) {
+        return;
+    }
+    cmdBuffer->waitCompile();
+
+    CommandStream &cmdStream = cmdBuffer->mCommandBuffer;
+    std::vector<uint64_t> positions;
+    CommandBufferVk::collectElementPositions(cmdStream, positions);
+
+    // 引用的元素和Secondary指令缓冲先于指令流写入
+    for (uint64_t pos : positions) {
+        GfxIdxTy idx;
+        cmdStream.copy(pos, &idx, sizeof(GfxIdxTy));
+        if (getElementTypeIdx(idx) == ElementType::CommandBuffer) {
+            auto *secondary = dynamic_cast<CommandBufferVk *>(mContext->findCommandBufferP(idx));
+            GX_ASSERT_S(secondary, "CaptureVk can not find CommandBuffer from idx = %d", idx);
+            writeCommandBuffer(secondary, writtenCmdBuffers);
+        } else {
+            writeElement(idx);
+        }
+    }
+    for (auto &patch : cmdBuffer->mPatches) {
+        if (patch.patched && patch.cmdKey != CommandKey::BindDescSet) {
+            writeElement(patch.buffer);
+        }
+    }
+
+    mStream.write((uint8_t) CaptureChunk::CommandBuffer);
+    mStream.write(cmdBuffer->idx());
+    mStream.write((uint8_t) cmdBuffer->mLevel);
+    mStream.write((uint8_t) cmdBuffer->mQueueType);
+    mStream.writeVarint((uint32_t) cmdBuffer->bufferCount());
+    mStream.write(cmdStream.writePos());
+    mStream.write(cmdStream, 0, cmdStream.writePos());
+
+    mStream.writeVarint((uint32_t) cmdBuffer->mSubpassContents.size());
+    for (auto contents : cmdBuffer->mSubpassContents) {
+        mStream.write((uint32_t) contents);
+    }
+
+    mStream.writeVarint((uint32_t) cmdBuffer->mSortedRegions.size());
+    for (auto &region : cmdBuffer->mSortedRegions) {
+        mStream.write(region.beginPos);
+        mStream.write(region.endPos);
+        mStream.write(region.sorted);
+        mStream.writeVarint((uint32_t) region.commands.size());
+        mStream.write(region.commands.data(), sizeof(uint64_t) * region.commands.size());
+    }
+
+    mStream.writeVarint((uint32_t) cmdBuffer->mPatches.size());
+    for (auto &patch : cmdBuffer->mPatches) {
+        mStream.write(patch.pos);
+        mStream.write(patch.endPos);
+        mStream.write(patch.cmdKey);
+        mStream.write(patch.dynamicOffsetCount);
+        mStream.write(patch.patched);
+        mStream.writeVarint((uint32_t) patch.dynamicOffsets.size());
+        mStream.write(patch.dynamicOffsets.data(), sizeof(uint32_t) * patch.dynamicOffsets.size());
+        mStream.write(patch.buffer);
+        mStream.write(patch.offset);
+    }
+}
+
+bool CaptureVk::readBufferContents(BufferVk *buffer, std::vector<uint8_t> &data)
+{
+    if (buffer->mSize == 0) {
+        return false;
+    }
+
+    GVkContext *vkContext = mContext->vkContext();
+    // 之前提交的指令可能仍在写入Buffer，每次提交最多等待一次
+    if (!mDeviceIdle) {
+        vkContext->gvkDevice()->waitIdle();
+        mDeviceIdle = true;
+    }
+
+    GVkBuffer staging;
+    staging.create(vkContext->gvkDevice(),
+                   VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                   VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                   VK_SHARING_MODE_EXCLUSIVE,
+                   buffer->mSize);
+    if (!staging.isCreated()) {
+        Log("CaptureVk::readBufferContents create staging buffer failure");
+        return false;
+    }
+
+    GVkQueue *queue = vkContext->graphicsQueue();
+    GVkCommandPool pool;
+    pool.create(queue, VK_FLAGS_NONE);
+    VkCommandBuffer vkCmdBuffer = pool.allocateCommandBuffer();
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(vkCmdBuffer, &beginInfo);
+    VkBufferCopy region{0, 0, buffer->mSize};
+    vkCmdCopyBuffer(vkCmdBuffer, buffer->vkBuffer(), staging.vkBuffer(), 1, &region);
+    vkEndCommandBuffer(vkCmdBuffer);
+
+    GVkFence fence;
+    fence.create(queue->device(), VK_FLAGS_NONE);
+    queue->submit({}, {vkCmdBuffer}, {}, fence);
+    fence.wait();
+    fence.destroy();
+    pool.destroy();
+
+    data.resize(buffer->mSize);
+    memcpy(data.data(), staging.map(), buffer->mSize);
+    staging.unmap();
+    staging.destroy();
+    return true;
+}
+
+void CaptureVk::flush()
+{
+    if (mStream.writePos() > 0) {
+        mStream.visit(0, mStream.writePos(), [this](const uint8_t *data, uint64_t size) {
+            fwrite(data, 1, size, mFile);
+        });
+        mStream.reset();
+    }
+}
+
+/// ============ Replay ============ ///
+
+bool CaptureVk::replay(ContextVk *context, const std::string &path,
+                       const CaptureReplayInfo &info, CaptureReplayResult &result)
+{
+    result = CaptureReplayResult{};
+    GTime loadStart = GTime::currentSteadyTime();
+
+    FILE *file = fopen(path.c_str(), "rb");
+    if (file == nullptr) {
+        Log("CaptureVk::replay open %s failure", path.c_str());
+        return false;
+    }
+    fseek(file, 0, SEEK_END);
+    auto fileSize = (uint64_t) ftell(file);
+    fseek(file, 0, SEEK_SET);
+    std::vector<uint8_t> fileData(fileSize);
+    size_t readSize = fread(fileData.data(), 1, fileSize, file);
+    fclose(file);
+    if (readSize != fileSize || fileSize < sizeof(uint32_t) * 2) {
+        Log("CaptureVk::replay read %s failure", path.c_str());
+        return false;
+    }
+
+    CommandStream stream;
+    stream.init(&context->commandArena());
+    stream.write(fileData.data(), fileSize);
+    fileData = {};
+
+    uint32_t magic;
+    uint32_t version;
+    stream.read(magic);
+    stream.read(version);
+    if (magic != GFX_CAPTURE_MAGIC || version != GFX_CAPTURE_VERSION) {
+        Log("CaptureVk::replay %s is not a supported capture file", path.c_str());
+        return false;
+    }
+
+    Context_T *contextT = context->mParentCtx;
+
+    // 捕获时的idx到回放时创建的元素
+    std::unordered_map<GfxIdxTy, ElementHandle *> elements;
+    std::vector<std::pair<ElementType::Enum, ElementHandle *>> created;
+    std::vector<CommandBufferVk *> cmdBuffers;
+
+    struct ReplaySubmit
+    {
+        CommandBufferVk *cmdBuffer;
+        uint32_t bufferIndex;
+    };
+    std::vector<std::vector<ReplaySubmit>> frames(1);
+
+    auto find = [&elements](GfxIdxTy idx) -> ElementHandle * {
+        auto it = elements.find(idx);
+        if (it == elements.end()) {
+            Log("CaptureVk::replay can not find element from idx = %d", idx);
+            return nullptr;
+        }
+        return it->second;
+    };
+    auto readHandle = [&stream, &find]() -> ElementHandle * {
+        bool valid;
+        stream.read(valid);
+        if (!valid) {
+            return nullptr;
+        }
+        GfxIdxTy idx;
+        stream.read(idx);
+        return find(idx);
+    };
+    auto add = [&elements, &created](GfxIdxTy idx, ElementType::Enum type, ElementHandle *obj) {
+        elements[idx] = obj;
+        created.emplace_back(type, obj);
+    };
+
+    bool success = true;
+    bool finished = false;
+    while (success && !finished && stream.readPos() < stream.writePos()) {
+        uint8_t chunk;
+        GfxIdxTy idx;
+        stream.read(chunk);
+        if (chunk != CaptureChunk::End && chunk != CaptureChunk::FrameEnd) {
+            stream.read(idx);
+        }
+
+        switch (chunk) {
+            case CaptureChunk::End:
+                finished = true;
+                break;
+            case CaptureChunk::Buffer: {
+                CreateBufferInfo createInfo{};
+                uint8_t memoryUsage;
+                bool hasData;
+                stream.read(createInfo.type);
+                stream.read(memoryUsage);
+                stream.read(createInfo.size);
+                stream.read(hasData);
+                createInfo.memoryUsage = (BufferMemoryUsage::Enum) memoryUsage;
+
+                auto *buffer = dynamic_cast<BufferVk *>(createBuffer(contextT, createInfo));
+                add(idx, ElementType::Buffer, buffer);
+                if (hasData) {
+                    // 通过暂存缓冲上传，GpuOnly的Buffer无法直接映射
+                    Buffer staging = createBuffer(contextT, {BufferType::Staging, BufferMemoryUsage::CpuToGpu,
+                                                             createInfo.size});
+                    stream.read(staging->map(), createInfo.size);
+                    staging->flush();
+                    staging->unmap();
+
+                    CommandBuffer upload = createCommandBuffer(contextT, {QueueType::Graphics, 1});
+                    upload->begin()
+                          ->copyBuffer(staging, buffer, 0, 0, createInfo.size)
+                          ->end();
+                    contextT->submitCommandBlock(upload, 0);
+                    destroyCommandBuffer(upload);
+                    destroyBuffer(staging);
+                }
+            }
+                break;
+            case CaptureChunk::Texture: {
+                CreateTextureInfo createInfo{};
+                uint8_t sample;
+                stream.read(createInfo);
+                stream.read(sample);
+                auto *texture = contextT->contextP()->createTextureP(createInfo, (SampleCountFlag::Enum) sample);
+                add(idx, ElementType::Texture, texture);
+            }
+                break;
+            case CaptureChunk::Sampler: {
+                CreateSamplerInfo createInfo{};
+                stream.read(createInfo.t);
+                add(idx, ElementType::Sampler, dynamic_cast<SamplerVk *>(createSampler(contextT, createInfo)));
+            }
+                break;
+            case CaptureChunk::Shader: {
+                uint8_t type;
+                CreateShaderInfo createInfo{};
+                uint32_t codeSize;
+                stream.read(type);
+                stream.read(createInfo.tag);
+                stream.readVarint(codeSize);
+                std::vector<uint8_t> code(codeSize);
+                stream.read(code.data(), codeSize);
+                createInfo.type = (ShaderType::Enum) type;
+                createInfo.pCode = code.data();
+                createInfo.codeSize = codeSize;
+                add(idx, ElementType::Shader, dynamic_cast<ShaderVk *>(createShader(contextT, createInfo)));
+            }
+                break;
+            case CaptureChunk::Query: {
+                uint8_t queryType;
+                CreateQueryInfo createInfo{};
+                stream.read(queryType);
+                stream.read(createInfo.queryCount);
+                stream.read(createInfo.pipelineStatistics);
+                createInfo.queryType = (QueryType::Enum) queryType;
+                add(idx, ElementType::Query, dynamic_cast<QueryVk *>(createQuery(contextT, createInfo)));
+            }
+                break;
+            case CaptureChunk::RenderTarget: {
+                auto readAttachment = [&stream, &find](Attachment &attach) {
+                    GfxIdxTy textureIdx;
+                    stream.read(textureIdx);
+                    stream.read(attach.mipLevel);
+                    stream.read(attach.layer);
+                    attach.texture = dynamic_cast<TextureVk *>(find(textureIdx));
+                    return attach.texture != nullptr;
+                };
+
+                CreateRenderTargetInfo createInfo{};
+                uint8_t sample;
+                uint32_t frameCount;
+                uint32_t colorCount;
+                bool hasDepth;
+                stream.read(sample);
+                stream.readVarint(frameCount);
+                stream.readVarint(colorCount);
+                createInfo.sample = (SampleCountFlag::Enum) sample;
+                createInfo.colorAttachments.resize(frameCount);
+                for (auto &frameColors : createInfo.colorAttachments) {
+                    frameColors.resize(colorCount);
+                    for (auto &attach : frameColors) {
+                        success = readAttachment(attach) && success;
+                    }
+                }
+                stream.read(hasDepth);
+                if (hasDepth) {
+                    success = readAttachment(createInfo.depthStencilAttachment) && success;
+                }
+                if (success) {
+                    add(idx, ElementType::RenderTarget,
+                        dynamic_cast<RenderTargetVk *>(createRenderTarget(contextT, createInfo)));
+                }
+            }
+                break;
+            case CaptureChunk::ResourceBinder: {
+                ResourceLayoutInfo layoutInfo{};
+                uint32_t count;
+                stream.readVarint(count);
+                layoutInfo.bindingInfos.resize(count);
+                stream.read(layoutInfo.bindingInfos.data(), sizeof(ResourceLayoutBindingInfo) * count);
+                ResourceBinder binder = createResourceBinder(contextT, layoutInfo);
+                add(idx, ElementType::ResourceBinder, dynamic_cast<ResourceBinderVk *>(binder));
+
+                stream.readVarint(count);
+                for (uint32_t binding = 0; binding < count; binding++) {
+                    uint8_t kind;
+                    uint8_t type;
+                    stream.read(kind);
+                    stream.read(type);
+                    if (kind == 1) {
+                        auto *texture = dynamic_cast<TextureVk *>(readHandle());
+                        auto *sampler = dynamic_cast<SamplerVk *>(readHandle());
+                        TextureBindRange range{};
+                        stream.read(range);
+                        if (texture == nullptr) {
+                            continue;
+                        }
+                        if (type == ResourceType::InputAttachment) {
+                            binder->bindInputAttachment(binding, texture, range);
+                        } else {
+                            binder->bindTexture(binding, texture, sampler, range);
+                        }
+                    } else {
+                        auto *buffer = dynamic_cast<BufferVk *>(readHandle());
+                        uint64_t offset;
+                        uint64_t range;
+                        uint32_t format = 0;
+                        stream.read(offset);
+                        stream.read(range);
+                        if (kind == 2) {
+                            stream.read(format);
+                        }
+                        if (buffer == nullptr) {
+                            continue;
+                        }
+                        if (kind == 2) {
+                            binder->bindTexelBuffer(binding, buffer, (Format::Enum) format, offset, range);
+                        } else {
+                            binder->bindBufferRange(binding, buffer, offset, range);
+                        }
+                    }
+                }
+            }
+                break;
+            case CaptureChunk::CommandBuffer: {
+                uint8_t level;
+                uint8_t queueType;
+                uint32_t bufferCount;
+                uint64_t size;
+                stream.read(level);
+                stream.read(queueType);
+                stream.readVarint(bufferCount);
+                stream.read(size);
+
+                CreateCommandBufferInfo createInfo{};
+                createInfo.queueType = (QueueType::Enum) queueType;
+                createInfo.bufferCount = bufferCount;
+                createInfo.level = (CommandBufferLevel::Enum) level;
+                auto *cmdBuffer = dynamic_cast<CommandBufferVk *>(createCommandBuffer(contextT, createInfo));
+                cmdBuffers.push_back(cmdBuffer);
+
+                // 指令流中的元素idx替换为回放时创建的元素
+                std::vector<uint8_t> commands(size);
+                stream.read(commands.data(), size);
+                CommandStream &cmdStream = cmdBuffer->mCommandBuffer;
+                cmdStream.write(commands.data(), size);
+                std::vector<uint64_t> positions;
+                CommandBufferVk::collectElementPositions(cmdStream, positions);
+                for (uint64_t pos : positions) {
+                    GfxIdxTy elementIdx;
+                    memcpy(&elementIdx, commands.data() + pos, sizeof(GfxIdxTy));
+                    ElementHandle *obj = find(elementIdx);
+                    if (obj == nullptr) {
+                        success = false;
+                        break;
+                    }
+                    elementIdx = obj->idx();
+                    memcpy(commands.data() + pos, &elementIdx, sizeof(GfxIdxTy));
+                }
+                cmdStream.reset();
+                cmdStream.write(commands.data(), size);
+
+                uint32_t count;
+                stream.readVarint(count);
+                cmdBuffer->mSubpassContents.resize(count);
+                for (auto &contents : cmdBuffer->mSubpassContents) {
+                    uint32_t value;
+                    stream.read(value);
+                    contents = (CommandBufferVk::SubpassContents::Enum) value;
+                }
+
+                stream.readVarint(count);
+                cmdBuffer->mSortedRegions.resize(count);
+                for (auto &region : cmdBuffer->mSortedRegions) {
+                    stream.read(region.beginPos);
+                    stream.read(region.endPos);
+                    stream.read(region.sorted);
+                    uint32_t commandCount;
+                    stream.readVarint(commandCount);
+                    region.commands.resize(commandCount);
+                    stream.read(region.commands.data(), sizeof(uint64_t) * commandCount);
+                }
+
+                stream.readVarint(count);
+                cmdBuffer->mPatches.resize(count);
+                for (auto &patch : cmdBuffer->mPatches) {
+                    stream.read(patch.pos);
+                    stream.read(patch.endPos);
+                    stream.read(patch.cmdKey);
+                    stream.read(patch.dynamicOffsetCount);
+                    stream.read(patch.patched);
+                    uint32_t offsetCount;
+                    stream.readVarint(offsetCount);
+                    patch.dynamicOffsets.resize(offsetCount);
+                    stream.read(patch.dynamicOffsets.data(), sizeof(uint32_t) * offsetCount);
+                    stream.read(patch.buffer);
+                    stream.read(patch.offset);
+                    if (patch.patched && patch.cmdKey != CommandKey::BindDescSet) {
+                        ElementHandle *obj = find(patch.buffer);
+                        if (obj == nullptr) {
+                            success = false;
+                            break;
+                        }
+                        patch.buffer = obj->idx();
+                    }
+                }
+
+                // 同一指令缓冲可能被多次捕获，之后的引用使用最新的一次
+                elements[idx] = cmdBuffer;
+            }
+                break;
+            case CaptureChunk::Submit: {
+                uint32_t bufferIndex;
+                stream.readVarint(bufferIndex);
+                auto *cmdBuffer = dynamic_cast<CommandBufferVk *>(find(idx));
+                if (cmdBuffer == nullptr) {
+                    success = false;
+                    break;
+                }
+                bufferIndex = std::min(bufferIndex, (uint32_t) cmdBuffer->bufferCount() - 1);
+                frames.back().push_back({cmdBuffer, bufferIndex});
+                result.submitCount++;
+            }
+                break;
+            case CaptureChunk::FrameEnd:
+                frames.emplace_back();
+                break;
+            default:
+                Log("CaptureVk::replay unknown chunk type %d", chunk);
+                success = false;
+                break;
+        }
+    }
+    stream.destroy();
+
+    if (frames.back().empty()) {
+        frames.pop_back();
+    }
+    result.frameCount = (uint32_t) frames.size();
+    result.elementCount = (uint32_t) created.size();
+    result.loadTime = (uint64_t) GTime::currentSteadyTime().microSecsTo(loadStart);
+
+    if (success) {
+        GTime compileStart = GTime::currentSteadyTime();
+        for (auto &frame : frames) {
+            for (auto &submit : frame) {
+                if (!submit.cmdBuffer->isCompiled(submit.bufferIndex)) {
+                    submit.cmdBuffer->compile(submit.bufferIndex);
+                }
+            }
+        }
+        result.compileTime = (uint64_t) GTime::currentSteadyTime().microSecsTo(compileStart);
+
+        for (uint32_t loop = 0; loop < info.loopCount; loop++) {
+            for (auto &frame : frames) {
+                GTime frameStart = GTime::currentSteadyTime();
+                for (auto &submit : frame) {
+                    contextT->submitCommand(submit.cmdBuffer, submit.bufferIndex, GFX_NULL_HANDLE);
+                }
+                context->waitIdle();
+                result.frameTimes.push_back((uint64_t) GTime::currentSteadyTime().microSecsTo(frameStart));
+            }
+        }
+    }
+
+    context->waitIdle();
+    for (auto *cmdBuffer : cmdBuffers) {
+        destroyCommandBuffer(cmdBuffer);
+    }
+    for (auto it = created.rbegin(); it != created.rend(); ++it) {
+        ElementHandle *obj = it->second;
+        if (obj == nullptr) {
+            continue;
+        }
+        switch (it->first) {
+            case ElementType::Buffer:
+                destroyBuffer(dynamic_cast<BufferVk *>(obj));
+                break;
+            case ElementType::Texture:
+                destroyTexture(dynamic_cast<TextureVk *>(obj));
+                break;
+            case ElementType::Sampler:
+                destroySampler(dynamic_cast<SamplerVk *>(obj));
+                break;
+            case ElementType::Shader:
+                destroyShader(dynamic_cast<ShaderVk *>(obj));
+                break;
+            case ElementType::Query:
+                destroyQuery(dynamic_cast<QueryVk *>(obj));
+                break;
+            case ElementType::RenderTarget:
+                destroyRenderTarget(dynamic_cast<RenderTargetVk *>(obj));
+                break;
+            case ElementType::ResourceBinder:
+                destroyResourceBinder(dynamic_cast<ResourceBinderVk *>(obj));
+                break;
+            default:
+                break;
+        }
+    }
+
+    return success;
+}
+
+}
+}
@@ -0,0 +1,2894 @@
+/*
+ * Copyright (c) 2023 Gxin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "gfx_command_recorder.h"
+#include "gfx_context.h"
+
+#include <gx/debug.h>
+
+#include <sstream>
+#include <algorithm>
+
+
+namespace gfx
+{
+
+void CommandRecorder::initRecorder(Context_T *context, const CreateCommandBufferInfo &createInfo,
+                                   CommandArena &arena)
+{
+    mContextT = context;
+    mLevel = createInfo.level;
+    mQueueType = createInfo.queueType;
+    mIsBundle = createInfo.bundle;
+
+    // 指令流的内存块从上下文的内存池获取，销毁时归还以便复用
+    mCommandBuffer.init(&arena);
+}
+
+void CommandRecorder::destroyRecorder()
+{
+    mCommandBuffer.destroy();
+    mReferences.clear();
+    mContextT = GFX_NULL_HANDLE;
+}
+
+Context_T *CommandRecorder::context()
+{
+    return mContextT;
+}
+
+void CommandRecorder::waitCompile()
+{
+}
+
+void CommandRecorder::onEnd()
+{
+}
+
+void CommandRecorder::onPatched()
+{
+    // 已编译的指令无法修改，下一次提交时从指令流重新编译
+    mIsCompiled = false;
+}
+
+CommandBufferLevel::Enum CommandRecorder::level() const
+{
+    return mLevel;
+}
+
+void CommandCounts::count(uint8_t cmdKey)
+{
+    commandCount++;
+    switch (cmdKey) {
+        case CommandKey::Draw:
+        case CommandKey::DrawIndexed:
+        case CommandKey::DrawIndirect:
+        case CommandKey::DrawIndexedIndirect:
+            drawCount++;
+            break;
+        case CommandKey::Dispatch:
+        case CommandKey::DispatchIndirect:
+            dispatchCount++;
+            break;
+        case CommandKey::BeginRenderPass:
+            renderPassCount++;
+            break;
+        default:
+            break;
+    }
+}
+
+const CommandCounts &CommandRecorder::commandCounts() const
+{
+    return mCommandCounts;
+}
+
+void CommandRecorder::collectElementPositions(CommandStream &stream, std::vector<uint64_t> &positions,
+                                              CommandCounts *counts)
+{
+    // 与各录制函数的写入格式保持一致，只跳过参数，记录元素idx的位置
+    auto element = [&stream, &positions]() {
+        positions.push_back(stream.readPos());
+        stream.seekReadPos(SEEK_CUR, sizeof(GfxIdxTy));
+    };
+    auto skip = [&stream](uint64_t size) {
+        stream.seekReadPos(SEEK_CUR, (int64_t) size);
+    };
+    auto skipArray = [&stream, &skip](uint64_t elementSize) {
+        uint32_t count;
+        stream.read(count);
+        skip(elementSize * count);
+    };
+
+    RenderPassInfo renderPassInfo;
+    GraphicsPipelineStateInfo pipelineState;
+    VertexLayout vertexLayout;
+    std::string label;
+    uint32_t count;
+    uint32_t u32;
+    int32_t i32;
+
+    stream.seekReadPos(SEEK_SET, 0);
+    while (stream.readPos() < stream.writePos()) {
+        uint8_t cmdKey;
+        stream.read(cmdKey);
+        if (counts) {
+            counts->count(cmdKey);
+        }
+        switch (cmdKey) {
+            case CommandKey::Begin:
+            case CommandKey::End:
+            case CommandKey::EndRenderPass:
+            case CommandKey::NextSubpass:
+            case CommandKey::EndDebug:
+            case CommandKey::BeginSortedDraws:
+            case CommandKey::EndSortedDraws:
+                break;
+            case CommandKey::SetClearColor:
+                skip(sizeof(ClearColor));
+                break;
+            case CommandKey::SetClearDepSte:
+                skip(sizeof(float) + sizeof(uint32_t));
+                break;
+            case CommandKey::BindRenderTarget:
+                element();
+                break;
+            case CommandKey::BeginRenderPass:
+                skip(sizeof(Rect2D));
+                readRenderPassInfo(stream, renderPassInfo);
+                break;
+            case CommandKey::SetGraphPipelineState:
+                readGraphicsPipelineState(stream, pipelineState);
+                break;
+            case CommandKey::SetVertexLayout:
+                readVertexLayout(stream, vertexLayout);
+                break;
+            case CommandKey::SetShaders:
+                stream.readVarint(count);
+                for (uint32_t i = 0; i < count; i++) {
+                    element();
+                }
+                break;
+            case CommandKey::SetViewport:
+                skip(sizeof(Rect2D) + sizeof(float) * 2);
+                break;
+            case CommandKey::SetScissor:
+                skip(sizeof(Rect2D));
+                break;
+            case CommandKey::SetLineWidth:
+                skip(sizeof(float));
+                break;
+            case CommandKey::SetStencilCompMask:
+            case CommandKey::SetStencilWriteMask:
+            case CommandKey::SetStencilReference:
+                skip(sizeof(uint8_t) + sizeof(uint32_t));
+                break;
+            case CommandKey::BindDescSet:
+                skip(sizeof(uint8_t));
+                stream.readVarint(count);
+                for (uint32_t i = 0; i < count; i++) {
+                    element();
+                }
+                stream.readVarint(count);
+                skip(sizeof(uint32_t) * count);
+                break;
+            case CommandKey::BindVertexBuf: {
+                uint8_t size;
+                skip(sizeof(uint32_t));
+                stream.read(size);
+                for (uint32_t i = 0; i < size; i++) {
+                    element();
+                }
+                skip(sizeof(uint64_t) * size);
+            }
+                break;
+            case CommandKey::BindIndexBuf:
+                element();
+                skip(sizeof(uint32_t) + sizeof(IndexType::Enum));
+                break;
+            case CommandKey::Draw:
+                for (uint32_t i = 0; i < 4; i++) {
+                    stream.readVarint(u32);
+                }
+                break;
+            case CommandKey::DrawIndexed:
+                stream.readVarint(u32);
+                stream.readVarint(u32);
+                stream.readVarint(u32);
+                stream.readVarint(i32);
+                stream.readVarint(u32);
+                break;
+            case CommandKey::DrawIndirect:
+            case CommandKey::DrawIndexedIndirect:
+                element();
+                skip(sizeof(uint32_t) * 3);
+                break;
+            case CommandKey::Dispatch:
+                skip(sizeof(uint32_t) * 3);
+                break;
+            case CommandKey::DispatchIndirect:
+                element();
+                skip(sizeof(uint32_t));
+                break;
+            case CommandKey::PipelineBarrier:
+                skip(sizeof(PipelineStageMask) * 2);
+                break;
+            case CommandKey::BufferBarrier:
+                element();
+                skip(sizeof(BufferBarrierInfo));
+                break;
+            case CommandKey::ImageBarrier:
+                element();
+                skip(sizeof(uint8_t) * 2 + sizeof(ImageSubResourceRange));
+                break;
+            case CommandKey::CopyBuffer:
+                element();
+                element();
+                skip(sizeof(uint64_t) * 3);
+                break;
+            case CommandKey::CopyImage:
+                element();
+                element();
+                skipArray(sizeof(ImageCopyInfo));
+                break;
+            case CommandKey::CopyBufferToImage:
+            case CommandKey::CopyImageToBuffer:
+                element();
+                element();
+                skipArray(sizeof(BufferImageCopyInfo));
+                break;
+            case CommandKey::BlitImage:
+                element();
+                element();
+                skip(sizeof(uint8_t));
+                skipArray(sizeof(ImageBlitInfo));
+                break;
+            case CommandKey::CopyRT:
+                element();
+                element();
+                skip(sizeof(uint8_t));
+                skipArray(sizeof(ImageCopyInfo));
+                break;
+            case CommandKey::BlitRT:
+                element();
+                element();
+                skip(sizeof(uint8_t) * 2);
+                skipArray(sizeof(ImageBlitInfo));
+                break;
+            case CommandKey::BlitRTToImage:
+                element();
+                element();
+                skip(sizeof(uint8_t) * 3);
+                skipArray(sizeof(ImageBlitInfo));
+                break;
+            case CommandKey::CopyRTToImage:
+                element();
+                element();
+                skip(sizeof(uint8_t) * 2);
+                skipArray(sizeof(ImageCopyInfo));
+                break;
+            case CommandKey::CopyRTToBuffer:
+                element();
+                element();
+                skip(sizeof(uint8_t) * 2);
+                skipArray(sizeof(BufferImageCopyInfo));
+                break;
+            case CommandKey::FillBuffer:
+                element();
+                skip(sizeof(uint64_t) * 2 + sizeof(uint32_t));
+                break;
+            case CommandKey::BeginDebug:
+                stream.read(label);
+                break;
+            case CommandKey::ResetQuery:
+                element();
+                skip(sizeof(uint32_t) * 2);
+                break;
+            case CommandKey::BeginQuery:
+                element();
+                skip(sizeof(uint32_t) + sizeof(bool));
+                break;
+            case CommandKey::EndQuery:
+                element();
+                skip(sizeof(uint32_t));
+                break;
+            case CommandKey::WriteTimestamp:
+                skip(sizeof(uint32_t));
+                element();
+                skip(sizeof(uint32_t));
+                break;
+            case CommandKey::CopyQueryResults:
+                element();
+                skip(sizeof(uint32_t) * 2);
+                element();
+                skip(sizeof(uint64_t) + sizeof(QueryResultFlags));
+                break;
+            case CommandKey::ExecuteCommands:
+                stream.readVarint(count);
+                for (uint32_t i = 0; i < count; i++) {
+                    element();
+                }
+                break;
+            default:
+                GX_ASSERT_S(false, "CommandRecorder::collectElementPositions unknown command key %d", cmdKey);
+                return;
+        }
+    }
+}
+
+std::string CommandRecorder::dump()
+{
+    waitCompile();
+    if (mCommandBuffer.writePos() == 0) {
+        return "";
+    }
+
+    GX_ASSERT_S(!mIsBegun, "Call end first to finish writing to the command buffer");
+
+    if (mIsBegun) {
+        return "";
+    }
+
+    mCommandBuffer.seekReadPos(SEEK_SET, 0);
+
+    std::ostringstream out;
+
+    uint8_t cmdKey;
+    do {
+        const uint64_t cmdPos = mCommandBuffer.readPos();
+        mCommandBuffer.read(cmdKey);
+
+        if (cmdKey >= CommandKey::Count) {
+            out << CommandKeyStr[CommandKey::None] << std::endl;
+        } else {
+            out << CommandKeyStr[cmdKey] << std::endl;
+        }
+
+        dumpCommand(out, cmdKey, cmdPos);
+    } while (cmdKey != CommandKey::End);
+
+    return out.str();
+}
+
+void CommandRecorder::dumpCommand(std::ostringstream &out, uint8_t cmdKey, uint64_t cmdPos)
+{
+    switch (cmdKey) {
+        case CommandKey::SetClearColor: {
+            ClearColor cc{};
+            mCommandBuffer.read(cc);
+
+            out << "    {" << "clearColor: {"
+                << "r: " << cc.r
+                << ", g: " << cc.g
+                << ", b: " << cc.b
+                << ", a: " << cc.a
+                << "}}" << std::endl;
+        }
+            break;
+        case CommandKey::SetClearDepSte: {
+            float depth;
+            uint32_t stencil;
+            mCommandBuffer.read(depth);
+            mCommandBuffer.read(stencil);
+
+            out << "    {"
+                << "depth: " << depth
+                << ", stencil: "
+                << stencil
+                << "}" << std::endl;
+        }
+            break;
+        case CommandKey::BindRenderTarget: {
+            GfxIdxTy idx;
+            mCommandBuffer.read(idx);
+
+            out << "    {" << "idx: " << idx << "}" << std::endl;
+        }
+            break;
+        case CommandKey::BeginRenderPass: {
+            Rect2D renderArea{};
+            mCommandBuffer.read(renderArea);
+
+            out << "    {" << "renderArea: {"
+                << "x: " << renderArea.x << ", "
+                << "y: " << renderArea.y << ", "
+                << "width: " << renderArea.width << ", "
+                << "height: " << renderArea.height << "}"
+                << "}" << std::endl;
+        }
+            break;
+        case CommandKey::SetGraphPipelineState: {
+            GraphicsPipelineStateInfo stateInfo{};
+            readGraphicsPipelineState(mCommandBuffer, stateInfo);
+
+            out << "    {" << "stateInfo: {"
+                << "rasterStateInfo: {"
+                << "polygonMode: " << (int) stateInfo.rasterStateInfo.polygonMode
+                << ", primitive: " << (int) stateInfo.rasterStateInfo.primitive
+                << ", cullMode: " << (int) stateInfo.rasterStateInfo.cullMode
+                << ", frontFace: " << (int) stateInfo.rasterStateInfo.frontFace
+                << ", colorBlendOp: " << (int) stateInfo.rasterStateInfo.colorBlendOp
+                << ", primitiveRestartEnable: " << (int) stateInfo.rasterStateInfo.primitiveRestartEnable
+                << ", alphaBlendOp: " << (int) stateInfo.rasterStateInfo.alphaBlendOp
+                << ", logicOp: " << (int) stateInfo.rasterStateInfo.logicOp
+                << ", srcColorBlendFactor: " << (int) stateInfo.rasterStateInfo.srcColorBlendFactor
+                << ", srcAlphaBlendFactor: " << (int) stateInfo.rasterStateInfo.srcAlphaBlendFactor
+                << ", dstColorBlendFactor: " << (int) stateInfo.rasterStateInfo.dstColorBlendFactor
+                << ", dstAlphaBlendFactor: " << (int) stateInfo.rasterStateInfo.dstAlphaBlendFactor
+                << ", colorWriteMask: " << (int) stateInfo.rasterStateInfo.colorWriteMask
+                << ", logicOpEnable: " << (int) stateInfo.rasterStateInfo.logicOpEnable
+                << ", depthTestEnable: " << (int) stateInfo.rasterStateInfo.depthTestEnable
+                << ", depthWriteEnable: " << (int) stateInfo.rasterStateInfo.depthWriteEnable
+                << ", stencilTestEnable: " << (int) stateInfo.rasterStateInfo.stencilTestEnable
+                << ", depthCompareOp: " << (int) stateInfo.rasterStateInfo.depthCompareOp
+                << ", sampleShadingEnable: " << (int) stateInfo.rasterStateInfo.sampleShadingEnable
+                << ", conservativeEnable: " << (int) stateInfo.rasterStateInfo.conservativeEnable
+                << ", alphaToCoverageEnable: " << (int) stateInfo.rasterStateInfo.alphaToCoverageEnable
+                << ", alphaToOneEnable: " << (int) stateInfo.rasterStateInfo.alphaToOneEnable
+                << "},"
+                << "paramValueInfo: {"
+                << "depthBiasConstantFactor: " << stateInfo.paramValueInfo.depthBiasConstantFactor
+                << ", depthBiasClamp: " << stateInfo.paramValueInfo.depthBiasClamp
+                << ", depthBiasSlopeFactor: " << stateInfo.paramValueInfo.depthBiasSlopeFactor
+                << ", frontStencilOp: {failOp: " << (int) stateInfo.paramValueInfo.frontStencilOp.failOp
+                << ", passOp: " << (int) stateInfo.paramValueInfo.frontStencilOp.passOp
+                << ", depthFailOp: " << (int) stateInfo.paramValueInfo.frontStencilOp.depthFailOp
+                << ", compareOp: " << (int) stateInfo.paramValueInfo.frontStencilOp.compareOp
+                << "}"
+                << ", backStencilOp: {failOp: " << (int) stateInfo.paramValueInfo.backStencilOp.failOp
+                << ", passOp: " << (int) stateInfo.paramValueInfo.backStencilOp.passOp
+                << ", depthFailOp: " << (int) stateInfo.paramValueInfo.backStencilOp.depthFailOp
+                << ", compareOp: " << (int) stateInfo.paramValueInfo.backStencilOp.compareOp
+                << "}"
+                << ", tessellationPatchControlPoints: " << stateInfo.paramValueInfo.tessellationPatchControlPoints
+                << "}"
+                << "}"
+                << "}" << std::endl;
+        }
+            break;
+        case CommandKey::SetVertexLayout: {
+            VertexLayout vertexLayout{};
+            readVertexLayout(mCommandBuffer, vertexLayout);
+
+            out << "    {";
+            out << "vertexInputBindingInfos: [";
+            int iindex = 0;
+            for (auto &info : vertexLayout.vertexInputBindingInfos) {
+                if (info.stride > 0) {
+                    if (iindex > 0) {
+                        out << ", ";
+                    }
+                    iindex++;
+                    out << "{"
+                        << "binding: " << (int) info.binding
+                        << ", inputRate: " << (int) info.inputRate
+                        << ", stride: " << (int) info.stride
+                        << "}";
+                }
+            }
+            out << "]"
+                << ", vertexInputAttributeDescInfos: [";
+            iindex = 0;
+            for (auto &info : vertexLayout.vertexInputAttributeDescInfos) {
+                if (info.use) {
+                    if (iindex > 0) {
+                        out << ", ";
+                    }
+                    iindex++;
+                    out << "{"
+                        << "binding: " << (int) info.binding
+                        << ", location: " << (int) info.location
+                        << ", attrib: " << (int) info.attrib
+                        << ", normalized: " << (info.normalized ? "true" : "false")
+                        << ", offset: " << info.offset
+                        << "}";
+                }
+            }
+            out << "]";
+            out << "}" << std::endl;
+        }
+            break;
+        case CommandKey::SetShaders: {
+            uint32_t size;
+            GfxIdxTy idx;
+
+            out << "    {shaders: [";
+
+            mCommandBuffer.readVarint(size);
+            for (uint32_t k = 0; k < size; k++) {
+                if (k != 0) {
+                    out << ", ";
+                }
+                mCommandBuffer.read(idx);
+                out << idx;
+            }
+            out << "]}" << std::endl;
+        }
+            break;
+        case CommandKey::SetViewport: {
+            Rect2D viewport{};
+            float minDepth;
+            float maxDepth;
+
+            mCommandBuffer.read(viewport);
+            mCommandBuffer.read(minDepth);
+            mCommandBuffer.read(maxDepth);
+
+            out << "    {" << "viewport: {"
+                << "x: " << viewport.x
+                << ", y: " << viewport.y
+                << ", width: " << viewport.width
+                << ", height: " << viewport.height
+                << ", minDepth: " << minDepth
+                << ", maxDepth: " << maxDepth
+                << "}" << std::endl;
+        }
+            break;
+        case CommandKey::SetScissor: {
+            Rect2D scissor{};
+            mCommandBuffer.read(scissor);
+
+            out << "    {" << "scissor: {"
+                << "x: " << scissor.x
+                << ", y: " << scissor.y
+                << ", width: " << scissor.width
+                << ", height: " << scissor.height
+                << "}" << std::endl;
+        }
+            break;
+        case CommandKey::SetLineWidth: {
+            float lineWidth;
+            mCommandBuffer.read(lineWidth);
+
+            out << "    {" << "lineWidth: " << lineWidth << "}" << std::endl;
+        }
+            break;
+        case CommandKey::SetStencilCompMask: {
+            uint8_t face;
+            uint32_t mask;
+            mCommandBuffer.read(face);
+            mCommandBuffer.read(mask);
+
+            out << "    {"
+                << "face: " << (int) face
+                << ", mask: " << std::hex << "0x" << mask << std::dec
+                << "}" << std::endl;
+        }
+            break;
+        case CommandKey::SetStencilWriteMask: {
+            uint8_t face;
+            uint32_t mask;
+            mCommandBuffer.read(face);
+            mCommandBuffer.read(mask);
+
+            out << "    {"
+                << "face: " << (int) face
+                << ", mask: " << std::hex << "0x" << mask << std::dec
+                << "}" << std::endl;
+        }
+            break;
+        case CommandKey::SetStencilReference: {
+            uint8_t face;
+            uint32_t reference;
+            mCommandBuffer.read(face);
+            mCommandBuffer.read(reference);
+
+            out << "    {"
+                << "face: " << (int) face
+                << ", reference: " << std::hex << "0x" << reference << std::dec
+                << "}" << std::endl;
+        }
+            break;
+        case CommandKey::BindDescSet: {
+            uint8_t bindPoint;
+            uint32_t binderSize;
+
+            mCommandBuffer.read(bindPoint);
+            mCommandBuffer.readVarint(binderSize);
+
+            out << "    {"
+                << "bindPoint: " << (uint32_t)bindPoint
+                << ", binders: [";
+
+            for (uint32_t x = 0; x < binderSize; x++) {
+                GfxIdxTy idx;
+                mCommandBuffer.read(idx);
+                if (x != 0) {
+                    out << ", ";
+                }
+                out << idx;
+            }
+
+            out << "]"
+                << ", offsets = [";
+
+            uint32_t offsetSize;
+
+            mCommandBuffer.readVarint(offsetSize);
+            for (uint32_t x = 0; x < offsetSize; x++) {
+                uint32_t offset;
+                mCommandBuffer.read(offset);
+                if (x != 0) {
+                    out << ", ";
+                }
+                out << offset;
+            }
+
+            out << "]}" << std::endl;
+        }
+            break;
+        case CommandKey::BindVertexBuf: {
+            uint32_t firstBinding;
+            uint8_t size;
+
+            mCommandBuffer.read(firstBinding);
+            mCommandBuffer.read(size);
+            GX_ASSERT(size > 0);
+
+            out << "    {"
+                << "firstBinding: " << firstBinding
+                << ", buffers: [";
+
+            for (uint32_t x = 0; x < size; x++) {
+                GfxIdxTy idx;
+                mCommandBuffer.read(idx);
+
+                if (x > 0) {
+                    out << ", ";
+                }
+                out << idx;
+            }
+            out << "], offsets: [";
+            for (uint32_t x = 0; x < size; x++) {
+                uint64_t offset;
+                mCommandBuffer.read(offset);
+                if (x > 0) {
+                    out << ", ";
+                }
+                out << offset;
+            }
+            out << "]}" << std::endl;
+        }
+            break;
+        case CommandKey::BindIndexBuf: {
+            GfxIdxTy idx;
+            uint32_t offset;
+            IndexType::Enum indexType;
+            mCommandBuffer.read(idx);
+            mCommandBuffer.read(offset);
+            mCommandBuffer.read(indexType);
+
+            out << "    {"
+                << "buffer: " << idx
+                << ", offset: " << offset
+                << ", indexType: " << (int) indexType
+                << "}" << std::endl;
+        }
+            break;
+        case CommandKey::Draw: {
+            uint32_t vertexCount;
+            uint32_t instanceCount;
+            uint32_t firstVertex;
+            uint32_t firstInstance;
+            mCommandBuffer.readVarint(vertexCount);
+            mCommandBuffer.readVarint(instanceCount);
+            mCommandBuffer.readVarint(firstVertex);
+            mCommandBuffer.readVarint(firstInstance);
+
+            out << "    {"
+                << "vertexCount: " << vertexCount
+                << ", instanceCount: " << instanceCount
+                << ", firstVertex: " << firstVertex
+                << ", firstInstance: " << firstInstance
+                << "}" << std::endl;
+        }
+            break;
+        case CommandKey::DrawIndexed: {
+            uint32_t indexCount;
+            uint32_t instanceCount;
+            uint32_t firstIndex;
+            int32_t vertexOffset;
+            uint32_t firstInstance;
+            mCommandBuffer.readVarint(indexCount);
+            mCommandBuffer.readVarint(instanceCount);
+            mCommandBuffer.readVarint(firstIndex);
+            mCommandBuffer.readVarint(vertexOffset);
+            mCommandBuffer.readVarint(firstInstance);
+
+            out << "    {"
+                << "indexCount: " << indexCount
+                << ", instanceCount: " << instanceCount
+                << ", firstIndex: " << firstIndex
+                << ", vertexOffset: " << vertexOffset
+                << ", firstInstance: " << firstInstance
+                << "}" << std::endl;
+        }
+            break;
+        case CommandKey::DrawIndirect: {
+            GfxIdxTy idx;
+            uint32_t offset;
+            uint32_t drawCount;
+            uint32_t stride;
+
+            mCommandBuffer.read(idx);
+            mCommandBuffer.read(offset);
+            mCommandBuffer.read(drawCount);
+            mCommandBuffer.read(stride);
+
+            out << "    {"
+                << "buffer: " << idx
+                << ", offset: " << offset
+                << ", drawCount: " << drawCount
+                << ", stride: " << stride
+                << "}" << std::endl;
+        }
+            break;
+        case CommandKey::DrawIndexedIndirect: {
+            GfxIdxTy idx;
+            uint32_t offset;
+            uint32_t drawCount;
+            uint32_t stride;
+
+            mCommandBuffer.read(idx);
+            mCommandBuffer.read(offset);
+            mCommandBuffer.read(drawCount);
+            mCommandBuffer.read(stride);
+
+            out << "    {"
+                << "buffer: " << idx
+                << ", offset: " << offset
+                << ", drawCount: " << drawCount
+                << ", stride: " << stride
+                << "}" << std::endl;
+        }
+            break;
+        case CommandKey::Dispatch: {
+            uint32_t groupCountX;
+            uint32_t groupCountY;
+            uint32_t groupCountZ;
+
+            mCommandBuffer.read(groupCountX);
+            mCommandBuffer.read(groupCountY);
+            mCommandBuffer.read(groupCountZ);
+
+            out << "    {"
+                << "groupCountX: " << groupCountX
+                << ", groupCountY: " << groupCountY
+                << ", groupCountZ: " << groupCountZ
+                << "}" << std::endl;
+        }
+            break;
+        case CommandKey::DispatchIndirect: {
+            GfxIdxTy idx;
+            uint32_t offset;
+
+            mCommandBuffer.read(idx);
+            mCommandBuffer.read(offset);
+
+            out << "    {"
+                << "buffer: " << idx
+                << ", offset: " << offset
+                << "}" << std::endl;
+        }
+            break;
+        case CommandKey::PipelineBarrier: {
+            PipelineStageMask srcStage;
+            PipelineStageMask dstStage;
+
+            mCommandBuffer.read(srcStage);
+            mCommandBuffer.read(dstStage);
+
+            out << "    {"
+                << "srcStage: " << std::hex << srcStage
+                << ", dstStage: " << dstStage << std::dec
+                << "}" << std::endl;
+        }
+            break;
+        case CommandKey::BufferBarrier: {
+            GfxIdxTy idx;
+            BufferBarrierInfo barrierInfo{};
+
+            mCommandBuffer.read(idx);
+            mCommandBuffer.read(barrierInfo);
+
+            out << "    {"
+                << "idx: " << idx
+                << ", barrierInfo: " << "{"
+                << "srcStage: " << std::hex << barrierInfo.srcStage
+                << ", dstStage: " << std::hex << barrierInfo.dstStage
+                << ", srcAccess: " << std::hex << barrierInfo.srcAccess
+                << ", dstAccess: " << std::hex << barrierInfo.dstAccess
+                << ", srcQueue: " << std::dec << barrierInfo.srcQueue
+                << ", dstQueue: " << std::dec << barrierInfo.dstQueue
+                << "}"
+                << "}" << std::endl;
+        }
+            break;
+        case CommandKey::ImageBarrier: {
+            GfxIdxTy idx;
+            uint8_t srcLayout;
+            uint8_t dstLayout;
+            ImageSubResourceRange subResRange{};
+
+            mCommandBuffer.read(idx);
+            mCommandBuffer.read(srcLayout);
+            mCommandBuffer.read(dstLayout);
+            mCommandBuffer.read(subResRange);
+
+            out << "    {"
+                << "idx: " << idx
+                << ", srcLayout: " << (int) srcLayout
+                << ", dstLayout: " << (int) dstLayout
+                << ", subResRange: {"
+                << "baseMipLevel: " << subResRange.baseMipLevel
+                << ", levelCount: " << subResRange.levelCount
+                << ", baseArrayLayer: " << subResRange.baseArrayLayer
+                << ", layerCount: " << subResRange.layerCount
+                << "}"
+                << "}" << std::endl;
+        }
+            break;
+        case CommandKey::CopyBuffer: {
+            GfxIdxTy srcIdx;
+            GfxIdxTy dstIdx;
+            uint64_t srcOffset;
+            uint64_t dstOffset;
+            uint64_t size;
+
+            mCommandBuffer.read(srcIdx);
+            mCommandBuffer.read(dstIdx);
+            mCommandBuffer.read(srcOffset);
+            mCommandBuffer.read(dstOffset);
+            mCommandBuffer.read(size);
+
+            out << "    {"
+                << "srcIdx: " << srcIdx
+                << ", dstIdx: " << dstIdx
+                << ", srcOffset: " << srcOffset
+                << ", dstOffset: " << dstOffset
+                << ", size: " << size
+                << "}" << std::endl;
+        }
+            break;
+        case CommandKey::CopyImage: {
+            GfxIdxTy srcIdx;
+            GfxIdxTy dstIdx;
+            uint32_t copyInfoSize;
+            mCommandBuffer.read(srcIdx);
+            mCommandBuffer.read(dstIdx);
+            mCommandBuffer.read(copyInfoSize);
+
+            out << "    {"
+                << "srcIdx: " << srcIdx
+                << ", dstIdx: " << dstIdx
+                << " ImageCopyInfos: [";
+
+            if (copyInfoSize > 0) {
+                ImageCopyInfo copyInfo{};
+                for (uint32_t x = 0; x < copyInfoSize; x++) {
+                    mCommandBuffer.read(copyInfo);
+
+                    if (x > 0) {
+                        out << ", ";
+                    }
+                    out << "{"
+                        << "srcMipLevel: " << copyInfo.srcMipLevel
+                        << ", srcBaseArrayLayer: " << copyInfo.srcBaseArrayLayer
+                        << ", srcLayerCount: " << copyInfo.srcLayerCount
+                        << ", srcOffsetX: " << copyInfo.srcOffsetX
+                        << ", srcOffsetY: " << copyInfo.srcOffsetY
+                        << ", srcOffsetZ: " << copyInfo.srcOffsetZ
+                        << ", dstMipLevel: " << copyInfo.dstMipLevel
+                        << ", dstBaseArrayLayer: " << copyInfo.dstBaseArrayLayer
+                        << ", dstLayerCount: " << copyInfo.dstLayerCount
+                        << ", dstOffsetX: " << copyInfo.dstOffsetX
+                        << ", dstOffsetY: " << copyInfo.dstOffsetY
+                        << ", dstOffsetZ: " << copyInfo.dstOffsetZ
+                        << ", imageWidth: " << copyInfo.imageWidth
+                        << ", imageHeight: " << copyInfo.imageHeight
+                        << ", imageDepth: " << copyInfo.imageDepth
+                        << ", srcAspectMask: " << copyInfo.srcAspectMask
+                        << ", dstAspectMask: " << copyInfo.dstAspectMask
+                        << "}";
+                }
+            }
+            out << "]"
+                << "}" << std::endl;
+        }
+            break;
+        case CommandKey::CopyBufferToImage: {
+            GfxIdxTy srcIdx;
+            GfxIdxTy dstIdx;
+            uint32_t copyInfoSize;
+            mCommandBuffer.read(srcIdx);
+            mCommandBuffer.read(dstIdx);
+            mCommandBuffer.read(copyInfoSize);
+
+            out << "    {"
+                << "srcIdx: " << srcIdx
+                << ", dstIdx: " << dstIdx
+                << " BufferImageCopyInfos: [";
+
+            if (copyInfoSize > 0) {
+                BufferImageCopyInfo tempInfo{};
+                for (uint32_t x = 0; x < copyInfoSize; x++) {
+                    mCommandBuffer.read(tempInfo);
+                    if (x > 0) {
+                        out << ", ";
+                    }
+                    out << "{"
+                        << "bufferOffset: " << tempInfo.bufferOffset
+                        << ", bufferRowLength: " << tempInfo.bufferRowLength
+                        << ", bufferImageHeight: " << tempInfo.bufferImageHeight
+                        << ", mipLevel: " << tempInfo.mipLevel
+                        << ", baseArrayLayer: " << tempInfo.baseArrayLayer
+                        << ", layerCount: " << tempInfo.layerCount
+                        << ", imageOffsetX: " << tempInfo.imageOffsetX
+                        << ", imageOffsetY: " << tempInfo.imageOffsetY
+                        << ", imageOffsetZ: " << tempInfo.imageOffsetZ
+                        << ", imageWidth: " << tempInfo.imageWidth
+                        << ", imageHeight: " << tempInfo.imageHeight
+                        << ", imageDepth: " << tempInfo.imageDepth
+                        << ", aspectMask: " << std::hex << (uint32_t)tempInfo.aspectMask << std::dec
+                        << "}";
+                }
+            }
+            out << "]"
+                << "}" << std::endl;
+        }
+            break;
+        case CommandKey::CopyImageToBuffer: {
+            GfxIdxTy srcIdx;
+            GfxIdxTy dstIdx;
+            uint32_t copyInfoSize;
+            mCommandBuffer.read(srcIdx);
+            mCommandBuffer.read(dstIdx);
+            mCommandBuffer.read(copyInfoSize);
+
+            out << "    {"
+                << "srcIdx: " << srcIdx
+                << ", dstIdx: " << dstIdx
+                << ", BufferImageCopyInfos: [";
+
+            if (copyInfoSize > 0) {
+                BufferImageCopyInfo tempInfo{};
+                for (uint32_t x = 0; x < copyInfoSize; x++) {
+                    mCommandBuffer.read(tempInfo);
+                    if (x > 0) {
+                        out << ", ";
+                    }
+                    out << "{"
+                        << "bufferOffset: " << tempInfo.bufferOffset
+                        << ", bufferRowLength: " << tempInfo.bufferRowLength
+                        << ", bufferImageHeight: " << tempInfo.bufferImageHeight
+                        << ", mipLevel: " << tempInfo.mipLevel
+                        << ", baseArrayLayer: " << tempInfo.baseArrayLayer
+                        << ", layerCount: " << tempInfo.layerCount
+                        << ", imageOffsetX: " << tempInfo.imageOffsetX
+                        << ", imageOffsetY: " << tempInfo.imageOffsetY
+                        << ", imageOffsetZ: " << tempInfo.imageOffsetZ
+                        << ", imageWidth: " << tempInfo.imageWidth
+                        << ", imageHeight: " << tempInfo.imageHeight
+                        << ", imageDepth: " << tempInfo.imageDepth
+                        << ", aspectMask: " << std::hex << (uint32_t)tempInfo.aspectMask << std::dec
+                        << "}";
+                }
+            }
+
+            out << "]"
+                << "}" << std::endl;
+        }
+            break;
+        case CommandKey::BlitImage: {
+            GfxIdxTy srcIdx;
+            GfxIdxTy dstIdx;
+            uint8_t filter;
+            uint32_t blitInfoSize;
+            mCommandBuffer.read(srcIdx);
+            mCommandBuffer.read(dstIdx);
+            mCommandBuffer.read(filter);
+            mCommandBuffer.read(blitInfoSize);
+
+            out << "    {"
+                << "srcIdx: " << srcIdx
+                << ", dstIdx: " << dstIdx
+                << ", filter: " << (int) filter
+                << ", ImageBlitInfo: [";
+
+            if (blitInfoSize > 0) {
+                ImageBlitInfo blitInfo{};
+                for (uint32_t x = 0; x < blitInfoSize; x++) {
+                    mCommandBuffer.read(blitInfo);
+                    if (x > 0) {
+                        out << ", ";
+                    }
+                    out << "{"
+                        << "srcMipLevel: " << blitInfo.srcMipLevel
+                        << ", srcBaseArrayLayer: " << blitInfo.srcBaseArrayLayer
+                        << ", srcLayerCount: " << blitInfo.srcLayerCount
+                        << ", srcOffsetX: " << blitInfo.srcOffsetX
+                        << ", srcOffsetY: " << blitInfo.srcOffsetY
+                        << ", srcOffsetZ: " << blitInfo.srcOffsetZ
+                        << ", srcWidth: " << blitInfo.srcWidth
+                        << ", srcHeight: " << blitInfo.srcHeight
+                        << ", srcDepth: " << blitInfo.srcDepth
+                        << ", dstMipLevel: " << blitInfo.dstMipLevel
+                        << ", dstBaseArrayLayer: " << blitInfo.dstBaseArrayLayer
+                        << ", dstLayerCount: " << blitInfo.dstLayerCount
+                        << ", dstOffsetX: " << blitInfo.dstOffsetX
+                        << ", dstOffsetY: " << blitInfo.dstOffsetY
+                        << ", dstOffsetZ: " << blitInfo.dstOffsetZ
+                        << ", dstWidth: " << blitInfo.dstWidth
+                        << ", dstHeight: " << blitInfo.dstHeight
+                        << ", dstDepth: " << blitInfo.dstDepth
+                        << ", srcAspectMask: " << blitInfo.srcAspectMask
+                        << ", dstAspectMask: " << blitInfo.dstAspectMask
+                        << "}";
+                }
+            }
+            out << "]"
+                << "}" << std::endl;
+        }
+            break;
+        case CommandKey::CopyRT: {
+            GfxIdxTy srcIdx;
+            GfxIdxTy dstIdx;
+            uint8_t vFrameIndex;
+            uint32_t copyInfoSize;
+            mCommandBuffer.read(srcIdx);
+            mCommandBuffer.read(dstIdx);
+            mCommandBuffer.read(vFrameIndex);
+            mCommandBuffer.read(copyInfoSize);
+
+            out << "    {"
+                << "srcIdx: " << srcIdx
+                << ", dstIdx: " << dstIdx
+                << ", vFrameIndex: " << (int) vFrameIndex
+                << ", ImageCopyInfos: [";
+
+            if (copyInfoSize > 0) {
+                ImageCopyInfo copyInfo{};
+                for (uint32_t x = 0; x < copyInfoSize; x++) {
+                    mCommandBuffer.read(copyInfo);
+                    if (x > 0) {
+                        out << ", ";
+                    }
+                    out << "{"
+                        << "srcMipLevel: " << copyInfo.srcMipLevel
+                        << ", srcBaseArrayLayer: " << copyInfo.srcBaseArrayLayer
+                        << ", srcLayerCount: " << copyInfo.srcLayerCount
+                        << ", srcOffsetX: " << copyInfo.srcOffsetX
+                        << ", srcOffsetY: " << copyInfo.srcOffsetY
+                        << ", srcOffsetZ: " << copyInfo.srcOffsetZ
+                        << ", dstMipLevel: " << copyInfo.dstMipLevel
+                        << ", dstBaseArrayLayer: " << copyInfo.dstBaseArrayLayer
+                        << ", dstLayerCount: " << copyInfo.dstLayerCount
+                        << ", dstOffsetX: " << copyInfo.dstOffsetX
+                        << ", dstOffsetY: " << copyInfo.dstOffsetY
+                        << ", dstOffsetZ: " << copyInfo.dstOffsetZ
+                        << ", imageWidth: " << copyInfo.imageWidth
+                        << ", imageHeight: " << copyInfo.imageHeight
+                        << ", imageDepth: " << copyInfo.imageDepth
+                        << ", srcAspectMask: " << copyInfo.srcAspectMask
+                        << ", dstAspectMask: " << copyInfo.dstAspectMask
+                        << "}";
+                }
+            }
+            out << "]"
+                << "}" << std::endl;
+        }
+            break;
+        case CommandKey::BlitRT: {
+            GfxIdxTy srcIdx;
+            GfxIdxTy dstIdx;
+            uint8_t filter;
+            uint8_t vFrameIndex;
+            uint32_t blitInfoSize;
+            mCommandBuffer.read(srcIdx);
+            mCommandBuffer.read(dstIdx);
+            mCommandBuffer.read(filter);
+            mCommandBuffer.read(vFrameIndex);
+            mCommandBuffer.read(blitInfoSize);
+
+            out << "    {"
+                << "srcIdx: " << srcIdx
+                << ", dstIdx: " << dstIdx
+                << ", vFrameIndex: " << (int) vFrameIndex
+                << ", ImageBlitInfos: [";
+
+            if (blitInfoSize > 0) {
+                ImageBlitInfo blitInfo{};
+                for (uint32_t x = 0; x < blitInfoSize; x++) {
+                    mCommandBuffer.read(blitInfo);
+                    if (x > 0) {
+                        out << ", ";
+                    }
+                    out << "{"
+                        << "srcMipLevel: " << blitInfo.srcMipLevel
+                        << ", srcBaseArrayLayer: " << blitInfo.srcBaseArrayLayer
+                        << ", srcLayerCount: " << blitInfo.srcLayerCount
+                        << ", srcOffsetX: " << blitInfo.srcOffsetX
+                        << ", srcOffsetY: " << blitInfo.srcOffsetY
+                        << ", srcOffsetZ: " << blitInfo.srcOffsetZ
+                        << ", srcWidth: " << blitInfo.srcWidth
+                        << ", srcHeight: " << blitInfo.srcHeight
+                        << ", srcDepth: " << blitInfo.srcDepth
+                        << ", dstMipLevel: " << blitInfo.dstMipLevel
+                        << ", dstBaseArrayLayer: " << blitInfo.dstBaseArrayLayer
+                        << ", dstLayerCount: " << blitInfo.dstLayerCount
+                        << ", dstOffsetX: " << blitInfo.dstOffsetX
+                        << ", dstOffsetY: " << blitInfo.dstOffsetY
+                        << ", dstOffsetZ: " << blitInfo.dstOffsetZ
+                        << ", dstWidth: " << blitInfo.dstWidth
+                        << ", dstHeight: " << blitInfo.dstHeight
+                        << ", dstDepth: " << blitInfo.dstDepth
+                        << ", srcAspectMask: " << blitInfo.srcAspectMask
+                        << ", dstAspectMask: " << blitInfo.dstAspectMask
+                        << "}";
+                }
+            }
+            out << "]"
+                << "}" << std::endl;
+        }
+            break;
+        case CommandKey::BlitRTToImage: {
+            GfxIdxTy srcIdx;
+            GfxIdxTy dstIdx;
+            uint8_t filter;
+            uint8_t attachIndex;
+            uint8_t vFrameIndex;
+            uint32_t blitInfoSize;
+            mCommandBuffer.read(srcIdx);
+            mCommandBuffer.read(dstIdx);
+            mCommandBuffer.read(filter);
+            mCommandBuffer.read(attachIndex);
+            mCommandBuffer.read(vFrameIndex);
+            mCommandBuffer.read(blitInfoSize);
+
+            out << "    {"
+                << "srcIdx: " << srcIdx
+                << ", dstIdx: " << dstIdx
+                << ", filter: " << (int) filter
+                << ", attachIndex: " << (int) attachIndex
+                << ", vFrameIndex: " << (int) vFrameIndex
+                << ", ImageBlitInfos: [";
+
+            if (blitInfoSize > 0) {
+                ImageBlitInfo blitInfo{};
+                for (uint32_t x = 0; x < blitInfoSize; x++) {
+                    mCommandBuffer.read(blitInfo);
+                    if (x > 0) {
+                        out << ", ";
+                    }
+                    out << "{"
+                        << "srcMipLevel: " << blitInfo.srcMipLevel
+                        << ", srcBaseArrayLayer: " << blitInfo.srcBaseArrayLayer
+                        << ", srcLayerCount: " << blitInfo.srcLayerCount
+                        << ", srcOffsetX: " << blitInfo.srcOffsetX
+                        << ", srcOffsetY: " << blitInfo.srcOffsetY
+                        << ", srcOffsetZ: " << blitInfo.srcOffsetZ
+                        << ", srcWidth: " << blitInfo.srcWidth
+                        << ", srcHeight: " << blitInfo.srcHeight
+                        << ", srcDepth: " << blitInfo.srcDepth
+                        << ", dstMipLevel: " << blitInfo.dstMipLevel
+                        << ", dstBaseArrayLayer: " << blitInfo.dstBaseArrayLayer
+                        << ", dstLayerCount: " << blitInfo.dstLayerCount
+                        << ", dstOffsetX: " << blitInfo.dstOffsetX
+                        << ", dstOffsetY: " << blitInfo.dstOffsetY
+                        << ", dstOffsetZ: " << blitInfo.dstOffsetZ
+                        << ", dstWidth: " << blitInfo.dstWidth
+                        << ", dstHeight: " << blitInfo.dstHeight
+                        << ", dstDepth: " << blitInfo.dstDepth
+                        << ", srcAspectMask: " << blitInfo.srcAspectMask
+                        << ", dstAspectMask: " << blitInfo.dstAspectMask
+                        << "}";
+                }
+            }
+            out << "]"
+                << "}" << std::endl;
+        }
+            break;
+        case CommandKey::CopyRTToImage: {
+            GfxIdxTy srcIdx;
+            GfxIdxTy dstIdx;
+            uint8_t attachIndex;
+            uint8_t vFrameIndex;
+            uint32_t copyInfoSize;
+            mCommandBuffer.read(srcIdx);
+            mCommandBuffer.read(dstIdx);
+            mCommandBuffer.read(attachIndex);
+            mCommandBuffer.read(vFrameIndex);
+            mCommandBuffer.read(copyInfoSize);
+
+            out << "    {"
+                << "srcIdx: " << srcIdx
+                << ", dstIdx: " << dstIdx
+                << ", attachIndex: " << (int) attachIndex
+                << ", vFrameIndex: " << (int) vFrameIndex
+                << ", ImageCopyInfos: [";
+
+            if (copyInfoSize > 0) {
+                ImageCopyInfo copyInfo{};
+                for (uint32_t x = 0; x < copyInfoSize; x++) {
+                    mCommandBuffer.read(copyInfo);
+                    if (x > 0) {
+                        out << ", ";
+                    }
+                    out << "{"
+                        << "srcMipLevel: " << copyInfo.srcMipLevel
+                        << ", srcBaseArrayLayer: " << copyInfo.srcBaseArrayLayer
+                        << ", srcLayerCount: " << copyInfo.srcLayerCount
+                        << ", srcOffsetX: " << copyInfo.srcOffsetX
+                        << ", srcOffsetY: " << copyInfo.srcOffsetY
+                        << ", srcOffsetZ: " << copyInfo.srcOffsetZ
+                        << ", dstMipLevel: " << copyInfo.dstMipLevel
+                        << ", dstBaseArrayLayer: " << copyInfo.dstBaseArrayLayer
+                        << ", dstLayerCount: " << copyInfo.dstLayerCount
+                        << ", dstOffsetX: " << copyInfo.dstOffsetX
+                        << ", dstOffsetY: " << copyInfo.dstOffsetY
+                        << ", dstOffsetZ: " << copyInfo.dstOffsetZ
+                        << ", imageWidth: " << copyInfo.imageWidth
+                        << ", imageHeight: " << copyInfo.imageHeight
+                        << ", imageDepth: " << copyInfo.imageDepth
+                        << ", srcAspectMask: " << copyInfo.srcAspectMask
+                        << ", dstAspectMask: " << copyInfo.dstAspectMask
+                        << "}";
+                }
+            }
+            out << "]"
+                << "}" << std::endl;
+        }
+            break;
+        case CommandKey::CopyRTToBuffer: {
+            GfxIdxTy srcIdx;
+            GfxIdxTy dstIdx;
+            uint8_t attachIndex;
+            uint8_t vFrameIndex;
+            uint32_t copyInfoSize;
+            mCommandBuffer.read(srcIdx);
+            mCommandBuffer.read(dstIdx);
+            mCommandBuffer.read(attachIndex);
+            mCommandBuffer.read(vFrameIndex);
+            mCommandBuffer.read(copyInfoSize);
+
+            out << "    {"
+                << "srcIdx: " << srcIdx
+                << ", dstIdx: " << dstIdx
+                << ", attachIndex: " << (int) attachIndex
+                << ", vFrameIndex: " << (int) vFrameIndex
+                << ", ImageCopyInfos: [";
+
+            if (copyInfoSize > 0) {
+                BufferImageCopyInfo tempInfo{};
+                for (uint32_t x = 0; x < copyInfoSize; x++) {
+                    mCommandBuffer.read(tempInfo);
+                    if (x > 0) {
+                        out << ", ";
+                    }
+                    out << "{"
+                        << "bufferOffset: " << tempInfo.bufferOffset
+                        << ", bufferRowLength: " << tempInfo.bufferRowLength
+                        << ", bufferImageHeight: " << tempInfo.bufferImageHeight
+                        << ", mipLevel: " << tempInfo.mipLevel
+                        << ", baseArrayLayer: " << tempInfo.baseArrayLayer
+                        << ", layerCount: " << tempInfo.layerCount
+                        << ", imageOffsetX: " << tempInfo.imageOffsetX
+                        << ", imageOffsetY: " << tempInfo.imageOffsetY
+                        << ", imageOffsetZ: " << tempInfo.imageOffsetZ
+                        << ", imageWidth: " << tempInfo.imageWidth
+                        << ", imageHeight: " << tempInfo.imageHeight
+                        << ", imageDepth: " << tempInfo.imageDepth
+                        << ", aspectMask: " << std::hex << (uint32_t)tempInfo.aspectMask << std::dec
+                        << "}";
+                }
+            }
+            out << "]"
+                << "}" << std::endl;
+        }
+            break;
+        case CommandKey::FillBuffer: {
+            GfxIdxTy idx;
+            uint64_t offset;
+            uint64_t size;
+            uint32_t data;
+
+            mCommandBuffer.read(idx);
+            mCommandBuffer.read(offset);
+            mCommandBuffer.read(size);
+            mCommandBuffer.read(data);
+            out << "   {"
+                << "buffer: " << idx
+                << ", offset" << offset
+                << ", size" << size
+                << ", data" << data
+                << "}"
+                << std::endl;
+        }
+            break;
+        case CommandKey::BeginDebug: {
+            std::string label;
+            mCommandBuffer.read(label);
+            out << "    {"
+                << "debugLabel: " << label
+                << "}"
+                << std::endl;
+        }
+            break;
+        case CommandKey::EndDebug: {
+        }
+            break;
+        case CommandKey::ResetQuery: {
+            GfxIdxTy queryIdx;
+            uint32_t firstQuery;
+            uint32_t queryCount;
+
+            mCommandBuffer.read(queryIdx);
+            mCommandBuffer.read(firstQuery);
+            mCommandBuffer.read(queryCount);
+
+            out << "    {"
+                << "query: " << queryIdx
+                << ", firstQuery: " << firstQuery
+                << ", queryCount: " << queryCount
+                << "}"
+                << std::endl;
+        }
+            break;
+        case CommandKey::BeginQuery: {
+            GfxIdxTy queryIdx;
+            uint32_t queryIndex;
+            bool precise;
+
+            mCommandBuffer.read(queryIdx);
+            mCommandBuffer.read(queryIndex);
+            mCommandBuffer.read(precise);
+
+            out << "    {"
+                << "query: " << queryIdx
+                << ", queryIndex: " << queryIndex
+                << ", precise: " << precise
+                << "}"
+                << std::endl;
+        }
+            break;
+        case CommandKey::EndQuery: {
+            GfxIdxTy queryIdx;
+            uint32_t queryIndex;
+
+            mCommandBuffer.read(queryIdx);
+            mCommandBuffer.read(queryIndex);
+
+            out << "    {"
+                << "query: " << queryIdx
+                << ", queryIndex: " << queryIndex
+                << "}"
+                << std::endl;
+        }
+            break;
+        case CommandKey::WriteTimestamp: {
+            uint32_t pipelineStage;
+            GfxIdxTy queryIdx;
+            uint32_t queryIndex;
+
+            mCommandBuffer.read(pipelineStage);
+            mCommandBuffer.read(queryIdx);
+            mCommandBuffer.read(queryIndex);
+
+            out << "    {"
+                << "pipelineStage: " << pipelineStage
+                << ", query: " << queryIdx
+                << ", queryIndex: " << queryIndex
+                << "}"
+                << std::endl;
+        }
+            break;
+        case CommandKey::CopyQueryResults: {
+            GfxIdxTy queryIdx;
+            uint32_t firstQuery;
+            uint32_t queryCount;
+            GfxIdxTy dstBufferIdx;
+            uint64_t dstOffset;
+            QueryResultFlags resultFlags;
+
+            mCommandBuffer.read(queryIdx);
+            mCommandBuffer.read(firstQuery);
+            mCommandBuffer.read(queryCount);
+            mCommandBuffer.read(dstBufferIdx);
+            mCommandBuffer.read(dstOffset);
+            mCommandBuffer.read(resultFlags);
+
+            out << "    {"
+                << "query: " << queryIdx
+                << ", firstQuery: " << firstQuery
+                << ", queryCount: " << queryCount
+                << ", dstBuffer: " << dstBufferIdx
+                << ", dstOffset: " << dstOffset
+                << ", resultFlags: " << std::hex << (uint32_t)resultFlags << std::dec
+                << "}"
+                << std::endl;
+        }
+            break;
+        case CommandKey::BeginSortedDraws: {
+            const SortedRegion *region = findSortedRegion(cmdPos);
+            out << "    {" << "sorted: " << (region && region->sorted ? "true" : "false")
+                << ", commands: " << (region ? region->commands.size() : 0) << "}" << std::endl;
+            if (region && region->sorted) {
+                // 按排序后的执行顺序输出区间内的指令
+                const uint64_t readPos = mCommandBuffer.readPos();
+                for (uint64_t pos : region->commands) {
+                    uint8_t sortedKey;
+                    mCommandBuffer.seekReadPos(SEEK_SET, (int64_t) pos);
+                    mCommandBuffer.read(sortedKey);
+                    out << "    > " << CommandKeyStr[sortedKey] << std::endl;
+                    dumpCommand(out, sortedKey, pos);
+                }
+                mCommandBuffer.seekReadPos(SEEK_SET, (int64_t) readPos);
+            }
+        }
+            break;
+        case CommandKey::ExecuteCommands: {
+            uint32_t count;
+            mCommandBuffer.readVarint(count);
+
+            out << "    {" << "secondaries: [";
+            for (uint32_t k = 0; k < count; k++) {
+                GfxIdxTy idx;
+                mCommandBuffer.read(idx);
+                out << (k > 0 ? ", " : "") << idx;
+            }
+            out << "]}" << std::endl;
+        }
+            break;
+    }
+
+    // 已修补的指令同时输出修补后的参数
+    auto it = std::lower_bound(mPatches.begin(), mPatches.end(), cmdPos,
+                               [](const PatchPoint &patch, uint64_t pos) {
+                                   return patch.pos < pos;
+                               });
+    if (it != mPatches.end() && it->pos == cmdPos && it->patched) {
+        out << "    {" << "patched: ";
+        if (it->cmdKey == CommandKey::BindDescSet) {
+            out << "offsets = [";
+            for (size_t x = 0; x < it->dynamicOffsets.size(); x++) {
+                out << (x != 0 ? ", " : "") << it->dynamicOffsets[x];
+            }
+            out << "]";
+        } else {
+            out << "buffer: " << it->buffer << ", offset: " << it->offset;
+        }
+        out << "}" << std::endl;
+    }
+}
+
+
+CommandBuffer CommandRecorder::begin()
+{
+    GX_ASSERT_S(!mIsBegun, "Do not call begin repeatedly");
+
+    waitCompile();
+    resetCommandBuffer();
+
+    uint8_t cmdKey = CommandKey::Begin;
+    mCommandBuffer.write(cmdKey);
+
+    mIsBegun = true;
+
+    return this;
+}
+
+void CommandRecorder::end()
+{
+    GX_ASSERT_S(mIsBegun, "Please call begin first");
+    GX_ASSERT_S(!mInSortedDraws, "Please call endSortedDraws first");
+
+    uint8_t cmdKey = CommandKey::End;
+    mCommandBuffer.write(cmdKey);
+
+    mIsBegun = false;
+
+    onEnd();
+}
+
+CommandBuffer CommandRecorder::setClearColor(const ClearColor &clearColor)
+{
+    GX_ASSERT_S(mIsBegun, "Please call begin first");
+
+    uint8_t cmdKey = CommandKey::SetClearColor;
+    mCommandBuffer.write(cmdKey);
+    mCommandBuffer.write(clearColor);
+
+    return this;
+}
+
+CommandBuffer CommandRecorder::setClearDepthStencil(float depth, uint32_t stencil)
+{
+    GX_ASSERT_S(mIsBegun, "Please call begin first");
+
+    uint8_t cmdKey = CommandKey::SetClearDepSte;
+    mCommandBuffer.write(cmdKey);
+    mCommandBuffer.write(depth);
+    mCommandBuffer.write(stencil);
+
+    return this;
+}
+
+CommandBuffer CommandRecorder::bindRenderTarget(RenderTarget renderTarget)
+{
+    GX_ASSERT_S(mIsBegun, "Please call begin first");
+
+    GX_ASSERT(renderTarget);
+    auto *targetP = dynamic_cast<RenderTarget_P *>(renderTarget);
+    uint8_t cmdKey = CommandKey::BindRenderTarget;
+    mCommandBuffer.write(cmdKey);
+    writeElement(targetP);
+    mMaxFrameBufferCount = std::max<uint32_t>(mMaxFrameBufferCount, targetP->frameBufferCount());
+
+    return this;
+}
+
+CommandBuffer CommandRecorder::bindRenderTarget(Frame frame)
+{
+    GX_ASSERT_S(mIsBegun, "Please call begin first");
+
+    GX_ASSERT(frame);
+    GX_ASSERT(frame->renderTarget());
+    auto *targetP = dynamic_cast<RenderTarget_P *>(frame->renderTarget());
+    uint8_t cmdKey = CommandKey::BindRenderTarget;
+    mCommandBuffer.write(cmdKey);
+    writeElement(targetP);
+    mMaxFrameBufferCount = std::max<uint32_t>(mMaxFrameBufferCount, targetP->frameBufferCount());
+
+    return this;
+}
+
+CommandBuffer CommandRecorder::beginRenderPass(const Rect2D &renderArea, const RenderPassInfo &rpInfo)
+{
+    GX_ASSERT_S(mIsBegun, "Please call begin first");
+    GX_ASSERT_S(mLevel == CommandBufferLevel::Primary, "Secondary command buffer cannot begin render pass");
+
+    uint8_t cmdKey = CommandKey::BeginRenderPass;
+    mCommandBuffer.write(cmdKey);
+    mCommandBuffer.write(renderArea);
+    writeRenderPassInfo(mCommandBuffer, rpInfo);
+
+    mSubpassContents.push_back(SubpassContents::Inline);
+    mInRenderPass = true;
+
+    return this;
+}
+
+CommandBuffer CommandRecorder::endRenderPass()
+{
+    GX_ASSERT_S(mIsBegun, "Please call begin first");
+
+    uint8_t cmdKey = CommandKey::EndRenderPass;
+    mCommandBuffer.write(cmdKey);
+
+    mInRenderPass = false;
+
+    return this;
+}
+
+CommandBuffer CommandRecorder::setGraphicsPipelineState(const GraphicsPipelineStateInfo &pipelineState)
+{
+    GX_ASSERT_S(mIsBegun, "Please call begin first");
+
+    uint64_t cmdPos = mCommandBuffer.writePos();
+    uint8_t cmdKey = CommandKey::SetGraphPipelineState;
+    mCommandBuffer.write(cmdKey);
+    writeGraphicsPipelineState(mCommandBuffer, pipelineState);
+    trackCommand(cmdPos, cmdKey);
+
+    return this;
+}
+
+CommandBuffer CommandRecorder::setVertexLayout(const VertexLayout &vertexLayout)
+{
+    GX_ASSERT_S(mIsBegun, "Please call begin first");
+
+    uint64_t cmdPos = mCommandBuffer.writePos();
+    uint8_t cmdKey = CommandKey::SetVertexLayout;
+    mCommandBuffer.write(cmdKey);
+    writeVertexLayout(mCommandBuffer, vertexLayout);
+    trackCommand(cmdPos, cmdKey);
+
+    return this;
+}
+
+CommandBuffer CommandRecorder::setShaders(const std::vector<Shader> &shaders)
+{
+    GX_ASSERT_S(mIsBegun, "Please call begin first");
+
+    uint64_t cmdPos = mCommandBuffer.writePos();
+    uint8_t cmdKey = CommandKey::SetShaders;
+    mCommandBuffer.write(cmdKey);
+    mCommandBuffer.writeVarint((uint32_t) shaders.size());
+    for (auto &s : shaders) {
+        writeElement(dynamic_cast<Shader_P *>(s));
+    }
+    trackCommand(cmdPos, cmdKey);
+
+    return this;
+}
+
+CommandBuffer CommandRecorder::nextSubpass()
+{
+    GX_ASSERT_S(mIsBegun, "Please call begin first");
+
+    uint8_t cmdKey = CommandKey::NextSubpass;
+    mCommandBuffer.write(cmdKey);
+
+    mSubpassContents.push_back(SubpassContents::Inline);
+
+    return this;
+}
+
+CommandBuffer CommandRecorder::setViewport(const Rect2D &viewport, float minDepth, float maxDepth)
+{
+    GX_ASSERT_S(mIsBegun, "Please call begin first");
+
+    uint64_t cmdPos = mCommandBuffer.writePos();
+    uint8_t cmdKey = CommandKey::SetViewport;
+    mCommandBuffer.write(cmdKey);
+    mCommandBuffer.write(viewport);
+    mCommandBuffer.write(minDepth);
+    mCommandBuffer.write(maxDepth);
+    trackCommand(cmdPos, cmdKey);
+
+    return this;
+}
+
+CommandBuffer CommandRecorder::setScissor(const Rect2D &scissor)
+{
+    GX_ASSERT_S(mIsBegun, "Please call begin first");
+
+    uint64_t cmdPos = mCommandBuffer.writePos();
+    uint8_t cmdKey = CommandKey::SetScissor;
+    mCommandBuffer.write(cmdKey);
+    mCommandBuffer.write(scissor);
+    trackCommand(cmdPos, cmdKey);
+
+    return this;
+}
+
+CommandBuffer CommandRecorder::setLineWidth(float lineWidth)
+{
+    GX_ASSERT_S(mIsBegun, "Please call begin first");
+
+    uint64_t cmdPos = mCommandBuffer.writePos();
+    uint8_t cmdKey = CommandKey::SetLineWidth;
+    mCommandBuffer.write(cmdKey);
+    mCommandBuffer.write(lineWidth);
+    trackCommand(cmdPos, cmdKey);
+
+    return this;
+}
+
+CommandBuffer CommandRecorder::setStencilCompareMask(StencilFace::Enum face, uint32_t mask)
+{
+    GX_ASSERT_S(mIsBegun, "Please call begin first");
+
+    uint64_t cmdPos = mCommandBuffer.writePos();
+    uint8_t cmdKey = CommandKey::SetStencilCompMask;
+    mCommandBuffer.write(cmdKey);
+    mCommandBuffer.write((uint8_t) face);
+    mCommandBuffer.write(mask);
+    trackCommand(cmdPos, cmdKey);
+
+    return this;
+}
+
+CommandBuffer CommandRecorder::setStencilWriteMask(StencilFace::Enum face, uint32_t mask)
+{
+    GX_ASSERT_S(mIsBegun, "Please call begin first");
+
+    uint64_t cmdPos = mCommandBuffer.writePos();
+    uint8_t cmdKey = CommandKey::SetStencilWriteMask;
+    mCommandBuffer.write(cmdKey);
+    mCommandBuffer.write((uint8_t) face);
+    mCommandBuffer.write(mask);
+    trackCommand(cmdPos, cmdKey);
+
+    return this;
+}
+
+CommandBuffer CommandRecorder::setStencilReference(StencilFace::Enum face, uint32_t reference)
+{
+    GX_ASSERT_S(mIsBegun, "Please call begin first");
+
+    uint64_t cmdPos = mCommandBuffer.writePos();
+    uint8_t cmdKey = CommandKey::SetStencilReference;
+    mCommandBuffer.write(cmdKey);
+    mCommandBuffer.write((uint8_t) face);
+    mCommandBuffer.write(reference);
+    trackCommand(cmdPos, cmdKey);
+
+    return this;
+}
+
+CommandBuffer CommandRecorder::bindResources(ResourceBindPoint::Enum bindPoint,
+                                             const std::vector<ResourceBinder> &binders,
+                                             const std::vector<uint32_t> &dynamicOffsets)
+{
+    GX_ASSERT_S(mIsBegun, "Please call begin first");
+
+    uint64_t cmdPos = mCommandBuffer.writePos();
+    uint8_t cmdKey = CommandKey::BindDescSet;
+    mCommandBuffer.write(cmdKey);
+    mCommandBuffer.write((uint8_t) bindPoint);
+    mCommandBuffer.writeVarint((uint32_t) binders.size());
+    for (auto i : binders) {
+        writeElement(dynamic_cast<ResourceBinder_P *>(i));
+    }
+    mCommandBuffer.writeVarint((uint32_t) dynamicOffsets.size());
+    mCommandBuffer.write(dynamicOffsets.data(), sizeof(uint32_t) * dynamicOffsets.size());
+    setPatchCandidate(cmdPos, cmdKey, dynamicOffsets.size());
+    trackCommand(cmdPos, cmdKey);
+
+    return this;
+}
+
+CommandBuffer CommandRecorder::bindVertexBuffer(uint32_t firstBinding,
+                                                const std::vector<Buffer> &buffers,
+                                                const std::vector<uint64_t> &offsets)
+{
+    GX_ASSERT_S(mIsBegun, "Please call begin first");
+
+    GX_ASSERT(!buffers.empty());
+    GX_ASSERT(buffers.size() == offsets.size());
+
+    uint8_t size = buffers.size();
+
+    uint64_t cmdPos = mCommandBuffer.writePos();
+    uint8_t cmdKey = CommandKey::BindVertexBuf;
+    mCommandBuffer.write(cmdKey);
+    mCommandBuffer.write(firstBinding);
+    mCommandBuffer.write(size);
+    for (auto &i : buffers) {
+        writeElement(dynamic_cast<Buffer_P *>(i));
+    }
+    for (uint64_t i : offsets) {
+        mCommandBuffer.write(i);
+    }
+    trackCommand(cmdPos, cmdKey);
+
+    return this;
+}
+
+CommandBuffer CommandRecorder::bindIndexBuffer(Buffer buffer, uint32_t offset, IndexType::Enum indexType)
+{
+    GX_ASSERT_S(mIsBegun, "Please call begin first");
+
+    GX_ASSERT(buffer);
+    auto *objP = dynamic_cast<Buffer_P *>(buffer);
+    uint64_t cmdPos = mCommandBuffer.writePos();
+    uint8_t cmdKey = CommandKey::BindIndexBuf;
+    mCommandBuffer.write(cmdKey);
+    writeElement(objP);
+    mCommandBuffer.write(offset);
+    mCommandBuffer.write(indexType);
+    setPatchCandidate(cmdPos, cmdKey);
+    trackCommand(cmdPos, cmdKey);
+
+    return this;
+}
+
+CommandBuffer CommandRecorder::draw(uint32_t vertexCount, uint32_t instanceCount,
+                                    uint32_t firstVertex, uint32_t firstInstance)
+{
+    GX_ASSERT_S(mIsBegun, "Please call begin first");
+
+    uint64_t cmdPos = mCommandBuffer.writePos();
+    uint8_t cmdKey = CommandKey::Draw;
+    mCommandBuffer.write(cmdKey);
+    // 绘制参数通常为较小的整数，使用varint编码
+    mCommandBuffer.writeVarint(vertexCount);
+    mCommandBuffer.writeVarint(instanceCount);
+    mCommandBuffer.writeVarint(firstVertex);
+    mCommandBuffer.writeVarint(firstInstance);
+    trackCommand(cmdPos, cmdKey);
+
+    return this;
+}
+
+CommandBuffer CommandRecorder::drawIndexed(uint32_t indexCount, uint32_t instanceCount,
+                                           uint32_t firstIndex, int32_t vertexOffset,
+                                           uint32_t firstInstance)
+{
+    GX_ASSERT_S(mIsBegun, "Please call begin first");
+
+    uint64_t cmdPos = mCommandBuffer.writePos();
+    uint8_t cmdKey = CommandKey::DrawIndexed;
+    mCommandBuffer.write(cmdKey);
+    mCommandBuffer.writeVarint(indexCount);
+    mCommandBuffer.writeVarint(instanceCount);
+    mCommandBuffer.writeVarint(firstIndex);
+    mCommandBuffer.writeVarint(vertexOffset);
+    mCommandBuffer.writeVarint(firstInstance);
+    trackCommand(cmdPos, cmdKey);
+
+    return this;
+}
+
+CommandBuffer CommandRecorder::drawIndirect(Buffer buffer, uint32_t offset, uint32_t drawCount, uint32_t stride)
+{
+    GX_ASSERT_S(mIsBegun, "Please call begin first");
+
+    GX_ASSERT(buffer);
+    auto *objP = dynamic_cast<Buffer_P *>(buffer);
+
+    uint64_t cmdPos = mCommandBuffer.writePos();
+    uint8_t cmdKey = CommandKey::DrawIndirect;
+    mCommandBuffer.write(cmdKey);
+    writeElement(objP);
+    mCommandBuffer.write(offset);
+    mCommandBuffer.write(drawCount);
+    mCommandBuffer.write(stride);
+    setPatchCandidate(cmdPos, cmdKey);
+    trackCommand(cmdPos, cmdKey);
+
+    return this;
+}
+
+CommandBuffer CommandRecorder::drawIndexedIndirect(Buffer buffer, uint32_t offset, uint32_t drawCount, uint32_t stride)
+{
+    GX_ASSERT_S(mIsBegun, "Please call begin first");
+
+    GX_ASSERT(buffer);
+    auto *objP = dynamic_cast<Buffer_P *>(buffer);
+
+    uint64_t cmdPos = mCommandBuffer.writePos();
+    uint8_t cmdKey = CommandKey::DrawIndexedIndirect;
+    mCommandBuffer.write(cmdKey);
+    writeElement(objP);
+    mCommandBuffer.write(offset);
+    mCommandBuffer.write(drawCount);
+    mCommandBuffer.write(stride);
+    setPatchCandidate(cmdPos, cmdKey);
+    trackCommand(cmdPos, cmdKey);
+
+    return this;
+}
+
+CommandBuffer CommandRecorder::dispatch(uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ)
+{
+    GX_ASSERT_S(mIsBegun, "Please call begin first");
+
+    uint8_t cmdKey = CommandKey::Dispatch;
+    mCommandBuffer.write(cmdKey);
+    mCommandBuffer.write(groupCountX);
+    mCommandBuffer.write(groupCountY);
+    mCommandBuffer.write(groupCountZ);
+
+    return this;
+}
+
+CommandBuffer CommandRecorder::dispatchIndirect(Buffer buffer, uint32_t offset)
+{
+    GX_ASSERT_S(mIsBegun, "Please call begin first");
+
+    GX_ASSERT(buffer);
+    auto *objP = dynamic_cast<Buffer_P *>(buffer);
+
+    uint64_t cmdPos = mCommandBuffer.writePos();
+    uint8_t cmdKey = CommandKey::DispatchIndirect;
+    mCommandBuffer.write(cmdKey);
+    writeElement(objP);
+    mCommandBuffer.write(offset);
+    setPatchCandidate(cmdPos, cmdKey);
+
+    return this;
+}
+
+CommandBuffer CommandRecorder::beginSortedDraws()
+{
+    GX_ASSERT_S(mIsBegun, "Please call begin first");
+    GX_ASSERT_S(!mInSortedDraws, "Do not call beginSortedDraws repeatedly");
+    GX_ASSERT_S(mInRenderPass || mLevel == CommandBufferLevel::Secondary,
+                "beginSortedDraws must be called in render pass");
+    if (mInSortedDraws) {
+        return this;
+    }
+
+    SortedRegion region{};
+    region.beginPos = mCommandBuffer.writePos();
+    region.endPos = region.beginPos;
+    region.sorted = false;
+    mSortedRegions.push_back(std::move(region));
+
+    uint8_t cmdKey = CommandKey::BeginSortedDraws;
+    mCommandBuffer.write(cmdKey);
+
+    mInSortedDraws = true;
+    mSortedDrawsSortable = true;
+    mSortedLastEndPos = mCommandBuffer.writePos();
+    mSortedDraws.clear();
+    mSortedDrawStates.clear();
+
+    return this;
+}
+
+CommandBuffer CommandRecorder::endSortedDraws()
+{
+    GX_ASSERT_S(mIsBegun, "Please call begin first");
+    GX_ASSERT_S(mInSortedDraws, "Please call beginSortedDraws first");
+    if (!mInSortedDraws) {
+        return this;
+    }
+
+    if (mCommandBuffer.writePos() != mSortedLastEndPos) {
+        mSortedDrawsSortable = false;
+    }
+
+    SortedRegion &region = mSortedRegions.back();
+    region.sorted = sortDraws(region);
+    region.endPos = mCommandBuffer.writePos();
+
+    uint8_t cmdKey = CommandKey::EndSortedDraws;
+    mCommandBuffer.write(cmdKey);
+
+    mInSortedDraws = false;
+    mSortedDraws.clear();
+    mSortedDrawStates.clear();
+
+    return this;
+}
+
+CommandBuffer CommandRecorder::executeCommands(const std::vector<CommandBuffer> &secondaryCmdBuffers)
+{
+    GX_ASSERT_S(mIsBegun, "Please call begin first");
+
+    if (secondaryCmdBuffers.empty()) {
+        Log("CommandRecorder::executeCommands secondaryCmdBuffers is empty");
+        return this;
+    }
+
+    std::vector<GfxIdxTy> secondaryIdxList;
+    auto writeSecondaries = [this, &secondaryIdxList]() {
+        if (secondaryIdxList.empty()) {
+            return;
+        }
+        GX_ASSERT_S(mLevel == CommandBufferLevel::Primary,
+                    "Secondary command buffer cannot execute secondary command buffers");
+
+        uint8_t cmdKey = CommandKey::ExecuteCommands;
+        mCommandBuffer.write(cmdKey);
+        mCommandBuffer.writeVarint((uint32_t) secondaryIdxList.size());
+        for (auto idx : secondaryIdxList) {
+            mCommandBuffer.write(idx);
+        }
+        secondaryIdxList.clear();
+
+        // 执行Secondary指令缓冲的Subpass需要以SECONDARY_COMMAND_BUFFERS方式开始
+        if (mInRenderPass && !mSubpassContents.empty()) {
+            mSubpassContents.back() = SubpassContents::SecondaryCommandBuffers;
+        }
+    };
+
+    for (auto subBuffer : secondaryCmdBuffers) {
+        auto *subRecorder = dynamic_cast<CommandRecorder *>(subBuffer);
+        // 拼接时会读取其指令流
+        subRecorder->waitCompile();
+        if (subRecorder->mCommandBuffer.writePos() == 0) {
+            continue;
+        }
+        if (subRecorder->mIsBegun) {
+            Log("CommandRecorder::executeCommands secondary command buffer check end failure");
+            continue;
+        }
+        if (mIsBundle) {
+            mReferences[subRecorder->idx()] = subRecorder;
+        }
+        if (subRecorder->mLevel == CommandBufferLevel::Secondary) {
+            secondaryIdxList.push_back(subRecorder->idx());
+            continue;
+        }
+        writeSecondaries();
+
+        uint8_t cmdKey;
+        CommandStream &cmdBuffer = subRecorder->mCommandBuffer;
+        cmdBuffer.seekReadPos(SEEK_SET, 0);
+        cmdBuffer.read(cmdKey);
+        if (cmdKey != CommandKey::Begin) {
+            Log("CommandRecorder::executeCommands secondaryCmdBuffer head is not Begin command");
+            continue;
+        }
+        const uint64_t srcPos = cmdBuffer.readPos();
+        const uint64_t dstPos = mCommandBuffer.writePos();
+        mCommandBuffer.write(cmdBuffer, srcPos, cmdBuffer.writePos() - sizeof(uint8_t) - srcPos);
+        cmdBuffer.seekReadPos(SEEK_SET, cmdBuffer.writePos() - sizeof(uint8_t));
+        cmdBuffer.read(cmdKey);
+        GX_ASSERT_S(cmdKey == CommandKey::End, "secondary command buffer check end failure");
+
+        mSubpassContents.insert(mSubpassContents.end(),
+                                subRecorder->mSubpassContents.begin(), subRecorder->mSubpassContents.end());
+        if (mIsBundle) {
+            mReferences.insert(subRecorder->mReferences.begin(), subRecorder->mReferences.end());
+        }
+        for (auto &srcRegion : subRecorder->mSortedRegions) {
+            SortedRegion region = srcRegion;
+            region.beginPos = region.beginPos - srcPos + dstPos;
+            region.endPos = region.endPos - srcPos + dstPos;
+            for (auto &pos : region.commands) {
+                pos = pos - srcPos + dstPos;
+            }
+            mSortedRegions.push_back(std::move(region));
+        }
+        // 修补点随指令一起复制，拼接前已应用的修补在本指令缓冲中同样生效
+        for (auto &srcPatch : subRecorder->mPatches) {
+            PatchPoint patch = srcPatch;
+            patch.pos = patch.pos - srcPos + dstPos;
+            patch.endPos = patch.endPos - srcPos + dstPos;
+            mPatches.push_back(std::move(patch));
+        }
+    }
+    writeSecondaries();
+
+    // 执行后绑定状态未知，不能作为之后无序绘制区间的初始状态
+    mTrackedStates.clear();
+
+    return this;
+}
+
+CommandBuffer CommandRecorder::pipelineBarrier(PipelineStageMask srcStage, PipelineStageMask dstStage)
+{
+    GX_ASSERT_S(mIsBegun, "Please call begin first");
+
+    uint8_t cmdKey = CommandKey::PipelineBarrier;
+    mCommandBuffer.write(cmdKey);
+    mCommandBuffer.write(srcStage);
+    mCommandBuffer.write(dstStage);
+
+    return this;
+}
+
+CommandBuffer CommandRecorder::bufferMemoryBarrier(Buffer buffer, const BufferBarrierInfo &barrierInfo)
+{
+    GX_ASSERT_S(mIsBegun, "Please call begin first");
+
+    GX_ASSERT(buffer);
+    auto *bufferP = dynamic_cast<Buffer_P *>(buffer);
+
+    uint8_t cmdKey = CommandKey::BufferBarrier;
+    mCommandBuffer.write(cmdKey);
+    writeElement(bufferP);
+    mCommandBuffer.write(barrierInfo);
+
+    return this;
+}
+
+CommandBuffer CommandRecorder::imageMemoryBarrier(Texture texture,
+                                                  ImageLayout::Enum srcLayout,
+                                                  ImageLayout::Enum dstLayout,
+                                                  const ImageSubResourceRange &range)
+{
+    GX_ASSERT_S(mIsBegun, "Please call begin first");
+
+    GX_ASSERT(texture);
+    auto *textureP = dynamic_cast<Texture_P *>(texture);
+
+    uint8_t cmdKey = CommandKey::ImageBarrier;
+    mCommandBuffer.write(cmdKey);
+    writeElement(textureP);
+    mCommandBuffer.write((uint8_t) srcLayout);
+    mCommandBuffer.write((uint8_t) dstLayout);
+    mCommandBuffer.write(range);
+
+    return this;
+}
+
+CommandBuffer CommandRecorder::copyBuffer(Buffer src, Buffer dst, uint64_t srcOffset, uint64_t dstOffset, uint64_t size)
+{
+    GX_ASSERT_S(mIsBegun, "Please call begin first");
+
+    GX_ASSERT(src);
+    GX_ASSERT(dst);
+    auto *srcP = dynamic_cast<Buffer_P *>(src);
+    auto *dstP = dynamic_cast<Buffer_P *>(dst);
+
+    uint8_t cmdKey = CommandKey::CopyBuffer;
+    mCommandBuffer.write(cmdKey);
+    writeElement(srcP);
+    writeElement(dstP);
+    mCommandBuffer.write(srcOffset);
+    mCommandBuffer.write(dstOffset);
+    mCommandBuffer.write(size);
+
+    return this;
+}
+
+CommandBuffer CommandRecorder::copyImage(Texture src, Texture dst, const std::vector<ImageCopyInfo> &copyInfos)
+{
+    GX_ASSERT_S(mIsBegun, "Please call begin first");
+
+    GX_ASSERT(src);
+    GX_ASSERT(dst);
+    auto *srcP = dynamic_cast<Texture_P *>(src);
+    auto *dstP = dynamic_cast<Texture_P *>(dst);
+
+    uint8_t cmdKey = CommandKey::CopyImage;
+    mCommandBuffer.write(cmdKey);
+    writeElement(srcP);
+    writeElement(dstP);
+    mCommandBuffer.write((uint32_t) copyInfos.size());
+    if (!copyInfos.empty()) {
+        for (auto &info : copyInfos) {
+            mCommandBuffer.write(info);
+        }
+    }
+
+    return this;
+}
+
+CommandBuffer CommandRecorder::copyBufferToImage(Buffer src, Texture dst,
+                                                 const std::vector<BufferImageCopyInfo> &copyInfos)
+{
+    GX_ASSERT_S(mIsBegun, "Please call begin first");
+
+    GX_ASSERT(src);
+    GX_ASSERT(dst);
+    auto *srcP = dynamic_cast<Buffer_P *>(src);
+    auto *dstP = dynamic_cast<Texture_P *>(dst);
+
+    uint8_t cmdKey = CommandKey::CopyBufferToImage;
+    mCommandBuffer.write(cmdKey);
+    writeElement(srcP);
+    writeElement(dstP);
+    mCommandBuffer.write((uint32_t) copyInfos.size());
+    if (!copyInfos.empty()) {
+        for (auto &info : copyInfos) {
+            mCommandBuffer.write(info);
+        }
+    }
+
+    return this;
+}
+
+CommandBuffer CommandRecorder::copyImageToBuffer(Texture src, Buffer dst,
+                                                 const std::vector<BufferImageCopyInfo> &copyInfos)
+{
+    GX_ASSERT_S(mIsBegun, "Please call begin first");
+
+    GX_ASSERT(src);
+    GX_ASSERT(dst);
+    auto *srcP = dynamic_cast<Texture_P *>(src);
+    auto *dstP = dynamic_cast<Buffer_P *>(dst);
+
+    uint8_t cmdKey = CommandKey::CopyImageToBuffer;
+    mCommandBuffer.write(cmdKey);
+    writeElement(srcP);
+    writeElement(dstP);
+    mCommandBuffer.write((uint32_t) copyInfos.size());
+    if (!copyInfos.empty()) {
+        for (auto &info : copyInfos) {
+            mCommandBuffer.write(info);
+        }
+    }
+
+    return this;
+}
+
+CommandBuffer CommandRecorder::blitImage(Texture src, Texture dst, const std::vector<ImageBlitInfo> &blitInfos,
+                                         BlitFilter::Enum filter)
+{
+    GX_ASSERT_S(mIsBegun, "Please call begin first");
+
+    GX_ASSERT(src);
+    GX_ASSERT(dst);
+    auto *srcP = dynamic_cast<Texture_P *>(src);
+    auto *dstP = dynamic_cast<Texture_P *>(dst);
+
+    uint8_t cmdKey = CommandKey::BlitImage;
+    mCommandBuffer.write(cmdKey);
+    writeElement(srcP);
+    writeElement(dstP);
+    mCommandBuffer.write((uint8_t) filter);
+    mCommandBuffer.write((uint32_t) blitInfos.size());
+    if (!blitInfos.empty()) {
+        for (auto &info : blitInfos) {
+            mCommandBuffer.write(info);
+        }
+    }
+
+    return this;
+}
+
+CommandBuffer CommandRecorder::copyRenderTarget(RenderTarget src, RenderTarget dst,
+                                                const std::vector<ImageCopyInfo> &copyInfos,
+                                                uint8_t frameIndex)
+{
+    GX_ASSERT_S(mIsBegun, "Please call begin first");
+
+    GX_ASSERT(src);
+    GX_ASSERT(dst);
+    auto *srcP = dynamic_cast<RenderTarget_P *>(src);
+    auto *dstP = dynamic_cast<RenderTarget_P *>(dst);
+
+    uint8_t cmdKey = CommandKey::CopyRT;
+    mCommandBuffer.write(cmdKey);
+    writeElement(srcP);
+    writeElement(dstP);
+    mCommandBuffer.write(frameIndex);
+    mCommandBuffer.write((uint32_t) copyInfos.size());
+    if (!copyInfos.empty()) {
+        for (auto &info : copyInfos) {
+            mCommandBuffer.write(info);
+        }
+    }
+
+    return this;
+}
+
+CommandBuffer CommandRecorder::blitRenderTarget(RenderTarget src, RenderTarget dst,
+                                                const std::vector<ImageBlitInfo> &blitInfos,
+                                                BlitFilter::Enum filter,
+                                                uint8_t frameIndex)
+{
+    GX_ASSERT_S(mIsBegun, "Please call begin first");
+
+    GX_ASSERT(src);
+    GX_ASSERT(dst);
+    auto *srcP = dynamic_cast<RenderTarget_P *>(src);
+    auto *dstP = dynamic_cast<RenderTarget_P *>(dst);
+
+    uint8_t cmdKey = CommandKey::BlitRT;
+    mCommandBuffer.write(cmdKey);
+    writeElement(srcP);
+    writeElement(dstP);
+    mCommandBuffer.write((uint8_t) filter);
+    mCommandBuffer.write(frameIndex);
+    mCommandBuffer.write((uint32_t) blitInfos.size());
+    if (!blitInfos.empty()) {
+        for (auto &info : blitInfos) {
+            mCommandBuffer.write(info);
+        }
+    }
+
+    return this;
+}
+
+CommandBuffer CommandRecorder::blitRenderTargetToImage(RenderTarget src, Texture dst,
+                                                       const std::vector<ImageBlitInfo> &blitInfos,
+                                                       BlitFilter::Enum filter,
+                                                       uint8_t attachIndex,
+                                                       uint8_t frameIndex)
+{
+    GX_ASSERT_S(mIsBegun, "Please call begin first");
+
+    GX_ASSERT(src);
+    GX_ASSERT(dst);
+
+    auto *srcP = dynamic_cast<RenderTarget_P *>(src);
+    auto *dstP = dynamic_cast<Texture_P *>(dst);
+
+    uint8_t cmdKey = CommandKey::BlitRTToImage;
+    mCommandBuffer.write(cmdKey);
+    writeElement(srcP);
+    writeElement(dstP);
+    mCommandBuffer.write((uint8_t) filter);
+    mCommandBuffer.write(attachIndex);
+    mCommandBuffer.write(frameIndex);
+    mCommandBuffer.write((uint32_t) blitInfos.size());
+    if (!blitInfos.empty()) {
+        for (auto &info : blitInfos) {
+            mCommandBuffer.write(info);
+        }
+    }
+
+    return this;
+}
+
+CommandBuffer CommandRecorder::copyRenderTargetToImage(RenderTarget src, Texture dst,
+                                                       const std::vector<ImageCopyInfo> &copyInfos,
+                                                       uint8_t attachIndex,
+                                                       uint8_t frameIndex)
+{
+    GX_ASSERT_S(mIsBegun, "Please call begin first");
+
+    GX_ASSERT(src);
+    GX_ASSERT(dst);
+
+    auto *srcP = dynamic_cast<RenderTarget_P *>(src);
+    auto *dstP = dynamic_cast<Texture_P *>(dst);
+
+    uint8_t cmdKey = CommandKey::CopyRTToImage;
+    mCommandBuffer.write(cmdKey);
+    writeElement(srcP);
+    writeElement(dstP);
+    mCommandBuffer.write(attachIndex);
+    mCommandBuffer.write(frameIndex);
+    mCommandBuffer.write((uint32_t) copyInfos.size());
+    if (!copyInfos.empty()) {
+        for (auto &info : copyInfos) {
+            mCommandBuffer.write(info);
+        }
+    }
+
+    return this;
+}
+
+CommandBuffer CommandRecorder::copyRenderTargetToBuffer(RenderTarget src, Buffer dst,
+                                                        const std::vector<BufferImageCopyInfo> &copyInfos,
+                                                        uint8_t attachIndex,
+                                                        uint8_t frameIndex)
+{
+    GX_ASSERT_S(mIsBegun, "Please call begin first");
+
+    GX_ASSERT(src);
+    GX_ASSERT(dst);
+
+    auto *srcP = dynamic_cast<RenderTarget_P *>(dst);
+    auto *dstP = dynamic_cast<Buffer_P *>(dst);
+
+    uint8_t cmdKey = CommandKey::CopyRTToBuffer;
+    mCommandBuffer.write(cmdKey);
+    writeElement(srcP);
+    writeElement(dstP);
+    mCommandBuffer.write(attachIndex);
+    mCommandBuffer.write(frameIndex);
+    mCommandBuffer.write((uint32_t) copyInfos.size());
+    if (!copyInfos.empty()) {
+        for (auto &info : copyInfos) {
+            mCommandBuffer.write(info);
+        }
+    }
+
+    return this;
+}
+
+CommandBuffer CommandRecorder::fillBuffer(Buffer buffer, uint64_t offset, uint64_t size, uint32_t data)
+{
+    GX_ASSERT_S(mIsBegun, "Please call begin first");
+    GX_ASSERT(buffer);
+
+    auto *bufferP = dynamic_cast<Buffer_P *>(buffer);
+
+    uint8_t cmdKey = CommandKey::FillBuffer;
+    mCommandBuffer.write(cmdKey);
+    writeElement(bufferP);
+    mCommandBuffer.write(offset);
+    mCommandBuffer.write(size);
+    mCommandBuffer.write(data);
+
+    return this;
+}
+
+CommandBuffer CommandRecorder::beginDebugLabel(const std::string &label)
+{
+    GX_ASSERT_S(mIsBegun, "Please call begin first");
+
+    uint8_t cmdKey = CommandKey::BeginDebug;
+    mCommandBuffer.write(cmdKey);
+    mCommandBuffer.write(label);
+    mDebugLabelCount++;
+
+    return this;
+}
+
+CommandBuffer CommandRecorder::endDebugLabel()
+{
+    GX_ASSERT_S(mIsBegun, "Please call begin first");
+
+    uint8_t cmdKey = CommandKey::EndDebug;
+    mCommandBuffer.write(cmdKey);
+
+    return this;
+}
+
+CommandBuffer CommandRecorder::resetQuery(Query query, uint32_t firstQuery, uint32_t queryCount)
+{
+    GX_ASSERT_S(mIsBegun, "Please call begin first");
+    GX_ASSERT(query);
+
+    auto *queryP = dynamic_cast<Query_P *>(query);
+
+    uint8_t cmdKey = CommandKey::ResetQuery;
+    mCommandBuffer.write(cmdKey);
+    writeElement(queryP);
+    mCommandBuffer.write(firstQuery);
+    mCommandBuffer.write(queryCount);
+
+    return this;
+}
+
+CommandBuffer CommandRecorder::beginQuery(Query query, uint32_t queryIndex, bool precise)
+{
+    GX_ASSERT_S(mIsBegun, "Please call begin first");
+    GX_ASSERT(query);
+
+    auto *queryP = dynamic_cast<Query_P *>(query);
+
+    uint8_t cmdKey = CommandKey::BeginQuery;
+    mCommandBuffer.write(cmdKey);
+    writeElement(queryP);
+    mCommandBuffer.write(queryIndex);
+    mCommandBuffer.write(precise);
+
+    return this;
+}
+
+CommandBuffer CommandRecorder::endQuery(Query query, uint32_t queryIndex)
+{
+    GX_ASSERT_S(mIsBegun, "Please call begin first");
+    GX_ASSERT(query);
+
+    auto *queryP = dynamic_cast<Query_P *>(query);
+
+    uint8_t cmdKey = CommandKey::EndQuery;
+    mCommandBuffer.write(cmdKey);
+    writeElement(queryP);
+    mCommandBuffer.write(queryIndex);
+
+    return this;
+}
+
+CommandBuffer CommandRecorder::writeTimestamp(PipelineStage::Enum pipelineStage, Query query, uint32_t queryIndex)
+{
+    GX_ASSERT_S(mIsBegun, "Please call begin first");
+    GX_ASSERT(query);
+
+    auto *queryP = dynamic_cast<Query_P *>(query);
+
+    uint8_t cmdKey = CommandKey::WriteTimestamp;
+    mCommandBuffer.write(cmdKey);
+    mCommandBuffer.write((uint32_t)pipelineStage);
+    writeElement(queryP);
+    mCommandBuffer.write(queryIndex);
+
+    return this;
+}
+
+CommandBuffer CommandRecorder::copyQueryResults(Query query,
+                                                uint32_t firstQuery,
+                                                uint32_t queryCount,
+                                                Buffer dstBuffer,
+                                                uint64_t dstOffset,
+                                                QueryResultFlags resultFlags)
+{
+    GX_ASSERT_S(mIsBegun, "Please call begin first");
+    GX_ASSERT(query);
+    GX_ASSERT(dstBuffer);
+
+    auto *queryP = dynamic_cast<Query_P *>(query);
+    auto *bufferP = dynamic_cast<Buffer_P *>(dstBuffer);
+
+    uint8_t cmdKey = CommandKey::CopyQueryResults;
+    mCommandBuffer.write(cmdKey);
+    writeElement(queryP);
+    mCommandBuffer.write(firstQuery);
+    mCommandBuffer.write(queryCount);
+    writeElement(bufferP);
+    mCommandBuffer.write(dstOffset);
+    mCommandBuffer.write(resultFlags);
+
+    return this;
+}
+
+CommandPatch CommandRecorder::markPatch()
+{
+    GX_ASSERT_S(mIsBegun, "Please call begin first");
+
+    if (!mHasPatchCandidate || mPatchCandidate.endPos != mCommandBuffer.writePos()) {
+        Log("CommandRecorder::markPatch the last command does not support patch");
+        return COMMAND_PATCH_INVALID;
+    }
+    if (mPatches.empty() || mPatches.back().pos != mPatchCandidate.pos) {
+        mPatches.push_back(mPatchCandidate);
+    }
+    return (CommandPatch) (mPatches.size() - 1);
+}
+
+void CommandRecorder::patchDynamicOffsets(CommandPatch patch, const std::vector<uint32_t> &dynamicOffsets)
+{
+    waitCompile();
+    GX_ASSERT_S(patch < mPatches.size(), "Invalid command patch %d", patch);
+    if (patch >= mPatches.size()) {
+        return;
+    }
+    PatchPoint &patchPoint = mPatches[patch];
+    GX_ASSERT_S(patchPoint.cmdKey == CommandKey::BindDescSet,
+                "Command patch %d is not bindResources", patch);
+    GX_ASSERT_S(patchPoint.dynamicOffsetCount == dynamicOffsets.size(),
+                "Dynamic offset count mismatch, need %d", patchPoint.dynamicOffsetCount);
+    if (patchPoint.cmdKey != CommandKey::BindDescSet
+        || patchPoint.dynamicOffsetCount != dynamicOffsets.size()) {
+        return;
+    }
+
+    patchPoint.patched = true;
+    patchPoint.dynamicOffsets = dynamicOffsets;
+
+    onPatched();
+}
+
+void CommandRecorder::patchBuffer(CommandPatch patch, Buffer buffer, uint32_t offset)
+{
+    waitCompile();
+    GX_ASSERT_S(patch < mPatches.size(), "Invalid command patch %d", patch);
+    GX_ASSERT(buffer);
+    if (patch >= mPatches.size() || !buffer) {
+        return;
+    }
+    PatchPoint &patchPoint = mPatches[patch];
+    GX_ASSERT_S(patchPoint.cmdKey == CommandKey::BindIndexBuf
+                || patchPoint.cmdKey == CommandKey::DrawIndirect
+                || patchPoint.cmdKey == CommandKey::DrawIndexedIndirect
+                || patchPoint.cmdKey == CommandKey::DispatchIndirect,
+                "Command patch %d does not use buffer", patch);
+    if (patchPoint.cmdKey == CommandKey::BindDescSet) {
+        return;
+    }
+
+    auto *bufferP = dynamic_cast<Buffer_P *>(buffer);
+    patchPoint.patched = true;
+    patchPoint.buffer = bufferP->idx();
+    patchPoint.offset = offset;
+    if (mIsBundle) {
+        mReferences[bufferP->idx()] = bufferP;
+    }
+
+    onPatched();
+}
+
+bool CommandRecorder::isValid()
+{
+    if (!mIsBundle || !mIsValid) {
+        return mIsValid;
+    }
+
+    Context_P *contextP = mContextT->contextP();
+    uint64_t epoch = contextP->elementEpoch();
+    if (epoch == mValidatedEpoch) {
+        return true;
+    }
+    // 有元素被销毁，检查引用的元素是否都还存在
+    for (auto &it : mReferences) {
+        if (!contextP->isElementAlive(it.first, it.second)) {
+            mIsValid = false;
+            return false;
+        }
+    }
+    mValidatedEpoch = epoch;
+    return true;
+}
+
+void CommandRecorder::resetCommandBuffer()
+{
+    mCommandBuffer.reset();
+    mSubpassContents.clear();
+    mInRenderPass = false;
+    mIsCompiled = false;
+    mMaxFrameBufferCount = 0;
+
+    mHasPatchCandidate = false;
+    mPatches.clear();
+    mReferences.clear();
+    mIsValid = true;
+
+    mTrackedStates.clear();
+    mSortedDraws.clear();
+    mSortedDrawStates.clear();
+    mSortedRegions.clear();
+    mInSortedDraws = false;
+    mElidedStateCount = 0;
+    mDebugLabelCount = 0;
+
+    if (mIsBundle) {
+        mValidatedEpoch = mContextT->contextP()->elementEpoch();
+    }
+}
+
+void CommandRecorder::writeElement(ElementHandle *obj)
+{
+    GfxIdxTy idx = obj->idx();
+    mCommandBuffer.write(idx);
+    if (mIsBundle) {
+        mReferences[idx] = obj;
+    }
+}
+
+void CommandRecorder::setPatchCandidate(uint64_t pos, uint8_t cmdKey, uint32_t dynamicOffsetCount)
+{
+    mPatchCandidate = PatchPoint{};
+    mPatchCandidate.pos = pos;
+    mPatchCandidate.endPos = mCommandBuffer.writePos();
+    mPatchCandidate.cmdKey = cmdKey;
+    mPatchCandidate.dynamicOffsetCount = dynamicOffsetCount;
+    mHasPatchCandidate = true;
+}
+
+void CommandRecorder::trackCommand(uint64_t cmdPos, uint8_t cmdKey)
+{
+    if (elideRedundantState(cmdPos, cmdKey)) {
+        mElidedStateCount++;
+        return;
+    }
+
+    if (mInSortedDraws) {
+        // 与上一条可排序指令之间录制了其他指令
+        if (cmdPos != mSortedLastEndPos) {
+            mSortedDrawsSortable = false;
+        }
+        mSortedLastEndPos = mCommandBuffer.writePos();
+    }
+
+    const uint64_t payloadPos = cmdPos + sizeof(uint8_t);
+
+    switch (cmdKey) {
+        case CommandKey::SetGraphPipelineState:
+            setTrackedState(StateSlot::GraphPipelineState, cmdPos);
+            break;
+        case CommandKey::SetVertexLayout:
+            setTrackedState(StateSlot::VertexLayout, cmdPos);
+            break;
+        case CommandKey::SetShaders:
+            setTrackedState(StateSlot::Shaders, cmdPos);
+            break;
+        case CommandKey::SetViewport:
+            setTrackedState(StateSlot::Viewport, cmdPos);
+            break;
+        case CommandKey::SetScissor:
+            setTrackedState(StateSlot::Scissor, cmdPos);
+            break;
+        case CommandKey::SetLineWidth:
+            setTrackedState(StateSlot::LineWidth, cmdPos);
+            break;
+        case CommandKey::SetStencilCompMask:
+        case CommandKey::SetStencilWriteMask:
+        case CommandKey::SetStencilReference: {
+            uint32_t frontSlot = cmdKey == CommandKey::SetStencilCompMask
+                                 ? StateSlot::StencilCompMaskFront
+                                 : (cmdKey == CommandKey::SetStencilWriteMask
+                                    ? StateSlot::StencilWriteMaskFront
+                                    : StateSlot::StencilReferenceFront);
+            auto face = (StencilFace::Enum) mCommandBuffer.byteAt(payloadPos);
+            if (face == StencilFace::Front || face == StencilFace::FrontAndBack) {
+                setTrackedState(frontSlot, cmdPos);
+            }
+            if (face == StencilFace::Back || face == StencilFace::FrontAndBack) {
+                setTrackedState(frontSlot + 1, cmdPos);
+            }
+        }
+            break;
+        case CommandKey::BindDescSet:
+            setTrackedState(mCommandBuffer.byteAt(payloadPos) == ResourceBindPoint::Compute
+                            ? StateSlot::ComputeDescSet
+                            : StateSlot::GraphicsDescSet, cmdPos);
+            break;
+        case CommandKey::BindVertexBuf: {
+            uint32_t firstBinding;
+            mCommandBuffer.copy(payloadPos, &firstBinding, sizeof(uint32_t));
+            uint8_t size = mCommandBuffer.byteAt(payloadPos + sizeof(uint32_t));
+            for (uint32_t b = 0; b < size; b++) {
+                setTrackedState(StateSlot::Count + firstBinding + b, cmdPos);
+            }
+        }
+            break;
+        case CommandKey::BindIndexBuf:
+            setTrackedState(StateSlot::IndexBuffer, cmdPos);
+            break;
+        case CommandKey::Draw:
+        case CommandKey::DrawIndexed:
+        case CommandKey::DrawIndirect:
+        case CommandKey::DrawIndexedIndirect: {
+            if (!mInSortedDraws) {
+                break;
+            }
+            SortedDraw draw{};
+            draw.pipelineKey = 0;
+            for (uint32_t slot : {StateSlot::GraphPipelineState, StateSlot::VertexLayout, StateSlot::Shaders,
+                                  StateSlot::StencilCompMaskFront, StateSlot::StencilCompMaskBack,
+                                  StateSlot::StencilWriteMaskFront, StateSlot::StencilWriteMaskBack,
+                                  StateSlot::StencilReferenceFront, StateSlot::StencilReferenceBack}) {
+                draw.pipelineKey = gx::hashOf(draw.pipelineKey, trackedStateHash(slot));
+            }
+            draw.binderKey = trackedStateHash(StateSlot::GraphicsDescSet);
+            draw.bufferKey = trackedStateHash(StateSlot::IndexBuffer);
+            for (uint32_t slot = StateSlot::Count; slot < mTrackedStates.size(); slot++) {
+                draw.bufferKey = gx::hashOf(draw.bufferKey, trackedStateHash(slot));
+            }
+            draw.order = (uint32_t) mSortedDraws.size();
+            draw.drawPos = cmdPos;
+            draw.stateOffset = (uint32_t) mSortedDrawStates.size();
+            draw.stateCount = (uint32_t) mTrackedStates.size();
+            for (auto &state : mTrackedStates) {
+                mSortedDrawStates.push_back(state.pos);
+            }
+            mSortedDraws.push_back(draw);
+        }
+            break;
+        default:
+            break;
+    }
+}
+
+void CommandRecorder::setTrackedState(uint32_t slot, uint64_t cmdPos)
+{
+    if (slot >= mTrackedStates.size()) {
+        mTrackedStates.resize(std::max<size_t>(slot + 1, StateSlot::Count));
+    }
+    TrackedState &state = mTrackedStates[slot];
+    state.pos = cmdPos;
+    state.endPos = mCommandBuffer.writePos();
+    state.hashed = false;
+}
+
+bool CommandRecorder::elideRedundantState(uint64_t cmdPos, uint8_t cmdKey)
+{
+    // 描述符集和索引缓冲是可修补的指令，录制时不省略，由编译时的状态缓存去除重复绑定
+    uint32_t slot;
+    switch (cmdKey) {
+        case CommandKey::SetGraphPipelineState:
+            slot = StateSlot::GraphPipelineState;
+            break;
+        case CommandKey::SetVertexLayout:
+            slot = StateSlot::VertexLayout;
+            break;
+        case CommandKey::SetShaders:
+            slot = StateSlot::Shaders;
+            break;
+        case CommandKey::SetViewport:
+            slot = StateSlot::Viewport;
+            break;
+        case CommandKey::SetScissor:
+            slot = StateSlot::Scissor;
+            break;
+        case CommandKey::SetLineWidth:
+            slot = StateSlot::LineWidth;
+            break;
+        default:
+            return false;
+    }
+
+    if (slot >= mTrackedStates.size() || mTrackedStates[slot].pos == UINT64_MAX) {
+        return false;
+    }
+    const TrackedState &state = mTrackedStates[slot];
+    const uint64_t size = mCommandBuffer.writePos() - cmdPos;
+    if (state.endPos - state.pos != size || !mCommandBuffer.equal(state.pos, cmdPos, size)) {
+        return false;
+    }
+
+    mCommandBuffer.truncate(cmdPos);
+    mHasPatchCandidate = false;
+    return true;
+}
+
+size_t CommandRecorder::trackedStateHash(uint32_t slot)
+{
+    if (slot >= mTrackedStates.size() || mTrackedStates[slot].pos == UINT64_MAX) {
+        return 0;
+    }
+    TrackedState &state = mTrackedStates[slot];
+    if (!state.hashed) {
+        // 以指令内容作为状态的标识，相同参数的不同指令视为同一状态
+        state.hash = mCommandBuffer.hash(state.pos, state.endPos - state.pos);
+        state.hashed = true;
+    }
+    return state.hash;
+}
+
+bool CommandRecorder::sortDraws(SortedRegion &region)
+{
+    if (!mSortedDrawsSortable) {
+        Log("CommandRecorder::endSortedDraws unsortable command recorded, keep recording order");
+        return false;
+    }
+    if (mSortedDraws.size() < 2) {
+        return false;
+    }
+
+    const size_t slotCount = mTrackedStates.size();
+
+    // 某个状态只在部分绘制前设置过时，无法确定其余绘制排序后使用的状态，保持录制顺序
+    for (size_t slot = 0; slot < slotCount; slot++) {
+        bool hasSet = false;
+        bool hasUnset = false;
+        for (auto &draw : mSortedDraws) {
+            bool isSet = slot < draw.stateCount && mSortedDrawStates[draw.stateOffset + slot] != UINT64_MAX;
+            hasSet |= isSet;
+            hasUnset |= !isSet;
+        }
+        if (hasSet && hasUnset) {
+            Log("CommandRecorder::endSortedDraws state is not set before all draws, keep recording order");
+            return false;
+        }
+    }
+
+    std::vector<uint32_t> order(mSortedDraws.size());
+    for (uint32_t k = 0; k < order.size(); k++) {
+        order[k] = k;
+    }
+    std::sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) {
+        const SortedDraw &da = mSortedDraws[a];
+        const SortedDraw &db = mSortedDraws[b];
+        if (da.pipelineKey != db.pipelineKey) {
+            return da.pipelineKey < db.pipelineKey;
+        }
+        if (da.binderKey != db.binderKey) {
+            return da.binderKey < db.binderKey;
+        }
+        if (da.bufferKey != db.bufferKey) {
+            return da.bufferKey < db.bufferKey;
+        }
+        return da.order < db.order;
+    });
+
+    std::vector<uint64_t> emitted(slotCount, UINT64_MAX);
+    std::vector<uint64_t> changed;
+    auto emitStates = [&](const uint64_t *states, size_t stateCount) {
+        uint64_t minPos = UINT64_MAX;
+        for (size_t slot = 0; slot < slotCount; slot++) {
+            uint64_t pos = slot < stateCount ? states[slot] : UINT64_MAX;
+            if (pos != UINT64_MAX && pos != emitted[slot]) {
+                minPos = std::min(minPos, pos);
+            }
+        }
+        if (minPos == UINT64_MAX) {
+            return;
+        }
+        // 一条指令可能设置多个状态槽，之后录制的状态需要在其后重新设置
+        changed.clear();
+        for (size_t slot = 0; slot < slotCount; slot++) {
+            uint64_t pos = slot < stateCount ? states[slot] : UINT64_MAX;
+            if (pos != UINT64_MAX && pos >= minPos) {
+                changed.push_back(pos);
+                emitted[slot] = pos;
+            }
+        }
+        std::sort(changed.begin(), changed.end());
+        changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+        region.commands.insert(region.commands.end(), changed.begin(), changed.end());
+    };
+
+    region.commands.clear();
+    for (uint32_t k : order) {
+        const SortedDraw &draw = mSortedDraws[k];
+        emitStates(mSortedDrawStates.data() + draw.stateOffset, draw.stateCount);
+        region.commands.push_back(mSortedDraws[k].drawPos);
+    }
+
+    // 区间结束后的状态与按录制顺序执行时相同
+    std::vector<uint64_t> finalStates(slotCount);
+    for (size_t slot = 0; slot < slotCount; slot++) {
+        finalStates[slot] = mTrackedStates[slot].pos;
+    }
+    emitStates(finalStates.data(), finalStates.size());
+
+    return true;
+}
+
+const CommandRecorder::SortedRegion *CommandRecorder::findSortedRegion(uint64_t beginPos) const
+{
+    auto it = std::lower_bound(mSortedRegions.begin(), mSortedRegions.end(), beginPos,
+                               [](const SortedRegion &region, uint64_t pos) {
+                                   return region.beginPos < pos;
+                               });
+    if (it == mSortedRegions.end() || it->beginPos != beginPos) {
+        return nullptr;
+    }
+    return &*it;
+}
+
+
+}
@@ -0,0 +1,274 @@
+/*
+ * Copyright (c) 2023 Gxin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "gfx_command_stream.h"
+
+#include <gx/debug.h>
+
+#include <cstdio>
+#include <cstdlib>
+
+
+namespace gfx
+{
+
+/// ============ CommandArena ============ ///
+
+CommandArena::~CommandArena()
+{
+    clear();
+}
+
+uint8_t *CommandArena::acquire()
+{
+    {
+        GLockerGuard locker(mMutex);
+        if (!mFreeChunks.empty()) {
+            uint8_t *chunk = mFreeChunks.back();
+            mFreeChunks.pop_back();
+            return chunk;
+        }
+    }
+
+    auto *chunk = (uint8_t *) malloc(CMD_CHUNK_SIZE);
+    GX_ASSERT_S(chunk != nullptr, "CommandArena::acquire malloc %d bytes failure", (int) CMD_CHUNK_SIZE);
+    return chunk;
+}
+
+void CommandArena::release(uint8_t *chunk)
+{
+    if (chunk == nullptr) {
+        return;
+    }
+    GLockerGuard locker(mMutex);
+    mFreeChunks.push_back(chunk);
+}
+
+void CommandArena::clear()
+{
+    GLockerGuard locker(mMutex);
+    for (auto *chunk : mFreeChunks) {
+        free(chunk);
+    }
+    mFreeChunks.clear();
+}
+
+/// ============ CommandStream ============ ///
+
+CommandStream::~CommandStream()
+{
+    destroy();
+}
+
+void CommandStream::init(CommandArena *arena)
+{
+    GX_ASSERT(arena != nullptr);
+    mArena = arena;
+    mWritePos = 0;
+    mReadPos = 0;
+}
+
+void CommandStream::destroy()
+{
+    if (mArena) {
+        for (auto *chunk : mChunks) {
+            mArena->release(chunk);
+        }
+    }
+    mChunks.clear();
+    mWritePos = 0;
+    mReadPos = 0;
+}
+
+void CommandStream::write(const void *data, uint64_t size)
+{
+    const auto *src = (const uint8_t *) data;
+    while (size > 0) {
+        const uint64_t chunkIndex = mWritePos >> CMD_CHUNK_SHIFT;
+        if (chunkIndex == mChunks.size()) {
+            GX_ASSERT_S(mArena != nullptr, "CommandStream is not initialized");
+            mChunks.push_back(mArena->acquire());
+        }
+        const uint64_t offset = mWritePos & CMD_CHUNK_MASK;
+        const uint64_t n = std::min<uint64_t>(size, CMD_CHUNK_SIZE - offset);
+        memcpy(mChunks[chunkIndex] + offset, src, n);
+        src += n;
+        size -= n;
+        mWritePos += n;
+    }
+}
+
+void CommandStream::write(const std::string &str)
+{
+    writeVarint((uint32_t) str.size());
+    write(str.data(), str.size());
+}
+
+void CommandStream::write(const CommandStream &src, uint64_t pos, uint64_t size)
+{
+    GX_ASSERT_S(&src != this, "CommandStream::write can not append from itself");
+    GX_ASSERT_S(pos + size <= src.mWritePos, "CommandStream::write source out of range");
+    src.visit(pos, size, [this](const uint8_t *data, uint64_t n) {
+        write(data, n);
+    });
+}
+
+void CommandStream::read(void *data, uint64_t size)
+{
+    copy(mReadPos, data, size);
+    mReadPos += size;
+}
+
+void CommandStream::read(std::string &str)
+{
+    uint32_t size;
+    readVarint(size);
+    str.resize(size);
+    read(str.data(), size);
+}
+
+void CommandStream::writeVarint(uint32_t value)
+{
+    uint8_t bytes[5];
+    uint32_t count = 0;
+    while (value >= 0x80) {
+        bytes[count++] = (uint8_t) (value | 0x80);
+        value >>= 7;
+    }
+    bytes[count++] = (uint8_t) value;
+    write(bytes, count);
+}
+
+void CommandStream::readVarint(uint32_t &value)
+{
+    value = decodeVarint(mReadPos);
+    GX_ASSERT_S(mReadPos <= mWritePos, "CommandStream::readVarint out of range");
+}
+
+void CommandStream::writeVarint(int32_t value)
+{
+    writeVarint((uint32_t) ((value << 1) ^ (value >> 31)));
+}
+
+void CommandStream::readVarint(int32_t &value)
+{
+    uint32_t zigzag;
+    readVarint(zigzag);
+    value = (int32_t) ((zigzag >> 1) ^ (~(zigzag & 1) + 1));
+}
+
+uint32_t CommandStream::decodeVarint(uint64_t &pos) const
+{
+    uint32_t value = 0;
+    uint32_t shift = 0;
+    uint8_t byte;
+    do {
+        byte = byteAt(pos++);
+        value |= (uint32_t) (byte & 0x7f) << shift;
+        shift += 7;
+    } while ((byte & 0x80) && shift < 35);
+    return value;
+}
+
+void CommandStream::copy(uint64_t pos, void *data, uint64_t size) const
+{
+    GX_ASSERT_S(pos + size <= mWritePos, "CommandStream::read out of range");
+    auto *dst = (uint8_t *) data;
+    visit(pos, size, [&dst](const uint8_t *src, uint64_t n) {
+        memcpy(dst, src, n);
+        dst += n;
+    });
+}
+
+bool CommandStream::equal(uint64_t posA, uint64_t posB, uint64_t size) const
+{
+    GX_ASSERT_S(posA + size <= mWritePos && posB + size <= mWritePos, "CommandStream::equal out of range");
+    while (size > 0) {
+        const uint64_t offsetA = posA & CMD_CHUNK_MASK;
+        const uint64_t offsetB = posB & CMD_CHUNK_MASK;
+        const uint64_t n = std::min<uint64_t>(size, CMD_CHUNK_SIZE - std::max(offsetA, offsetB));
+        if (memcmp(mChunks[posA >> CMD_CHUNK_SHIFT] + offsetA, mChunks[posB >> CMD_CHUNK_SHIFT] + offsetB, n) != 0) {
+            return false;
+        }
+        posA += n;
+        posB += n;
+        size -= n;
+    }
+    return true;
+}
+
+size_t CommandStream::hash(uint64_t pos, uint64_t size) const
+{
+    GX_ASSERT_S(pos + size <= mWritePos, "CommandStream::hash out of range");
+    // FNV-1a逐字节累积，同样的内容跨越指令块时结果不变
+    uint64_t value = 14695981039346656037ull;
+    visit(pos, size, [&value](const uint8_t *data, uint64_t n) {
+        for (uint64_t i = 0; i < n; i++) {
+            value = (value ^ data[i]) * 1099511628211ull;
+        }
+    });
+    return (size_t) value;
+}
+
+void CommandStream::seekReadPos(int whence, int64_t pos)
+{
+    switch (whence) {
+        case SEEK_CUR:
+            mReadPos = (uint64_t) ((int64_t) mReadPos + pos);
+            break;
+        case SEEK_END:
+            mReadPos = (uint64_t) ((int64_t) mWritePos + pos);
+            break;
+        case SEEK_SET:
+        default:
+            mReadPos = (uint64_t) pos;
+            break;
+    }
+    GX_ASSERT_S(mReadPos <= mWritePos, "CommandStream::seekReadPos out of range");
+}
+
+uint64_t CommandStream::readPos() const
+{
+    return mReadPos;
+}
+
+uint64_t CommandStream::writePos() const
+{
+    return mWritePos;
+}
+
+void CommandStream::reset()
+{
+    mWritePos = 0;
+    mReadPos = 0;
+}
+
+void CommandStream::truncate(uint64_t pos)
+{
+    GX_ASSERT(pos <= mWritePos);
+    mWritePos = pos;
+    if (mReadPos > mWritePos) {
+        mReadPos = mWritePos;
+    }
+}
+
+}
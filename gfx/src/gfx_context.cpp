@@ -409,6 +409,21 @@ std::string Context_T::dumpCommandBuffer(CommandBuffer commandBuffer)
     return mHandleP->dumpCommandBuffer(commandBuffer);
 }
 
+ContextStatistics Context_T::getStatistics()
+{
+    return mCounters.snapshot();
+}
+
+MemoryStatistics Context_T::getMemoryStatistics()
+{
+    return mHandleP->getMemoryStatistics();
+}
+
+void Context_T::setMemoryBudgetCallback(const MemoryBudgetCallback &callback, float threshold)
+{
+    mHandleP->setMemoryBudgetCallback(callback, threshold);
+}
+
 Context_P *Context_T::contextP()
 {
     return mHandleP;
@@ -419,6 +434,26 @@ Instance_T *Context_T::instanceT()
     return mInstanceT;
 }
 
+Profiler &Context_T::profiler()
+{
+    return mProfiler;
+}
+
+ContextCounters &Context_T::counters()
+{
+    return mCounters;
+}
+
+MemoryTracker &Context_T::memoryTracker()
+{
+    return mMemoryTracker;
+}
+
+void Context_T::parallelCompile(uint32_t count, const std::function<void(uint32_t)> &task)
+{
+    mHandleP->parallelCompile(count, task);
+}
+
 Fence Context_T::createFence(bool signaled)
 {
     return mHandleP->createFenceP(signaled);
@@ -444,8 +479,12 @@ RenderTarget Context_T::createRenderTarget(const CreateRenderTargetInfo &createI
     return mHandleP->createRenderTargetP(createInfo);
 }
 
-void Context_T::destroyRenderTarget(RenderTarget obj)
+void Context_T::destroyRenderTarget(RenderTarget obj, bool deferred)
 {
+    if (deferred) {
+        mHandleP->deferDestroyP(dynamic_cast<ElementHandle *>(obj));
+        return;
+    }
     mHandleP->destroyRenderTargetP(obj);
 }
 
@@ -454,8 +493,12 @@ Buffer Context_T::createBuffer(const CreateBufferInfo &createInfo)
     return mHandleP->createBufferP(createInfo);
 }
 
-void Context_T::destroyBuffer(Buffer obj)
+void Context_T::destroyBuffer(Buffer obj, bool deferred)
 {
+    if (deferred) {
+        mHandleP->deferDestroyP(dynamic_cast<ElementHandle *>(obj));
+        return;
+    }
     mHandleP->destroyBufferP(obj);
 }
 
@@ -464,8 +507,12 @@ Texture Context_T::createTexture(const CreateTextureInfo &createInfo)
     return mHandleP->createTextureP(createInfo);
 }
 
-void Context_T::destroyTexture(Texture obj)
+void Context_T::destroyTexture(Texture obj, bool deferred)
 {
+    if (deferred) {
+        mHandleP->deferDestroyP(dynamic_cast<ElementHandle *>(obj));
+        return;
+    }
     mHandleP->destroyTextureP(obj);
 }
 
@@ -494,8 +541,12 @@ ResourceBinder Context_T::createResourceBinder(const ResourceLayoutInfo &layoutI
     return mHandleP->createResourceBinderP(layoutInfo);
 }
 
-void Context_T::destroyResourceBinder(ResourceBinder obj)
+void Context_T::destroyResourceBinder(ResourceBinder obj, bool deferred)
 {
+    if (deferred) {
+        mHandleP->deferDestroyP(dynamic_cast<ElementHandle *>(obj));
+        return;
+    }
     mHandleP->destroyResourceBinderP(obj);
 }
 
@@ -111,13 +111,13 @@ RenderTarget createRenderTarget(Context context, const CreateRenderTargetInfo &c
     return contextT->createRenderTarget(createInfo);
 }
 
-void destroyRenderTarget(RenderTarget obj)
+void destroyRenderTarget(RenderTarget obj, bool deferred)
 {
     auto *objP = dynamic_cast<ElementHandle*>(obj);
     GX_ASSERT(objP != nullptr);
     auto *contextT = dynamic_cast<Context_T *>(objP->context());
     GX_ASSERT(contextT);
-    contextT->destroyRenderTarget(obj);
+    contextT->destroyRenderTarget(obj, deferred);
 }
 
 Buffer createBuffer(Context context, const CreateBufferInfo &createInfo)
@@ -127,13 +127,13 @@ Buffer createBuffer(Context context, const CreateBufferInfo &createInfo)
     return contextT->createBuffer(createInfo);
 }
 
-void destroyBuffer(Buffer buffer)
+void destroyBuffer(Buffer buffer, bool deferred)
 {
     auto *objP = dynamic_cast<ElementHandle*>(buffer);
     GX_ASSERT(objP != nullptr);
     auto *contextT = dynamic_cast<Context_T *>(objP->context());
     GX_ASSERT(contextT);
-    contextT->destroyBuffer(buffer);
+    contextT->destroyBuffer(buffer, deferred);
 }
 
 Texture createTexture(Context context, const CreateTextureInfo &createInfo)
@@ -143,13 +143,13 @@ Texture createTexture(Context context, const CreateTextureInfo &createInfo)
     return contextT->createTexture(createInfo);
 }
 
-void destroyTexture(Texture texture)
+void destroyTexture(Texture texture, bool deferred)
 {
     auto *objP = dynamic_cast<ElementHandle*>(texture);
     GX_ASSERT(objP != nullptr);
     auto *contextT = dynamic_cast<Context_T *>(objP->context());
     GX_ASSERT(contextT);
-    contextT->destroyTexture(texture);
+    contextT->destroyTexture(texture, deferred);
 }
 
 Sampler createSampler(Context context, const CreateSamplerInfo &createInfo)
@@ -191,13 +191,13 @@ ResourceBinder createResourceBinder(Context context, const ResourceLayoutInfo &l
     return contextT->createResourceBinder(layoutInfo);
 }
 
-void destroyResourceBinder(ResourceBinder binder)
+void destroyResourceBinder(ResourceBinder binder, bool deferred)
 {
     auto *objP = dynamic_cast<ElementHandle*>(binder);
     GX_ASSERT(objP != nullptr);
     auto *contextT = dynamic_cast<Context_T *>(objP->context());
     GX_ASSERT(contextT);
-    contextT->destroyResourceBinder(binder);
+    contextT->destroyResourceBinder(binder, deferred);
 }
 
 CommandBuffer createCommandBuffer(Context context, const CreateCommandBufferInfo &createInfo)
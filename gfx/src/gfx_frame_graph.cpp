@@ -0,0 +1,713 @@
+/*
+ * Copyright (c) 2023 Gxin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "gfx_frame_graph_impl.h"
+#include "gfx_context.h"
+
+#include <gfx/gfx_tools.h>
+#include <gx/debug.h>
+
+#include <algorithm>
+#include <unordered_map>
+
+
+namespace gfx
+{
+
+// 纹理池和渲染目标缓存在连续多少次编译未被使用后回收
+// 需要大于Frames in flight的数量，避免回收仍在被GPU使用的资源
+constexpr uint64_t FRAME_GRAPH_IDLE_COMPILE_COUNT = 8;
+
+bool FrameGraph_T::init(Context context)
+{
+    GX_ASSERT(context);
+    mContext = context;
+    return true;
+}
+
+void FrameGraph_T::destroy()
+{
+    reset();
+
+    for (auto &cache : mRenderTargetCache) {
+        destroyRenderTarget(cache.renderTarget, true);
+    }
+    mRenderTargetCache.clear();
+
+    for (auto &pooled : mTexturePool) {
+        destroyTexture(pooled.texture, true);
+    }
+    mTexturePool.clear();
+
+    for (auto cmdBuffer : mPassCmdBuffers) {
+        if (cmdBuffer) {
+            destroyCommandBuffer(cmdBuffer);
+        }
+    }
+    mPassCmdBuffers.clear();
+    for (auto cmdBuffer : mPassSecondaryBuffers) {
+        if (cmdBuffer) {
+            destroyCommandBuffer(cmdBuffer);
+        }
+    }
+    mPassSecondaryBuffers.clear();
+
+    mContext = GFX_NULL_HANDLE;
+}
+
+FrameGraphResource FrameGraph_T::createTexture(const std::string &name, const CreateTextureInfo &createInfo)
+{
+    ResourceNode node{};
+    node.name = name;
+    node.kind = ResourceKind::Transient;
+    node.createInfo = createInfo;
+    mResources.push_back(node);
+    mIsCompiled = false;
+
+    return (FrameGraphResource) (mResources.size() - 1);
+}
+
+FrameGraphResource FrameGraph_T::importTexture(const std::string &name, Texture texture, ImageLayout::Enum layout)
+{
+    GX_ASSERT_S(texture != GFX_NULL_HANDLE, "FrameGraph::importTexture texture is null");
+
+    ResourceNode node{};
+    node.name = name;
+    node.kind = ResourceKind::Imported;
+    node.texture = texture;
+    node.importLayout = layout;
+    mResources.push_back(node);
+    mIsCompiled = false;
+
+    return (FrameGraphResource) (mResources.size() - 1);
+}
+
+FrameGraphResource FrameGraph_T::importFrame(const std::string &name, Frame frame)
+{
+    GX_ASSERT_S(frame != GFX_NULL_HANDLE, "FrameGraph::importFrame frame is null");
+
+    ResourceNode node{};
+    node.name = name;
+    node.kind = ResourceKind::Frame;
+    node.frame = frame;
+    mResources.push_back(node);
+    mIsCompiled = false;
+
+    return (FrameGraphResource) (mResources.size() - 1);
+}
+
+FrameGraphPass FrameGraph_T::addPass(const FrameGraphPassInfo &passInfo, const FrameGraphExecuteCallback &execute)
+{
+    GX_ASSERT_S(passInfo.type < FrameGraphPassType::Count, "FrameGraph::addPass unknown pass type");
+
+    PassNode node{};
+    node.info = passInfo;
+    node.execute = execute;
+    mPasses.push_back(node);
+    mIsCompiled = false;
+
+    return (FrameGraphPass) (mPasses.size() - 1);
+}
+
+void FrameGraph_T::read(FrameGraphPass pass, FrameGraphResource resource, FrameGraphAccess::Enum access)
+{
+    if (!checkPass(pass) || !checkResource(resource)) {
+        return;
+    }
+    GX_ASSERT_S(access == FrameGraphAccess::Sampled
+                || access == FrameGraphAccess::Storage
+                || access == FrameGraphAccess::TransferSrc,
+                "FrameGraph::read unsupported access %d", access);
+    GX_ASSERT_S(mResources[resource].kind != ResourceKind::Frame, "FrameGraph::read can not read frame resource");
+
+    mPasses[pass].accesses.push_back({resource, access, false, false, 0});
+    mIsCompiled = false;
+}
+
+void FrameGraph_T::write(FrameGraphPass pass, FrameGraphResource resource, FrameGraphAccess::Enum access)
+{
+    if (!checkPass(pass) || !checkResource(resource)) {
+        return;
+    }
+    GX_ASSERT_S(access == FrameGraphAccess::Storage
+                || access == FrameGraphAccess::TransferDst,
+                "FrameGraph::write unsupported access %d, use writeColor or writeDepthStencil for attachments", access);
+    GX_ASSERT_S(mResources[resource].kind != ResourceKind::Frame, "FrameGraph::write can not write frame resource");
+
+    mPasses[pass].accesses.push_back({resource, access, true, false, 0});
+    mIsCompiled = false;
+}
+
+void FrameGraph_T::writeColor(FrameGraphPass pass, FrameGraphResource resource, uint8_t index, bool clear)
+{
+    if (!checkPass(pass) || !checkResource(resource)) {
+        return;
+    }
+    GX_ASSERT_S(mPasses[pass].info.type == FrameGraphPassType::Graphics,
+                "FrameGraph::writeColor pass(%s) is not graphics pass", mPasses[pass].info.name.c_str());
+    GX_ASSERT_S(index < RenderTargetAttachmentFlag::ColorCount, "FrameGraph::writeColor index out of range");
+
+    mPasses[pass].accesses.push_back({resource, FrameGraphAccess::ColorAttachment, true, clear, index});
+    mIsCompiled = false;
+}
+
+void FrameGraph_T::writeDepthStencil(FrameGraphPass pass, FrameGraphResource resource, bool clear)
+{
+    if (!checkPass(pass) || !checkResource(resource)) {
+        return;
+    }
+    GX_ASSERT_S(mPasses[pass].info.type == FrameGraphPassType::Graphics,
+                "FrameGraph::writeDepthStencil pass(%s) is not graphics pass", mPasses[pass].info.name.c_str());
+
+    mPasses[pass].accesses.push_back({resource, FrameGraphAccess::DepthStencilAttachment, true, clear, 0});
+    mIsCompiled = false;
+}
+
+bool FrameGraph_T::compile()
+{
+    mCompileCount++;
+    mIsCompiled = false;
+
+    cullPasses();
+
+    if (!allocateTextures()) {
+        return false;
+    }
+    if (!buildPasses()) {
+        return false;
+    }
+
+    releaseIdleResources();
+
+    mIsCompiled = true;
+    return true;
+}
+
+void FrameGraph_T::execute(CommandBuffer cmdBuffer, bool parallel)
+{
+    GX_ASSERT_S(mIsCompiled, "FrameGraph::execute call compile first");
+    if (!mIsCompiled) {
+        return;
+    }
+
+    if (parallel) {
+        // Graphics Pass录制到继承RenderPass的Secondary指令缓冲，其余Pass录制到Primary指令缓冲后合并
+        mPassCmdBuffers.resize(std::max(mPassCmdBuffers.size(), mPasses.size()), GFX_NULL_HANDLE);
+        mPassSecondaryBuffers.resize(std::max(mPassSecondaryBuffers.size(), mPasses.size()), GFX_NULL_HANDLE);
+        for (uint32_t i = 0; i < mPasses.size(); i++) {
+            auto &pass = mPasses[i];
+            if (pass.culled || !pass.execute) {
+                continue;
+            }
+            getPassCmdBuffer(i);
+        }
+
+        // 各Pass的录制互不依赖，在上下文常驻的工作线程上并行录制
+        auto *contextT = dynamic_cast<Context_T *>(mContext);
+        contextT->parallelCompile((uint32_t) mPasses.size(), [this](uint32_t i) {
+            auto &pass = mPasses[i];
+            if (pass.culled || !pass.execute) {
+                return;
+            }
+            CommandBuffer passCmdBuffer = getPassCmdBuffer(i);
+            passCmdBuffer->begin();
+            pass.execute(this, passCmdBuffer);
+            passCmdBuffer->end();
+        });
+    }
+
+    for (uint32_t i = 0; i < mPasses.size(); i++) {
+        auto &pass = mPasses[i];
+        if (pass.culled) {
+            continue;
+        }
+
+        cmdBuffer->beginDebugLabel(pass.info.name);
+
+        for (auto &barrier : pass.barriers) {
+            cmdBuffer->imageMemoryBarrier(barrier.texture, barrier.srcLayout, barrier.dstLayout, {0, 0, 0, 0});
+        }
+
+        bool isGraphics = pass.info.type == FrameGraphPassType::Graphics;
+        if (isGraphics) {
+            if (pass.frame != GFX_NULL_HANDLE) {
+                cmdBuffer->bindRenderTarget(pass.frame);
+            } else {
+                cmdBuffer->bindRenderTarget(pass.renderTarget);
+            }
+            cmdBuffer->setClearColor(pass.info.clearColor);
+            cmdBuffer->setClearDepthStencil(pass.info.clearDepth, pass.info.clearStencil);
+            cmdBuffer->beginRenderPass(pass.renderArea, pass.rpInfo);
+        }
+
+        if (parallel) {
+            if (pass.execute) {
+                cmdBuffer->executeCommands({getPassCmdBuffer(i)});
+            }
+        } else if (pass.execute) {
+            pass.execute(this, cmdBuffer);
+        }
+
+        if (isGraphics) {
+            cmdBuffer->endRenderPass();
+        }
+
+        cmdBuffer->endDebugLabel();
+    }
+
+    for (auto &barrier : mFinalBarriers) {
+        cmdBuffer->imageMemoryBarrier(barrier.texture, barrier.srcLayout, barrier.dstLayout, {0, 0, 0, 0});
+    }
+
+    for (auto &pooled : mTexturePool) {
+        if (pooled.lastUsedCompile == mCompileCount) {
+            pooled.layout = getImageLayoutFromUsage(pooled.createInfo.usage, pooled.createInfo.aspect, false);
+        }
+    }
+}
+
+void FrameGraph_T::reset()
+{
+    mResources.clear();
+    mPasses.clear();
+    mFinalBarriers.clear();
+    mIsCompiled = false;
+}
+
+Texture FrameGraph_T::getTexture(FrameGraphResource resource)
+{
+    if (!checkResource(resource)) {
+        return GFX_NULL_HANDLE;
+    }
+    return mResources[resource].texture;
+}
+
+bool FrameGraph_T::isPassCulled(FrameGraphPass pass)
+{
+    if (!checkPass(pass)) {
+        return true;
+    }
+    return mPasses[pass].culled;
+}
+
+std::string FrameGraph_T::dump()
+{
+    std::string str;
+    str += "FrameGraph: passes = " + std::to_string(mPasses.size())
+           + ", resources = " + std::to_string(mResources.size())
+           + ", pooled textures = " + std::to_string(mTexturePool.size()) + "\n";
+
+    for (uint32_t i = 0; i < mPasses.size(); i++) {
+        auto &pass = mPasses[i];
+        str += "  [" + std::to_string(i) + "] " + pass.info.name;
+        if (pass.culled) {
+            str += " (culled)\n";
+            continue;
+        }
+        str += " barriers = " + std::to_string(pass.barriers.size());
+        if (pass.info.type == FrameGraphPassType::Graphics) {
+            str += ", clear = " + std::to_string(pass.rpInfo.clear)
+                   + ", discard = " + std::to_string(pass.rpInfo.discard)
+                   + ", discardEnd = " + std::to_string(pass.rpInfo.discardEnd);
+        }
+        str += "\n";
+        for (auto &access : pass.accesses) {
+            auto &res = mResources[access.resource];
+            str += std::string("    ") + (access.isWrite ? "write " : "read ") + res.name;
+            if (res.kind == ResourceKind::Transient) {
+                str += " -> texture(" + std::to_string(getObjectIdx(res.texture)) + ")";
+            }
+            str += "\n";
+        }
+    }
+    str += "  final barriers = " + std::to_string(mFinalBarriers.size()) + "\n";
+
+    return str;
+}
+
+bool FrameGraph_T::checkPass(FrameGraphPass pass) const
+{
+    GX_ASSERT_S(pass < mPasses.size(), "FrameGraph invalid pass %u", pass);
+    return pass < mPasses.size();
+}
+
+bool FrameGraph_T::checkResource(FrameGraphResource resource) const
+{
+    GX_ASSERT_S(resource < mResources.size(), "FrameGraph invalid resource %u", resource);
+    return resource < mResources.size();
+}
+
+void FrameGraph_T::cullPasses()
+{
+    // 从后向前遍历，needed表示之后存活的Pass需要资源在此时的内容
+    std::vector<bool> needed(mResources.size(), false);
+
+    for (int64_t i = (int64_t) mPasses.size() - 1; i >= 0; i--) {
+        auto &pass = mPasses[i];
+
+        bool alive = pass.info.sideEffect;
+        for (auto &access : pass.accesses) {
+            if (!access.isWrite) {
+                continue;
+            }
+            if (mResources[access.resource].kind != ResourceKind::Transient || needed[access.resource]) {
+                alive = true;
+            }
+        }
+        pass.culled = !alive;
+        if (!alive) {
+            continue;
+        }
+
+        // 清理写入不依赖之前的内容，其他写入需要保留之前的内容
+        for (auto &access : pass.accesses) {
+            if (access.isWrite) {
+                needed[access.resource] = !access.clear;
+            }
+        }
+        for (auto &access : pass.accesses) {
+            if (!access.isWrite) {
+                needed[access.resource] = true;
+            }
+        }
+    }
+}
+
+bool FrameGraph_T::allocateTextures()
+{
+    for (auto &res : mResources) {
+        res.firstPass = FRAME_GRAPH_INVALID_ID;
+        res.lastPass = FRAME_GRAPH_INVALID_ID;
+        if (res.kind == ResourceKind::Transient) {
+            res.texture = GFX_NULL_HANDLE;
+        }
+    }
+    for (uint32_t i = 0; i < mPasses.size(); i++) {
+        if (mPasses[i].culled) {
+            continue;
+        }
+        for (auto &access : mPasses[i].accesses) {
+            auto &res = mResources[access.resource];
+            if (res.firstPass == FRAME_GRAPH_INVALID_ID) {
+                res.firstPass = i;
+            }
+            res.lastPass = i;
+        }
+    }
+
+    std::vector<uint32_t> transients;
+    for (uint32_t i = 0; i < mResources.size(); i++) {
+        if (mResources[i].kind == ResourceKind::Transient && mResources[i].firstPass != FRAME_GRAPH_INVALID_ID) {
+            transients.push_back(i);
+        }
+    }
+    std::sort(transients.begin(), transients.end(), [this](uint32_t a, uint32_t b) {
+        return mResources[a].firstPass < mResources[b].firstPass;
+    });
+
+    for (auto &pooled : mTexturePool) {
+        pooled.busyUntilPass = FRAME_GRAPH_INVALID_ID;
+    }
+
+    // 生命周期不重叠且创建信息相同的临时资源共用同一纹理
+    for (uint32_t resIndex : transients) {
+        auto &res = mResources[resIndex];
+
+        PooledTexture *target = nullptr;
+        for (auto &pooled : mTexturePool) {
+            bool isFree = pooled.busyUntilPass == FRAME_GRAPH_INVALID_ID || pooled.busyUntilPass < res.firstPass;
+            if (isFree && isSameTextureInfo(pooled.createInfo, res.createInfo)) {
+                target = &pooled;
+                break;
+            }
+        }
+        if (target == nullptr) {
+            Texture texture = gfx::createTexture(mContext, res.createInfo);
+            if (texture == GFX_NULL_HANDLE) {
+                Log("FrameGraph::compile create texture(%s) failure", res.name.c_str());
+                return false;
+            }
+            mTexturePool.push_back({res.createInfo, texture, ImageLayout::Undefined, FRAME_GRAPH_INVALID_ID, 0});
+            target = &mTexturePool.back();
+        }
+
+        target->busyUntilPass = res.lastPass;
+        target->lastUsedCompile = mCompileCount;
+        res.texture = target->texture;
+    }
+
+    return true;
+}
+
+bool FrameGraph_T::buildPasses()
+{
+    mFinalBarriers.clear();
+
+    std::unordered_map<Texture, TextureState> states;
+    std::vector<Texture> stateOrder;
+    std::vector<bool> written(mResources.size(), false);
+
+    std::unordered_map<Texture, ImageLayout::Enum> pooledLayouts;
+    for (auto &pooled : mTexturePool) {
+        pooledLayouts[pooled.texture] = pooled.layout;
+    }
+
+    for (uint32_t passIndex = 0; passIndex < mPasses.size(); passIndex++) {
+        auto &pass = mPasses[passIndex];
+        pass.barriers.clear();
+        pass.renderTarget = GFX_NULL_HANDLE;
+        pass.frame = GFX_NULL_HANDLE;
+        pass.rpInfo = {};
+        pass.renderArea = {};
+        if (pass.culled) {
+            continue;
+        }
+
+        Texture colors[RenderTargetAttachmentFlag::ColorCount] = {};
+        uint32_t colorCount = 0;
+        Texture depthStencil = GFX_NULL_HANDLE;
+
+        for (auto &access : pass.accesses) {
+            auto &res = mResources[access.resource];
+            bool discard = !access.clear && !written[access.resource] && res.kind == ResourceKind::Transient;
+            // 瞬态资源在最后一次使用后不再被读取，无需写回内存
+            bool discardEnd = res.kind == ResourceKind::Transient && res.lastPass == passIndex;
+
+            if (access.access == FrameGraphAccess::ColorAttachment) {
+                auto flag = (RenderTargetAttachmentFlags) RenderTargetAttachmentFlag::Color0 << access.index;
+                pass.rpInfo.clear |= access.clear ? flag : 0;
+                pass.rpInfo.discard |= discard ? flag : 0;
+                pass.rpInfo.discardEnd |= discardEnd ? flag : 0;
+                colors[access.index] = res.texture;
+                colorCount = std::max(colorCount, (uint32_t) access.index + 1);
+            } else if (access.access == FrameGraphAccess::DepthStencilAttachment) {
+                pass.rpInfo.clear |= access.clear ? RenderTargetAttachmentFlag::Depth : 0;
+                pass.rpInfo.discard |= discard ? RenderTargetAttachmentFlag::Depth : 0;
+                pass.rpInfo.discardEnd |= discardEnd ? RenderTargetAttachmentFlag::Depth : 0;
+                depthStencil = res.texture;
+            }
+            if (access.isWrite) {
+                written[access.resource] = true;
+            }
+
+            // Frame的布局由Frame自行管理
+            if (res.kind == ResourceKind::Frame) {
+                pass.frame = res.frame;
+                continue;
+            }
+
+            auto it = states.find(res.texture);
+            if (it == states.end()) {
+                TextureState state{};
+                if (res.kind == ResourceKind::Imported) {
+                    state.layout = res.importLayout;
+                    state.finalLayout = res.importLayout;
+                } else {
+                    state.layout = pooledLayouts[res.texture];
+                    state.finalLayout = getImageLayoutFromUsage(res.texture->usage(), res.texture->aspect(), false);
+                }
+                state.written = false;
+                it = states.emplace(res.texture, state).first;
+                stateOrder.push_back(res.texture);
+            }
+            auto &state = it->second;
+
+            // 只读之后的只读不需要同步，其他情况都需要Barrier
+            ImageLayout::Enum dstLayout = getAccessLayout(access.access, pass.info.type, res.texture);
+            if (state.layout != dstLayout || state.written || access.isWrite) {
+                pass.barriers.push_back({res.texture, state.layout, dstLayout});
+            }
+            state.layout = dstLayout;
+            state.written = access.isWrite;
+        }
+
+        if (pass.info.type != FrameGraphPassType::Graphics) {
+            continue;
+        }
+
+        if (pass.frame != GFX_NULL_HANDLE) {
+            pass.renderArea = {0, 0, pass.frame->width(), pass.frame->height()};
+            continue;
+        }
+
+        std::vector<Texture> colorTextures(colors, colors + colorCount);
+        for (uint32_t c = 0; c < colorCount; c++) {
+            if (colorTextures[c] == GFX_NULL_HANDLE) {
+                Log("FrameGraph::compile pass(%s) color attachment index must be continuous",
+                     pass.info.name.c_str());
+                return false;
+            }
+        }
+        Texture sizeTexture = colorCount > 0 ? colorTextures[0] : depthStencil;
+        if (sizeTexture == GFX_NULL_HANDLE) {
+            Log("FrameGraph::compile graphics pass(%s) has no attachment", pass.info.name.c_str());
+            return false;
+        }
+
+        pass.renderTarget = getRenderTarget(colorTextures, depthStencil);
+        if (pass.renderTarget == GFX_NULL_HANDLE) {
+            Log("FrameGraph::compile pass(%s) create render target failure", pass.info.name.c_str());
+            return false;
+        }
+        pass.renderArea = {0, 0, sizeTexture->width(), sizeTexture->height()};
+    }
+
+    // 执行结束后还原纹理布局，保证帧图外的使用者和下一帧的起始状态一致
+    for (auto texture : stateOrder) {
+        auto &state = states[texture];
+        if (state.layout != state.finalLayout) {
+            mFinalBarriers.push_back({texture, state.layout, state.finalLayout});
+        }
+    }
+
+    return true;
+}
+
+RenderTarget FrameGraph_T::getRenderTarget(const std::vector<Texture> &colors, Texture depthStencil)
+{
+    for (auto &cache : mRenderTargetCache) {
+        if (cache.colors == colors && cache.depthStencil == depthStencil) {
+            cache.lastUsedCompile = mCompileCount;
+            return cache.renderTarget;
+        }
+    }
+
+    CreateRenderTargetInfo createInfo{};
+    createInfo.colorAttachments.resize(1);
+    for (auto texture : colors) {
+        createInfo.colorAttachments[0].push_back({texture, 0, 0});
+    }
+    createInfo.depthStencilAttachment = {depthStencil, 0, 0};
+
+    RenderTarget renderTarget = createRenderTarget(mContext, createInfo);
+    if (renderTarget != GFX_NULL_HANDLE) {
+        mRenderTargetCache.push_back({colors, depthStencil, renderTarget, mCompileCount});
+    }
+    return renderTarget;
+}
+
+CommandBuffer FrameGraph_T::getPassCmdBuffer(uint32_t pass)
+{
+    // 并行录制前在调用线程中创建，录制线程只读取
+    if (mPasses[pass].info.type == FrameGraphPassType::Graphics) {
+        if (mPassSecondaryBuffers[pass] == GFX_NULL_HANDLE) {
+            mPassSecondaryBuffers[pass] = createCommandBuffer(mContext, {
+                    QueueType::Graphics, 1, CommandBufferLevel::Secondary
+            });
+        }
+        return mPassSecondaryBuffers[pass];
+    }
+    if (mPassCmdBuffers[pass] == GFX_NULL_HANDLE) {
+        mPassCmdBuffers[pass] = createCommandBuffer(mContext, {QueueType::Graphics, 1});
+    }
+    return mPassCmdBuffers[pass];
+}
+
+void FrameGraph_T::releaseIdleResources()
+{
+    auto isIdle = [this](uint64_t lastUsedCompile) {
+        return lastUsedCompile + FRAME_GRAPH_IDLE_COMPILE_COUNT < mCompileCount;
+    };
+
+    for (auto it = mRenderTargetCache.begin(); it != mRenderTargetCache.end();) {
+        if (isIdle(it->lastUsedCompile)) {
+            destroyRenderTarget(it->renderTarget, true);
+            it = mRenderTargetCache.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    for (auto it = mTexturePool.begin(); it != mTexturePool.end();) {
+        if (isIdle(it->lastUsedCompile)) {
+            destroyTexture(it->texture, true);
+            it = mTexturePool.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+ImageLayout::Enum FrameGraph_T::getAccessLayout(FrameGraphAccess::Enum access, FrameGraphPassType::Enum passType,
+                                                Texture texture)
+{
+    switch (access) {
+        case FrameGraphAccess::Sampled: {
+            bool isDepth = (texture->aspect() & (TextureAspect::AspectDepth | TextureAspect::AspectStencil)) != 0;
+            return isDepth ? ImageLayout::DepthStencilReadOnly : ImageLayout::ShaderReadOnly;
+        }
+        case FrameGraphAccess::Storage:
+            return passType == FrameGraphPassType::Compute ? ImageLayout::ComputeGeneral
+                                                           : ImageLayout::GraphicsGeneral;
+        case FrameGraphAccess::TransferSrc:
+            return ImageLayout::TransferSrc;
+        case FrameGraphAccess::TransferDst:
+            return ImageLayout::TransferDst;
+        case FrameGraphAccess::ColorAttachment:
+            return ImageLayout::ColorAttachment;
+        case FrameGraphAccess::DepthStencilAttachment:
+            return ImageLayout::DepthStencilAttachment;
+        default:
+            GX_ASSERT_S(false, "FrameGraph unknown access %d", access);
+            return ImageLayout::Undefined;
+    }
+}
+
+bool FrameGraph_T::isSameTextureInfo(const CreateTextureInfo &a, const CreateTextureInfo &b)
+{
+    return a.type == b.type
+           && a.format == b.format
+           && a.usage == b.usage
+           && a.aspect == b.aspect
+           && a.width == b.width
+           && a.height == b.height
+           && a.depth == b.depth
+           && a.mipLevels == b.mipLevels
+           && a.arrayLayers == b.arrayLayers
+           && a.swizzle.r == b.swizzle.r
+           && a.swizzle.g == b.swizzle.g
+           && a.swizzle.b == b.swizzle.b
+           && a.swizzle.a == b.swizzle.a;
+}
+
+FrameGraph createFrameGraph(Context context)
+{
+    auto *obj = GX_NEW(FrameGraph_T);
+    if (obj == GFX_NULL_HANDLE) {
+        return GFX_NULL_HANDLE;
+    }
+    if (obj->init(context)) {
+        return obj;
+    }
+    GX_DELETE(obj);
+    return GFX_NULL_HANDLE;
+}
+
+void destroyFrameGraph(FrameGraph obj)
+{
+    auto *objT = dynamic_cast<FrameGraph_T *>(obj);
+    GX_ASSERT(objT);
+    objT->destroy();
+    GX_DELETE(objT);
+}
+
+}
@@ -0,0 +1,157 @@
+/*
+ * Copyright (c) 2023 Gxin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "gfx_memory_tracker.h"
+
+#include <gx/debug.h>
+
+#include <algorithm>
+
+
+namespace gfx
+{
+
+MemoryCategory::Enum MemoryCategory::ofBuffer(BufferTypeFlags type, BufferMemoryUsage::Enum memoryUsage)
+{
+    if ((type & BufferType::Staging) == BufferType::Staging) {
+        return Staging;
+    }
+    if (memoryUsage >= BufferMemoryUsage::Count) {
+        return GpuOnlyBuffer;
+    }
+    return (Enum) memoryUsage;
+}
+
+MemoryCategory::Enum MemoryCategory::ofTexture(TextureUsageFlags usage)
+{
+    if ((usage & TextureUsage::Attachment) == TextureUsage::Attachment) {
+        return Attachment;
+    }
+    return Texture;
+}
+
+void MemoryTracker::Counter::add(uint64_t size)
+{
+    count.fetch_add(1, std::memory_order_relaxed);
+    bytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+void MemoryTracker::Counter::sub(uint64_t size)
+{
+    count.fetch_sub(1, std::memory_order_relaxed);
+    bytes.fetch_sub(size, std::memory_order_relaxed);
+}
+
+MemoryResourceStatistics MemoryTracker::Counter::load() const
+{
+    MemoryResourceStatistics stats{};
+    stats.count = count.load(std::memory_order_relaxed);
+    stats.bytes = bytes.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void MemoryTracker::setMemoryTypeHeaps(const uint32_t *typeHeapIndices, uint32_t typeCount)
+{
+    GX_ASSERT(typeCount <= MAX_MEMORY_TYPES);
+    mTypeCount = std::min(typeCount, MAX_MEMORY_TYPES);
+    for (uint32_t i = 0; i < mTypeCount; i++) {
+        GX_ASSERT(typeHeapIndices[i] < MAX_MEMORY_HEAPS);
+        mTypeHeapIndices[i] = typeHeapIndices[i];
+    }
+}
+
+uint32_t MemoryTracker::allocate(const MemoryRecord &record)
+{
+    if (!record.isValid()) {
+        return MAX_MEMORY_HEAPS;
+    }
+    mCategories[record.category].add(record.size);
+
+    uint32_t heapIndex = heapOf(record.memoryType);
+    if (heapIndex < MAX_MEMORY_HEAPS) {
+        mTypes[record.memoryType].add(record.size);
+        mHeaps[heapIndex].add(record.size);
+    }
+    return heapIndex;
+}
+
+void MemoryTracker::free(MemoryRecord &record)
+{
+    if (!record.isValid()) {
+        return;
+    }
+    mCategories[record.category].sub(record.size);
+
+    uint32_t heapIndex = heapOf(record.memoryType);
+    if (heapIndex < MAX_MEMORY_HEAPS) {
+        mTypes[record.memoryType].sub(record.size);
+        mHeaps[heapIndex].sub(record.size);
+    }
+    record = {};
+}
+
+uint64_t MemoryTracker::heapAllocationBytes(uint32_t heapIndex) const
+{
+    if (heapIndex >= MAX_MEMORY_HEAPS) {
+        return 0;
+    }
+    return mHeaps[heapIndex].bytes.load(std::memory_order_relaxed);
+}
+
+void MemoryTracker::fillStatistics(MemoryStatistics &stats) const
+{
+    for (uint32_t i = 0; i < BufferMemoryUsage::Count; i++) {
+        stats.buffers[i] = mCategories[i].load();
+    }
+    stats.textures = mCategories[MemoryCategory::Texture].load();
+    stats.attachments = mCategories[MemoryCategory::Attachment].load();
+    stats.staging = mCategories[MemoryCategory::Staging].load();
+
+    for (uint32_t i = 0; i < stats.types.size() && i < mTypeCount; i++) {
+        MemoryResourceStatistics typeStats = mTypes[i].load();
+        stats.types[i].allocationCount = typeStats.count;
+        stats.types[i].allocationBytes = typeStats.bytes;
+    }
+    for (uint32_t i = 0; i < stats.heaps.size(); i++) {
+        fillHeapStatistics(i, stats.heaps[i]);
+    }
+}
+
+void MemoryTracker::fillHeapStatistics(uint32_t heapIndex, MemoryHeapStatistics &heap) const
+{
+    if (heapIndex >= MAX_MEMORY_HEAPS) {
+        return;
+    }
+    MemoryResourceStatistics heapStats = mHeaps[heapIndex].load();
+    heap.allocationCount = heapStats.count;
+    heap.allocationBytes = heapStats.bytes;
+}
+
+uint32_t MemoryTracker::heapOf(uint32_t memoryType) const
+{
+    if (memoryType >= mTypeCount) {
+        return MAX_MEMORY_HEAPS;
+    }
+    return mTypeHeapIndices[memoryType];
+}
+
+}
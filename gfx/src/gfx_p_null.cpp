@@ -0,0 +1,1611 @@
+/*
+ * Copyright (c) 2023 Gxin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "gfx_p_null.h"
+
+#include "gfx_context.h"
+#include "gfx_element.h"
+#include "gfx_private.h"
+
+#include <gx/debug.h>
+
+#include <cstring>
+#include <algorithm>
+
+
+namespace gfx
+{
+namespace none
+{
+
+/// ============ Export ============ ///
+
+Instance_P *createInstanceP()
+{
+    return GX_NEW(InstanceNull);
+}
+
+void destroyInstanceP(Instance_P *obj)
+{
+    auto *objT = dynamic_cast<InstanceNull *>(obj);
+    objT->destroy();
+    GX_DELETE(objT);
+}
+
+/// ============ InstanceNull ============ ///
+
+bool InstanceNull::init(const CreateInstanceInfo &createInfo)
+{
+    mIsCreated = true;
+    return true;
+}
+
+void InstanceNull::destroy()
+{
+    mIsCreated = false;
+}
+
+uint32_t InstanceNull::deviceCount()
+{
+    return 1;
+}
+
+DeviceInfo InstanceNull::deviceInfo(uint32_t deviceIndex)
+{
+    GX_ASSERT(deviceIndex < deviceCount());
+
+    DeviceInfo info{};
+    info.deviceIndex = deviceIndex;
+    info.deviceType = DeviceType::CPU;
+    strncpy(info.deviceName, "Null Device", sizeof(info.deviceName) - 1);
+    return info;
+}
+
+bool InstanceNull::isCreated()
+{
+    return mIsCreated;
+}
+
+Context_P *InstanceNull::createContextP()
+{
+    uint16_t idx = mCtxIDAllocator.alloc();
+    GX_ASSERT(mCtxIDAllocator.isValid(idx));
+    return GX_NEW(ContextNull, idx);
+}
+
+void InstanceNull::destroyContextP(Context_P *obj)
+{
+    auto *objT = dynamic_cast<ContextNull *>(obj);
+    mCtxIDAllocator.free(objT->idx());
+    objT->destroy();
+    GX_DELETE(objT);
+}
+
+/// ============ ContextNull ============ ///
+
+static inline size_t alignSize(size_t size, size_t align)
+{
+    return (size + align - 1) & ~(align - 1);
+}
+
+bool ContextNull::init(Instance_P *instance, Context_T *context, const CreateContextInfo &createInfo)
+{
+    GX_ASSERT(dynamic_cast<InstanceNull *>(instance));
+    GX_ASSERT(context);
+
+    mParentCtx = context;
+
+    if (createInfo.enableCapture) {
+        Log("ContextNull::init the null backend does not support capture");
+    }
+    return true;
+}
+
+void ContextNull::destroy()
+{
+    checkLeak();
+
+    mParentCtx = GFX_NULL_HANDLE;
+}
+
+Format::Enum ContextNull::getSupportedDepthFormat()
+{
+    return Format::D24_UNorm_S8_UInt;
+}
+
+std::vector<Format::Enum> ContextNull::formatSupported(const std::vector<Format::Enum> &formats,
+                                                       FormatFeatureFlags featureFlags)
+{
+    return formats;
+}
+
+size_t ContextNull::uniformBufferOffsetAlignment(size_t dataSize)
+{
+    return alignSize(dataSize, 256);
+}
+
+size_t ContextNull::storageBufferOffsetAlignment(size_t dataSize)
+{
+    return alignSize(dataSize, 256);
+}
+
+size_t ContextNull::texelBufferOffsetAlignment(size_t dataSize)
+{
+    return alignSize(dataSize, 256);
+}
+
+SampleCountFlag::Enum ContextNull::maxRenderTargetSampleCount()
+{
+    return SampleCountFlag::SampleCount_8;
+}
+
+uint32_t ContextNull::maxTextureDimension1D()
+{
+    return 16384;
+}
+
+uint32_t ContextNull::maxTextureDimension2D()
+{
+    return 16384;
+}
+
+uint32_t ContextNull::maxTextureDimension3D()
+{
+    return 2048;
+}
+
+uint32_t ContextNull::maxTextureDimensionCube()
+{
+    return 16384;
+}
+
+uint32_t ContextNull::maxTextureArrayLayers()
+{
+    return 2048;
+}
+
+bool ContextNull::isSupportTextureCubeArray()
+{
+    return true;
+}
+
+uint32_t ContextNull::maxPerStageShaderSamplersCount()
+{
+    return 16;
+}
+
+uint32_t ContextNull::maxPerStageShaderUniformBuffersCount()
+{
+    return 15;
+}
+
+uint32_t ContextNull::maxPerStageShaderStorageBuffersCount()
+{
+    return 16;
+}
+
+uint32_t ContextNull::maxPerStageShaderSampledImagesCount()
+{
+    return 128;
+}
+
+uint32_t ContextNull::maxPerStageShaderStorageImagesCount()
+{
+    return 8;
+}
+
+void ContextNull::waitIdle()
+{
+}
+
+CommandBufferNull *ContextNull::prepareSubmit(CommandBuffer cmdBuffer)
+{
+    GX_ASSERT(cmdBuffer);
+    auto *cmdBufferP = dynamic_cast<CommandBufferNull *>(cmdBuffer);
+    GX_ASSERT_S(cmdBufferP->level() == CommandBufferLevel::Primary, "Secondary command buffer cannot be submitted");
+    GX_ASSERT_S(cmdBufferP->isValid(), "Command bundle references destroyed elements, please record it again");
+
+    if (!cmdBufferP->isCompiled()) {
+        cmdBufferP->compile();
+    }
+    mParentCtx->counters().submitCount++;
+    return cmdBufferP;
+}
+
+void ContextNull::submitCommandBlock(CommandBuffer cmdBuffer, uint32_t bufferIndex)
+{
+    prepareSubmit(cmdBuffer);
+}
+
+void ContextNull::submitCommand(CommandBuffer cmdBuffer, uint32_t bufferIndex, Fence fence)
+{
+    prepareSubmit(cmdBuffer);
+
+    // 没有异步执行，提交即完成
+    if (fence != GFX_NULL_HANDLE) {
+        dynamic_cast<FenceNull *>(fence)->signal();
+    }
+}
+
+void ContextNull::queueWaitIdle(QueueType::Enum queueType)
+{
+}
+
+std::string ContextNull::dumpCommandBuffer(CommandBuffer commandBuffer)
+{
+    return dynamic_cast<CommandBufferNull *>(commandBuffer)->dump();
+}
+
+bool ContextNull::beginCapture(const std::string &path)
+{
+    Log("ContextNull::beginCapture the null backend does not support capture");
+    return false;
+}
+
+bool ContextNull::endCapture()
+{
+    return false;
+}
+
+bool ContextNull::isCapturing()
+{
+    return false;
+}
+
+bool ContextNull::replayCapture(const std::string &path, const CaptureReplayInfo &info, CaptureReplayResult &result)
+{
+    Log("ContextNull::replayCapture the null backend does not support capture");
+    return false;
+}
+
+void ContextNull::collectProfilerEvents()
+{
+    // 没有GPU时间戳，CPU区间由Context的性能分析器直接记录
+}
+
+void ContextNull::parallelCompile(uint32_t count, const std::function<void(uint32_t)> &task)
+{
+    // 没有编译线程，在调用线程中依次执行
+    for (uint32_t i = 0; i < count; i++) {
+        task(i);
+    }
+}
+
+MemoryStatistics ContextNull::getMemoryStatistics()
+{
+    // 没有设备内存堆，只统计各类资源的大小
+    MemoryStatistics stats{};
+    mParentCtx->memoryTracker().fillStatistics(stats);
+    return stats;
+}
+
+void ContextNull::setMemoryBudgetCallback(const MemoryBudgetCallback &callback, float threshold)
+{
+    // 没有内存预算，回调永远不会触发
+}
+
+Fence_P *ContextNull::createFenceP(bool signaled)
+{
+    uint16_t oIdx = mFenceIDAlloc.alloc();
+    GX_ASSERT(mFenceIDAlloc.isValid(oIdx));
+    auto *obj = GX_NEW(FenceNull, genElementIdx(mIdx, oIdx, ElementType::Fence));
+    if (obj && obj->init(mParentCtx, signaled)) {
+        GX_ASSERT(!containElementMap(obj->idx()));
+        insertElementMap(obj);
+        return obj;
+    }
+    GX_ASSERT_S(obj != nullptr, "ContextNull::createFenceP create object failure");
+    GX_DELETE(obj);
+    return GFX_NULL_HANDLE;
+}
+
+void ContextNull::destroyFenceP(Fence obj)
+{
+    GX_ASSERT(obj);
+    auto *objP = dynamic_cast<Fence_P *>(obj);
+    GX_ASSERT(objP);
+
+    uint8_t tId = getElementTypeIdx(objP->idx());
+    GX_ASSERT(tId == ElementType::Fence);
+    uint16_t oId = getElementObjectIdx(objP->idx());
+
+    destroyElement(objP);
+    mFenceIDAlloc.free(oId);
+}
+
+Fence_P *ContextNull::findFenceP(GfxIdxTy idx)
+{
+    auto *objE = findElement(ElementType::Fence, idx);
+    if (!objE) {
+        return GFX_NULL_HANDLE;
+    }
+    return dynamic_cast<Fence_P *>(objE);
+}
+
+Frame_P *ContextNull::createFrameP(const CreateFrameInfo &createInfo)
+{
+    uint16_t oIdx = mFrameIDAlloc.alloc();
+    GX_ASSERT(mFrameIDAlloc.isValid(oIdx));
+    auto *obj = GX_NEW(FrameNull, genElementIdx(mIdx, oIdx, ElementType::Frame));
+    if (obj && obj->init(mParentCtx, createInfo)) {
+        GX_ASSERT(!containElementMap(obj->idx()));
+        insertElementMap(obj);
+        return obj;
+    }
+    GX_ASSERT_S(obj != nullptr, "ContextNull::createFrameP create object failure");
+    GX_DELETE(obj);
+    return GFX_NULL_HANDLE;
+}
+
+void ContextNull::destroyFrameP(Frame obj)
+{
+    GX_ASSERT(obj);
+    auto *objP = dynamic_cast<Frame_P *>(obj);
+    GX_ASSERT(objP);
+
+    uint8_t tId = getElementTypeIdx(objP->idx());
+    GX_ASSERT(tId == ElementType::Frame);
+    uint16_t oId = getElementObjectIdx(objP->idx());
+
+    destroyElement(objP);
+    mFrameIDAlloc.free(oId);
+}
+
+Frame_P *ContextNull::findFrameP(GfxIdxTy idx)
+{
+    auto *objE = findElement(ElementType::Frame, idx);
+    if (!objE) {
+        return GFX_NULL_HANDLE;
+    }
+    return dynamic_cast<Frame_P *>(objE);
+}
+
+RenderTarget_P *ContextNull::createRenderTargetP(const CreateRenderTargetInfo &createInfo)
+{
+    uint16_t oIdx = mRenderTargetIDAlloc.alloc();
+    GX_ASSERT(mRenderTargetIDAlloc.isValid(oIdx));
+    auto *obj = GX_NEW(RenderTargetNull, genElementIdx(mIdx, oIdx, ElementType::RenderTarget));
+    if (obj && obj->init(mParentCtx, createInfo)) {
+        GX_ASSERT(!containElementMap(obj->idx()));
+        insertElementMap(obj);
+        return obj;
+    }
+    GX_ASSERT_S(obj != nullptr, "ContextNull::createRenderTargetP create object failure");
+    GX_DELETE(obj);
+    return GFX_NULL_HANDLE;
+}
+
+void ContextNull::destroyRenderTargetP(RenderTarget obj)
+{
+    GX_ASSERT(obj);
+    auto *objP = dynamic_cast<RenderTarget_P *>(obj);
+    GX_ASSERT(objP);
+
+    uint8_t tId = getElementTypeIdx(objP->idx());
+    GX_ASSERT(tId == ElementType::RenderTarget);
+    uint16_t oId = getElementObjectIdx(objP->idx());
+
+    destroyElement(objP);
+    mRenderTargetIDAlloc.free(oId);
+}
+
+RenderTarget_P *ContextNull::findRenderTargetP(GfxIdxTy idx)
+{
+    auto *objE = findElement(ElementType::RenderTarget, idx);
+    if (!objE) {
+        return GFX_NULL_HANDLE;
+    }
+    return dynamic_cast<RenderTarget_P *>(objE);
+}
+
+Texture_P *ContextNull::createTextureP(const CreateTextureInfo &createInfo, SampleCountFlag::Enum sample)
+{
+    uint16_t oIdx = mTextureIDAlloc.alloc();
+    GX_ASSERT(mTextureIDAlloc.isValid(oIdx));
+    auto *obj = GX_NEW(TextureNull, genElementIdx(mIdx, oIdx, ElementType::Texture));
+    if (obj && obj->init(mParentCtx, createInfo, sample)) {
+        GX_ASSERT(!containElementMap(obj->idx()));
+        insertElementMap(obj);
+        return obj;
+    }
+    GX_ASSERT_S(obj != nullptr, "ContextNull::createTextureP create object failure");
+    GX_DELETE(obj);
+    return GFX_NULL_HANDLE;
+}
+
+void ContextNull::destroyTextureP(Texture obj)
+{
+    GX_ASSERT(obj);
+    auto *objP = dynamic_cast<Texture_P *>(obj);
+    GX_ASSERT(objP);
+
+    uint8_t tId = getElementTypeIdx(objP->idx());
+    GX_ASSERT(tId == ElementType::Texture);
+    uint16_t oId = getElementObjectIdx(objP->idx());
+
+    destroyElement(objP);
+    mTextureIDAlloc.free(oId);
+}
+
+Texture_P *ContextNull::findTextureP(GfxIdxTy idx)
+{
+    auto *objE = findElement(ElementType::Texture, idx);
+    if (!objE) {
+        return GFX_NULL_HANDLE;
+    }
+    return dynamic_cast<Texture_P *>(objE);
+}
+
+Sampler_P *ContextNull::createSamplerP(const CreateSamplerInfo &createInfo)
+{
+    uint16_t oIdx = mSamplerIDAlloc.alloc();
+    GX_ASSERT(mSamplerIDAlloc.isValid(oIdx));
+    auto *obj = GX_NEW(SamplerNull, genElementIdx(mIdx, oIdx, ElementType::Sampler));
+    if (obj && obj->init(mParentCtx, createInfo)) {
+        GX_ASSERT(!containElementMap(obj->idx()));
+        insertElementMap(obj);
+        return obj;
+    }
+    GX_ASSERT_S(obj != nullptr, "ContextNull::createSamplerP create object failure");
+    GX_DELETE(obj);
+    return GFX_NULL_HANDLE;
+}
+
+void ContextNull::destroySamplerP(Sampler obj)
+{
+    GX_ASSERT(obj);
+    auto *objP = dynamic_cast<Sampler_P *>(obj);
+    GX_ASSERT(objP);
+
+    uint8_t tId = getElementTypeIdx(objP->idx());
+    GX_ASSERT(tId == ElementType::Sampler);
+    uint16_t oId = getElementObjectIdx(objP->idx());
+
+    destroyElement(objP);
+    mSamplerIDAlloc.free(oId);
+}
+
+Sampler_P *ContextNull::findSamplerP(GfxIdxTy idx)
+{
+    auto *objE = findElement(ElementType::Sampler, idx);
+    if (!objE) {
+        return GFX_NULL_HANDLE;
+    }
+    return dynamic_cast<Sampler_P *>(objE);
+}
+
+Buffer_P *ContextNull::createBufferP(const CreateBufferInfo &createInfo)
+{
+    uint16_t oIdx = mBufferIDAlloc.alloc();
+    GX_ASSERT(mBufferIDAlloc.isValid(oIdx));
+    auto *obj = GX_NEW(BufferNull, genElementIdx(mIdx, oIdx, ElementType::Buffer));
+    if (obj && obj->init(mParentCtx, createInfo)) {
+        GX_ASSERT(!containElementMap(obj->idx()));
+        insertElementMap(obj);
+        return obj;
+    }
+    GX_ASSERT_S(obj != nullptr, "ContextNull::createBufferP create object failure");
+    GX_DELETE(obj);
+    return GFX_NULL_HANDLE;
+}
+
+void ContextNull::destroyBufferP(Buffer obj)
+{
+    GX_ASSERT(obj);
+    auto *objP = dynamic_cast<Buffer_P *>(obj);
+    GX_ASSERT(objP);
+
+    uint8_t tId = getElementTypeIdx(objP->idx());
+    GX_ASSERT(tId == ElementType::Buffer);
+    uint16_t oId = getElementObjectIdx(objP->idx());
+
+    destroyElement(objP);
+    mBufferIDAlloc.free(oId);
+}
+
+Buffer_P *ContextNull::findBufferP(GfxIdxTy idx)
+{
+    auto *objE = findElement(ElementType::Buffer, idx);
+    if (!objE) {
+        return GFX_NULL_HANDLE;
+    }
+    return dynamic_cast<Buffer_P *>(objE);
+}
+
+Shader_P *ContextNull::createShaderP(const CreateShaderInfo &createInfo)
+{
+    uint16_t oIdx = mShaderIDAlloc.alloc();
+    GX_ASSERT(mShaderIDAlloc.isValid(oIdx));
+    auto *obj = GX_NEW(ShaderNull, genElementIdx(mIdx, oIdx, ElementType::Shader));
+    if (obj && obj->init(mParentCtx, createInfo)) {
+        GX_ASSERT(!containElementMap(obj->idx()));
+        insertElementMap(obj);
+        return obj;
+    }
+    GX_ASSERT_S(obj != nullptr, "ContextNull::createShaderP create object failure");
+    GX_DELETE(obj);
+    return GFX_NULL_HANDLE;
+}
+
+void ContextNull::destroyShaderP(Shader obj)
+{
+    GX_ASSERT(obj);
+    auto *objP = dynamic_cast<Shader_P *>(obj);
+    GX_ASSERT(objP);
+
+    uint8_t tId = getElementTypeIdx(objP->idx());
+    GX_ASSERT(tId == ElementType::Shader);
+    uint16_t oId = getElementObjectIdx(objP->idx());
+
+    destroyElement(objP);
+    mShaderIDAlloc.free(oId);
+}
+
+Shader_P *ContextNull::findShaderP(GfxIdxTy idx)
+{
+    auto *objE = findElement(ElementType::Shader, idx);
+    if (!objE) {
+        return GFX_NULL_HANDLE;
+    }
+    return dynamic_cast<Shader_P *>(objE);
+}
+
+ResourceBinder_P *ContextNull::createResourceBinderP(const ResourceLayoutInfo &layoutInfo)
+{
+    uint16_t oIdx = mDescSetBinderIDAlloc.alloc();
+    GX_ASSERT(mDescSetBinderIDAlloc.isValid(oIdx));
+    auto *obj = GX_NEW(ResourceBinderNull, genElementIdx(mIdx, oIdx, ElementType::ResourceBinder));
+    if (obj && obj->init(mParentCtx, layoutInfo)) {
+        GX_ASSERT(!containElementMap(obj->idx()));
+        insertElementMap(obj);
+        return obj;
+    }
+    GX_ASSERT_S(obj != nullptr, "ContextNull::createResourceBinderP create object failure");
+    GX_DELETE(obj);
+    return GFX_NULL_HANDLE;
+}
+
+void ContextNull::destroyResourceBinderP(ResourceBinder obj)
+{
+    GX_ASSERT(obj);
+    auto *objP = dynamic_cast<ResourceBinder_P *>(obj);
+    GX_ASSERT(objP);
+
+    uint8_t tId = getElementTypeIdx(objP->idx());
+    GX_ASSERT(tId == ElementType::ResourceBinder);
+    uint16_t oId = getElementObjectIdx(objP->idx());
+
+    destroyElement(objP);
+    mDescSetBinderIDAlloc.free(oId);
+}
+
+ResourceBinder_P *ContextNull::findResourceBinderP(GfxIdxTy idx)
+{
+    auto *objE = findElement(ElementType::ResourceBinder, idx);
+    if (!objE) {
+        return GFX_NULL_HANDLE;
+    }
+    return dynamic_cast<ResourceBinder_P *>(objE);
+}
+
+CommandBuffer_P *ContextNull::createCommandBufferP(const CreateCommandBufferInfo &createInfo)
+{
+    uint16_t oIdx = mCommandBufferIDAlloc.alloc();
+    GX_ASSERT(mCommandBufferIDAlloc.isValid(oIdx));
+    auto *obj = GX_NEW(CommandBufferNull, genElementIdx(mIdx, oIdx, ElementType::CommandBuffer));
+    if (obj && obj->init(mParentCtx, createInfo)) {
+        GX_ASSERT(!containElementMap(obj->idx()));
+        insertElementMap(obj);
+        return obj;
+    }
+    GX_ASSERT_S(obj != nullptr, "ContextNull::createCommandBufferP create object failure");
+    GX_DELETE(obj);
+    return GFX_NULL_HANDLE;
+}
+
+void ContextNull::destroyCommandBufferP(CommandBuffer obj)
+{
+    GX_ASSERT(obj);
+    auto *objP = dynamic_cast<CommandBuffer_P *>(obj);
+    GX_ASSERT(objP);
+
+    uint8_t tId = getElementTypeIdx(objP->idx());
+    GX_ASSERT(tId == ElementType::CommandBuffer);
+    uint16_t oId = getElementObjectIdx(objP->idx());
+
+    destroyElement(objP);
+    mCommandBufferIDAlloc.free(oId);
+}
+
+CommandBuffer_P *ContextNull::findCommandBufferP(GfxIdxTy idx)
+{
+    auto *objE = findElement(ElementType::CommandBuffer, idx);
+    if (!objE) {
+        return GFX_NULL_HANDLE;
+    }
+    return dynamic_cast<CommandBuffer_P *>(objE);
+}
+
+Query_P *ContextNull::createQueryP(const CreateQueryInfo &createInfo)
+{
+    uint16_t oIdx = mQueryIDAlloc.alloc();
+    GX_ASSERT(mQueryIDAlloc.isValid(oIdx));
+    auto *obj = GX_NEW(QueryNull, genElementIdx(mIdx, oIdx, ElementType::Query));
+    if (obj && obj->init(mParentCtx, createInfo)) {
+        GX_ASSERT(!containElementMap(obj->idx()));
+        insertElementMap(obj);
+        return obj;
+    }
+    GX_ASSERT_S(obj != nullptr, "ContextNull::createQueryP create object failure");
+    GX_DELETE(obj);
+    return GFX_NULL_HANDLE;
+}
+
+void ContextNull::destroyQueryP(Query obj)
+{
+    GX_ASSERT(obj);
+    auto *objP = dynamic_cast<Query_P *>(obj);
+    GX_ASSERT(objP);
+
+    uint8_t tId = getElementTypeIdx(objP->idx());
+    GX_ASSERT(tId == ElementType::Query);
+    uint16_t oId = getElementObjectIdx(objP->idx());
+
+    destroyElement(objP);
+    mQueryIDAlloc.free(oId);
+}
+
+Query_P *ContextNull::findQueryP(GfxIdxTy idx)
+{
+    auto *objE = findElement(ElementType::Query, idx);
+    if (!objE) {
+        return GFX_NULL_HANDLE;
+    }
+    return dynamic_cast<Query_P *>(objE);
+}
+
+void ContextNull::deferDestroyP(ElementHandle *obj)
+{
+    GX_ASSERT(obj != nullptr);
+    GX_ASSERT_S(obj->context() == this->mParentCtx, "Context mismatch");
+
+    switch ((ElementType::Enum) getElementTypeIdx(obj->idx())) {
+        case ElementType::RenderTarget:
+            destroyRenderTargetP(dynamic_cast<RenderTarget_P *>(obj));
+            break;
+        case ElementType::Buffer:
+            destroyBufferP(dynamic_cast<Buffer_P *>(obj));
+            break;
+        case ElementType::Texture:
+            destroyTextureP(dynamic_cast<Texture_P *>(obj));
+            break;
+        case ElementType::ResourceBinder:
+            destroyResourceBinderP(dynamic_cast<ResourceBinder_P *>(obj));
+            break;
+        default:
+            GX_ASSERT_S(false, "Element type(%d) does not support deferred destroy", getElementTypeIdx(obj->idx()));
+            break;
+    }
+}
+
+uint64_t ContextNull::elementEpoch() const
+{
+    return mElementEpoch;
+}
+
+bool ContextNull::isElementAlive(GfxIdxTy idx, ElementHandle *obj)
+{
+    GLockerGuard locker(mElementMapMutex);
+    auto it = mElementMap.find(idx);
+    return it != mElementMap.end() && it->second == obj;
+}
+
+CommandArena &ContextNull::commandArena()
+{
+    return mCommandArena;
+}
+
+bool ContextNull::containElementMap(GfxIdxTy idx)
+{
+    GLockerGuard locker(mElementMapMutex);
+    return mElementMap.find(idx) != mElementMap.end();
+}
+
+void ContextNull::insertElementMap(ElementHandle *obj)
+{
+    GLockerGuard locker(mElementMapMutex);
+    mElementMap.insert(std::make_pair(obj->idx(), obj));
+    GX_ASSERT_S(mElementMap.find(obj->idx()) != mElementMap.end(), "insertElementMap failure");
+}
+
+void ContextNull::removeElementMap(GfxIdxTy idx, ElementHandle *obj)
+{
+    GLockerGuard locker(mElementMapMutex);
+    auto it = mElementMap.find(idx);
+    if (it == mElementMap.end()) {
+        return;
+    }
+    auto *objF = it->second;
+    GX_ASSERT_S(obj == objF, "find idx(%d) element object mismatch", idx);
+    mElementMap.erase(it);
+}
+
+void ContextNull::destroyElement(ElementHandle *obj)
+{
+    GX_ASSERT_S(obj->context() == this->mParentCtx, "Context mismatch");
+    GfxIdxTy idx = obj->idx();
+    removeElementMap(idx, obj);
+    ++mElementEpoch;
+
+    obj->destroy();
+    GX_DELETE(obj);
+}
+
+ElementHandle *ContextNull::findElement(ElementType::Enum type, GfxIdxTy idx)
+{
+    // 先做类型校验
+    GX_ASSERT(getElementContextIdx(idx) == mIdx);
+    GX_ASSERT(getElementTypeIdx(idx) == (uint8_t)type);
+    if (getElementTypeIdx(idx) != (uint8_t)type) {
+        return GFX_NULL_HANDLE;
+    }
+
+    GLockerGuard locker(mElementMapMutex);
+
+    auto it = mElementMap.find(idx);
+    if (it == mElementMap.end()) {
+        return GFX_NULL_HANDLE;
+    }
+    return it->second;
+}
+
+void ContextNull::checkLeak()
+{
+    bool hasLeak = !mElementMap.empty();
+    uint32_t leakCounts[ElementType::Count] = {0};
+
+    for (auto &[k, v] : mElementMap) {
+        uint8_t tid = getElementTypeIdx(k);
+        leakCounts[tid]++;
+    }
+
+    for (int i = 0; i < ElementType::Count; i++) {
+        if (leakCounts[i] > 0) {
+            Log("GFX Element(%s) leak, leak count = %d", ElementTypeNames[i], leakCounts[i]);
+        }
+    }
+    GX_ASSERT_S(!hasLeak, "GFX Elements memory leak");
+}
+
+/// ============ FenceNull ============ ///
+
+bool FenceNull::init(Context_T *context, bool signaled)
+{
+    mContextT = context;
+    mSignaled = signaled;
+    return true;
+}
+
+void FenceNull::destroy()
+{
+    mContextT = GFX_NULL_HANDLE;
+}
+
+Context_T *FenceNull::context()
+{
+    return mContextT;
+}
+
+FenceWaitRet::Enum FenceNull::wait(uint64_t timeout)
+{
+    // 所有提交都已同步完成，未发出信号的Fence永远不会再发出信号
+    return mSignaled ? FenceWaitRet::Success : FenceWaitRet::Timeout;
+}
+
+void FenceNull::reset()
+{
+    mSignaled = false;
+}
+
+bool FenceNull::isSignaled()
+{
+    return mSignaled;
+}
+
+void FenceNull::signal()
+{
+    mSignaled = true;
+}
+
+/// ============ FrameNull ============ ///
+
+bool FrameNull::init(Context_T *context, const CreateFrameInfo &createInfo)
+{
+    mContextT = context;
+    mRenderTargetType = createInfo.targetType;
+    mVSync = createInfo.vSync;
+    mWidth = createInfo.frameWidth;
+    mHeight = createInfo.frameHeight;
+
+    bool ok;
+    if (mRenderTargetType == FrameTargetType::SwapChain) {
+        ok = initSwapChainTarget();
+    } else {
+        mRenderTarget = (RenderTarget) createInfo.pTarget;
+        ok = mRenderTarget != nullptr;
+    }
+    if (!ok) {
+        destroy();
+    }
+    return ok;
+}
+
+void FrameNull::destroy()
+{
+    if (mRenderTargetType == FrameTargetType::SwapChain) {
+        destroySwapChainTarget();
+    }
+    mRenderTarget = GFX_NULL_HANDLE;
+    mContextT = GFX_NULL_HANDLE;
+}
+
+bool FrameNull::reset(uint32_t width, uint32_t height, bool vSync, bool enforce)
+{
+    if (mRenderTargetType == FrameTargetType::RenderTarget) {
+        // 自定义RenderTarget的Frame，不支持reset，直接返回true
+        return true;
+    }
+
+    bool resize = width != this->mWidth || height != this->mHeight;
+    if (!enforce && !resize && vSync == this->mVSync) {
+        return false;
+    }
+
+    mWidth = width;
+    mHeight = height;
+    mVSync = vSync;
+
+    destroySwapChainTarget();
+    return initSwapChainTarget();
+}
+
+bool FrameNull::beginFrame()
+{
+    ProfilerScope zone(mContextT->profiler(), "FrameNull::beginFrame");
+    updateFrameState();
+    mContextT->profiler().nextFrame();
+
+    if (mRenderTarget == GFX_NULL_HANDLE) {
+        return false;
+    }
+    mCurrentFrameIndex = (mCurrentFrameIndex + 1) % mRenderTarget->frameBufferCount();
+    return true;
+}
+
+void FrameNull::submit(CommandBuffer commandBuffer)
+{
+    ProfilerScope zone(mContextT->profiler(), "FrameNull::submit");
+    auto *contextNull = dynamic_cast<ContextNull *>(mContextT->contextP());
+    auto *cmdBufferP = contextNull->prepareSubmit(commandBuffer);
+
+    mFrameState.current.submitCount++;
+    mFrameState.current.redundantStateCount += cmdBufferP->redundantStateCount();
+    const auto &commandCounts = cmdBufferP->commandCounts();
+    mFrameState.current.commandCount += commandCounts.commandCount;
+    mFrameState.current.drawCount += commandCounts.drawCount;
+    mFrameState.current.dispatchCount += commandCounts.dispatchCount;
+    mFrameState.current.renderPassCount += commandCounts.renderPassCount;
+}
+
+void FrameNull::endFrame(bool waitQueue)
+{
+    ProfilerScope zone(mContextT->profiler(), "FrameNull::endFrame");
+}
+
+void FrameNull::waitGraphicsQueueIdle()
+{
+}
+
+void FrameNull::setSwapChainErrorCallback(const FrameSwapChainErrorCallback &callback)
+{
+    mSwapChainErrorCb = callback;
+}
+
+uint32_t FrameNull::frameBufferCount()
+{
+    return mRenderTarget->frameBufferCount();
+}
+
+uint32_t FrameNull::currentFrameIndex()
+{
+    return mCurrentFrameIndex;
+}
+
+RenderTarget FrameNull::renderTarget()
+{
+    return mRenderTarget;
+}
+
+uint32_t FrameNull::width()
+{
+    return mWidth;
+}
+
+uint32_t FrameNull::height()
+{
+    return mHeight;
+}
+
+Format::Enum FrameNull::getSwapChainDepthFormat()
+{
+    return mDepthFormat;
+}
+
+Format::Enum FrameNull::getSwapChainColorFormat()
+{
+    return mColorFormat;
+}
+
+uint64_t FrameNull::getFrameTime()
+{
+    return mFrameState.frameTime;
+}
+
+FrameStatistics FrameNull::getFrameStatistics()
+{
+    return mFrameState.statistics;
+}
+
+Context_T *FrameNull::context()
+{
+    return mContextT;
+}
+
+bool FrameNull::initSwapChainTarget()
+{
+    mColorFormat = Format::B8G8R8A8_UNorm;
+    mDepthFormat = mContextT->getSupportedDepthFormat();
+
+    mColorTextures.resize(SWAP_CHAIN_BUFFER_COUNT);
+    for (auto &t : mColorTextures) {
+        t = mContextT->createTexture(
+                {
+                        TextureType::Texture2D,
+                        mColorFormat,
+                        TextureUsage::Attachment,
+                        TextureAspect::AspectColor,
+                        mWidth, mHeight, 1, 1, 1
+                });
+    }
+
+    mDepthTexture = mContextT->createTexture(
+            {
+                    TextureType::Texture2D,
+                    mDepthFormat,
+                    TextureUsage::Attachment,
+                    TextureAspect::AspectDepth | TextureAspect::AspectStencil,
+                    mWidth, mHeight, 1, 1, 1
+            });
+
+    CreateRenderTargetInfo createRTInfo{};
+    createRTInfo.colorAttachments.resize(mColorTextures.size());
+    for (uint32_t i = 0; i < mColorTextures.size(); i++) {
+        createRTInfo.colorAttachments[i].resize(1);
+        createRTInfo.colorAttachments[i][0].texture = mColorTextures[i];
+        createRTInfo.colorAttachments[i][0].mipLevel = 0;
+        createRTInfo.colorAttachments[i][0].layer = 0;
+    }
+
+    createRTInfo.depthStencilAttachment.texture = mDepthTexture;
+    createRTInfo.depthStencilAttachment.mipLevel = 0;
+    createRTInfo.depthStencilAttachment.layer = 0;
+
+    createRTInfo.sample = SampleCountFlag::SampleCount_1;
+
+    mRenderTarget = mContextT->createRenderTarget(createRTInfo);
+    mCurrentFrameIndex = 0;
+    return mRenderTarget != GFX_NULL_HANDLE;
+}
+
+void FrameNull::destroySwapChainTarget()
+{
+    if (mRenderTarget != GFX_NULL_HANDLE) {
+        mContextT->destroyRenderTarget(mRenderTarget);
+        mRenderTarget = GFX_NULL_HANDLE;
+    }
+
+    for (auto *t : mColorTextures) {
+        mContextT->destroyTexture(t);
+    }
+    mColorTextures.clear();
+
+    if (mDepthTexture != GFX_NULL_HANDLE) {
+        mContextT->destroyTexture(mDepthTexture);
+        mDepthTexture = GFX_NULL_HANDLE;
+    }
+}
+
+void FrameNull::updateFrameState()
+{
+    uint64_t timeDiff = GTime::currentSteadyTime().microSecsTo(mFrameState.time);
+    mFrameState.frameTime = timeDiff;
+
+    mFrameState.time.resetToSteadyClock();
+
+    ContextStatistics contextStats = mContextT->counters().snapshot();
+    ContextCounters::fillFrameStatistics(mFrameState.current, contextStats, mFrameState.contextStats);
+    mFrameState.contextStats = contextStats;
+
+    mFrameState.statistics = mFrameState.current;
+    mFrameState.current = {};
+}
+
+/// ============ RenderTargetNull ============ ///
+
+bool RenderTargetNull::init(Context_T *context, const CreateRenderTargetInfo &createInfo)
+{
+    mContextT = context;
+
+    GX_ASSERT(createInfo.sample <= mContextT->maxRenderTargetSampleCount());
+
+    uint32_t attachSize = 0;
+    if (!createInfo.colorAttachments.empty()) {
+        attachSize += (mColorCount = createInfo.colorAttachments[0].size());
+
+        mAttachColors.resize(createInfo.colorAttachments.size());
+        for (uint32_t i = 0; i < createInfo.colorAttachments.size(); i++) {
+            auto &attach = createInfo.colorAttachments[i];
+            GX_ASSERT(attach.size() == attachSize);
+            mAttachColors[i] = attach;
+        }
+    }
+    if (createInfo.depthStencilAttachment.texture != nullptr) {
+        attachSize += 1;
+        mHasDepth = true;
+        mAttachDepth = createInfo.depthStencilAttachment;
+    }
+
+    GX_ASSERT(attachSize > 0);
+
+    mFrameCount = createInfo.colorAttachments.empty() ? 1 : createInfo.colorAttachments.size();
+
+    if (mColorCount > 0) {
+        auto &attachmentInfo = createInfo.colorAttachments[0][0];
+        mWidth = valueForLevel(attachmentInfo.mipLevel, attachmentInfo.texture->width());
+        mHeight = valueForLevel(attachmentInfo.mipLevel, attachmentInfo.texture->height());
+    } else {
+        auto &attachmentInfo = createInfo.depthStencilAttachment;
+        mWidth = valueForLevel(attachmentInfo.mipLevel, attachmentInfo.texture->width());
+        mHeight = valueForLevel(attachmentInfo.mipLevel, attachmentInfo.texture->height());
+    }
+
+    GX_ASSERT(mWidth > 0);
+    GX_ASSERT(mHeight > 0);
+    return true;
+}
+
+void RenderTargetNull::destroy()
+{
+    mAttachColors.clear();
+    mContextT = GFX_NULL_HANDLE;
+}
+
+uint32_t RenderTargetNull::width()
+{
+    return mWidth;
+}
+
+uint32_t RenderTargetNull::height()
+{
+    return mHeight;
+}
+
+uint8_t RenderTargetNull::frameBufferCount()
+{
+    return mFrameCount;
+}
+
+uint8_t RenderTargetNull::colorAttachmentCount()
+{
+    return mColorCount;
+}
+
+bool RenderTargetNull::hasDepthStencil()
+{
+    return mHasDepth;
+}
+
+Attachment RenderTargetNull::getColorAttachment(uint8_t frameIndex, uint8_t attachIndex)
+{
+    GX_ASSERT(frameIndex < mFrameCount);
+    GX_ASSERT(attachIndex < mColorCount);
+    return mAttachColors[frameIndex][attachIndex];
+}
+
+Attachment RenderTargetNull::getDepthStencilAttachment()
+{
+    GX_ASSERT(mHasDepth);
+    return mAttachDepth;
+}
+
+Context_T *RenderTargetNull::context()
+{
+    return mContextT;
+}
+
+uint32_t RenderTargetNull::valueForLevel(uint8_t level, uint32_t baseLevelValue)
+{
+    return std::max(1u, baseLevelValue >> level);
+}
+
+/// ============ BufferNull ============ ///
+
+bool BufferNull::init(Context_T *context, const CreateBufferInfo &createInfo)
+{
+    mContextT = context;
+    mType = createInfo.type;
+    mMemoryUsage = createInfo.memoryUsage;
+    mSize = createInfo.size;
+
+    if (mSize == 0) {
+        return false;
+    }
+    mMemoryRecord.category = MemoryCategory::ofBuffer(mType, mMemoryUsage);
+    mMemoryRecord.size = mSize;
+    mContextT->memoryTracker().allocate(mMemoryRecord);
+
+    return true;
+}
+
+void BufferNull::destroy()
+{
+    if (mContextT) {
+        mContextT->memoryTracker().free(mMemoryRecord);
+    }
+    mData.clear();
+    mData.shrink_to_fit();
+    mContextT = GFX_NULL_HANDLE;
+}
+
+Context_T *BufferNull::context()
+{
+    return mContextT;
+}
+
+uint64_t BufferNull::size()
+{
+    return mSize;
+}
+
+void *BufferNull::map()
+{
+    // 与VMA分配的行为一致，GpuOnly的Buffer不可映射
+    if (mMemoryUsage == BufferMemoryUsage::GpuOnly) {
+        return nullptr;
+    }
+    if (mData.empty()) {
+        mData.resize(mSize);
+    }
+    return mData.data();
+}
+
+void BufferNull::flush()
+{
+    mContextT->counters().uploadBytes += mSize;
+}
+
+void BufferNull::flush(uint64_t offset, uint64_t size)
+{
+    if (offset < mSize) {
+        mContextT->counters().uploadBytes += std::min(size, mSize - offset);
+    }
+}
+
+void BufferNull::invalidate(uint64_t offset, uint64_t size)
+{
+}
+
+void BufferNull::markDirty(uint64_t offset, uint64_t size)
+{
+    flush(offset, size);
+}
+
+void BufferNull::unmap()
+{
+}
+
+/// ============ TextureNull ============ ///
+
+bool TextureNull::init(Context_T *context, const CreateTextureInfo &createInfo, SampleCountFlag::Enum sample)
+{
+    if (createInfo.mipLevels < 1) {
+        GX_ASSERT_S(false, "mipLevels must be >= 1");
+        return false;
+    }
+    if (createInfo.arrayLayers < 1) {
+        GX_ASSERT_S(false, "arrayLayers must be >= 1");
+        return false;
+    }
+
+    mContextT = context;
+
+    std::hash<CreateTextureInfo> hashFunc;
+
+    mHash = hashFunc(createInfo);
+    mHash = hashOf(mHash, idx());
+    mSample = sample;
+
+    mWidth = createInfo.width;
+    mHeight = createInfo.height;
+    mDepth = createInfo.depth;
+    mType = createInfo.type;
+    mFormat = createInfo.format;
+    mUsage = createInfo.usage;
+    mAspect = createInfo.aspect;
+    mMipLevels = createInfo.mipLevels;
+    mLayerCount = createInfo.arrayLayers;
+
+    mStreaming = createInfo.residentMipLevels > 0 && createInfo.residentMipLevels < createInfo.mipLevels;
+    if (mStreaming) {
+        mResidentBaseMip = createInfo.mipLevels - createInfo.residentMipLevels;
+    }
+
+    mMemoryRecord.category = MemoryCategory::ofTexture(mUsage);
+    mMemoryRecord.size = size();
+    mContextT->memoryTracker().allocate(mMemoryRecord);
+
+    return true;
+}
+
+void TextureNull::destroy()
+{
+    if (mContextT) {
+        mContextT->memoryTracker().free(mMemoryRecord);
+    }
+    mContextT = GFX_NULL_HANDLE;
+}
+
+Context_T *TextureNull::context()
+{
+    return mContextT;
+}
+
+size_t TextureNull::hash()
+{
+    return mHash;
+}
+
+TextureType::Enum TextureNull::type()
+{
+    return mType;
+}
+
+Format::Enum TextureNull::format()
+{
+    return mFormat;
+}
+
+TextureUsageFlags TextureNull::usage()
+{
+    return mUsage;
+}
+
+TextureAspectFlags TextureNull::aspect()
+{
+    return mAspect;
+}
+
+uint32_t TextureNull::width()
+{
+    return mWidth;
+}
+
+uint32_t TextureNull::height()
+{
+    return mHeight;
+}
+
+uint32_t TextureNull::depth()
+{
+    return mDepth;
+}
+
+uint32_t TextureNull::layerCount()
+{
+    return mLayerCount;
+}
+
+uint32_t TextureNull::mipLevels()
+{
+    return mMipLevels;
+}
+
+uint64_t TextureNull::size()
+{
+    return residentSize(mResidentBaseMip);
+}
+
+uint64_t TextureNull::residentSize(uint32_t baseMip)
+{
+    // 按未压缩的紧密排列估算
+    uint64_t texelCount = 0;
+    for (uint32_t i = baseMip; i < mMipLevels; i++) {
+        texelCount += (uint64_t) std::max(1u, mWidth >> i)
+                      * std::max(1u, mHeight >> i)
+                      * std::max(1u, mDepth >> i);
+    }
+    return texelCount * mLayerCount * (uint32_t) mSample * mContextT->formatSize(mFormat);
+}
+
+void TextureNull::setData(const void *data, uint64_t size, Fence fence)
+{
+    setMipData(0, 0, 1, data, size, fence);
+}
+
+void TextureNull::setMipData(uint32_t mipLevel, uint32_t baseLayer, uint32_t layerCount,
+                             const void *data, uint64_t size, Fence fence)
+{
+    if (mipLevel < mResidentBaseMip || mipLevel >= mMipLevels) {
+        Log("TextureNull::setMipData mip level %u is not resident", mipLevel);
+        return;
+    }
+    mContextT->counters().uploadBytes += size;
+    if (fence != GFX_NULL_HANDLE) {
+        dynamic_cast<FenceNull *>(fence)->signal();
+    }
+}
+
+void TextureNull::updateRegions(const void *data, uint64_t size,
+                                const std::vector<TextureUpdateRegion> &regions, Fence fence)
+{
+    mContextT->counters().uploadBytes += size;
+    if (fence != GFX_NULL_HANDLE) {
+        dynamic_cast<FenceNull *>(fence)->signal();
+    }
+}
+
+uint32_t TextureNull::residentBaseMip()
+{
+    return mResidentBaseMip;
+}
+
+bool TextureNull::setResidentBaseMip(uint32_t baseMip, Fence fence)
+{
+    if (!mStreaming || baseMip >= mMipLevels) {
+        return false;
+    }
+    if (baseMip != mResidentBaseMip) {
+        mContextT->memoryTracker().free(mMemoryRecord);
+        mResidentBaseMip = baseMip;
+        mMemoryRecord.size = size();
+        mContextT->memoryTracker().allocate(mMemoryRecord);
+    }
+    if (fence != GFX_NULL_HANDLE) {
+        dynamic_cast<FenceNull *>(fence)->signal();
+    }
+    return true;
+}
+
+void TextureNull::genMipmap(Fence fence)
+{
+    if (fence != GFX_NULL_HANDLE) {
+        dynamic_cast<FenceNull *>(fence)->signal();
+    }
+}
+
+/// ============ SamplerNull ============ ///
+
+bool SamplerNull::init(Context_T *context, const CreateSamplerInfo &createInfo)
+{
+    mContextT = context;
+    mCreateInfo = createInfo;
+    return true;
+}
+
+void SamplerNull::destroy()
+{
+    mContextT = GFX_NULL_HANDLE;
+}
+
+Context_T *SamplerNull::context()
+{
+    return mContextT;
+}
+
+/// ============ ShaderNull ============ ///
+
+bool ShaderNull::init(Context_T *context, const CreateShaderInfo &createInfo)
+{
+    mContextT = context;
+    mTag = createInfo.tag;
+    mType = createInfo.type;
+    mHash = hashOf(idx());
+    return createInfo.pCode != nullptr && createInfo.codeSize > 0;
+}
+
+void ShaderNull::destroy()
+{
+    mContextT = GFX_NULL_HANDLE;
+}
+
+Context_T *ShaderNull::context()
+{
+    return mContextT;
+}
+
+size_t ShaderNull::hash()
+{
+    return mHash;
+}
+
+/// ============ ResourceBinderNull ============ ///
+
+bool ResourceBinderNull::init(Context_T *context, const ResourceLayoutInfo &layoutInfo)
+{
+    mContextT = context;
+    mLayoutInfo = layoutInfo;
+    mBindInfos.resize(layoutInfo.bindingInfos.size(), {GFX_NULL_HANDLE, GFX_NULL_HANDLE, GFX_NULL_HANDLE, 0, 0});
+    return true;
+}
+
+void ResourceBinderNull::destroy()
+{
+    mBindInfos.clear();
+    mContextT = GFX_NULL_HANDLE;
+}
+
+Context_T *ResourceBinderNull::context()
+{
+    return mContextT;
+}
+
+void ResourceBinderNull::bindBuffer(uint32_t binding, Buffer buffer)
+{
+    bindBufferRange(binding, buffer, 0, GFX_WHOLE_SIZE);
+}
+
+void ResourceBinderNull::bindBufferRange(uint32_t binding, Buffer buffer, uint64_t offset, uint64_t range)
+{
+    GX_ASSERT(binding < mBindInfos.size());
+    mBindInfos[binding] = {buffer, GFX_NULL_HANDLE, GFX_NULL_HANDLE, offset, range};
+}
+
+void ResourceBinderNull::bindTexelBuffer(uint32_t binding, Buffer buffer, Format::Enum format,
+                                         uint64_t offset, uint64_t range)
+{
+    GX_ASSERT(binding < mBindInfos.size());
+    mBindInfos[binding] = {buffer, GFX_NULL_HANDLE, GFX_NULL_HANDLE, offset, range};
+}
+
+void ResourceBinderNull::bindTexture(uint32_t binding, Texture texture, Sampler sampler,
+                                     const TextureBindRange &range)
+{
+    GX_ASSERT(binding < mBindInfos.size());
+    mBindInfos[binding] = {GFX_NULL_HANDLE, texture, sampler, 0, 0};
+}
+
+void ResourceBinderNull::bindInputAttachment(uint32_t binding, Texture texture, const TextureBindRange &range)
+{
+    bindTexture(binding, texture, GFX_NULL_HANDLE, range);
+}
+
+/// ============ CommandBufferNull ============ ///
+
+bool CommandBufferNull::init(Context_T *context, const CreateCommandBufferInfo &createInfo)
+{
+    auto *contextNull = dynamic_cast<ContextNull *>(context->contextP());
+    initRecorder(context, createInfo, contextNull->commandArena());
+    return true;
+}
+
+void CommandBufferNull::destroy()
+{
+    mElementPositions.clear();
+    destroyRecorder();
+}
+
+void CommandBufferNull::compile()
+{
+    GX_ASSERT_S(!mIsBegun, "Please call end first");
+
+    ProfilerScope zone(mContextT->profiler(), "CommandBufferNull::compile");
+    const uint64_t compileBeginNs = Profiler::now();
+
+    // 没有可生成的GPU指令，只按编码格式遍历一次指令流
+    mElementPositions.clear();
+    mCommandCounts = {};
+    collectElementPositions(mCommandBuffer, mElementPositions, &mCommandCounts);
+    mIsCompiled = true;
+
+    auto &counters = mContextT->counters();
+    counters.compileCount++;
+    counters.compileTimeNs += Profiler::now() - compileBeginNs;
+}
+
+bool CommandBufferNull::isCompiled() const
+{
+    return mIsCompiled;
+}
+
+uint32_t CommandBufferNull::redundantStateCount() const
+{
+    return mElidedStateCount;
+}
+
+/// ============ QueryNull ============ ///
+
+bool QueryNull::init(Context_T *context, const CreateQueryInfo &createInfo)
+{
+    mContextT = context;
+    mHash = hashOf(createInfo);
+    mQueryType = createInfo.queryType;
+    mQueryCount = createInfo.queryCount;
+    return true;
+}
+
+void QueryNull::destroy()
+{
+    mContextT = nullptr;
+}
+
+Context_T *QueryNull::context()
+{
+    return mContextT;
+}
+
+size_t QueryNull::hash()
+{
+    return mHash;
+}
+
+void QueryNull::getQueryResults(std::vector<uint64_t> &results, QueryResultFlags flags)
+{
+    getQueryResults(results, 0, mQueryCount, flags);
+}
+
+void QueryNull::getQueryResults(std::vector<uint64_t> &results, uint32_t firstQuery, uint32_t queryCount,
+                                QueryResultFlags flags)
+{
+    // 没有GPU执行，所有查询视为立即可用且结果为0
+    const bool withAvailability = flags & QueryResultFlag::WithAvailability;
+    if (mQueryType == QueryType::PipelineStatistics) {
+        results.assign(mQueryCount + (withAvailability ? 1 : 0), 0);
+        if (withAvailability) {
+            results.back() = 1;
+        }
+        return;
+    }
+
+    firstQuery = std::min(firstQuery, mQueryCount);
+    queryCount = std::min(queryCount, mQueryCount - firstQuery);
+    if (withAvailability) {
+        results.assign(queryCount * 2, 0);
+        for (uint32_t i = 0; i < queryCount; i++) {
+            results[i * 2 + 1] = 1;
+        }
+    } else {
+        results.assign(queryCount, 0);
+    }
+}
+
+}
+}
@@ -23,6 +23,7 @@
 #ifdef USE_GP_API_VULKAN
 
 #include "gfx_p_vk.h"
+#include "gfx_capture_vk.h"
 
 #include "gfx_context.h"
 #include "gfx_element.h"
@@ -36,6 +37,10 @@
 #include <cstring>
 #include <string>
 #include <sstream>
+#include <thread>
+#include <string_view>
+#include <algorithm>
+#include <array>
 #include <math.h>
 
 #endif //USE_GP_API_VULKAN
@@ -242,10 +247,28 @@ bool ContextVk::init(Instance_P *instance, Context_T *context, const CreateConte
 
     VkQueueFlags vkQueueFlags = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_TRANSFER_BIT | VK_QUEUE_COMPUTE_BIT;
 
+    const void *pNextFeatures = nullptr;
+    bool enableSync2 = querySynchronization2(createInfo.deviceIndex, instanceVk);
+#if defined(VK_VERSION_1_3)
+    VkPhysicalDeviceSynchronization2Features sync2Features{};
+    sync2Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES;
+    sync2Features.synchronization2 = VK_TRUE;
+    if (enableSync2) {
+        pNextFeatures = &sync2Features;
+    }
+#endif
+
+    // 查询内存预算需要vkGetPhysicalDeviceMemoryProperties2
+    bool enableMemoryBudget = USE_VK_API_VER >= VK_API_VERSION_1_1
+                              && vkGetPhysicalDeviceMemoryProperties2 != nullptr
+                              && queryDeviceExtension(createInfo.deviceIndex, instanceVk,
+                                                      VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+
+    VkPhysicalDeviceFeatures vkFeatures = getVkDeviceFeatures(createInfo.deviceIndex, instanceVk);
     if (!mVkContext.create(instanceVk->vkInstance(),
-                           getVkDeviceFeatures(createInfo.deviceIndex, instanceVk),
-                           transDeviceExt(createInfo.exts),
-                           createInfo.deviceIndex, vkQueueFlags)) {
+                           vkFeatures,
+                           transDeviceExt(createInfo.exts, enableMemoryBudget),
+                           createInfo.deviceIndex, vkQueueFlags, pNextFeatures)) {
         Log("Create vulkan device failure!");
         return false;
     }
@@ -253,16 +276,55 @@ bool ContextVk::init(Instance_P *instance, Context_T *context, const CreateConte
     auto properties = mVkContext.gvkDevice()->deviceProperties();
     mSupportQueryTimestamp = (bool)properties.limits.timestampComputeAndGraphics;
     mTimestampPeriod = properties.limits.timestampPeriod;
+    mSupportMultiDrawIndirect = vkFeatures.multiDrawIndirect;
+    mSupportDrawIndirectFirstInstance = vkFeatures.drawIndirectFirstInstance;
+    mMaxDrawIndirectCount = mSupportMultiDrawIndirect ? properties.limits.maxDrawIndirectCount : 1;
+#if defined(VK_VERSION_1_3)
+    mSupportSynchronization2 = enableSync2 && vkCmdPipelineBarrier2 != nullptr;
+#endif
+
+    mMemoryAllocator.create(mVkContext.gvkDevice());
+    mMemoryBudget.init(this, &context->memoryTracker(), enableMemoryBudget);
 
 #ifdef USE_AMD_VULKAN_MEMORY_ALLOCATOR
     initVma();
 #endif //USE_AMD_VULKAN_MEMORY_ALLOCATOR
 
+    mEnableCapture = createInfo.enableCapture;
+    if (mEnableCapture) {
+        mCapture = GX_NEW(CaptureVk, this);
+    }
+
+    mGpuProfiler.init(this, &context->profiler());
+
     return true;
 }
 
 void ContextVk::destroy()
 {
+    if (mCapture) {
+        mCapture->end();
+        GX_DELETE(mCapture);
+        mCapture = nullptr;
+    }
+
+    if (!mCompileThreads.empty()) {
+        {
+            std::lock_guard<std::mutex> lock(mCompileMutex);
+            mCompileThreadExit = true;
+            mCompileCond.notify_all();
+        }
+        for (auto &thread : mCompileThreads) {
+            thread.join();
+        }
+        mCompileThreads.clear();
+    }
+
+    // 销毁延迟销毁队列中剩余的对象
+    mVkContext.gvkDevice()->waitIdle();
+    releaseDeferredObjects(UINT64_MAX);
+    mGpuProfiler.destroy();
+
     // clear DescriptorPools
     for (auto iPool : mVkDescriptorPools) {
         if (iPool) {
@@ -304,6 +366,10 @@ void ContextVk::destroy()
 
     checkLeak();
 
+    mCommandArena.clear();
+
+    mMemoryAllocator.destroy();
+
 #ifdef USE_AMD_VULKAN_MEMORY_ALLOCATOR
     vmaDestroyAllocator(mVmaAllocator);
 #endif //USE_AMD_VULKAN_MEMORY_ALLOCATOR
@@ -338,8 +404,23 @@ float ContextVk::maxSamplerAnisotropy()
     return 1.0f;
 }
 
+uint32_t ContextVk::clampSamplerAnisotropyLog2(uint32_t anisotropyLog2)
+{
+    if (anisotropyLog2 == 0 || !samplerAnisotropy()) {
+        return 0;
+    }
+    float maxAnisotropy = maxSamplerAnisotropy();
+    uint32_t maxLog2 = 0;
+    while (maxLog2 < 7 && (float) (2u << maxLog2) <= maxAnisotropy) {
+        maxLog2++;
+    }
+    return std::min(anisotropyLog2, maxLog2);
+}
+
 VkDescriptorSet ContextVk::allocVkDescriptorSet(VkDescriptorSetLayout vkLayout, VkDescriptorPool &pool)
 {
+    mParentCtx->counters().descriptorSetAllocCount++;
+
     std::vector<VkDescriptorPool> &pools = getDescriptorPools();
 
     VkDescriptorSetAllocateInfo descriptorSetAllocateInfo{};
@@ -396,6 +477,280 @@ float ContextVk::getTimestampPeriod() const
     return mTimestampPeriod;
 }
 
+bool ContextVk::isSupportSynchronization2() const
+{
+    return mSupportSynchronization2;
+}
+
+bool ContextVk::isSupportMultiDrawIndirect() const
+{
+    return mSupportMultiDrawIndirect;
+}
+
+bool ContextVk::isSupportDrawIndirectFirstInstance() const
+{
+    return mSupportDrawIndirectFirstInstance;
+}
+
+uint32_t ContextVk::maxDrawIndirectCount() const
+{
+    return mMaxDrawIndirectCount;
+}
+
+bool ContextVk::isCaptureEnabled() const
+{
+    return mEnableCapture;
+}
+
+CaptureVk *ContextVk::activeCapture()
+{
+    return mCapture && mCapture->isActive() ? mCapture : nullptr;
+}
+
+GpuProfilerVk &ContextVk::gpuProfiler()
+{
+    return mGpuProfiler;
+}
+
+MemoryBudgetVk &ContextVk::memoryBudget()
+{
+    return mMemoryBudget;
+}
+
+GVkMemoryAllocator *ContextVk::memoryAllocator()
+{
+    return &mMemoryAllocator;
+}
+
+void ContextVk::trackMemory(const MemoryRecord &record)
+{
+    uint32_t heapIndex = mParentCtx->memoryTracker().allocate(record);
+    mMemoryBudget.check(heapIndex);
+}
+
+void ContextVk::untrackMemory(MemoryRecord &record)
+{
+    mParentCtx->memoryTracker().free(record);
+}
+
+void ContextVk::addDirtyBuffer(BufferVk *buffer)
+{
+    GLockerGuard locker(mDirtyBufferMutex);
+    mDirtyBuffers.push_back(buffer);
+}
+
+void ContextVk::removeDirtyBuffer(BufferVk *buffer)
+{
+    GLockerGuard locker(mDirtyBufferMutex);
+    mDirtyBuffers.erase(std::remove(mDirtyBuffers.begin(), mDirtyBuffers.end(), buffer), mDirtyBuffers.end());
+}
+
+void ContextVk::flushDirtyBuffers()
+{
+    GLockerGuard locker(mDirtyBufferMutex);
+    if (mDirtyBuffers.empty()) {
+        return;
+    }
+
+    mDirtyRangeBatch.clear();
+    for (auto *buffer : mDirtyBuffers) {
+        buffer->collectDirtyRanges(mDirtyRangeBatch);
+    }
+    mDirtyBuffers.clear();
+
+    auto count = (uint32_t) mDirtyRangeBatch.allocations.size();
+    if (count == 0) {
+        return;
+    }
+#ifdef USE_AMD_VULKAN_MEMORY_ALLOCATOR
+    vmaFlushAllocations(mVmaAllocator, count, mDirtyRangeBatch.allocations.data(),
+                        mDirtyRangeBatch.offsets.data(), mDirtyRangeBatch.sizes.data());
+#else
+    mMemoryAllocator.flush(count, mDirtyRangeBatch.allocations.data(),
+                           mDirtyRangeBatch.offsets.data(), mDirtyRangeBatch.sizes.data());
+#endif //USE_AMD_VULKAN_MEMORY_ALLOCATOR
+}
+
+CommandArena &ContextVk::commandArena()
+{
+    return mCommandArena;
+}
+
+void ContextVk::enqueueCompile(CommandBufferVk *cmdBuffer)
+{
+    std::lock_guard<std::mutex> lock(mCompileMutex);
+    startCompileThreads();
+    mCompileQueue.emplace_back([cmdBuffer]() {
+        cmdBuffer->runPendingCompile();
+    });
+    mCompileCond.notify_one();
+}
+
+void ContextVk::parallelCompile(uint32_t count, const std::function<void(uint32_t)> &task)
+{
+    if (count == 0) {
+        return;
+    }
+    if (count == 1) {
+        task(0);
+        return;
+    }
+
+    // 辅助任务可能在调用返回后才被线程取出，共享状态由各任务共同持有
+    struct ParallelState
+    {
+        std::function<void(uint32_t)> task;
+        uint32_t count;
+        std::atomic<uint32_t> next{0};
+        std::mutex mutex;
+        std::condition_variable cond;
+        uint32_t done = 0;
+    };
+    auto state = std::make_shared<ParallelState>();
+    state->task = task;
+    state->count = count;
+
+    auto run = [](ParallelState &s) {
+        uint32_t finished = 0;
+        for (uint32_t index = s.next++; index < s.count; index = s.next++) {
+            s.task(index);
+            finished++;
+        }
+        if (finished > 0) {
+            std::lock_guard<std::mutex> lock(s.mutex);
+            s.done += finished;
+            if (s.done == s.count) {
+                s.cond.notify_all();
+            }
+        }
+    };
+
+    {
+        std::lock_guard<std::mutex> lock(mCompileMutex);
+        startCompileThreads();
+        const auto helperCount = std::min<size_t>(count - 1, mCompileThreads.size());
+        for (size_t k = 0; k < helperCount; k++) {
+            mCompileQueue.emplace_back([state, run]() {
+                run(*state);
+            });
+        }
+        mCompileCond.notify_all();
+    }
+
+    run(*state);
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->cond.wait(lock, [&state]() {
+        return state->done == state->count;
+    });
+}
+
+void ContextVk::startCompileThreads()
+{
+    if (!mCompileThreads.empty()) {
+        return;
+    }
+    const uint32_t hardwareThreads = std::thread::hardware_concurrency();
+    const uint32_t threadCount = std::max(1u, std::min(hardwareThreads > 1 ? hardwareThreads - 1 : 1u,
+                                                       (uint32_t) MAX_COMPILE_THREADS));
+    mCompileThreadExit = false;
+    for (uint32_t k = 0; k < threadCount; k++) {
+        mCompileThreads.emplace_back(&ContextVk::compileThreadLoop, this);
+    }
+}
+
+void ContextVk::compileThreadLoop()
+{
+    while (true) {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(mCompileMutex);
+            mCompileCond.wait(lock, [this]() {
+                return mCompileThreadExit || !mCompileQueue.empty();
+            });
+            // 退出前编译完队列中剩余的指令缓冲，避免等待者阻塞
+            if (mCompileQueue.empty()) {
+                break;
+            }
+            job = std::move(mCompileQueue.front());
+            mCompileQueue.pop_front();
+        }
+        job();
+    }
+}
+
+uint64_t ContextVk::elementEpoch() const
+{
+    return mElementEpoch;
+}
+
+uint64_t ContextVk::residencyEpoch() const
+{
+    return mResidencyEpoch;
+}
+
+void ContextVk::onResidencyChanged()
+{
+    ++mResidencyEpoch;
+}
+
+bool ContextVk::isElementAlive(GfxIdxTy idx, ElementHandle *obj)
+{
+    GLockerGuard locker(mElementMapMutex);
+    auto it = mElementMap.find(idx);
+    return it != mElementMap.end() && it->second == obj;
+}
+
+uint64_t ContextVk::nextSubmitSerial()
+{
+    return ++mSubmitSerial;
+}
+
+uint64_t ContextVk::submitSerial() const
+{
+    return mSubmitSerial;
+}
+
+uint64_t ContextVk::completedSerial()
+{
+    GLockerGuard locker(mDeferredDestroyMutex);
+    return mCompletedSerial;
+}
+
+void ContextVk::releaseDeferredObjects(uint64_t completedSerial)
+{
+    std::vector<ElementHandle *> releaseObjects;
+
+    mDeferredDestroyMutex.lock();
+    mCompletedSerial = std::max(mCompletedSerial, completedSerial);
+    // 序号单调递增，队首的元素最先满足销毁条件
+    while (!mDeferredDestroyQueue.empty() && mDeferredDestroyQueue.front().serial <= mCompletedSerial) {
+        releaseObjects.push_back(mDeferredDestroyQueue.front().obj);
+        mDeferredDestroyQueue.pop_front();
+    }
+    mDeferredDestroyMutex.unlock();
+
+    for (auto *obj : releaseObjects) {
+        switch ((ElementType::Enum) getElementTypeIdx(obj->idx())) {
+            case ElementType::RenderTarget:
+                destroyRenderTargetP(dynamic_cast<RenderTarget_P *>(obj));
+                break;
+            case ElementType::Buffer:
+                destroyBufferP(dynamic_cast<Buffer_P *>(obj));
+                break;
+            case ElementType::Texture:
+                destroyTextureP(dynamic_cast<Texture_P *>(obj));
+                break;
+            case ElementType::ResourceBinder:
+                destroyResourceBinderP(dynamic_cast<ResourceBinder_P *>(obj));
+                break;
+            default:
+                GX_ASSERT_S(false, "Element type(%d) does not support deferred destroy", getElementTypeIdx(obj->idx()));
+                break;
+        }
+    }
+}
+
 VkPhysicalDeviceFeatures ContextVk::getVkDeviceFeatures(uint32_t deviceIndex, InstanceVk *instance)
 {
     VkPhysicalDeviceFeatures vkFeatures{};
@@ -406,6 +761,8 @@ VkPhysicalDeviceFeatures ContextVk::getVkDeviceFeatures(uint32_t deviceIndex, In
     vkFeatures.geometryShader = supportedFeatures.geometryShader;
     vkFeatures.tessellationShader = supportedFeatures.tessellationShader;
     vkFeatures.samplerAnisotropy = supportedFeatures.samplerAnisotropy;
+    vkFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+    vkFeatures.drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance;
 
     vkFeatures.textureCompressionASTC_LDR = supportedFeatures.textureCompressionASTC_LDR;
     vkFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC;
@@ -414,11 +771,65 @@ VkPhysicalDeviceFeatures ContextVk::getVkDeviceFeatures(uint32_t deviceIndex, In
     return vkFeatures;
 }
 
-std::vector<const char *> ContextVk::transDeviceExt(const std::vector<DeviceEXT> &exts)
+bool ContextVk::querySynchronization2(uint32_t deviceIndex, InstanceVk *instance)
+{
+#if defined(VK_VERSION_1_3)
+    if (USE_VK_API_VER < VK_API_VERSION_1_3 || vkGetPhysicalDeviceFeatures2 == nullptr) {
+        return false;
+    }
+    VkPhysicalDevice physicalDevice = instance->vkInstance()->getPhysicalDevice(deviceIndex);
+    if (physicalDevice == VK_NULL_HANDLE) {
+        return false;
+    }
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    if (properties.apiVersion < VK_API_VERSION_1_3) {
+        return false;
+    }
+
+    VkPhysicalDeviceSynchronization2Features sync2Features{};
+    sync2Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES;
+
+    VkPhysicalDeviceFeatures2 features2{};
+    features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    features2.pNext = &sync2Features;
+    vkGetPhysicalDeviceFeatures2(physicalDevice, &features2);
+
+    return sync2Features.synchronization2 == VK_TRUE;
+#else
+    return false;
+#endif
+}
+
+bool ContextVk::queryDeviceExtension(uint32_t deviceIndex, InstanceVk *instance, const char *extName)
+{
+    VkPhysicalDevice physicalDevice = instance->vkInstance()->getPhysicalDevice(deviceIndex);
+    if (physicalDevice == VK_NULL_HANDLE) {
+        return false;
+    }
+
+    uint32_t count = 0;
+    vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &count, nullptr);
+    std::vector<VkExtensionProperties> extensions(count);
+    vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &count, extensions.data());
+
+    for (const auto &ext : extensions) {
+        if (strcmp(ext.extensionName, extName) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::vector<const char *> ContextVk::transDeviceExt(const std::vector<DeviceEXT> &exts, bool enableMemoryBudget)
 {
     std::vector<const char *> vkDeviceExts;
 
 //    vkDeviceExts.push_back(VK_EXT_CUSTOM_BORDER_COLOR_EXTENSION_NAME);  // 纹理环绕border模式自定义颜色扩展
+    if (enableMemoryBudget) {
+        vkDeviceExts.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);    // 驱动提供的内存堆预算和占用
+    }
     return vkDeviceExts;
 }
 
@@ -469,6 +880,9 @@ void ContextVk::initVma()
     allocatorInfo.physicalDevice = mVkContext.gvkDevice()->physicalDevice();
     allocatorInfo.device = mVkContext.gvkDevice()->vkDevice();
     allocatorInfo.instance = mVkContext.vkInstance();
+    if (mMemoryBudget.isSupportBudgetExt()) {
+        allocatorInfo.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
+    }
 
     vmaCreateAllocator(&allocatorInfo, &mVmaAllocator);
 }
@@ -672,43 +1086,64 @@ uint32_t ContextVk::maxPerStageShaderStorageImagesCount()
 void ContextVk::waitIdle()
 {
     mVkContext.gvkDevice()->waitIdle();
+    releaseDeferredObjects(mSubmitSerial);
 }
 
 void ContextVk::submitCommandBlock(CommandBuffer cmdBuffer, uint32_t bufferIndex)
 {
     GX_ASSERT(cmdBuffer);
     auto *cmdBufferP = dynamic_cast<CommandBufferVk *>(cmdBuffer);
-    auto *cmdPool = cmdBufferP->mVkCommandPool;
-    auto *queue = cmdPool->queue();
+    GX_ASSERT_S(cmdBufferP->level() == CommandBufferLevel::Primary, "Secondary command buffer cannot be submitted");
+    GX_ASSERT_S(cmdBufferP->isValid(), "Command bundle references destroyed elements, please record it again");
+    auto *queue = cmdBufferP->mVkCommandPool.queue();
+
+    if (auto *capture = activeCapture()) {
+        capture->recordSubmit(cmdBufferP, bufferIndex);
+    }
 
-    if (!cmdBufferP->isCompiled()) {
-        cmdBufferP->compile();
+    if (!cmdBufferP->isCompiled(bufferIndex)) {
+        cmdBufferP->compile(bufferIndex);
     }
+    mGpuProfiler.onSubmit(cmdBufferP->querySlot(bufferIndex));
+    mParentCtx->counters().submitCount++;
+    flushDirtyBuffers();
 
     GVkFence fence;
     fence.create(queue->device(), VK_FLAGS_NONE);
 
+    nextSubmitSerial();
     queue->submit({}, {cmdBufferP->getVkCommandBuffer(bufferIndex)}, {}, fence);
 
     fence.wait();
     fence.destroy();
+    // 返回时已执行完成，之后可以直接重新录制
+    cmdBufferP->setSubmitSerial(bufferIndex, 0);
 }
 
 void ContextVk::submitCommand(CommandBuffer cmdBuffer, uint32_t bufferIndex, Fence fence)
 {
     GX_ASSERT(cmdBuffer);
     auto *cmdBufferP = dynamic_cast<CommandBufferVk *>(cmdBuffer);
-    auto *cmdPool = cmdBufferP->mVkCommandPool;
-    auto *queue = cmdPool->queue();
+    GX_ASSERT_S(cmdBufferP->level() == CommandBufferLevel::Primary, "Secondary command buffer cannot be submitted");
+    GX_ASSERT_S(cmdBufferP->isValid(), "Command bundle references destroyed elements, please record it again");
+    auto *queue = cmdBufferP->mVkCommandPool.queue();
     FenceVk *fenceP = GFX_NULL_HANDLE;
     if (fence) {
         fenceP = dynamic_cast<FenceVk *>(fence);
     }
 
-    if (!cmdBufferP->isCompiled()) {
-        cmdBufferP->compile();
+    if (auto *capture = activeCapture()) {
+        capture->recordSubmit(cmdBufferP, bufferIndex);
+    }
+
+    if (!cmdBufferP->isCompiled(bufferIndex)) {
+        cmdBufferP->compile(bufferIndex);
     }
+    mGpuProfiler.onSubmit(cmdBufferP->querySlot(bufferIndex));
+    mParentCtx->counters().submitCount++;
+    flushDirtyBuffers();
 
+    cmdBufferP->setSubmitSerial(bufferIndex, nextSubmitSerial());
     queue->submit({}, {cmdBufferP->getVkCommandBuffer(bufferIndex)}, {},
                   fenceP ? fenceP->vkFence()->vkFence() : VK_NULL_HANDLE);
 }
@@ -733,6 +1168,49 @@ std::string ContextVk::dumpCommandBuffer(CommandBuffer commandBuffer)
     return dynamic_cast<CommandBufferVk *>(commandBuffer)->dump();
 }
 
+bool ContextVk::beginCapture(const std::string &path)
+{
+    if (!mCapture) {
+        Log("ContextVk::beginCapture the context was not created with enableCapture");
+        return false;
+    }
+    return mCapture->begin(path);
+}
+
+bool ContextVk::endCapture()
+{
+    return mCapture && mCapture->end();
+}
+
+bool ContextVk::isCapturing()
+{
+    return activeCapture() != nullptr;
+}
+
+bool ContextVk::replayCapture(const std::string &path, const CaptureReplayInfo &info, CaptureReplayResult &result)
+{
+    return CaptureVk::replay(this, path, info, result);
+}
+
+void ContextVk::collectProfilerEvents()
+{
+    mGpuProfiler.collect();
+}
+
+MemoryStatistics ContextVk::getMemoryStatistics()
+{
+    mMemoryBudget.update();
+
+    MemoryStatistics stats{};
+    mMemoryBudget.fillStatistics(stats);
+    return stats;
+}
+
+void ContextVk::setMemoryBudgetCallback(const MemoryBudgetCallback &callback, float threshold)
+{
+    mMemoryBudget.setCallback(callback, threshold);
+}
+
 Fence_P *ContextVk::createFenceP(bool signaled)
 {
     uint16_t oIdx = mFenceIDAlloc.alloc();
@@ -928,12 +1406,28 @@ Texture_P *ContextVk::findTextureP(GfxIdxTy idx)
 
 Sampler_P *ContextVk::createSamplerP(const CreateSamplerInfo &createInfo)
 {
+    // 超出设备上限的各向异性级别与上限等价，归一化后再查找缓存
+    CreateSamplerInfo info = createInfo;
+    info.anisotropyLog2 = clampSamplerAnisotropyLog2(createInfo.anisotropyLog2);
+
+    GLockerGuard locker(mRwSamplerMapMutex);
+    auto it = mSamplerMap.find(info.t);
+    if (it != mSamplerMap.end()) {
+        auto *cached = dynamic_cast<SamplerVk *>(findElement(ElementType::Sampler, it->second));
+        if (cached != nullptr) {
+            cached->refCount()++;
+            return cached;
+        }
+        mSamplerMap.erase(it);
+    }
+
     uint16_t oIdx = mSamplerIDAlloc.alloc();
     GX_ASSERT(mSamplerIDAlloc.isValid(oIdx));
     auto *obj = GX_NEW(SamplerVk, genElementIdx(mIdx, oIdx, ElementType::Sampler));
-    if (obj && obj->init(mParentCtx, createInfo)) {
+    if (obj && obj->init(mParentCtx, info)) {
         GX_ASSERT(!containElementMap(obj->idx()));
         insertElementMap(obj);
+        mSamplerMap[info.t] = obj->idx();
         return obj;
     }
     GX_ASSERT_S(obj != nullptr, "ContextVk::createSamplerP create object failure");
@@ -944,13 +1438,26 @@ Sampler_P *ContextVk::createSamplerP(const CreateSamplerInfo &createInfo)
 void ContextVk::destroySamplerP(Sampler obj)
 {
     GX_ASSERT(obj);
-    auto *objP = dynamic_cast<Sampler_P *>(obj);
+    auto *objP = dynamic_cast<SamplerVk *>(obj);
     GX_ASSERT(objP);
 
     uint8_t tId = getElementTypeIdx(objP->idx());
     GX_ASSERT(tId == ElementType::Sampler);
     uint16_t oId = getElementObjectIdx(objP->idx());
 
+    {
+        // 仍有其他句柄共享时只减少引用计数
+        GLockerGuard locker(mRwSamplerMapMutex);
+        GX_ASSERT(objP->refCount() > 0);
+        if (--objP->refCount() > 0) {
+            return;
+        }
+        auto it = mSamplerMap.find(objP->createInfo().t);
+        if (it != mSamplerMap.end() && it->second == objP->idx()) {
+            mSamplerMap.erase(it);
+        }
+    }
+
     destroyElement(objP);
     mSamplerIDAlloc.free(oId);
 }
@@ -1150,15 +1657,21 @@ PipelineVk *ContextVk::getGraphicsPipeline(const CreateGraphicsPipelineStateInfo
     if (it != mGraphPipelineMap.end()) {
         obj = findPipeline(it->second);
     }
+    auto &counters = mParentCtx->counters();
     if (obj == GFX_NULL_HANDLE) {
         Log("ContextVk::getGraphicsPipelineP create graphics pipeline");
+        const uint64_t createBeginNs = Profiler::now();
         obj = createGraphicsPipeline(createInfo);
+        counters.pipelineCacheMissCount++;
+        counters.pipelineCreateTimeNs += Profiler::now() - createBeginNs;
         if (obj) {
             mGraphPipelineMap.emplace(queryInfo, obj->idx());
             for (auto *shader : createInfo.shaderPrograms) {
                 dynamic_cast<ShaderVk *>(shader)->refPipeline(obj->idx());
             }
         }
+    } else {
+        counters.pipelineCacheHitCount++;
     }
 
     return obj;
@@ -1176,15 +1689,21 @@ PipelineVk *ContextVk::getComputePipeline(const CreateComputePipelineStateInfo &
     if (it != mCompPipelineMap.end()) {
         obj = findPipeline(it->second);
     }
+    auto &counters = mParentCtx->counters();
     if (obj == GFX_NULL_HANDLE) {
         Log("ContextVk::getComputePipeline create compute pipeline");
+        const uint64_t createBeginNs = Profiler::now();
         obj = createComputePipeline(createInfo);
+        counters.pipelineCacheMissCount++;
+        counters.pipelineCreateTimeNs += Profiler::now() - createBeginNs;
         if (obj) {
             mCompPipelineMap.emplace(queryInfo, obj->idx());
             for (auto *shader : createInfo.shaderPrograms) {
                 dynamic_cast<ShaderVk *>(shader)->refPipeline(obj->idx());
             }
         }
+    } else {
+        counters.pipelineCacheHitCount++;
     }
 
     return obj;
@@ -1192,6 +1711,8 @@ PipelineVk *ContextVk::getComputePipeline(const CreateComputePipelineStateInfo &
 
 PipelineVk *ContextVk::createGraphicsPipeline(const CreateGraphicsPipelineStateInfo &createInfo)
 {
+    ProfilerScope zone(mParentCtx->profiler(), "ContextVk::createGraphicsPipeline");
+
     uint16_t oIdx = mPipelineStateIDAlloc.alloc();
     GX_ASSERT(mPipelineStateIDAlloc.isValid(oIdx));
     auto *obj = GX_NEW(PipelineVk, genElementIdx(mIdx, oIdx, ElementType::PipelineState));
@@ -1246,6 +1767,8 @@ void ContextVk::destroyPipeline(PipelineVk *obj)
 
 PipelineVk *ContextVk::createComputePipeline(const CreateComputePipelineStateInfo &createInfo)
 {
+    ProfilerScope zone(mParentCtx->profiler(), "ContextVk::createComputePipeline");
+
     uint16_t oIdx = mPipelineStateIDAlloc.alloc();
     GX_ASSERT(mPipelineStateIDAlloc.isValid(oIdx));
     auto *obj = GX_NEW(PipelineVk, genElementIdx(mIdx, oIdx, ElementType::PipelineState));
@@ -1335,6 +1858,27 @@ Query_P *ContextVk::findQueryP(GfxIdxTy idx)
     return dynamic_cast<Query_P *>(objE);
 }
 
+void ContextVk::deferDestroyP(ElementHandle *obj)
+{
+    GX_ASSERT(obj != nullptr);
+    GX_ASSERT_S(obj->context() == this->mParentCtx, "Context mismatch");
+
+    // 立即从元素表中移除，之后不能再通过idx找到该对象
+    removeElementMap(obj->idx(), obj);
+    ++mElementEpoch;
+
+    mDeferredDestroyMutex.lock();
+    uint64_t serial = mSubmitSerial;
+    mDeferredDestroyQueue.push_back({obj, serial});
+    bool completed = serial <= mCompletedSerial;
+    mDeferredDestroyMutex.unlock();
+
+    if (completed) {
+        // 此前的提交都已执行完成，无需等待
+        releaseDeferredObjects(serial);
+    }
+}
+
 RenderPassVk *ContextVk::createRenderPass(const GetRenderPassInfo &createInfo)
 {
     uint16_t oIdx = mRenderPassIDAlloc.alloc();
@@ -1446,6 +1990,7 @@ void ContextVk::destroyElement(ElementHandle *obj)
     GX_ASSERT_S(obj->context() == this->mParentCtx, "Context mismatch");
     GfxIdxTy idx = obj->idx();
     removeElementMap(idx, obj);
+    ++mElementEpoch;
 
     obj->destroy();
     GX_DELETE(obj);
@@ -1573,6 +2118,14 @@ SampleCountFlag::Enum RenderPassVk::sampleCountFlag() const
     return mSampleCountFlag == 0 ? SampleCountFlag::SampleCount_1 : (SampleCountFlag::Enum) mSampleCountFlag;
 }
 
+/**
+ * 瞬态附件或结束时丢弃的附件不需要写回内存
+ */
+static inline VkAttachmentStoreOp toVkStoreOp(const AttachmentDesc &desc)
+{
+    return desc.discardEnd || desc.transient ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE;
+}
+
 bool RenderPassVk::initVkRenderPass(const GetRenderPassInfo &createInfo)
 {
     std::hash<GetRenderPassInfo> hashFunc;
@@ -1605,14 +2158,13 @@ bool RenderPassVk::initVkRenderPass(const GetRenderPassInfo &createInfo)
             // msaa color
             vkAttachments[attachmentIndex].format = toVkFormat(gfxAttachDesc.format);
             vkAttachments[attachmentIndex].samples = toVkSampleCount(sample);
+            // 多重采样附件是瞬态的，内容只在RenderPass内有效，结束时只保留解析结果
             vkAttachments[attachmentIndex].loadOp = gfxAttachDesc.clear ? VK_ATTACHMENT_LOAD_OP_CLEAR
-                                                                        : gfxAttachDesc.discard
-                                                                          ? VK_ATTACHMENT_LOAD_OP_DONT_CARE
-                                                                          : VK_ATTACHMENT_LOAD_OP_LOAD;
+                                                                        : VK_ATTACHMENT_LOAD_OP_DONT_CARE;
             vkAttachments[attachmentIndex].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
             vkAttachments[attachmentIndex].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
             vkAttachments[attachmentIndex].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-            vkAttachments[attachmentIndex].initialLayout = toVkImageLayout(gfxAttachDesc.initLayout);
+            vkAttachments[attachmentIndex].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
             vkAttachments[attachmentIndex].finalLayout = toVkImageLayout(gfxAttachDesc.finalLayout);
             attachmentIndex += 1;
 
@@ -1620,7 +2172,7 @@ bool RenderPassVk::initVkRenderPass(const GetRenderPassInfo &createInfo)
             vkAttachments[attachmentIndex].format = toVkFormat(gfxAttachDesc.format);
             vkAttachments[attachmentIndex].samples = toVkSampleCount(SampleCountFlag::SampleCount_1);
             vkAttachments[attachmentIndex].loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-            vkAttachments[attachmentIndex].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+            vkAttachments[attachmentIndex].storeOp = toVkStoreOp(gfxAttachDesc);
             vkAttachments[attachmentIndex].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
             vkAttachments[attachmentIndex].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
             vkAttachments[attachmentIndex].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
@@ -1629,15 +2181,17 @@ bool RenderPassVk::initVkRenderPass(const GetRenderPassInfo &createInfo)
         } else {
             vkAttachments[attachmentIndex].format = toVkFormat(gfxAttachDesc.format);
             vkAttachments[attachmentIndex].samples = toVkSampleCount(SampleCountFlag::SampleCount_1);
+            // 瞬态附件的内容不会保留到下一个RenderPass，无需加载
+            bool discard = gfxAttachDesc.discard || gfxAttachDesc.transient;
             vkAttachments[attachmentIndex].loadOp = gfxAttachDesc.clear ? VK_ATTACHMENT_LOAD_OP_CLEAR
-                                                                        : gfxAttachDesc.discard
+                                                                        : discard
                                                                           ? VK_ATTACHMENT_LOAD_OP_DONT_CARE
                                                                           : VK_ATTACHMENT_LOAD_OP_LOAD;
-            vkAttachments[attachmentIndex].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+            vkAttachments[attachmentIndex].storeOp = toVkStoreOp(gfxAttachDesc);
             vkAttachments[attachmentIndex].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
             vkAttachments[attachmentIndex].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
             vkAttachments[attachmentIndex].initialLayout =
-                    gfxAttachDesc.discard ? VK_IMAGE_LAYOUT_UNDEFINED : toVkImageLayout(gfxAttachDesc.initLayout);
+                    discard ? VK_IMAGE_LAYOUT_UNDEFINED : toVkImageLayout(gfxAttachDesc.initLayout);
             vkAttachments[attachmentIndex].finalLayout = toVkImageLayout(gfxAttachDesc.finalLayout);
             attachmentIndex += 1;
         }
@@ -1651,35 +2205,35 @@ bool RenderPassVk::initVkRenderPass(const GetRenderPassInfo &createInfo)
             vkAttachments[depthIndex].format = toVkFormat(depthAttachmentDesc.format);
             vkAttachments[depthIndex].samples = toVkSampleCount(sample);
             vkAttachments[depthIndex].loadOp = depthAttachmentDesc.clear ? VK_ATTACHMENT_LOAD_OP_CLEAR
-                                                                         : depthAttachmentDesc.discard
-                                                                           ? VK_ATTACHMENT_LOAD_OP_DONT_CARE
-                                                                           : VK_ATTACHMENT_LOAD_OP_LOAD;
+                                                                         : VK_ATTACHMENT_LOAD_OP_DONT_CARE;
             vkAttachments[depthIndex].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
             vkAttachments[depthIndex].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-            vkAttachments[depthIndex].stencilStoreOp = VK_ATTACHMENT_STORE_OP_STORE;
-            vkAttachments[depthIndex].initialLayout = toVkImageLayout(depthAttachmentDesc.initLayout);
+            vkAttachments[depthIndex].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+            vkAttachments[depthIndex].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
             vkAttachments[depthIndex].finalLayout = toVkImageLayout(depthAttachmentDesc.finalLayout);
 
             // depth
             vkAttachments[depthIndex + 1].format = toVkFormat(depthAttachmentDesc.format);
             vkAttachments[depthIndex + 1].samples = toVkSampleCount(SampleCountFlag::SampleCount_1);
             vkAttachments[depthIndex + 1].loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-            vkAttachments[depthIndex + 1].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+            vkAttachments[depthIndex + 1].storeOp = toVkStoreOp(depthAttachmentDesc);
             vkAttachments[depthIndex + 1].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-            vkAttachments[depthIndex + 1].stencilStoreOp = VK_ATTACHMENT_STORE_OP_STORE;
+            vkAttachments[depthIndex + 1].stencilStoreOp = toVkStoreOp(depthAttachmentDesc);
             vkAttachments[depthIndex + 1].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
             vkAttachments[depthIndex + 1].finalLayout = toVkImageLayout(depthAttachmentDesc.finalLayout);
         } else {
             vkAttachments[depthIndex].format = toVkFormat(depthAttachmentDesc.format);
+            bool discard = depthAttachmentDesc.discard || depthAttachmentDesc.transient;
             vkAttachments[depthIndex].samples = toVkSampleCount(SampleCountFlag::SampleCount_1);
             vkAttachments[depthIndex].loadOp = depthAttachmentDesc.clear ? VK_ATTACHMENT_LOAD_OP_CLEAR
-                                                                         : depthAttachmentDesc.discard
+                                                                         : discard
                                                                            ? VK_ATTACHMENT_LOAD_OP_DONT_CARE
                                                                            : VK_ATTACHMENT_LOAD_OP_LOAD;
-            vkAttachments[depthIndex].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+            vkAttachments[depthIndex].storeOp = toVkStoreOp(depthAttachmentDesc);
             vkAttachments[depthIndex].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-            vkAttachments[depthIndex].stencilStoreOp = VK_ATTACHMENT_STORE_OP_STORE;
-            vkAttachments[depthIndex].initialLayout = toVkImageLayout(depthAttachmentDesc.initLayout);
+            vkAttachments[depthIndex].stencilStoreOp = toVkStoreOp(depthAttachmentDesc);
+            vkAttachments[depthIndex].initialLayout =
+                    discard ? VK_IMAGE_LAYOUT_UNDEFINED : toVkImageLayout(depthAttachmentDesc.initLayout);
             vkAttachments[depthIndex].finalLayout = toVkImageLayout(depthAttachmentDesc.finalLayout);
         }
     }
@@ -1803,6 +2357,9 @@ bool FrameVk::init(Context_T *context, const CreateFrameInfo &createInfo)
 
 void FrameVk::destroy()
 {
+    // 等待设备空闲，同时回收reset时延迟销毁的渲染目标和纹理，它们引用着旧交换链的图像
+    mContextT->waitIdle();
+
     if (mRenderTargetType == FrameTargetType::SwapChain) {
         mContextT->destroyRenderTarget(mRenderTarget);
     }
@@ -1821,6 +2378,9 @@ void FrameVk::destroy()
         f.destroy();
     }
     mFences.clear();
+    mFenceSerials.clear();
+
+    releaseRetiredSwapChain(true);
 
     if (mVkSwapChain) {
         mVkSwapChain->destroy();
@@ -1847,12 +2407,21 @@ bool FrameVk::reset(uint32_t width, uint32_t height, bool vSync, bool enforce)
         return false;
     }
 
-    mContextT->waitIdle();
-
     mWidth = width;
     mHeight = height;
     mVSync = vSync;
 
+    // 不等待设备空闲，旧的渲染目标和纹理进入延迟销毁队列，
+    // 旧交换链在新交换链的首次提交完成并且新交换链的图像轮换一周后销毁
+    auto *contextVk = dynamic_cast<ContextVk *>(mContextT->contextP());
+    mRetireSerial = contextVk->submitSerial() + 1;
+    mRetireAcquireCount = 0;
+
+    if (mRenderTarget != GFX_NULL_HANDLE) {
+        mContextT->destroyRenderTarget(mRenderTarget, true);
+        mRenderTarget = GFX_NULL_HANDLE;
+    }
+
     initSwapChain(nullptr);
 
     if (mRenderTargetType == FrameTargetType::SwapChain) {
@@ -1864,7 +2433,9 @@ bool FrameVk::reset(uint32_t width, uint32_t height, bool vSync, bool enforce)
 
 bool FrameVk::beginFrame()
 {
+    ProfilerScope zone(mContextT->profiler(), "FrameVk::beginFrame");
     updateFrameState();
+    mContextT->profiler().nextFrame();
 
     GVkFence *fence = nullptr;
 
@@ -1877,6 +2448,7 @@ bool FrameVk::beginFrame()
             VK_CHECK_RESULT(result);
             return false;
         }
+        mRetireAcquireCount++;
     } else if (mRenderTargetType == FrameTargetType::RenderTarget) {
         if (mRenderTarget == nullptr) {
             return false;
@@ -1894,21 +2466,39 @@ bool FrameVk::beginFrame()
             return false;
         }
         fence->reset();
+
+        // Fence关联的提交已执行完成，回收延迟销毁的对象
+        auto *contextVk = dynamic_cast<ContextVk *>(mContextT->contextP());
+        contextVk->releaseDeferredObjects(mFenceSerials[mCurrentFrameIndex]);
+        releaseRetiredSwapChain(false);
     }
 
+    auto *contextVk = dynamic_cast<ContextVk *>(mContextT->contextP());
+    contextVk->gpuProfiler().collect();
+    contextVk->memoryBudget().update();
+
     return true;
 }
 
 void FrameVk::submit(CommandBuffer commandBuffer)
 {
+    ProfilerScope zone(mContextT->profiler(), "FrameVk::submit");
     GVkContext *gVkContext = getGVkContext(mContextT);
     GVkFence *fence = nullptr;
 
     auto *cmdBufferP = dynamic_cast<CommandBufferVk *>(commandBuffer);
+    GX_ASSERT_S(cmdBufferP->level() == CommandBufferLevel::Primary, "Secondary command buffer cannot be submitted");
+    GX_ASSERT_S(cmdBufferP->isValid(), "Command bundle references destroyed elements, please record it again");
+
+    auto *contextVk = dynamic_cast<ContextVk *>(mContextT->contextP());
+    if (auto *capture = contextVk->activeCapture()) {
+        capture->recordSubmit(cmdBufferP, mCurrentFrameIndex);
+    }
 
-    if (!cmdBufferP->isCompiled()) {
-        cmdBufferP->compile(this);
+    if (!cmdBufferP->isCompiled(mCurrentFrameIndex)) {
+        cmdBufferP->compile(mCurrentFrameIndex);
     }
+    contextVk->gpuProfiler().onSubmit(cmdBufferP->querySlot(mCurrentFrameIndex));
 
     if (!mFences.empty()) {
         fence = &mFences[mCurrentFrameIndex];
@@ -1916,6 +2506,26 @@ void FrameVk::submit(CommandBuffer commandBuffer)
 
     VkCommandBuffer vkCmdBuffer = cmdBufferP->getVkCommandBuffer(mCurrentFrameIndex);
 
+    uint64_t serial = contextVk->nextSubmitSerial();
+    if (fence) {
+        mFenceSerials[mCurrentFrameIndex] = serial;
+    }
+    cmdBufferP->setSubmitSerial(mCurrentFrameIndex, serial);
+
+    mFrameState.current.submitCount++;
+    mFrameState.current.barrierCommandCount += cmdBufferP->barrierCommandCount();
+    mFrameState.current.barrierCount += cmdBufferP->barrierCount();
+    mFrameState.current.redundantStateCount += cmdBufferP->redundantStateCount();
+    mFrameState.current.mergedDrawCount += cmdBufferP->mergedDrawCount();
+    const auto &commandCounts = cmdBufferP->commandCounts();
+    mFrameState.current.commandCount += commandCounts.commandCount;
+    mFrameState.current.drawCount += commandCounts.drawCount;
+    mFrameState.current.dispatchCount += commandCounts.dispatchCount;
+    mFrameState.current.renderPassCount += commandCounts.renderPassCount;
+    mFrameState.current.pipelineBindCount += cmdBufferP->pipelineBindCount();
+    mContextT->counters().submitCount++;
+    contextVk->flushDirtyBuffers();
+
     if (mVkSwapChain && mVkSwapChain->getImageAvailableSemaphore() != VK_NULL_HANDLE) {
         gVkContext->graphicsQueue()
                 ->submit({{mVkSwapChain->getImageAvailableSemaphore(), VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT}},
@@ -1933,8 +2543,13 @@ void FrameVk::submit(CommandBuffer commandBuffer)
 
 void FrameVk::endFrame(bool waitQueue)
 {
+    ProfilerScope zone(mContextT->profiler(), "FrameVk::endFrame");
     GVkContext *gVkContext = getGVkContext(mContextT);
 
+    if (auto *capture = dynamic_cast<ContextVk *>(mContextT->contextP())->activeCapture()) {
+        capture->recordFrameEnd();
+    }
+
     if (mRenderTargetType == FrameTargetType::SwapChain) {
         VkResult result = mVkSwapChain->queuePresent(gVkContext->graphicsQueue(), mCurrentFrameIndex, mRenderSemaphore);
         if (!((result == VK_SUCCESS) || (result == VK_SUBOPTIMAL_KHR))) {
@@ -2002,6 +2617,11 @@ uint64_t FrameVk::getFrameTime()
     return mFrameState.frameTime;
 }
 
+FrameStatistics FrameVk::getFrameStatistics()
+{
+    return mFrameState.statistics;
+}
+
 Context_T *FrameVk::context()
 {
     return mContextT;
@@ -2039,26 +2659,32 @@ bool FrameVk::initSwapChain(const SwapChainInfo *swapChainInfo)
 #if defined(VK_USE_PLATFORM_MACOS_MVK) || defined(VK_USE_PLATFORM_IOS_MVK)
             // Switching VSync with MoltenVK will result in a SUBOPTIMAL_KHR error when calling acquireNextImage,
             // as it is not possible to create a Swapchain through oldSwapchain
+            mContextT->waitIdle();
             swapChain->destroy();
 #endif
-            mRenderSemaphore.destroy();
+            // 旧信号量可能仍被未完成的呈现等待，随旧交换链一起延迟销毁
+            mRetiredSemaphores.push_back(mRenderSemaphore);
+            mRenderSemaphore = GVkSemaphore();
             mRenderSemaphore.create(vkContext->vkDevice());
 
             swapChain->create(vkContext->gvkDevice(),
                               mVkSurface,
-                              width, height, mVSync);
+                              width, height, mVSync, true);
+
+            // 新交换链的图像数量可能增加
+            initFence(mVkSwapChain->bufferCount());
         }
 
         if (!mColorTextures.empty()) {
             for (auto *t : mColorTextures) {
-                mContextT->destroyTexture(t);
+                mContextT->destroyTexture(t, true);
             }
         }
         uint32_t bufferCount = mVkSwapChain->bufferCount();
         mColorTextures.resize(bufferCount);
 
         if (mDepthTexture != GFX_NULL_HANDLE) {
-            mContextT->destroyTexture(mDepthTexture);
+            mContextT->destroyTexture(mDepthTexture, true);
         }
 
         Format::Enum colorFormat = fromVkFormat(mVkSwapChain->colorFormat());
@@ -2123,8 +2749,15 @@ bool FrameVk::initRenderTarget(bool isSwapChain)
 
 bool FrameVk::initFence(uint32_t bufferCount)
 {
+    // 已有的Fence可能仍关联着未完成的提交，只补充新增的部分
+    size_t oldCount = mFences.size();
+    if (bufferCount <= oldCount) {
+        return true;
+    }
     mFences.resize(bufferCount);
-    for (auto &f : mFences) {
+    mFenceSerials.resize(bufferCount, 0);
+    for (size_t i = oldCount; i < bufferCount; i++) {
+        auto &f = mFences[i];
         // beginFrame中先wait再reset，所以一开始要设置为signaled状态
         f.create(getGVkContext(mContextT)->gvkDevice(), VK_FENCE_CREATE_SIGNALED_BIT);
         if (f.vkFence() == VK_NULL_HANDLE) {
@@ -2141,6 +2774,40 @@ void FrameVk::updateFrameState()
     mFrameState.frameTime = timeDiff;
 
     mFrameState.time.resetToSteadyClock();
+
+    ContextStatistics contextStats = mContextT->counters().snapshot();
+    ContextCounters::fillFrameStatistics(mFrameState.current, contextStats, mFrameState.contextStats);
+    mFrameState.contextStats = contextStats;
+
+    mFrameState.statistics = mFrameState.current;
+    mFrameState.current = {};
+}
+
+void FrameVk::releaseRetiredSwapChain(bool force)
+{
+    auto *swapChain = dynamic_cast<GVkSurfaceSwapChain *>(mVkSwapChain);
+    bool hasRetired = !mRetiredSemaphores.empty() || (swapChain && swapChain->hasRetired());
+    if (!hasRetired) {
+        return;
+    }
+    if (!force) {
+        // 新交换链的首次提交完成只说明GPU不再使用旧资源，旧交换链上排队的呈现没有Fence可以等待，
+        // 呈现按队列顺序处理，新交换链的每个图像都被重新获取过一次后，之前的呈现已经全部完成
+        if (dynamic_cast<ContextVk *>(mContextT->contextP())->completedSerial() < mRetireSerial) {
+            return;
+        }
+        if (swapChain && mRetireAcquireCount <= swapChain->bufferCount()) {
+            return;
+        }
+    }
+
+    if (swapChain) {
+        swapChain->destroyRetired();
+    }
+    for (auto &semaphore : mRetiredSemaphores) {
+        semaphore.destroy();
+    }
+    mRetiredSemaphores.clear();
 }
 
 /// ============ RenderTargetVk ============ ///
@@ -2150,6 +2817,8 @@ bool RenderTargetVk::init(Context_T *context, const CreateRenderTargetInfo &crea
 
     GX_ASSERT(createInfo.sample <= mContextT->maxRenderTargetSampleCount());
 
+    mSample = createInfo.sample;
+
     uint32_t attachSize = 0;
     if (!createInfo.colorAttachments.empty()) {
         attachSize += (mColorCount = createInfo.colorAttachments[0].size());
@@ -2265,6 +2934,7 @@ void RenderTargetVk::destroy()
     }
     mFBCache.clear();
     mFBViews.clear();
+    mRenderPassCache.clear();
 
     mContextT = GFX_NULL_HANDLE;
 }
@@ -2316,6 +2986,7 @@ GVkFrameBuffer *RenderTargetVk::getVkFrameBuffer(RenderPassVk *rp, uint32_t inde
 {
     GfxIdxTy idx = rp->idx();
 
+    GLockerGuard locker(mFBCacheMutex);
     auto it = mFBCache.find(idx);
     if (it == mFBCache.end()) {
         auto fbs = createFrameBuffer(rp);
@@ -2345,6 +3016,18 @@ constexpr inline RenderTargetAttachmentFlag::Enum getRenderTargetAttachmentFlags
 
 RenderPassVk *RenderTargetVk::getRenderPass(const RenderPassInfo &rpInfo) const
 {
+    {
+        GLockerGuard locker(mRenderPassCacheMutex);
+        for (const auto &cached : mRenderPassCache) {
+            if (cached.rpInfo.clear == rpInfo.clear
+                && cached.rpInfo.discard == rpInfo.discard
+                && cached.rpInfo.discardEnd == rpInfo.discardEnd
+                && cached.rpInfo.subPassInfo == rpInfo.subPassInfo) {
+                return cached.renderPass;
+            }
+        }
+    }
+
     auto info = mGetRenderPassBase;
     const auto &subPassInfo = rpInfo.subPassInfo;
 
@@ -2354,6 +3037,7 @@ RenderPassVk *RenderTargetVk::getRenderPass(const RenderPassInfo &rpInfo) const
 
             info.colorAttachmentDescs[i].clear = rpInfo.clear & target;
             info.colorAttachmentDescs[i].discard = rpInfo.discard & target;
+            info.colorAttachmentDescs[i].discardEnd = rpInfo.discardEnd & target;
         }
     }
 
@@ -2362,6 +3046,7 @@ RenderPassVk *RenderTargetVk::getRenderPass(const RenderPassInfo &rpInfo) const
                 = getRenderTargetAttachmentFlagsAt(RenderTargetAttachmentFlag::ColorCount);
         info.depthAttachmentDesc.clear = rpInfo.clear & target;
         info.depthAttachmentDesc.discard = rpInfo.discard & target;
+        info.depthAttachmentDesc.discardEnd = rpInfo.discardEnd & target;
     }
 
     if (subPassInfo.subPassDescs.empty() || subPassInfo.subPassDepends.empty()) {
@@ -2385,6 +3070,11 @@ RenderPassVk *RenderTargetVk::getRenderPass(const RenderPassInfo &rpInfo) const
     RenderPassVk *rp = dynamic_cast<ContextVk *>(mContextT->contextP())->getRenderPass(info);
     GX_ASSERT(rp != GFX_NULL_HANDLE);
 
+    if (rp != GFX_NULL_HANDLE) {
+        GLockerGuard locker(mRenderPassCacheMutex);
+        mRenderPassCache.push_back({rpInfo, rp});
+    }
+
     return rp;
 }
 
@@ -2435,7 +3125,7 @@ bool RenderTargetVk::initMSAARenderTarget(const CreateRenderTargetInfo &createIn
                 {
                         aColor->type(),
                         aColor->format(),
-                        aColor->usage(),
+                        (TextureUsageFlags) (TextureUsage::Attachment | TextureUsage::Transient),
                         aColor->aspect(),
                         aColor->width(),
                         aColor->height(),
@@ -2466,7 +3156,7 @@ bool RenderTargetVk::initMSAARenderTarget(const CreateRenderTargetInfo &createIn
                 {
                         depthTexP->type(),
                         depthTexP->format(),
-                        depthTexP->usage(),
+                        (TextureUsageFlags) (TextureUsage::Attachment | TextureUsage::Transient),
                         depthTexP->aspect(),
                         depthTexP->width(),
                         depthTexP->height(),
@@ -2534,6 +3224,7 @@ void RenderTargetVk::initRenderPassBase(const CreateRenderTargetInfo &createInfo
         for (uint32_t i = 0; i < createInfo.colorAttachments[0].size(); i++) {
             auto &ca = createInfo.colorAttachments[0][i];
             info.colorAttachmentDescs[i].format = ca.texture->format();
+            info.colorAttachmentDescs[i].transient = (ca.texture->usage() & TextureUsage::Transient) != 0;
             if (isSwapChain) {
                 info.colorAttachmentDescs[i].initLayout = ImageLayout::ColorAttachment;
                 info.colorAttachmentDescs[i].finalLayout = ImageLayout::ColorAttachment;
@@ -2549,6 +3240,8 @@ void RenderTargetVk::initRenderPassBase(const CreateRenderTargetInfo &createInfo
     }
     if (createInfo.depthStencilAttachment.texture != nullptr) {
         info.depthAttachmentDesc.format = createInfo.depthStencilAttachment.texture->format();
+        info.depthAttachmentDesc.transient =
+                (createInfo.depthStencilAttachment.texture->usage() & TextureUsage::Transient) != 0;
         if (isSwapChain) {
             info.depthAttachmentDesc.initLayout = ImageLayout::DepthStencilAttachment;
             info.depthAttachmentDesc.finalLayout = ImageLayout::DepthStencilAttachment;
@@ -2591,27 +3284,45 @@ uint32_t RenderTargetVk::valueForLevel(uint8_t level, uint32_t baseLevelValue)
 bool BufferVk::init(Context_T *context, const CreateBufferInfo &createInfo)
 {
     mContextT = context;
+    mMapFlags = createInfo.mapFlags;
 
 #ifdef USE_AMD_VULKAN_MEMORY_ALLOCATOR
-    return initByVMA(createInfo);
+    bool ok = initByVMA(createInfo);
 #else
-    return initByGVkBuffer(createInfo);
+    bool ok = initByGVkBuffer(createInfo);
 #endif //USE_AMD_VULKAN_MEMORY_ALLOCATOR
+    if (!ok) {
+        return false;
+    }
+
+    if ((mMapFlags & BufferMapFlag::Persistent) == BufferMapFlag::Persistent && map() == nullptr) {
+        Log("BufferVk::init persistent mapping requires host visible memory");
+        mMapFlags &= ~BufferMapFlag::Persistent;
+    }
+    return true;
 }
 
 void BufferVk::destroy()
 {
-    unmap();
+    unmapMemory();
 
     auto contextVk = getContextVk();
     auto *vkContext = contextVk->vkContext();
 
+    if (mDirtyRegistered) {
+        contextVk->removeDirtyBuffer(this);
+        mDirtyRegistered = false;
+    }
+    mDirtyRanges.clear();
+
     for (auto &[k, p] : mVkBufferViews) {
         vkDestroyBufferView(vkContext->vkDevice(), p, nullptr);
     }
 
     mVkBufferViews.clear();
 
+    contextVk->untrackMemory(mMemoryRecord);
+
 #ifdef USE_AMD_VULKAN_MEMORY_ALLOCATOR
     vmaDestroyBuffer(getContextVk()->getVmaAllocator(),
                      mBuffer, mAllocation);
@@ -2663,11 +3374,27 @@ void *BufferVk::map()
 
 void BufferVk::flush()
 {
+    {
+        // 整块刷新覆盖了所有已记录的写入区间
+        GLockerGuard locker(mDirtyMutex);
+        mDirtyRanges.clear();
+    }
+    flush(0, GFX_WHOLE_SIZE);
+}
+
+void BufferVk::flush(uint64_t offset, uint64_t size)
+{
+    if (offset >= mSize) {
+        return;
+    }
+    size = std::min(size, mSize - offset);
 #ifdef USE_AMD_VULKAN_MEMORY_ALLOCATOR
     if (mBuffer == VK_NULL_HANDLE || mAllocation == nullptr) {
         return;
     }
-    vmaFlushAllocation(getContextVk()->getVmaAllocator(), mAllocation, 0, VK_WHOLE_SIZE);
+    if (mNonCoherent) {
+        vmaFlushAllocation(getContextVk()->getVmaAllocator(), mAllocation, offset, size);
+    }
 #else
     if (!mGVkBuffer.isCreated()) {
         return;
@@ -2676,13 +3403,113 @@ void BufferVk::flush()
         Log("BufferVk::flush not mapped");
         return;
     }
-    if (mMemoryUsage != BufferMemoryUsage::GpuOnly) {
-        mGVkBuffer.flush(VK_WHOLE_SIZE, 0);
+    if (mNonCoherent) {
+        mGVkBuffer.flush(size, offset);
+    }
+#endif //USE_AMD_VULKAN_MEMORY_ALLOCATOR
+    mContextT->counters().uploadBytes += size;
+}
+
+void BufferVk::invalidate(uint64_t offset, uint64_t size)
+{
+    if (offset >= mSize || !mNonCoherent) {
+        return;
+    }
+    size = std::min(size, mSize - offset);
+#ifdef USE_AMD_VULKAN_MEMORY_ALLOCATOR
+    if (mBuffer == VK_NULL_HANDLE || mAllocation == nullptr) {
+        return;
+    }
+    vmaInvalidateAllocation(getContextVk()->getVmaAllocator(), mAllocation, offset, size);
+#else
+    if (!mGVkBuffer.isCreated()) {
+        return;
+    }
+    mGVkBuffer.invalidate(size, offset);
+#endif //USE_AMD_VULKAN_MEMORY_ALLOCATOR
+}
+
+void BufferVk::markDirty(uint64_t offset, uint64_t size)
+{
+    if ((mMapFlags & BufferMapFlag::DirtyTracking) != BufferMapFlag::DirtyTracking) {
+        flush(offset, size);
+        return;
+    }
+    if (offset >= mSize || size == 0) {
+        return;
+    }
+    uint64_t end = offset + std::min(size, mSize - offset);
+
+    bool needRegister;
+    {
+        GLockerGuard locker(mDirtyMutex);
+        mDirtyRanges.emplace_back(offset, end);
+        if (mDirtyRanges.size() >= MAX_DIRTY_RANGES) {
+            coalesceDirtyRanges();
+        }
+        needRegister = !mDirtyRegistered;
+        mDirtyRegistered = true;
+    }
+    // 不能在持有mDirtyMutex时加锁ContextVk的列表，flushDirtyBuffers以相反的顺序加锁
+    if (needRegister) {
+        getContextVk()->addDirtyBuffer(this);
+    }
+}
+
+void BufferVk::collectDirtyRanges(MappedRangeBatchVk &batch)
+{
+    GLockerGuard locker(mDirtyMutex);
+    mDirtyRegistered = false;
+    if (mDirtyRanges.empty()) {
+        return;
     }
+    coalesceDirtyRanges();
+
+    uint64_t bytes = 0;
+    for (const auto &[begin, end] : mDirtyRanges) {
+#ifdef USE_AMD_VULKAN_MEMORY_ALLOCATOR
+        batch.allocations.push_back(mAllocation);
+#else
+        batch.allocations.push_back(&mGVkBuffer.allocation());
 #endif //USE_AMD_VULKAN_MEMORY_ALLOCATOR
+        batch.offsets.push_back(begin);
+        batch.sizes.push_back(end - begin);
+        bytes += end - begin;
+    }
+    mDirtyRanges.clear();
+    mContextT->counters().uploadBytes += bytes;
+}
+
+void BufferVk::coalesceDirtyRanges()
+{
+    if (mDirtyRanges.size() < 2) {
+        return;
+    }
+    std::sort(mDirtyRanges.begin(), mDirtyRanges.end());
+
+    size_t count = 0;
+    for (size_t i = 1; i < mDirtyRanges.size(); i++) {
+        auto &last = mDirtyRanges[count];
+        const auto &range = mDirtyRanges[i];
+        if (range.first <= last.second) {
+            last.second = std::max(last.second, range.second);
+        } else {
+            mDirtyRanges[++count] = range;
+        }
+    }
+    mDirtyRanges.resize(count + 1);
 }
 
 void BufferVk::unmap()
+{
+    // 持久映射的Buffer在销毁时才解除映射
+    if ((mMapFlags & BufferMapFlag::Persistent) == BufferMapFlag::Persistent) {
+        return;
+    }
+    unmapMemory();
+}
+
+void BufferVk::unmapMemory()
 {
 #ifdef USE_AMD_VULKAN_MEMORY_ALLOCATOR
     if (mBuffer == VK_NULL_HANDLE || mAllocation == nullptr) {
@@ -2806,6 +3633,10 @@ bool BufferVk::initByVMA(const CreateBufferInfo &createInfo)
         vkBufferUsage |= VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
         vkBufferUsage |= VK_BUFFER_USAGE_TRANSFER_DST_BIT;
     }
+    // 捕获时需要回读所有Buffer的内容
+    if (contextVk->isCaptureEnabled()) {
+        vkBufferUsage |= VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    }
 
     switch (createInfo.memoryUsage) {
         default:
@@ -2833,8 +3664,22 @@ bool BufferVk::initByVMA(const CreateBufferInfo &createInfo)
     VmaAllocationCreateInfo allocCreateInfo = {};
     allocCreateInfo.usage = memoryUsage;
 
-    return vmaCreateBuffer(contextVk->getVmaAllocator(), &bufferInfo, &allocCreateInfo,
-                           &mBuffer, &mAllocation, &mAllocInfo) == VK_SUCCESS;
+    if (vmaCreateBuffer(contextVk->getVmaAllocator(), &bufferInfo, &allocCreateInfo,
+                        &mBuffer, &mAllocation, &mAllocInfo) != VK_SUCCESS) {
+        return false;
+    }
+
+    VkMemoryPropertyFlags memFlags;
+    vmaGetMemoryTypeProperties(contextVk->getVmaAllocator(), mAllocInfo.memoryType, &memFlags);
+    mNonCoherent = (memFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0
+                   && (memFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) == 0;
+
+    mMemoryRecord.category = MemoryCategory::ofBuffer(mType, mMemoryUsage);
+    mMemoryRecord.memoryType = mAllocInfo.memoryType;
+    mMemoryRecord.size = mAllocInfo.size;
+    contextVk->trackMemory(mMemoryRecord);
+
+    return true;
 }
 
 #else
@@ -2883,6 +3728,10 @@ bool BufferVk::initByGVkBuffer(const CreateBufferInfo &createInfo)
         vkBufferUsage |= VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
         vkBufferUsage |= VK_BUFFER_USAGE_TRANSFER_DST_BIT;
     }
+    // 捕获时需要回读所有Buffer的内容
+    if (contextVk->isCaptureEnabled()) {
+        vkBufferUsage |= VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    }
 
     switch (createInfo.memoryUsage) {
         default:
@@ -2903,14 +3752,34 @@ bool BufferVk::initByGVkBuffer(const CreateBufferInfo &createInfo)
             break;
     }
 
+    // Staging Buffer通常只在一次上传中使用，从线性内存块中分配
+    auto strategy = (mType & BufferType::Staging) == BufferType::Staging ? GVkMemoryAllocator::Linear
+                                                                         : GVkMemoryAllocator::General;
     mGVkBuffer.create(
             contextVk->vkContext()->gvkDevice(),
             vkBufferUsage,
             vkMemoryProperty,
             VK_SHARING_MODE_EXCLUSIVE,
-            createInfo.size);
+            createInfo.size,
+            nullptr,
+            contextVk->memoryAllocator(),
+            strategy);
+
+    if (!mGVkBuffer.isCreated()) {
+        return false;
+    }
+
+    VkMemoryPropertyFlags memFlags = contextVk->vkContext()->gvkDevice()->deviceMemoryProperties()
+            .memoryTypes[mGVkBuffer.memoryTypeIndex()].propertyFlags;
+    mNonCoherent = (memFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0
+                   && (memFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) == 0;
 
-    return mGVkBuffer.isCreated();
+    mMemoryRecord.category = MemoryCategory::ofBuffer(mType, mMemoryUsage);
+    mMemoryRecord.memoryType = mGVkBuffer.memoryTypeIndex();
+    mMemoryRecord.size = mGVkBuffer.memorySize();
+    contextVk->trackMemory(mMemoryRecord);
+
+    return true;
 }
 
 #endif //USE_AMD_VULKAN_MEMORY_ALLOCATOR
@@ -2926,18 +3795,22 @@ bool TextureVk::init(Context_T *context, const CreateTextureInfo &createInfo,
 
     mHash = hashFunc(createInfo);
     mHash = hashOf(mHash, idx());
+    mSample = sample;
 
     return initVkTexture(createInfo, sample, image);
 }
 
 void TextureVk::destroy()
 {
+    releaseRetiredResources(true);
+
     auto vkDevice = getGVkContext(mContextT)->vkDevice();
     for (auto &[k, v] : mImageViewCache) {
         vkDestroyImageView(vkDevice, v, nullptr);
     }
     mImageViewCache.clear();
     if (!mIsFromImage) {
+        dynamic_cast<ContextVk *>(mContextT->contextP())->untrackMemory(mMemoryRecord);
         mVkImage->destroy();
         GX_DELETE(mVkImage);
     }
@@ -3006,9 +3879,215 @@ uint64_t TextureVk::size()
 
 void TextureVk::setData(const void *data, uint64_t size, Fence fence)
 {
-    if (!data) {
+    setMipData(0, 0, 1, data, size, fence);
+}
+
+void TextureVk::setMipData(uint32_t mipLevel, uint32_t baseLayer, uint32_t layerCount,
+                           const void *data, uint64_t size, Fence fence)
+{
+    TextureUpdateRegion region{};
+    region.mipLevel = mipLevel;
+    region.baseArrayLayer = baseLayer;
+    region.layerCount = layerCount;
+    region.width = std::max(1u, mWidth >> mipLevel);
+    region.height = std::max(1u, mHeight >> mipLevel);
+    region.depth = std::max(1u, mDepth >> mipLevel);
+
+    updateRegions(data, size, {region}, fence);
+}
+
+/**
+ * 压缩格式按块存储，formatSize为每块的字节数，获取块的像素宽高，非压缩格式为1x1
+ */
+static inline void getFormatBlockExtent(Format::Enum format, uint32_t &width, uint32_t &height)
+{
+    switch (format) {
+        case Format::BC1_RGB_UNorm:
+        case Format::BC1_RGB_SRgb:
+        case Format::BC1_RGBA_UNorm:
+        case Format::BC1_RGBA_SRgb:
+        case Format::BC2_UNorm:
+        case Format::BC2_SRgb:
+        case Format::BC3_UNorm:
+        case Format::BC3_SRgb:
+        case Format::BC4_UNorm:
+        case Format::BC4_SNorm:
+        case Format::BC5_UNorm:
+        case Format::BC5_SNorm:
+        case Format::BC6H_UFloat:
+        case Format::BC6H_SFloat:
+        case Format::BC7_UNorm:
+        case Format::BC7_SRgb:
+        case Format::ETC2_R8G8B8_UNorm:
+        case Format::ETC2_R8G8B8_SRgb:
+        case Format::ETC2_R8G8B8A1_UNorm:
+        case Format::ETC2_R8G8B8A1_SRgb:
+        case Format::ETC2_R8G8B8A8_UNorm:
+        case Format::ETC2_R8G8B8A8_SRgb:
+        case Format::EAC_R11_UNorm:
+        case Format::EAC_R11_SNorm:
+        case Format::EAC_R11G11_UNorm:
+        case Format::EAC_R11G11_SNorm:
+            width = 4;
+            height = 4;
+            break;
+        case Format::ASTC_4x4_UNorm:
+        case Format::ASTC_4x4_SRgb:
+            width = 4;
+            height = 4;
+            break;
+        case Format::ASTC_5x4_UNorm:
+        case Format::ASTC_5x4_SRgb:
+            width = 5;
+            height = 4;
+            break;
+        case Format::ASTC_5x5_UNorm:
+        case Format::ASTC_5x5_SRgb:
+            width = 5;
+            height = 5;
+            break;
+        case Format::ASTC_6x5_UNorm:
+        case Format::ASTC_6x5_SRgb:
+            width = 6;
+            height = 5;
+            break;
+        case Format::ASTC_6x6_UNorm:
+        case Format::ASTC_6x6_SRgb:
+            width = 6;
+            height = 6;
+            break;
+        case Format::ASTC_8x5_UNorm:
+        case Format::ASTC_8x5_SRgb:
+            width = 8;
+            height = 5;
+            break;
+        case Format::ASTC_8x6_UNorm:
+        case Format::ASTC_8x6_SRgb:
+            width = 8;
+            height = 6;
+            break;
+        case Format::ASTC_8x8_UNorm:
+        case Format::ASTC_8x8_SRgb:
+            width = 8;
+            height = 8;
+            break;
+        case Format::ASTC_10x5_UNorm:
+        case Format::ASTC_10x5_SRgb:
+            width = 10;
+            height = 5;
+            break;
+        case Format::ASTC_10x6_UNorm:
+        case Format::ASTC_10x6_SRgb:
+            width = 10;
+            height = 6;
+            break;
+        case Format::ASTC_10x8_UNorm:
+        case Format::ASTC_10x8_SRgb:
+            width = 10;
+            height = 8;
+            break;
+        case Format::ASTC_10x10_UNorm:
+        case Format::ASTC_10x10_SRgb:
+            width = 10;
+            height = 10;
+            break;
+        case Format::ASTC_12x10_UNorm:
+        case Format::ASTC_12x10_SRgb:
+            width = 12;
+            height = 10;
+            break;
+        case Format::ASTC_12x12_UNorm:
+        case Format::ASTC_12x12_SRgb:
+            width = 12;
+            height = 12;
+            break;
+        default:
+            width = 1;
+            height = 1;
+            break;
+    }
+}
+
+void TextureVk::updateRegions(const void *data, uint64_t size,
+                              const std::vector<TextureUpdateRegion> &regions, Fence fence)
+{
+    if (!data || regions.empty()) {
+        return;
+    }
+
+    std::vector<BufferImageCopyInfo> copyInfos;
+    copyInfos.reserve(regions.size());
+    // 每个mip等级只转换一次布局，覆盖所有区域涉及的层
+    std::vector<ImageSubResourceRange> barrierRanges;
+
+    for (const auto &region : regions) {
+        if (region.mipLevel < mResidentBaseMip || region.mipLevel >= mMipLevels) {
+            Log("TextureVk::updateRegions mip level %u is not resident", region.mipLevel);
+            continue;
+        }
+        uint32_t layerCount = region.layerCount == 0 ? 1 : region.layerCount;
+        uint32_t depth = region.depth == 0 ? 1 : region.depth;
+        GX_ASSERT_S(region.baseArrayLayer + layerCount <= mLayerCount, "Layer range out of bounds");
+        GX_ASSERT_S(region.offsetX >= 0 && region.offsetY >= 0 && region.offsetZ >= 0
+                    && (uint32_t) region.offsetX + region.width <= std::max(1u, mWidth >> region.mipLevel)
+                    && (uint32_t) region.offsetY + region.height <= std::max(1u, mHeight >> region.mipLevel)
+                    && (uint32_t) region.offsetZ + depth <= std::max(1u, mDepth >> region.mipLevel),
+                    "Region out of bounds");
+
+        // 按源数据的行、层排列计算区域最后一个块的结束位置，超出数据大小时跳过该区域
+        uint32_t blockWidth;
+        uint32_t blockHeight;
+        getFormatBlockExtent(mFormat, blockWidth, blockHeight);
+        uint64_t rowBlocks = ((region.rowLength == 0 ? region.width : region.rowLength) + blockWidth - 1) / blockWidth;
+        uint64_t imageRows = ((region.imageHeight == 0 ? region.height : region.imageHeight) + blockHeight - 1)
+                             / blockHeight;
+        uint64_t widthBlocks = (region.width + blockWidth - 1) / blockWidth;
+        uint64_t heightBlocks = (region.height + blockHeight - 1) / blockHeight;
+        uint64_t dataBytes = 0;
+        if (widthBlocks > 0 && heightBlocks > 0) {
+            dataBytes = (((uint64_t) depth * layerCount - 1) * imageRows * rowBlocks
+                         + (heightBlocks - 1) * rowBlocks + widthBlocks) * mContextT->formatSize(mFormat);
+        }
+        if (region.dataOffset >= size || dataBytes > size - region.dataOffset) {
+            Log("TextureVk::updateRegions region data out of bounds, offset %llu, bytes %llu, size %llu",
+                (unsigned long long) region.dataOffset, (unsigned long long) dataBytes, (unsigned long long) size);
+            continue;
+        }
+
+        BufferImageCopyInfo copyInfo{};
+        copyInfo.bufferOffset = region.dataOffset;
+        copyInfo.bufferRowLength = region.rowLength;
+        copyInfo.bufferImageHeight = region.imageHeight;
+        copyInfo.mipLevel = region.mipLevel;
+        copyInfo.baseArrayLayer = region.baseArrayLayer;
+        copyInfo.layerCount = layerCount;
+        copyInfo.imageOffsetX = region.offsetX;
+        copyInfo.imageOffsetY = region.offsetY;
+        copyInfo.imageOffsetZ = region.offsetZ;
+        copyInfo.imageWidth = region.width;
+        copyInfo.imageHeight = region.height;
+        copyInfo.imageDepth = depth;
+        copyInfos.push_back(copyInfo);
+
+        auto it = std::find_if(barrierRanges.begin(), barrierRanges.end(),
+                               [&](const ImageSubResourceRange &range) {
+                                   return range.baseMipLevel == region.mipLevel;
+                               });
+        if (it == barrierRanges.end()) {
+            barrierRanges.push_back({region.mipLevel, region.baseArrayLayer, 1, layerCount});
+        } else {
+            uint32_t endLayer = std::max(it->baseArrayLayer + it->layerCount, region.baseArrayLayer + layerCount);
+            it->baseArrayLayer = std::min(it->baseArrayLayer, region.baseArrayLayer);
+            it->layerCount = endLayer - it->baseArrayLayer;
+        }
+    }
+
+    if (copyInfos.empty()) {
         return;
     }
+
+    releaseRetiredResources(false);
+
     Buffer stagingBuffer = mContextT->createBuffer(
             {BufferType::Staging, BufferMemoryUsage::CpuOnly, size});
 
@@ -3020,29 +4099,182 @@ void TextureVk::setData(const void *data, uint64_t size, Fence fence)
 
     ImageLayout::Enum dstLayout = getImageLayoutFromUsage(mUsage, mAspect, false);
 
-    BufferImageCopyInfo copyInfo{};
-    copyInfo.imageWidth = mWidth;
-    copyInfo.imageHeight = mHeight;
-    copyInfo.imageDepth = mDepth;
-    copyInfo.imageOffsetX = 0;
-    copyInfo.imageOffsetY = 0;
-    copyInfo.layerCount = 1;
-    copyInfo.mipLevel = 0;
-
-    cmdBuffer->begin()
-            ->imageMemoryBarrier(this, ImageLayout::Undefined, ImageLayout::TransferDst, {0, 0, 1, 1})
-            ->copyBufferToImage(stagingBuffer, this, {copyInfo})
-            ->imageMemoryBarrier(this, ImageLayout::TransferDst, dstLayout, {0, 0, 1, 1})
-            ->end();
+    cmdBuffer->begin();
+    initImageLayout(cmdBuffer);
+    // 从当前布局而不是Undefined转换，区域之外的内容得以保留
+    for (const auto &range : barrierRanges) {
+        cmdBuffer->imageMemoryBarrier(this, dstLayout, ImageLayout::TransferDst, range);
+    }
+    cmdBuffer->copyBufferToImage(stagingBuffer, this, copyInfos);
+    for (const auto &range : barrierRanges) {
+        cmdBuffer->imageMemoryBarrier(this, ImageLayout::TransferDst, dstLayout, range);
+    }
+    cmdBuffer->end();
 
     if (fence == GFX_NULL_HANDLE) {
         mContextT->submitCommandBlock(cmdBuffer, 0);
+        mContextT->destroyBuffer(stagingBuffer);
+        mContextT->destroyCommandBuffer(cmdBuffer);
     } else {
+        // 异步上传，暂存缓冲和指令缓冲在GPU执行完成后释放
         mContextT->submitCommand(cmdBuffer, 0, fence);
+        mContextT->destroyBuffer(stagingBuffer, true);
+        retireCommandBuffer(cmdBuffer);
+    }
+}
+
+uint32_t TextureVk::residentBaseMip()
+{
+    return mResidentBaseMip;
+}
+
+uint64_t TextureVk::residentSize(uint32_t baseMip)
+{
+    if (baseMip >= mMipLevels) {
+        return 0;
+    }
+    if (baseMip == mResidentBaseMip) {
+        return mVkImage->size();
+    }
+    // 按未压缩的紧密排列估算
+    uint64_t texelCount = 0;
+    for (uint32_t i = baseMip; i < mMipLevels; i++) {
+        texelCount += (uint64_t) std::max(1u, mWidth >> i)
+                      * std::max(1u, mHeight >> i)
+                      * std::max(1u, mDepth >> i);
+    }
+    return texelCount * mLayerCount * (uint32_t) mSample * mContextT->formatSize(mFormat);
+}
+
+bool TextureVk::setResidentBaseMip(uint32_t baseMip, Fence fence)
+{
+    if (!mStreaming) {
+        Log("TextureVk::setResidentBaseMip texture is not created with residentMipLevels");
+        return false;
+    }
+    if (baseMip >= mMipLevels) {
+        Log("TextureVk::setResidentBaseMip baseMip(%u) out of range", baseMip);
+        return false;
+    }
+    if (baseMip == mResidentBaseMip) {
+        return true;
+    }
+
+    releaseRetiredResources(false);
+
+    auto *contextVk = dynamic_cast<ContextVk *>(mContextT->contextP());
+
+    // 编译线程可能同时通过图像视图缓存读取图像和驻留范围
+    GLockerGuard locker(mImageViewCacheMutex);
+
+    GVkImage *oldImage = mVkImage;
+    MemoryRecord oldMemoryRecord = mMemoryRecord;
+    uint32_t oldBaseMip = mResidentBaseMip;
+
+    if (!createImage(std::max(1u, mWidth >> baseMip),
+                     std::max(1u, mHeight >> baseMip),
+                     std::max(1u, mDepth >> baseMip),
+                     mMipLevels - baseMip, mLayerCount, mVkImageType,
+                     toVkFormat(mFormat), toVkSampleCount(mSample),
+                     VK_IMAGE_TILING_OPTIMAL, mVkImageUsage, mVkImageAspect,
+                     VK_SHARING_MODE_EXCLUSIVE, mVkImageLayout, mType == TextureType::TextureCube)) {
+        Log("TextureVk::setResidentBaseMip create image failure");
+        GX_DELETE(mVkImage);
+        mVkImage = oldImage;
+        mMemoryRecord = oldMemoryRecord;
+        return false;
     }
 
-    mContextT->destroyBuffer(stagingBuffer);
-    mContextT->destroyCommandBuffer(cmdBuffer);
+    // 拷贝新旧驻留范围共有的mip
+    uint32_t copyBaseMip = std::max(baseMip, oldBaseMip);
+    uint32_t copyLevelCount = mMipLevels - copyBaseMip;
+    VkImageLayout usageLayout = toVkImageLayout(getUsageImageLayout(mUsage, mAspect));
+
+    VkImageSubresourceRange srcRange{};
+    srcRange.aspectMask = oldImage->aspectMask();
+    srcRange.baseMipLevel = copyBaseMip - oldBaseMip;
+    srcRange.levelCount = copyLevelCount;
+    srcRange.baseArrayLayer = 0;
+    srcRange.layerCount = mLayerCount;
+
+    VkImageSubresourceRange dstRange{};
+    dstRange.aspectMask = mVkImage->aspectMask();
+    dstRange.baseMipLevel = 0;
+    dstRange.levelCount = mMipLevels - baseMip;
+    dstRange.baseArrayLayer = 0;
+    dstRange.layerCount = mLayerCount;
+
+    std::vector<VkImageCopy> regions(copyLevelCount);
+    for (uint32_t i = 0; i < copyLevelCount; i++) {
+        uint32_t mipLevel = copyBaseMip + i;
+        auto &region = regions[i];
+        region.srcSubresource.aspectMask = oldImage->aspectMask();
+        region.srcSubresource.mipLevel = mipLevel - oldBaseMip;
+        region.srcSubresource.baseArrayLayer = 0;
+        region.srcSubresource.layerCount = mLayerCount;
+        region.dstSubresource.aspectMask = mVkImage->aspectMask();
+        region.dstSubresource.mipLevel = mipLevel - baseMip;
+        region.dstSubresource.baseArrayLayer = 0;
+        region.dstSubresource.layerCount = mLayerCount;
+        region.srcOffset = {0, 0, 0};
+        region.dstOffset = {0, 0, 0};
+        region.extent.width = std::max(1u, mWidth >> mipLevel);
+        region.extent.height = std::max(1u, mHeight >> mipLevel);
+        region.extent.depth = std::max(1u, mDepth >> mipLevel);
+    }
+
+    auto *cmdPool = GX_NEW(GVkCommandPool);
+    cmdPool->create(contextVk->vkContext()->graphicsQueue());
+    VkCommandBuffer vkCmdBuffer = cmdPool->allocateCommandBuffer();
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    VK_CHECK_RESULT(vkBeginCommandBuffer(vkCmdBuffer, &beginInfo));
+
+    oldImage->imageMemoryBarrier(vkCmdBuffer, mLayoutInitialized ? usageLayout : VK_IMAGE_LAYOUT_UNDEFINED,
+                                 VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, srcRange, false);
+    mVkImage->imageMemoryBarrier(vkCmdBuffer, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                 dstRange, false);
+    vkCmdCopyImage(vkCmdBuffer,
+                   *oldImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                   *mVkImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                   (uint32_t) regions.size(), regions.data());
+    mVkImage->imageMemoryBarrier(vkCmdBuffer, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, usageLayout, dstRange, false);
+
+    VK_CHECK_RESULT(vkEndCommandBuffer(vkCmdBuffer));
+
+    contextVk->nextSubmitSerial();
+    if (fence == GFX_NULL_HANDLE) {
+        GVkFence vkFence;
+        vkFence.create(cmdPool->queue()->device(), VK_FLAGS_NONE);
+        cmdPool->queue()->submit({}, {vkCmdBuffer}, {}, vkFence);
+        vkFence.wait();
+        vkFence.destroy();
+    } else {
+        cmdPool->queue()->submit({}, {vkCmdBuffer}, {}, dynamic_cast<FenceVk *>(fence)->vkFence()->vkFence());
+    }
+
+    // 旧图像和图像视图可能仍被此前提交的指令引用，延迟到这些指令执行完成后释放
+    RetiredResource retired{};
+    retired.image = oldImage;
+    retired.memoryRecord = oldMemoryRecord;
+    retired.cmdPool = cmdPool;
+    retired.serial = contextVk->submitSerial();
+    for (auto &[k, v] : mImageViewCache) {
+        retired.views.push_back(v);
+    }
+    mImageViewCache.clear();
+    mRetiredResources.push_back(std::move(retired));
+
+    mResidentBaseMip = baseMip;
+    mResidencyVersion++;
+    // 已编译的指令缓冲引用了旧图像，提交前需要重新录制
+    contextVk->onResidencyChanged();
+    // 新图像已整体转换到用途对应的布局
+    mLayoutInitialized = true;
+
+    return true;
 }
 
 void TextureVk::genMipmap(Fence fence)
@@ -3051,17 +4283,24 @@ void TextureVk::genMipmap(Fence fence)
         return;
     }
 
+    releaseRetiredResources(false);
+
     CommandBuffer cmdBuffer = mContextT->createCommandBuffer({QueueType::Graphics, 1});
     cmdBuffer->begin();
 
-    cmdBuffer->imageMemoryBarrier(this, ImageLayout::Undefined, ImageLayout::TransferSrc, {0, 0, 1, 1});
+    initImageLayout(cmdBuffer);
+
+    // 流式纹理从驻留的最高精度mip开始生成，其内容已经上传，各层从使用时的布局转换，不能丢弃
+    uint32_t baseMip = mResidentBaseMip;
+    ImageLayout::Enum dstLayout = getImageLayoutFromUsage(mUsage, mAspect, false);
+    cmdBuffer->imageMemoryBarrier(this, dstLayout, ImageLayout::TransferSrc, {baseMip, 0, 1, mLayerCount});
 
     uint32_t infoIndex = 0;
     for (uint32_t i = 0; i < mLayerCount; i++) {
-        int32_t mipWidth = (int32_t)mWidth;
-        int32_t mipHeight = (int32_t)mHeight;
-        int32_t mipDepth= (int32_t)mDepth;
-        for (uint32_t x = 1; x < mMipLevels; x++) {
+        int32_t mipWidth = (int32_t) std::max(1u, mWidth >> baseMip);
+        int32_t mipHeight = (int32_t) std::max(1u, mHeight >> baseMip);
+        int32_t mipDepth = (int32_t) std::max(1u, mDepth >> baseMip);
+        for (uint32_t x = baseMip + 1; x < mMipLevels; x++) {
             ImageBlitInfo blitInfo {};
             blitInfo.srcWidth = mipWidth;
             blitInfo.srcHeight = mipHeight;
@@ -3092,18 +4331,17 @@ void TextureVk::genMipmap(Fence fence)
         }
     }
 
-    ImageLayout::Enum dstLayout = getImageLayoutFromUsage(mUsage, mAspect, false);
     // dst -> layout
-    cmdBuffer->imageMemoryBarrier(this, ImageLayout::TransferSrc, dstLayout, {0, 0});
+    cmdBuffer->imageMemoryBarrier(this, ImageLayout::TransferSrc, dstLayout, {baseMip, 0});
 
     cmdBuffer->end();
     if (fence == GFX_NULL_HANDLE) {
         mContextT->submitCommandBlock(cmdBuffer, 0);
+        mContextT->destroyCommandBuffer(cmdBuffer);
     } else {
         mContextT->submitCommand(cmdBuffer, 0, fence);
+        retireCommandBuffer(cmdBuffer);
     }
-
-    mContextT->destroyCommandBuffer(cmdBuffer);
 }
 
 GVkContext *TextureVk::vkContext()
@@ -3118,6 +4356,22 @@ GVkImage *TextureVk::vkImage()
     return mVkImage;
 }
 
+uint32_t TextureVk::residentMipLevel(uint32_t mipLevel) const
+{
+    GX_ASSERT_S(mipLevel >= mResidentBaseMip, "Mip level %u is not resident", mipLevel);
+    return mipLevel - mResidentBaseMip;
+}
+
+bool TextureVk::isStreaming() const
+{
+    return mStreaming;
+}
+
+uint32_t TextureVk::residencyVersion() const
+{
+    return mResidencyVersion;
+}
+
 VkImageView TextureVk::createImageView(const TextureBindRange &range, bool isAttachment)
 {
     CreateImageViewInfo createInfo {
@@ -3145,6 +4399,15 @@ VkImageView TextureVk::createImageView(const TextureBindRange &range, bool isAtt
         createInfo.range.layerCount = mLayerCount;
     }
 
+    // 视图只暴露已驻留的mip，更高精度的mip被截断到驻留的最高精度mip
+    if (mResidentBaseMip > 0) {
+        uint32_t endMip = std::min(mMipLevels, createInfo.range.baseMipLevel + createInfo.range.levelCount);
+        uint32_t baseMip = std::min(std::max(createInfo.range.baseMipLevel, mResidentBaseMip), mMipLevels - 1);
+        createInfo.range.baseMipLevel = baseMip - mResidentBaseMip;
+        createInfo.range.levelCount = std::max(endMip, baseMip + 1) - baseMip;
+    }
+
+    GLockerGuard locker(mImageViewCacheMutex);
     auto it = mImageViewCache.find(createInfo);
     if (it != mImageViewCache.end()) {
         return it->second;
@@ -3234,13 +4497,9 @@ void TextureVk::imageMemoryBarrier(VkCommandBuffer cmdBuffer,
                                    const ImageSubResourceRange &subResRange)
 {
     VkImageSubresourceRange vkSubResRange{};
-    vkSubResRange.aspectMask = mVkImage->aspectMask();
-    vkSubResRange.baseMipLevel = subResRange.baseMipLevel;
-    vkSubResRange.levelCount = subResRange.levelCount == 0
-                               ? (mMipLevels - subResRange.baseMipLevel) : subResRange.levelCount;
-    vkSubResRange.baseArrayLayer = subResRange.baseArrayLayer;
-    vkSubResRange.layerCount = subResRange.layerCount == 0
-                               ? (mLayerCount - subResRange.baseArrayLayer) : subResRange.layerCount;
+    if (!toResidentRange(subResRange, vkSubResRange)) {
+        return;
+    }
 
     mVkImage->imageMemoryBarrier(
             cmdBuffer,
@@ -3250,6 +4509,28 @@ void TextureVk::imageMemoryBarrier(VkCommandBuffer cmdBuffer,
             (srcLayout == ImageLayout::ComputeGeneral || dstLayout == ImageLayout::ComputeGeneral));
 }
 
+bool TextureVk::getImageMemoryBarrier(ImageLayout::Enum srcLayout,
+                                      ImageLayout::Enum dstLayout,
+                                      const ImageSubResourceRange &subResRange,
+                                      VkImageMemoryBarrier &imageBarrier,
+                                      VkPipelineStageFlags &srcStage,
+                                      VkPipelineStageFlags &dstStage)
+{
+    VkImageSubresourceRange vkSubResRange{};
+    if (!toResidentRange(subResRange, vkSubResRange)) {
+        return false;
+    }
+
+    mVkImage->getImageMemoryBarrier(
+            toVkImageLayout(srcLayout),
+            toVkImageLayout(dstLayout),
+            vkSubResRange,
+            (srcLayout == ImageLayout::ComputeGeneral || dstLayout == ImageLayout::ComputeGeneral),
+            imageBarrier, srcStage, dstStage);
+    mVkImage->setLayout(imageBarrier.newLayout);
+    return true;
+}
+
 ImageLayout::Enum TextureVk::getUsageImageLayout(TextureUsageFlags usage, TextureAspectFlags aspect)
 {
     if ((usage & TextureUsage::Attachment) == TextureUsage::Attachment) {
@@ -3266,26 +4547,99 @@ ImageLayout::Enum TextureVk::getUsageImageLayout(TextureUsageFlags usage, Textur
     }
 }
 
-bool TextureVk::initVkTexture(const CreateTextureInfo &createInfo,
-                              SampleCountFlag::Enum sample,
-                              GVkImage *image)
+bool TextureVk::toResidentRange(const ImageSubResourceRange &subResRange,
+                                VkImageSubresourceRange &vkSubResRange) const
 {
-    if (createInfo.mipLevels < 1) {
-        GX_ASSERT_S(false, "mipLevels must be >= 1");
-        return false;
-    }
-    if (createInfo.arrayLayers < 1) {
-        GX_ASSERT_S(false, "arrayLayers must be >= 1");
+    uint32_t endMip = subResRange.levelCount == 0
+                      ? mMipLevels : std::min(mMipLevels, subResRange.baseMipLevel + subResRange.levelCount);
+    uint32_t baseMip = std::max(subResRange.baseMipLevel, mResidentBaseMip);
+    if (baseMip >= endMip) {
         return false;
     }
 
-    bool isCube = createInfo.type == TextureType::TextureCube;
-
-    VkImageType vkImageType = VK_IMAGE_TYPE_2D;
-    VkImageUsageFlags vkImageUsage = 0;
-    VkImageLayout vkImageLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    vkSubResRange.aspectMask = mVkImage->aspectMask();
+    vkSubResRange.baseMipLevel = baseMip - mResidentBaseMip;
+    vkSubResRange.levelCount = endMip - baseMip;
+    vkSubResRange.baseArrayLayer = subResRange.baseArrayLayer;
+    vkSubResRange.layerCount = subResRange.layerCount == 0
+                               ? (mLayerCount - subResRange.baseArrayLayer) : subResRange.layerCount;
+    return true;
+}
 
-    mWidth = createInfo.width;
+void TextureVk::initImageLayout(CommandBuffer cmdBuffer)
+{
+    if (mLayoutInitialized) {
+        return;
+    }
+    ImageLayout::Enum dstLayout = getImageLayoutFromUsage(mUsage, mAspect, false);
+    cmdBuffer->imageMemoryBarrier(this, ImageLayout::Undefined, dstLayout, {mResidentBaseMip, 0, 0, 0});
+    mLayoutInitialized = true;
+}
+
+void TextureVk::retireCommandBuffer(CommandBuffer cmdBuffer)
+{
+    auto *contextVk = dynamic_cast<ContextVk *>(mContextT->contextP());
+
+    RetiredResource retired{};
+    retired.cmdBuffer = cmdBuffer;
+    retired.serial = contextVk->submitSerial();
+    mRetiredResources.push_back(std::move(retired));
+}
+
+void TextureVk::releaseRetiredResources(bool force)
+{
+    if (mRetiredResources.empty()) {
+        return;
+    }
+    auto *contextVk = dynamic_cast<ContextVk *>(mContextT->contextP());
+    auto vkDevice = contextVk->vkContext()->vkDevice();
+    uint64_t completedSerial = force ? UINT64_MAX : contextVk->completedSerial();
+
+    auto it = mRetiredResources.begin();
+    while (it != mRetiredResources.end()) {
+        if (it->serial > completedSerial) {
+            ++it;
+            continue;
+        }
+        for (auto view : it->views) {
+            vkDestroyImageView(vkDevice, view, nullptr);
+        }
+        if (it->image) {
+            contextVk->untrackMemory(it->memoryRecord);
+            it->image->destroy();
+            GX_DELETE(it->image);
+        }
+        if (it->cmdPool) {
+            it->cmdPool->destroy();
+            GX_DELETE(it->cmdPool);
+        }
+        if (it->cmdBuffer) {
+            mContextT->destroyCommandBuffer(it->cmdBuffer);
+        }
+        it = mRetiredResources.erase(it);
+    }
+}
+
+bool TextureVk::initVkTexture(const CreateTextureInfo &createInfo,
+                              SampleCountFlag::Enum sample,
+                              GVkImage *image)
+{
+    if (createInfo.mipLevels < 1) {
+        GX_ASSERT_S(false, "mipLevels must be >= 1");
+        return false;
+    }
+    if (createInfo.arrayLayers < 1) {
+        GX_ASSERT_S(false, "arrayLayers must be >= 1");
+        return false;
+    }
+
+    bool isCube = createInfo.type == TextureType::TextureCube;
+
+    VkImageType vkImageType = VK_IMAGE_TYPE_2D;
+    VkImageUsageFlags vkImageUsage = 0;
+    VkImageLayout vkImageLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    mWidth = createInfo.width;
     mHeight = createInfo.height;
     mDepth = createInfo.depth;
     mType = createInfo.type;
@@ -3299,11 +4653,19 @@ bool TextureVk::initVkTexture(const CreateTextureInfo &createInfo,
     if (image != nullptr) {
         mVkImage = image;
         mIsFromImage = true;
+        mLayoutInitialized = true;
         return true;
     }
 
     mIsFromImage = false;
 
+    mStreaming = createInfo.residentMipLevels > 0 && createInfo.residentMipLevels < createInfo.mipLevels;
+    if (mStreaming) {
+        GX_ASSERT_S((createInfo.usage & (TextureUsage::Attachment | TextureUsage::Transient)) == 0,
+                    "Streaming texture cannot be an attachment");
+        mResidentBaseMip = createInfo.mipLevels - createInfo.residentMipLevels;
+    }
+
     // trans type
     switch (createInfo.type) {
         case TextureType::Texture1D:
@@ -3346,6 +4708,17 @@ bool TextureVk::initVkTexture(const CreateTextureInfo &createInfo,
     if (createInfo.usage & TextureUsage::InputAttachment) {
         vkImageUsage |= VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
     }
+    if (createInfo.usage & TextureUsage::Transient) {
+        GX_ASSERT_S((createInfo.usage & TextureUsage::Attachment) == TextureUsage::Attachment,
+                    "Transient texture must be an attachment");
+        GX_ASSERT_S((createInfo.usage & (TextureUsage::Sampled | TextureUsage::Storage)) == 0,
+                    "Transient texture cannot be sampled or used as storage");
+        // 瞬态附件只允许附件类的用途，GVkImage会为其选择延迟分配的内存
+        vkImageUsage &= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT
+                        | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT
+                        | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+        vkImageUsage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+    }
 
     // trans layout
     if ((createInfo.usage & TextureUsage::Attachment) == TextureUsage::Attachment) {
@@ -3361,33 +4734,36 @@ bool TextureVk::initVkTexture(const CreateTextureInfo &createInfo,
         vkImageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
     }
 
-    bool ok;
+    VkImageAspectFlags vkImageAspect = 0;
     if (createInfo.aspect == TextureAspect::AspectColor) {
-        ok = createImage(createInfo.width, createInfo.height, createInfo.depth,
-                         createInfo.mipLevels, createInfo.arrayLayers, vkImageType,
-                         toVkFormat(createInfo.format), toVkSampleCount(sample),
-                         VK_IMAGE_TILING_OPTIMAL, vkImageUsage, VK_IMAGE_ASPECT_COLOR_BIT,
-                         VK_SHARING_MODE_EXCLUSIVE, vkImageLayout, isCube);
+        vkImageAspect = VK_IMAGE_ASPECT_COLOR_BIT;
     } else if (((createInfo.aspect & TextureAspect::AspectDepth) == TextureAspect::AspectDepth)
                || ((createInfo.aspect & TextureAspect::AspectStencil) == TextureAspect::AspectStencil)) {
-        VkImageAspectFlags vkImageAspect = 0;
         if ((createInfo.aspect & TextureAspect::AspectDepth) == TextureAspect::AspectDepth) {
             vkImageAspect |= VK_IMAGE_ASPECT_DEPTH_BIT;
         }
         if ((createInfo.aspect & TextureAspect::AspectStencil) == TextureAspect::AspectStencil) {
             vkImageAspect |= VK_IMAGE_ASPECT_STENCIL_BIT;
         }
-        ok = createImage(createInfo.width, createInfo.height, createInfo.depth,
-                         createInfo.mipLevels, createInfo.arrayLayers, vkImageType,
-                         toVkFormat(createInfo.format), toVkSampleCount(sample),
-                         VK_IMAGE_TILING_OPTIMAL, vkImageUsage, vkImageAspect,
-                         VK_SHARING_MODE_EXCLUSIVE, vkImageLayout, false);
+        isCube = false;
     } else {
         GX_ASSERT_S(false, "Unsupported aspect type (%x)", createInfo.aspect);
-        ok = false;
+        return false;
     }
 
-    return ok;
+    // 记录图像参数，流式纹理调整驻留范围时按相同参数重新创建
+    mVkImageType = vkImageType;
+    mVkImageUsage = vkImageUsage;
+    mVkImageAspect = vkImageAspect;
+    mVkImageLayout = vkImageLayout;
+
+    return createImage(std::max(1u, createInfo.width >> mResidentBaseMip),
+                       std::max(1u, createInfo.height >> mResidentBaseMip),
+                       std::max(1u, createInfo.depth >> mResidentBaseMip),
+                       createInfo.mipLevels - mResidentBaseMip, createInfo.arrayLayers, vkImageType,
+                       toVkFormat(createInfo.format), toVkSampleCount(sample),
+                       VK_IMAGE_TILING_OPTIMAL, vkImageUsage, vkImageAspect,
+                       VK_SHARING_MODE_EXCLUSIVE, vkImageLayout, isCube);
 }
 
 bool TextureVk::createImage(uint32_t width, uint32_t height, uint32_t depth,
@@ -3408,15 +4784,26 @@ bool TextureVk::createImage(uint32_t width, uint32_t height, uint32_t depth,
         imageFlags = VK_IMAGE_CREATE_CUBE_COMPATIBLE_BIT;
     }
 
-    GVkContext *vkContext = getGVkContext(mContextT);
+    auto *contextVk = dynamic_cast<ContextVk *>(mContextT->contextP());
 
     mVkImage = GX_NEW(GVkImage);
 
-    mVkImage->create(vkContext->gvkDevice(), imageType, format,
+    // 纹理不经过VMA，由ContextVk的内存块分配器子分配
+    mVkImage->create(contextVk->vkContext()->gvkDevice(), imageType, format,
                     width, height, depth, sampleCount, tiling, usage, aspect,
-                    sharingMode, layout, mipLevels, arrayLayers, imageFlags);
+                    sharingMode, layout, mipLevels, arrayLayers, imageFlags,
+                    contextVk->memoryAllocator());
 
-    return mVkImage->isCreated();
+    if (!mVkImage->isCreated()) {
+        return false;
+    }
+
+    mMemoryRecord.category = MemoryCategory::ofTexture(mUsage);
+    mMemoryRecord.memoryType = mVkImage->memoryTypeIndex();
+    mMemoryRecord.size = mVkImage->size();
+    contextVk->trackMemory(mMemoryRecord);
+
+    return true;
 }
 
 /// ============ SamplerVk ============ ///
@@ -3424,6 +4811,7 @@ bool TextureVk::createImage(uint32_t width, uint32_t height, uint32_t depth,
 bool SamplerVk::init(Context_T *context, const CreateSamplerInfo &createInfo)
 {
     mContextT = context;
+    mCreateInfo = createInfo;
 
     mVkSampler.create(getGVkContext(context)->gvkDevice(), false);
 
@@ -3466,12 +4854,27 @@ GVkSampler *SamplerVk::vkSampler()
     return &mVkSampler;
 }
 
+const CreateSamplerInfo &SamplerVk::createInfo() const
+{
+    return mCreateInfo;
+}
+
+uint32_t &SamplerVk::refCount()
+{
+    return mRefCount;
+}
+
 /// ============ ShaderVk ============ ///
 
 bool ShaderVk::init(Context_T *context, const CreateShaderInfo &createInfo)
 {
     mContextT = context;
     mTag = createInfo.tag;
+    mType = createInfo.type;
+    if (dynamic_cast<ContextVk *>(context->contextP())->isCaptureEnabled()) {
+        auto *code = static_cast<const uint8_t *>(createInfo.pCode);
+        mCode.assign(code, code + createInfo.codeSize);
+    }
     return createVkShaderModule(createInfo);
 }
 
@@ -3703,6 +5106,10 @@ void ResourceBinderVk::bindTexture(uint32_t binding, Texture texture, Sampler sa
             pInfo.range = range;
             pInfo.updated = false;
             mAllUpdated = false;
+            auto *textureVk = dynamic_cast<TextureVk *>(texture);
+            if (textureVk && textureVk->isStreaming()) {
+                mHasStreamingTexture = true;
+            }
         }
     }
 }
@@ -3719,7 +5126,7 @@ GVkContext *ResourceBinderVk::vkContext()
     return context->vkContext();
 }
 
-ResourceLayoutInfo ResourceBinderVk::getDescriptorLayoutInfo() const
+const ResourceLayoutInfo &ResourceBinderVk::getDescriptorLayoutInfo() const
 {
     return mDescLayoutInfo;
 }
@@ -3729,11 +5136,36 @@ VkDescriptorSet ResourceBinderVk::getVkDescriptorSet() const
     return mDescSet;
 }
 
+bool ResourceBinderVk::hasStreamingTexture() const
+{
+    return mHasStreamingTexture;
+}
+
 void ResourceBinderVk::bindResources()
 {
+    // 多个指令缓冲可能在不同线程中同时编译并绑定同一个ResourceBinder
+    GLockerGuard locker(mBindMutex);
+
+    if (mHasStreamingTexture) {
+        // 流式纹理调整驻留范围后图像视图已被替换，需要重写描述符
+        for (auto &info : mBindDescInfo) {
+            if (info.index() != 1) {
+                continue;
+            }
+            BindSamplerInfo &pInfo = std::get<BindSamplerInfo>(info);
+            auto *textureVk = dynamic_cast<TextureVk *>(pInfo.texture);
+            if (pInfo.updated && textureVk && textureVk->residencyVersion() != pInfo.residencyVersion) {
+                pInfo.updated = false;
+                mAllUpdated = false;
+            }
+        }
+    }
     if (mAllUpdated) {
         return;
     }
+    ProfilerScope zone(mContextT->profiler(), "ResourceBinderVk::bindResources");
+    mContextT->counters().descriptorSetUpdateCount++;
+
     std::vector<VkWriteDescriptorSet> writeDescriptorSets;
 
     for (uint32_t binding = 0; binding < mBindDescInfo.size(); binding++) {
@@ -3777,6 +5209,7 @@ void ResourceBinderVk::bindResources()
             writeDescSet.dstBinding = binding;
 
             auto *textureVk = dynamic_cast<TextureVk *>(pInfo.texture);
+            pInfo.residencyVersion = textureVk->residencyVersion();
             if (pInfo.type == ResourceType::InputAttachment || pInfo.sampler == nullptr) {
                 VkImageView imageView = textureVk->createImageView(pInfo.range, false);
                 pInfo.writeInfo = textureVk->getDescriptor(imageView, VK_NULL_HANDLE);
@@ -3840,7 +5273,7 @@ bool ResourceBinderVk::initBindInfo()
             case ResourceType::StorageImage:
             case ResourceType::InputAttachment:
                 mBindDescInfo[j] = BindSamplerInfo{
-                        info.descriptorType, GFX_NULL_HANDLE, GFX_NULL_HANDLE, {}, true, {}
+                        info.descriptorType, GFX_NULL_HANDLE, GFX_NULL_HANDLE, {}, true, 0, {}
                 };
                 break;
             case ResourceType::UniformBuffer:
@@ -4225,2004 +5658,909 @@ size_t PipelineVk::hash()
     return mHash;
 }
 
-/// ============ CommandBufferVk ============ ///
-
-bool CommandBufferVk::init(Context_T *context, const CreateCommandBufferInfo &createInfo)
+/// ============ BarrierBatchVk ============ ///
+void BarrierBatchVk::setUseSynchronization2(bool use)
 {
-    mContextT = context;
-    auto *contextP = dynamic_cast<ContextVk *>(context->contextP());
-
-    GVkContext *vkContext = contextP->vkContext();
-
-    switch (createInfo.queueType) {
-        default:
-        case QueueType::Graphics:
-            mVkCommandPool = vkContext->graphicsCmdPool();
-            break;
-        case QueueType::Compute:
-            mVkCommandPool = vkContext->computeCmdPool();
-            break;
-        case QueueType::Transfer:
-            mVkCommandPool = vkContext->transferCmdPool();
-            break;
-    }
-
-    VkCommandBufferAllocateInfo info = {};
-    info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    info.commandPool = *mVkCommandPool;
-    info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    info.commandBufferCount = createInfo.bufferCount;
-
-    mVkCommandBuffers.resize(createInfo.bufferCount);
-    VK_CHECK_RESULT(vkAllocateCommandBuffers(getGVkContext(mContextT)->vkDevice(), &info, mVkCommandBuffers.data()));
-
-    mCommandBuffer.reset(CMD_BUFFER_SIZE);
-
-    return true;
+    mUseSynchronization2 = use;
 }
 
-void CommandBufferVk::destroy()
+void BarrierBatchVk::addExecutionBarrier(VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage)
 {
-    vkFreeCommandBuffers(getGVkContext(mContextT)->vkDevice(), *mVkCommandPool,
-                         static_cast<uint32_t>(mVkCommandBuffers.size()), mVkCommandBuffers.data());
-    mVkCommandBuffers.clear();
-    mVkCommandPool = nullptr;
-    mContextT = GFX_NULL_HANDLE;
+    mExecStages.push_back({srcStage, dstStage});
+    mDstStages |= dstStage;
 }
 
-Context_T *CommandBufferVk::context()
+void BarrierBatchVk::addBufferBarrier(VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage,
+                                      const VkBufferMemoryBarrier &barrier)
 {
-    return mContextT;
+    mBufferStages.push_back({srcStage, dstStage});
+    mBufferBarriers.push_back(barrier);
+    mDstStages |= dstStage;
 }
 
-VkCommandBuffer CommandBufferVk::getVkCommandBuffer(uint32_t index)
+void BarrierBatchVk::addImageBarrier(VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage,
+                                     const VkImageMemoryBarrier &barrier)
 {
-    index = index % mVkCommandBuffers.size();
-    return mVkCommandBuffers[index];
+    mImageStages.push_back({srcStage, dstStage});
+    mImageBarriers.push_back(barrier);
+    mDstStages |= dstStage;
 }
 
-void CommandBufferVk::compile(FrameVk *frame)
+bool BarrierBatchVk::isConflict(VkBuffer buffer) const
 {
-    compileCommand(frame);
+    for (const auto &b : mBufferBarriers) {
+        if (b.buffer == buffer) {
+            return true;
+        }
+    }
+    return false;
 }
 
-bool CommandBufferVk::isCompiled() const
+bool BarrierBatchVk::isConflict(const VkImageMemoryBarrier &barrier) const
 {
-    return mIsCompiled;
+    const auto &range = barrier.subresourceRange;
+    for (const auto &b : mImageBarriers) {
+        if (b.image != barrier.image) {
+            continue;
+        }
+        const auto &r = b.subresourceRange;
+        bool mipOverlap = range.baseMipLevel < r.baseMipLevel + r.levelCount
+                          && r.baseMipLevel < range.baseMipLevel + range.levelCount;
+        bool layerOverlap = range.baseArrayLayer < r.baseArrayLayer + r.layerCount
+                            && r.baseArrayLayer < range.baseArrayLayer + range.layerCount;
+        if (mipOverlap && layerOverlap) {
+            return true;
+        }
+    }
+    return false;
 }
 
-std::string CommandBufferVk::dump()
+bool BarrierBatchVk::isChained(VkPipelineStageFlags srcStage) const
 {
-    if (mCommandBuffer.writePos() == 0) {
-        return "";
+    // 旧接口合并时所有阶段取并集，源阶段包含了前面Barrier的目标阶段，依赖链不会断开
+    if (!mUseSynchronization2 || mDstStages == 0) {
+        return false;
     }
-
-    GX_ASSERT_S(!mIsBegun, "Call end first to finish writing to the command buffer");
-
-    if (mIsBegun) {
-        return "";
+    // ALL_COMMANDS和ALL_GRAPHICS包含其他阶段，按相交处理
+    const VkPipelineStageFlags allStages = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT | VK_PIPELINE_STAGE_ALL_GRAPHICS_BIT;
+    if ((srcStage & allStages) || (mDstStages & allStages)) {
+        return true;
     }
-
-    mCommandBuffer.seekReadPos(SEEK_SET, 0);
-
-    std::ostringstream out;
-
-    uint8_t cmdKey;
-    do {
-        mCommandBuffer.read(cmdKey);
-
-        if (cmdKey >= CommandKey::Count) {
-            out << CommandKeyStr[CommandKey::None] << std::endl;
-        } else {
-            out << CommandKeyStr[cmdKey] << std::endl;
-        }
-
-        switch (cmdKey) {
-            case CommandKey::SetClearColor: {
-                ClearColor cc{};
-                mCommandBuffer.read(cc);
-
-                out << "    {" << "clearColor: {"
-                    << "r: " << cc.r
-                    << ", g: " << cc.g
-                    << ", b: " << cc.b
-                    << ", a: " << cc.a
-                    << "}}" << std::endl;
-            }
-                break;
-            case CommandKey::SetClearDepSte: {
-                float depth;
-                uint32_t stencil;
-                mCommandBuffer.read(depth);
-                mCommandBuffer.read(stencil);
-
-                out << "    {"
-                    << "depth: " << depth
-                    << ", stencil: "
-                    << stencil
-                    << "}" << std::endl;
-            }
-                break;
-            case CommandKey::BindRenderTarget: {
-                GfxIdxTy idx;
-                mCommandBuffer.read(idx);
-
-                out << "    {" << "idx: " << idx << "}" << std::endl;
-            }
-                break;
-            case CommandKey::BeginRenderPass: {
-                Rect2D renderArea{};
-                mCommandBuffer.read(renderArea);
-
-                out << "    {" << "renderArea: {"
-                    << "x: " << renderArea.x << ", "
-                    << "y: " << renderArea.y << ", "
-                    << "width: " << renderArea.width << ", "
-                    << "height: " << renderArea.height << "}"
-                    << "}" << std::endl;
-            }
-                break;
-            case CommandKey::SetGraphPipelineState: {
-                GraphicsPipelineStateInfo stateInfo{};
-                mCommandBuffer.read(stateInfo);
-
-                out << "    {" << "stateInfo: {"
-                    << "rasterStateInfo: {"
-                    << "polygonMode: " << (int) stateInfo.rasterStateInfo.polygonMode
-                    << ", primitive: " << (int) stateInfo.rasterStateInfo.primitive
-                    << ", cullMode: " << (int) stateInfo.rasterStateInfo.cullMode
-                    << ", frontFace: " << (int) stateInfo.rasterStateInfo.frontFace
-                    << ", colorBlendOp: " << (int) stateInfo.rasterStateInfo.colorBlendOp
-                    << ", primitiveRestartEnable: " << (int) stateInfo.rasterStateInfo.primitiveRestartEnable
-                    << ", alphaBlendOp: " << (int) stateInfo.rasterStateInfo.alphaBlendOp
-                    << ", logicOp: " << (int) stateInfo.rasterStateInfo.logicOp
-                    << ", srcColorBlendFactor: " << (int) stateInfo.rasterStateInfo.srcColorBlendFactor
-                    << ", srcAlphaBlendFactor: " << (int) stateInfo.rasterStateInfo.srcAlphaBlendFactor
-                    << ", dstColorBlendFactor: " << (int) stateInfo.rasterStateInfo.dstColorBlendFactor
-                    << ", dstAlphaBlendFactor: " << (int) stateInfo.rasterStateInfo.dstAlphaBlendFactor
-                    << ", colorWriteMask: " << (int) stateInfo.rasterStateInfo.colorWriteMask
-                    << ", logicOpEnable: " << (int) stateInfo.rasterStateInfo.logicOpEnable
-                    << ", depthTestEnable: " << (int) stateInfo.rasterStateInfo.depthTestEnable
-                    << ", depthWriteEnable: " << (int) stateInfo.rasterStateInfo.depthWriteEnable
-                    << ", stencilTestEnable: " << (int) stateInfo.rasterStateInfo.stencilTestEnable
-                    << ", depthCompareOp: " << (int) stateInfo.rasterStateInfo.depthCompareOp
-                    << ", sampleShadingEnable: " << (int) stateInfo.rasterStateInfo.sampleShadingEnable
-                    << ", conservativeEnable: " << (int) stateInfo.rasterStateInfo.conservativeEnable
-                    << ", alphaToCoverageEnable: " << (int) stateInfo.rasterStateInfo.alphaToCoverageEnable
-                    << ", alphaToOneEnable: " << (int) stateInfo.rasterStateInfo.alphaToOneEnable
-                    << "},"
-                    << "paramValueInfo: {"
-                    << "depthBiasConstantFactor: " << stateInfo.paramValueInfo.depthBiasConstantFactor
-                    << ", depthBiasClamp: " << stateInfo.paramValueInfo.depthBiasClamp
-                    << ", depthBiasSlopeFactor: " << stateInfo.paramValueInfo.depthBiasSlopeFactor
-                    << ", frontStencilOp: {failOp: " << (int) stateInfo.paramValueInfo.frontStencilOp.failOp
-                    << ", passOp: " << (int) stateInfo.paramValueInfo.frontStencilOp.passOp
-                    << ", depthFailOp: " << (int) stateInfo.paramValueInfo.frontStencilOp.depthFailOp
-                    << ", compareOp: " << (int) stateInfo.paramValueInfo.frontStencilOp.compareOp
-                    << "}"
-                    << ", backStencilOp: {failOp: " << (int) stateInfo.paramValueInfo.backStencilOp.failOp
-                    << ", passOp: " << (int) stateInfo.paramValueInfo.backStencilOp.passOp
-                    << ", depthFailOp: " << (int) stateInfo.paramValueInfo.backStencilOp.depthFailOp
-                    << ", compareOp: " << (int) stateInfo.paramValueInfo.backStencilOp.compareOp
-                    << "}"
-                    << ", tessellationPatchControlPoints: " << stateInfo.paramValueInfo.tessellationPatchControlPoints
-                    << "}"
-                    << "}"
-                    << "}" << std::endl;
-            }
-                break;
-            case CommandKey::SetVertexLayout: {
-                VertexLayout vertexLayout{};
-                mCommandBuffer.read(vertexLayout);
-
-                out << "    {";
-                out << "vertexInputBindingInfos: [";
-                int iindex = 0;
-                for (auto &info : vertexLayout.vertexInputBindingInfos) {
-                    if (info.stride > 0) {
-                        if (iindex > 0) {
-                            out << ", ";
-                        }
-                        iindex++;
-                        out << "{"
-                            << "binding: " << (int) info.binding
-                            << ", inputRate: " << (int) info.inputRate
-                            << ", stride: " << (int) info.stride
-                            << "}";
-                    }
-                }
-                out << "]"
-                    << ", vertexInputAttributeDescInfos: [";
-                iindex = 0;
-                for (auto &info : vertexLayout.vertexInputAttributeDescInfos) {
-                    if (info.use) {
-                        if (iindex > 0) {
-                            out << ", ";
-                        }
-                        iindex++;
-                        out << "{"
-                            << "binding: " << (int) info.binding
-                            << ", location: " << (int) info.location
-                            << ", attrib: " << (int) info.attrib
-                            << ", normalized: " << (info.normalized ? "true" : "false")
-                            << ", offset: " << info.offset
-                            << "}";
-                    }
-                }
-                out << "]";
-                out << "}" << std::endl;
-            }
-                break;
-            case CommandKey::SetShaders: {
-                uint32_t size;
-                GfxIdxTy idx;
-
-                out << "    {shaders: [";
-
-                mCommandBuffer.read(size);
-                for (uint32_t k = 0; k < size; k++) {
-                    if (k != 0) {
-                        out << ", ";
-                    }
-                    mCommandBuffer.read(idx);
-                    out << idx;
-                }
-                out << "]}" << std::endl;
-            }
-                break;
-            case CommandKey::SetViewport: {
-                Rect2D viewport{};
-                float minDepth;
-                float maxDepth;
-
-                mCommandBuffer.read(viewport);
-                mCommandBuffer.read(minDepth);
-                mCommandBuffer.read(maxDepth);
-
-                out << "    {" << "viewport: {"
-                    << "x: " << viewport.x
-                    << ", y: " << viewport.y
-                    << ", width: " << viewport.width
-                    << ", height: " << viewport.height
-                    << ", minDepth: " << minDepth
-                    << ", maxDepth: " << maxDepth
-                    << "}" << std::endl;
-            }
-                break;
-            case CommandKey::SetScissor: {
-                Rect2D scissor{};
-                mCommandBuffer.read(scissor);
-
-                out << "    {" << "scissor: {"
-                    << "x: " << scissor.x
-                    << ", y: " << scissor.y
-                    << ", width: " << scissor.width
-                    << ", height: " << scissor.height
-                    << "}" << std::endl;
-            }
-                break;
-            case CommandKey::SetLineWidth: {
-                float lineWidth;
-                mCommandBuffer.read(lineWidth);
-
-                out << "    {" << "lineWidth: " << lineWidth << "}" << std::endl;
-            }
-                break;
-            case CommandKey::SetStencilCompMask: {
-                uint8_t face;
-                uint32_t mask;
-                mCommandBuffer.read(face);
-                mCommandBuffer.read(mask);
-
-                out << "    {"
-                    << "face: " << (int) face
-                    << ", mask: " << std::hex << "0x" << mask << std::dec
-                    << "}" << std::endl;
-            }
-                break;
-            case CommandKey::SetStencilWriteMask: {
-                uint8_t face;
-                uint32_t mask;
-                mCommandBuffer.read(face);
-                mCommandBuffer.read(mask);
-
-                out << "    {"
-                    << "face: " << (int) face
-                    << ", mask: " << std::hex << "0x" << mask << std::dec
-                    << "}" << std::endl;
-            }
-                break;
-            case CommandKey::SetStencilReference: {
-                uint8_t face;
-                uint32_t reference;
-                mCommandBuffer.read(face);
-                mCommandBuffer.read(reference);
-
-                out << "    {"
-                    << "face: " << (int) face
-                    << ", reference: " << std::hex << "0x" << reference << std::dec
-                    << "}" << std::endl;
-            }
-                break;
-            case CommandKey::BindDescSet: {
-                uint8_t bindPoint;
-                uint32_t binderSize;
-
-                mCommandBuffer.read(bindPoint);
-                mCommandBuffer.read(binderSize);
-
-                out << "    {"
-                    << "bindPoint: " << (uint32_t)bindPoint
-                    << ", binders: [";
-
-                for (uint32_t x = 0; x < binderSize; x++) {
-                    GfxIdxTy idx;
-                    mCommandBuffer.read(idx);
-                    if (x != 0) {
-                        out << ", ";
-                    }
-                    out << idx;
-                }
-
-                out << "]"
-                    << ", offsets = [";
-
-                uint32_t offsetSize;
-
-                mCommandBuffer.read(offsetSize);
-                for (uint32_t x = 0; x < offsetSize; x++) {
-                    uint32_t offset;
-                    mCommandBuffer.read(offset);
-                    if (x != 0) {
-                        out << ", ";
-                    }
-                    out << offset;
-                }
-
-                out << "]}" << std::endl;
-            }
-                break;
-            case CommandKey::BindVertexBuf: {
-                uint32_t firstBinding;
-                uint8_t size;
-
-                mCommandBuffer.read(firstBinding);
-                mCommandBuffer.read(size);
-                GX_ASSERT(size > 0);
-
-                out << "    {"
-                    << "firstBinding: " << firstBinding
-                    << ", buffers: [";
-
-                for (uint32_t x = 0; x < size; x++) {
-                    GfxIdxTy idx;
-                    mCommandBuffer.read(idx);
-
-                    if (x > 0) {
-                        out << ", ";
-                    }
-                    out << idx;
-                }
-                out << "], offsets: [";
-                for (uint32_t x = 0; x < size; x++) {
-                    uint64_t offset;
-                    mCommandBuffer.read(offset);
-                    if (x > 0) {
-                        out << ", ";
-                    }
-                    out << offset;
-                }
-                out << "]}" << std::endl;
-            }
-                break;
-            case CommandKey::BindIndexBuf: {
-                GfxIdxTy idx;
-                uint32_t offset;
-                IndexType::Enum indexType;
-                mCommandBuffer.read(idx);
-                mCommandBuffer.read(offset);
-                mCommandBuffer.read(indexType);
-
-                out << "    {"
-                    << "buffer: " << idx
-                    << ", offset: " << offset
-                    << ", indexType: " << (int) indexType
-                    << "}" << std::endl;
-            }
-                break;
-            case CommandKey::Draw: {
-                uint32_t vertexCount;
-                uint32_t instanceCount;
-                uint32_t firstVertex;
-                uint32_t firstInstance;
-                mCommandBuffer.read(vertexCount);
-                mCommandBuffer.read(instanceCount);
-                mCommandBuffer.read(firstVertex);
-                mCommandBuffer.read(firstInstance);
-
-                out << "    {"
-                    << "vertexCount: " << vertexCount
-                    << ", instanceCount: " << instanceCount
-                    << ", firstVertex: " << firstVertex
-                    << ", firstInstance: " << firstInstance
-                    << "}" << std::endl;
-            }
-                break;
-            case CommandKey::DrawIndexed: {
-                uint32_t indexCount;
-                uint32_t instanceCount;
-                uint32_t firstIndex;
-                int32_t vertexOffset;
-                uint32_t firstInstance;
-                mCommandBuffer.read(indexCount);
-                mCommandBuffer.read(instanceCount);
-                mCommandBuffer.read(firstIndex);
-                mCommandBuffer.read(vertexOffset);
-                mCommandBuffer.read(firstInstance);
-
-                out << "    {"
-                    << "indexCount: " << indexCount
-                    << ", instanceCount: " << instanceCount
-                    << ", firstIndex: " << firstIndex
-                    << ", vertexOffset: " << vertexOffset
-                    << ", firstInstance: " << firstInstance
-                    << "}" << std::endl;
-            }
-                break;
-            case CommandKey::DrawIndirect: {
-                GfxIdxTy idx;
-                uint32_t offset;
-                uint32_t drawCount;
-                uint32_t stride;
-
-                mCommandBuffer.read(idx);
-                mCommandBuffer.read(offset);
-                mCommandBuffer.read(drawCount);
-                mCommandBuffer.read(stride);
-
-                out << "    {"
-                    << "buffer: " << idx
-                    << ", offset: " << offset
-                    << ", drawCount: " << drawCount
-                    << ", stride: " << stride
-                    << "}" << std::endl;
-            }
-                break;
-            case CommandKey::DrawIndexedIndirect: {
-                GfxIdxTy idx;
-                uint32_t offset;
-                uint32_t drawCount;
-                uint32_t stride;
-
-                mCommandBuffer.read(idx);
-                mCommandBuffer.read(offset);
-                mCommandBuffer.read(drawCount);
-                mCommandBuffer.read(stride);
-
-                out << "    {"
-                    << "buffer: " << idx
-                    << ", offset: " << offset
-                    << ", drawCount: " << drawCount
-                    << ", stride: " << stride
-                    << "}" << std::endl;
-            }
-                break;
-            case CommandKey::Dispatch: {
-                uint32_t groupCountX;
-                uint32_t groupCountY;
-                uint32_t groupCountZ;
-
-                mCommandBuffer.read(groupCountX);
-                mCommandBuffer.read(groupCountY);
-                mCommandBuffer.read(groupCountZ);
-
-                out << "    {"
-                    << "groupCountX: " << groupCountX
-                    << ", groupCountY: " << groupCountY
-                    << ", groupCountZ: " << groupCountZ
-                    << "}" << std::endl;
-            }
-                break;
-            case CommandKey::DispatchIndirect: {
-                GfxIdxTy idx;
-                uint32_t offset;
-
-                mCommandBuffer.read(idx);
-                mCommandBuffer.read(offset);
-
-                out << "    {"
-                    << "buffer: " << idx
-                    << ", offset: " << offset
-                    << "}" << std::endl;
-            }
-                break;
-            case CommandKey::PipelineBarrier: {
-                PipelineStageMask srcStage;
-                PipelineStageMask dstStage;
-
-                mCommandBuffer.read(srcStage);
-                mCommandBuffer.read(dstStage);
-
-                out << "    {"
-                    << "srcStage: " << std::hex << srcStage
-                    << ", dstStage: " << dstStage << std::dec
-                    << "}" << std::endl;
-            }
-                break;
-            case CommandKey::BufferBarrier: {
-                GfxIdxTy idx;
-                BufferBarrierInfo barrierInfo{};
-
-                mCommandBuffer.read(idx);
-                mCommandBuffer.read(barrierInfo);
-
-                out << "    {"
-                    << "idx: " << idx
-                    << ", barrierInfo: " << "{"
-                    << "srcStage: " << std::hex << barrierInfo.srcStage
-                    << ", dstStage: " << std::hex << barrierInfo.dstStage
-                    << ", srcAccess: " << std::hex << barrierInfo.srcAccess
-                    << ", dstAccess: " << std::hex << barrierInfo.dstAccess
-                    << ", srcQueue: " << std::dec << barrierInfo.srcQueue
-                    << ", dstQueue: " << std::dec << barrierInfo.dstQueue
-                    << "}"
-                    << "}" << std::endl;
-            }
-                break;
-            case CommandKey::ImageBarrier: {
-                GfxIdxTy idx;
-                uint8_t srcLayout;
-                uint8_t dstLayout;
-                ImageSubResourceRange subResRange{};
-
-                mCommandBuffer.read(idx);
-                mCommandBuffer.read(srcLayout);
-                mCommandBuffer.read(dstLayout);
-                mCommandBuffer.read(subResRange);
-
-                out << "    {"
-                    << "idx: " << idx
-                    << ", srcLayout: " << (int) srcLayout
-                    << ", dstLayout: " << (int) dstLayout
-                    << ", subResRange: {"
-                    << "baseMipLevel: " << subResRange.baseMipLevel
-                    << ", levelCount: " << subResRange.levelCount
-                    << ", baseArrayLayer: " << subResRange.baseArrayLayer
-                    << ", layerCount: " << subResRange.layerCount
-                    << "}"
-                    << "}" << std::endl;
-            }
-                break;
-            case CommandKey::CopyBuffer: {
-                GfxIdxTy srcIdx;
-                GfxIdxTy dstIdx;
-                uint64_t srcOffset;
-                uint64_t dstOffset;
-                uint64_t size;
-
-                mCommandBuffer.read(srcIdx);
-                mCommandBuffer.read(dstIdx);
-                mCommandBuffer.read(srcOffset);
-                mCommandBuffer.read(dstOffset);
-                mCommandBuffer.read(size);
-
-                out << "    {"
-                    << "srcIdx: " << srcIdx
-                    << ", dstIdx: " << dstIdx
-                    << ", srcOffset: " << srcOffset
-                    << ", dstOffset: " << dstOffset
-                    << ", size: " << size
-                    << "}" << std::endl;
-            }
-                break;
-            case CommandKey::CopyImage: {
-                GfxIdxTy srcIdx;
-                GfxIdxTy dstIdx;
-                uint32_t copyInfoSize;
-                mCommandBuffer.read(srcIdx);
-                mCommandBuffer.read(dstIdx);
-                mCommandBuffer.read(copyInfoSize);
-
-                out << "    {"
-                    << "srcIdx: " << srcIdx
-                    << ", dstIdx: " << dstIdx
-                    << " ImageCopyInfos: [";
-
-                if (copyInfoSize > 0) {
-                    ImageCopyInfo copyInfo{};
-                    for (uint32_t x = 0; x < copyInfoSize; x++) {
-                        mCommandBuffer.read(copyInfo);
-
-                        if (x > 0) {
-                            out << ", ";
-                        }
-                        out << "{"
-                            << "srcMipLevel: " << copyInfo.srcMipLevel
-                            << ", srcBaseArrayLayer: " << copyInfo.srcBaseArrayLayer
-                            << ", srcLayerCount: " << copyInfo.srcLayerCount
-                            << ", srcOffsetX: " << copyInfo.srcOffsetX
-                            << ", srcOffsetY: " << copyInfo.srcOffsetY
-                            << ", srcOffsetZ: " << copyInfo.srcOffsetZ
-                            << ", dstMipLevel: " << copyInfo.dstMipLevel
-                            << ", dstBaseArrayLayer: " << copyInfo.dstBaseArrayLayer
-                            << ", dstLayerCount: " << copyInfo.dstLayerCount
-                            << ", dstOffsetX: " << copyInfo.dstOffsetX
-                            << ", dstOffsetY: " << copyInfo.dstOffsetY
-                            << ", dstOffsetZ: " << copyInfo.dstOffsetZ
-                            << ", imageWidth: " << copyInfo.imageWidth
-                            << ", imageHeight: " << copyInfo.imageHeight
-                            << ", imageDepth: " << copyInfo.imageDepth
-                            << ", srcAspectMask: " << copyInfo.srcAspectMask
-                            << ", dstAspectMask: " << copyInfo.dstAspectMask
-                            << "}";
-                    }
-                }
-                out << "]"
-                    << "}" << std::endl;
-            }
-                break;
-            case CommandKey::CopyBufferToImage: {
-                GfxIdxTy srcIdx;
-                GfxIdxTy dstIdx;
-                uint32_t copyInfoSize;
-                mCommandBuffer.read(srcIdx);
-                mCommandBuffer.read(dstIdx);
-                mCommandBuffer.read(copyInfoSize);
-
-                out << "    {"
-                    << "srcIdx: " << srcIdx
-                    << ", dstIdx: " << dstIdx
-                    << " BufferImageCopyInfos: [";
-
-                if (copyInfoSize > 0) {
-                    BufferImageCopyInfo tempInfo{};
-                    for (uint32_t x = 0; x < copyInfoSize; x++) {
-                        mCommandBuffer.read(tempInfo);
-                        if (x > 0) {
-                            out << ", ";
-                        }
-                        out << "{"
-                            << "bufferOffset: " << tempInfo.bufferOffset
-                            << ", bufferRowLength: " << tempInfo.bufferRowLength
-                            << ", bufferImageHeight: " << tempInfo.bufferImageHeight
-                            << ", mipLevel: " << tempInfo.mipLevel
-                            << ", baseArrayLayer: " << tempInfo.baseArrayLayer
-                            << ", layerCount: " << tempInfo.layerCount
-                            << ", imageOffsetX: " << tempInfo.imageOffsetX
-                            << ", imageOffsetY: " << tempInfo.imageOffsetY
-                            << ", imageOffsetZ: " << tempInfo.imageOffsetZ
-                            << ", imageWidth: " << tempInfo.imageWidth
-                            << ", imageHeight: " << tempInfo.imageHeight
-                            << ", imageDepth: " << tempInfo.imageDepth
-                            << ", aspectMask: " << std::hex << (uint32_t)tempInfo.aspectMask << std::dec
-                            << "}";
-                    }
-                }
-                out << "]"
-                    << "}" << std::endl;
-            }
-                break;
-            case CommandKey::CopyImageToBuffer: {
-                GfxIdxTy srcIdx;
-                GfxIdxTy dstIdx;
-                uint32_t copyInfoSize;
-                mCommandBuffer.read(srcIdx);
-                mCommandBuffer.read(dstIdx);
-                mCommandBuffer.read(copyInfoSize);
-
-                out << "    {"
-                    << "srcIdx: " << srcIdx
-                    << ", dstIdx: " << dstIdx
-                    << ", BufferImageCopyInfos: [";
-
-                if (copyInfoSize > 0) {
-                    BufferImageCopyInfo tempInfo{};
-                    for (uint32_t x = 0; x < copyInfoSize; x++) {
-                        mCommandBuffer.read(tempInfo);
-                        if (x > 0) {
-                            out << ", ";
-                        }
-                        out << "{"
-                            << "bufferOffset: " << tempInfo.bufferOffset
-                            << ", bufferRowLength: " << tempInfo.bufferRowLength
-                            << ", bufferImageHeight: " << tempInfo.bufferImageHeight
-                            << ", mipLevel: " << tempInfo.mipLevel
-                            << ", baseArrayLayer: " << tempInfo.baseArrayLayer
-                            << ", layerCount: " << tempInfo.layerCount
-                            << ", imageOffsetX: " << tempInfo.imageOffsetX
-                            << ", imageOffsetY: " << tempInfo.imageOffsetY
-                            << ", imageOffsetZ: " << tempInfo.imageOffsetZ
-                            << ", imageWidth: " << tempInfo.imageWidth
-                            << ", imageHeight: " << tempInfo.imageHeight
-                            << ", imageDepth: " << tempInfo.imageDepth
-                            << ", aspectMask: " << std::hex << (uint32_t)tempInfo.aspectMask << std::dec
-                            << "}";
-                    }
-                }
-
-                out << "]"
-                    << "}" << std::endl;
-            }
-                break;
-            case CommandKey::BlitImage: {
-                GfxIdxTy srcIdx;
-                GfxIdxTy dstIdx;
-                uint8_t filter;
-                uint32_t blitInfoSize;
-                mCommandBuffer.read(srcIdx);
-                mCommandBuffer.read(dstIdx);
-                mCommandBuffer.read(filter);
-                mCommandBuffer.read(blitInfoSize);
-
-                out << "    {"
-                    << "srcIdx: " << srcIdx
-                    << ", dstIdx: " << dstIdx
-                    << ", filter: " << (int) filter
-                    << ", ImageBlitInfo: [";
-
-                if (blitInfoSize > 0) {
-                    ImageBlitInfo blitInfo{};
-                    for (uint32_t x = 0; x < blitInfoSize; x++) {
-                        mCommandBuffer.read(blitInfo);
-                        if (x > 0) {
-                            out << ", ";
-                        }
-                        out << "{"
-                            << "srcMipLevel: " << blitInfo.srcMipLevel
-                            << ", srcBaseArrayLayer: " << blitInfo.srcBaseArrayLayer
-                            << ", srcLayerCount: " << blitInfo.srcLayerCount
-                            << ", srcOffsetX: " << blitInfo.srcOffsetX
-                            << ", srcOffsetY: " << blitInfo.srcOffsetY
-                            << ", srcOffsetZ: " << blitInfo.srcOffsetZ
-                            << ", srcWidth: " << blitInfo.srcWidth
-                            << ", srcHeight: " << blitInfo.srcHeight
-                            << ", srcDepth: " << blitInfo.srcDepth
-                            << ", dstMipLevel: " << blitInfo.dstMipLevel
-                            << ", dstBaseArrayLayer: " << blitInfo.dstBaseArrayLayer
-                            << ", dstLayerCount: " << blitInfo.dstLayerCount
-                            << ", dstOffsetX: " << blitInfo.dstOffsetX
-                            << ", dstOffsetY: " << blitInfo.dstOffsetY
-                            << ", dstOffsetZ: " << blitInfo.dstOffsetZ
-                            << ", dstWidth: " << blitInfo.dstWidth
-                            << ", dstHeight: " << blitInfo.dstHeight
-                            << ", dstDepth: " << blitInfo.dstDepth
-                            << ", srcAspectMask: " << blitInfo.srcAspectMask
-                            << ", dstAspectMask: " << blitInfo.dstAspectMask
-                            << "}";
-                    }
-                }
-                out << "]"
-                    << "}" << std::endl;
-            }
-                break;
-            case CommandKey::CopyRT: {
-                GfxIdxTy srcIdx;
-                GfxIdxTy dstIdx;
-                uint8_t vFrameIndex;
-                uint32_t copyInfoSize;
-                std::vector<ImageCopyInfo> copyInfos;
-                mCommandBuffer.read(srcIdx);
-                mCommandBuffer.read(dstIdx);
-                mCommandBuffer.read(vFrameIndex);
-                mCommandBuffer.read(copyInfoSize);
-
-                out << "    {"
-                    << "srcIdx: " << srcIdx
-                    << ", dstIdx: " << dstIdx
-                    << ", vFrameIndex: " << (int) vFrameIndex
-                    << ", ImageCopyInfos: [";
-
-                if (copyInfoSize > 0) {
-                    ImageCopyInfo copyInfo{};
-                    for (uint32_t x = 0; x < copyInfoSize; x++) {
-                        mCommandBuffer.read(copyInfo);
-                        if (x > 0) {
-                            out << ", ";
-                        }
-                        out << "{"
-                            << "srcMipLevel: " << copyInfo.srcMipLevel
-                            << ", srcBaseArrayLayer: " << copyInfo.srcBaseArrayLayer
-                            << ", srcLayerCount: " << copyInfo.srcLayerCount
-                            << ", srcOffsetX: " << copyInfo.srcOffsetX
-                            << ", srcOffsetY: " << copyInfo.srcOffsetY
-                            << ", srcOffsetZ: " << copyInfo.srcOffsetZ
-                            << ", dstMipLevel: " << copyInfo.dstMipLevel
-                            << ", dstBaseArrayLayer: " << copyInfo.dstBaseArrayLayer
-                            << ", dstLayerCount: " << copyInfo.dstLayerCount
-                            << ", dstOffsetX: " << copyInfo.dstOffsetX
-                            << ", dstOffsetY: " << copyInfo.dstOffsetY
-                            << ", dstOffsetZ: " << copyInfo.dstOffsetZ
-                            << ", imageWidth: " << copyInfo.imageWidth
-                            << ", imageHeight: " << copyInfo.imageHeight
-                            << ", imageDepth: " << copyInfo.imageDepth
-                            << ", srcAspectMask: " << copyInfo.srcAspectMask
-                            << ", dstAspectMask: " << copyInfo.dstAspectMask
-                            << "}";
-                    }
-                }
-                out << "]"
-                    << "}" << std::endl;
-            }
-                break;
-            case CommandKey::BlitRT: {
-                GfxIdxTy srcIdx;
-                GfxIdxTy dstIdx;
-                uint8_t filter;
-                uint8_t vFrameIndex;
-                uint32_t blitInfoSize;
-                mCommandBuffer.read(srcIdx);
-                mCommandBuffer.read(dstIdx);
-                mCommandBuffer.read(filter);
-                mCommandBuffer.read(vFrameIndex);
-                mCommandBuffer.read(blitInfoSize);
-
-                out << "    {"
-                    << "srcIdx: " << srcIdx
-                    << ", dstIdx: " << dstIdx
-                    << ", vFrameIndex: " << (int) vFrameIndex
-                    << ", ImageBlitInfos: [";
-
-                if (blitInfoSize > 0) {
-                    ImageBlitInfo blitInfo{};
-                    for (uint32_t x = 0; x < blitInfoSize; x++) {
-                        mCommandBuffer.read(blitInfo);
-                        if (x > 0) {
-                            out << ", ";
-                        }
-                        out << "{"
-                            << "srcMipLevel: " << blitInfo.srcMipLevel
-                            << ", srcBaseArrayLayer: " << blitInfo.srcBaseArrayLayer
-                            << ", srcLayerCount: " << blitInfo.srcLayerCount
-                            << ", srcOffsetX: " << blitInfo.srcOffsetX
-                            << ", srcOffsetY: " << blitInfo.srcOffsetY
-                            << ", srcOffsetZ: " << blitInfo.srcOffsetZ
-                            << ", srcWidth: " << blitInfo.srcWidth
-                            << ", srcHeight: " << blitInfo.srcHeight
-                            << ", srcDepth: " << blitInfo.srcDepth
-                            << ", dstMipLevel: " << blitInfo.dstMipLevel
-                            << ", dstBaseArrayLayer: " << blitInfo.dstBaseArrayLayer
-                            << ", dstLayerCount: " << blitInfo.dstLayerCount
-                            << ", dstOffsetX: " << blitInfo.dstOffsetX
-                            << ", dstOffsetY: " << blitInfo.dstOffsetY
-                            << ", dstOffsetZ: " << blitInfo.dstOffsetZ
-                            << ", dstWidth: " << blitInfo.dstWidth
-                            << ", dstHeight: " << blitInfo.dstHeight
-                            << ", dstDepth: " << blitInfo.dstDepth
-                            << ", srcAspectMask: " << blitInfo.srcAspectMask
-                            << ", dstAspectMask: " << blitInfo.dstAspectMask
-                            << "}";
-                    }
-                }
-                out << "]"
-                    << "}" << std::endl;
-            }
-                break;
-            case CommandKey::BlitRTToImage: {
-                GfxIdxTy srcIdx;
-                GfxIdxTy dstIdx;
-                uint8_t filter;
-                uint8_t attachIndex;
-                uint8_t vFrameIndex;
-                uint32_t blitInfoSize;
-                mCommandBuffer.read(srcIdx);
-                mCommandBuffer.read(dstIdx);
-                mCommandBuffer.read(filter);
-                mCommandBuffer.read(attachIndex);
-                mCommandBuffer.read(vFrameIndex);
-                mCommandBuffer.read(blitInfoSize);
-
-                out << "    {"
-                    << "srcIdx: " << srcIdx
-                    << ", dstIdx: " << dstIdx
-                    << ", filter: " << (int) filter
-                    << ", attachIndex: " << (int) attachIndex
-                    << ", vFrameIndex: " << (int) vFrameIndex
-                    << ", ImageBlitInfos: [";
-
-                if (blitInfoSize > 0) {
-                    ImageBlitInfo blitInfo{};
-                    for (uint32_t x = 0; x < blitInfoSize; x++) {
-                        mCommandBuffer.read(blitInfo);
-                        if (x > 0) {
-                            out << ", ";
-                        }
-                        out << "{"
-                            << "srcMipLevel: " << blitInfo.srcMipLevel
-                            << ", srcBaseArrayLayer: " << blitInfo.srcBaseArrayLayer
-                            << ", srcLayerCount: " << blitInfo.srcLayerCount
-                            << ", srcOffsetX: " << blitInfo.srcOffsetX
-                            << ", srcOffsetY: " << blitInfo.srcOffsetY
-                            << ", srcOffsetZ: " << blitInfo.srcOffsetZ
-                            << ", srcWidth: " << blitInfo.srcWidth
-                            << ", srcHeight: " << blitInfo.srcHeight
-                            << ", srcDepth: " << blitInfo.srcDepth
-                            << ", dstMipLevel: " << blitInfo.dstMipLevel
-                            << ", dstBaseArrayLayer: " << blitInfo.dstBaseArrayLayer
-                            << ", dstLayerCount: " << blitInfo.dstLayerCount
-                            << ", dstOffsetX: " << blitInfo.dstOffsetX
-                            << ", dstOffsetY: " << blitInfo.dstOffsetY
-                            << ", dstOffsetZ: " << blitInfo.dstOffsetZ
-                            << ", dstWidth: " << blitInfo.dstWidth
-                            << ", dstHeight: " << blitInfo.dstHeight
-                            << ", dstDepth: " << blitInfo.dstDepth
-                            << ", srcAspectMask: " << blitInfo.srcAspectMask
-                            << ", dstAspectMask: " << blitInfo.dstAspectMask
-                            << "}";
-                    }
-                }
-                out << "]"
-                    << "}" << std::endl;
-            }
-                break;
-            case CommandKey::CopyRTToImage: {
-                GfxIdxTy srcIdx;
-                GfxIdxTy dstIdx;
-                uint8_t attachIndex;
-                uint8_t vFrameIndex;
-                uint32_t copyInfoSize;
-                mCommandBuffer.read(srcIdx);
-                mCommandBuffer.read(dstIdx);
-                mCommandBuffer.read(attachIndex);
-                mCommandBuffer.read(vFrameIndex);
-                mCommandBuffer.read(copyInfoSize);
-
-                out << "    {"
-                    << "srcIdx: " << srcIdx
-                    << ", dstIdx: " << dstIdx
-                    << ", attachIndex: " << (int) attachIndex
-                    << ", vFrameIndex: " << (int) vFrameIndex
-                    << ", ImageCopyInfos: [";
-
-                if (copyInfoSize > 0) {
-                    ImageCopyInfo copyInfo{};
-                    for (uint32_t x = 0; x < copyInfoSize; x++) {
-                        mCommandBuffer.read(copyInfo);
-                        if (x > 0) {
-                            out << ", ";
-                        }
-                        out << "{"
-                            << "srcMipLevel: " << copyInfo.srcMipLevel
-                            << ", srcBaseArrayLayer: " << copyInfo.srcBaseArrayLayer
-                            << ", srcLayerCount: " << copyInfo.srcLayerCount
-                            << ", srcOffsetX: " << copyInfo.srcOffsetX
-                            << ", srcOffsetY: " << copyInfo.srcOffsetY
-                            << ", srcOffsetZ: " << copyInfo.srcOffsetZ
-                            << ", dstMipLevel: " << copyInfo.dstMipLevel
-                            << ", dstBaseArrayLayer: " << copyInfo.dstBaseArrayLayer
-                            << ", dstLayerCount: " << copyInfo.dstLayerCount
-                            << ", dstOffsetX: " << copyInfo.dstOffsetX
-                            << ", dstOffsetY: " << copyInfo.dstOffsetY
-                            << ", dstOffsetZ: " << copyInfo.dstOffsetZ
-                            << ", imageWidth: " << copyInfo.imageWidth
-                            << ", imageHeight: " << copyInfo.imageHeight
-                            << ", imageDepth: " << copyInfo.imageDepth
-                            << ", srcAspectMask: " << copyInfo.srcAspectMask
-                            << ", dstAspectMask: " << copyInfo.dstAspectMask
-                            << "}";
-                    }
-                }
-                out << "]"
-                    << "}" << std::endl;
-            }
-                break;
-            case CommandKey::CopyRTToBuffer: {
-                GfxIdxTy srcIdx;
-                GfxIdxTy dstIdx;
-                uint8_t attachIndex;
-                uint8_t vFrameIndex;
-                uint32_t copyInfoSize;
-                mCommandBuffer.read(srcIdx);
-                mCommandBuffer.read(dstIdx);
-                mCommandBuffer.read(attachIndex);
-                mCommandBuffer.read(vFrameIndex);
-                mCommandBuffer.read(copyInfoSize);
-
-                out << "    {"
-                    << "srcIdx: " << srcIdx
-                    << ", dstIdx: " << dstIdx
-                    << ", attachIndex: " << (int) attachIndex
-                    << ", vFrameIndex: " << (int) vFrameIndex
-                    << ", ImageCopyInfos: [";
-
-                if (copyInfoSize > 0) {
-                    BufferImageCopyInfo tempInfo{};
-                    for (uint32_t x = 0; x < copyInfoSize; x++) {
-                        mCommandBuffer.read(tempInfo);
-                        if (x > 0) {
-                            out << ", ";
-                        }
-                        out << "{"
-                            << "bufferOffset: " << tempInfo.bufferOffset
-                            << ", bufferRowLength: " << tempInfo.bufferRowLength
-                            << ", bufferImageHeight: " << tempInfo.bufferImageHeight
-                            << ", mipLevel: " << tempInfo.mipLevel
-                            << ", baseArrayLayer: " << tempInfo.baseArrayLayer
-                            << ", layerCount: " << tempInfo.layerCount
-                            << ", imageOffsetX: " << tempInfo.imageOffsetX
-                            << ", imageOffsetY: " << tempInfo.imageOffsetY
-                            << ", imageOffsetZ: " << tempInfo.imageOffsetZ
-                            << ", imageWidth: " << tempInfo.imageWidth
-                            << ", imageHeight: " << tempInfo.imageHeight
-                            << ", imageDepth: " << tempInfo.imageDepth
-                            << ", aspectMask: " << std::hex << (uint32_t)tempInfo.aspectMask << std::dec
-                            << "}";
-                    }
-                }
-                out << "]"
-                    << "}" << std::endl;
-            }
-                break;
-            case CommandKey::FillBuffer: {
-                GfxIdxTy idx;
-                uint64_t offset;
-                uint64_t size;
-                uint32_t data;
-
-                mCommandBuffer.read(idx);
-                mCommandBuffer.read(offset);
-                mCommandBuffer.read(size);
-                mCommandBuffer.read(data);
-                out << "   {"
-                    << "buffer: " << idx
-                    << ", offset" << offset
-                    << ", size" << size
-                    << ", data" << data
-                    << "}"
-                    << std::endl;
-            }
-                break;
-            case CommandKey::BeginDebug: {
-                std::string label;
-                mCommandBuffer.read(label);
-                out << "    {"
-                    << "debugLabel: " << label
-                    << "}"
-                    << std::endl;
-            }
-                break;
-            case CommandKey::EndDebug: {
-            }
-                break;
-            case CommandKey::ResetQuery: {
-                GfxIdxTy queryIdx;
-                uint32_t firstQuery;
-                uint32_t queryCount;
-
-                mCommandBuffer.read(queryIdx);
-                mCommandBuffer.read(firstQuery);
-                mCommandBuffer.read(queryCount);
-
-                out << "    {"
-                    << "query: " << queryIdx
-                    << ", firstQuery: " << firstQuery
-                    << ", queryCount: " << queryCount
-                    << "}"
-                    << std::endl;
-            }
-                break;
-            case CommandKey::BeginQuery: {
-                GfxIdxTy queryIdx;
-                uint32_t queryIndex;
-                bool precise;
-
-                mCommandBuffer.read(queryIdx);
-                mCommandBuffer.read(queryIndex);
-                mCommandBuffer.read(precise);
-
-                out << "    {"
-                    << "query: " << queryIdx
-                    << ", queryIndex: " << queryIndex
-                    << ", precise: " << precise
-                    << "}"
-                    << std::endl;
-            }
-                break;
-            case CommandKey::EndQuery: {
-                GfxIdxTy queryIdx;
-                uint32_t queryIndex;
-
-                mCommandBuffer.read(queryIdx);
-                mCommandBuffer.read(queryIndex);
-
-                out << "    {"
-                    << "query: " << queryIdx
-                    << ", queryIndex: " << queryIndex
-                    << "}"
-                    << std::endl;
-            }
-                break;
-            case CommandKey::WriteTimestamp: {
-                uint32_t pipelineStage;
-                GfxIdxTy queryIdx;
-                uint32_t queryIndex;
-
-                mCommandBuffer.read(pipelineStage);
-                mCommandBuffer.read(queryIdx);
-                mCommandBuffer.read(queryIndex);
-
-                out << "    {"
-                    << "pipelineStage: " << pipelineStage
-                    << ", query: " << queryIdx
-                    << ", queryIndex: " << queryIndex
-                    << "}"
-                    << std::endl;
-            }
-                break;
-            case CommandKey::CopyQueryResults: {
-                GfxIdxTy queryIdx;
-                uint32_t firstQuery;
-                uint32_t queryCount;
-                GfxIdxTy dstBufferIdx;
-                uint64_t dstOffset;
-                QueryResultFlags resultFlags;
-
-                mCommandBuffer.read(queryIdx);
-                mCommandBuffer.read(firstQuery);
-                mCommandBuffer.read(queryCount);
-                mCommandBuffer.read(dstBufferIdx);
-                mCommandBuffer.read(dstOffset);
-                mCommandBuffer.read(resultFlags);
-
-                out << "    {"
-                    << "query: " << queryIdx
-                    << ", firstQuery: " << firstQuery
-                    << ", queryCount: " << queryCount
-                    << ", dstBuffer: " << dstBufferIdx
-                    << ", dstOffset: " << dstOffset
-                    << ", resultFlags: " << std::hex << (uint32_t)resultFlags << std::dec
-                    << "}"
-                    << std::endl;
-            }
-                break;
-        }
-    } while (cmdKey != CommandKey::End);
-
-    return out.str();
+    return (srcStage & mDstStages) != 0;
 }
 
-
-CommandBuffer CommandBufferVk::begin()
+bool BarrierBatchVk::empty() const
 {
-    GX_ASSERT_S(!mIsBegun, "Do not call begin repeatedly");
-
-    resetCommandBuffer();
-
-    uint8_t cmdKey = CommandKey::Begin;
-    mCommandBuffer.write(cmdKey);
-
-    mIsBegun = true;
-
-    return this;
+    return mExecStages.empty() && mBufferBarriers.empty() && mImageBarriers.empty();
 }
 
-void CommandBufferVk::end()
+uint32_t BarrierBatchVk::flush(VkCommandBuffer cmdBuffer)
 {
-    GX_ASSERT_S(mIsBegun, "Please call begin first");
-
-    uint8_t cmdKey = CommandKey::End;
-    mCommandBuffer.write(cmdKey);
-
-    mIsBegun = false;
-}
+    if (empty()) {
+        return 0;
+    }
 
-CommandBuffer CommandBufferVk::setClearColor(const ClearColor &clearColor)
-{
-    GX_ASSERT_S(mIsBegun, "Please call begin first");
+#if defined(VK_VERSION_1_3)
+    if (mUseSynchronization2) {
+        // synchronization2下每个Barrier保留各自的阶段掩码，合并后不会扩大同步范围，相互依赖的Barrier在添加前已分批
+        auto &memoryBarriers = mMemoryBarriers2;
+        memoryBarriers.assign(mExecStages.size(), VkMemoryBarrier2{});
+        for (size_t i = 0; i < mExecStages.size(); i++) {
+            auto &b = memoryBarriers[i];
+            b.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2;
+            b.srcStageMask = mExecStages[i].srcStage;
+            b.dstStageMask = mExecStages[i].dstStage;
+        }
 
-    uint8_t cmdKey = CommandKey::SetClearColor;
-    mCommandBuffer.write(cmdKey);
-    mCommandBuffer.write(clearColor);
+        auto &bufferBarriers = mBufferBarriers2;
+        bufferBarriers.assign(mBufferBarriers.size(), VkBufferMemoryBarrier2{});
+        for (size_t i = 0; i < mBufferBarriers.size(); i++) {
+            const auto &src = mBufferBarriers[i];
+            auto &b = bufferBarriers[i];
+            b.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2;
+            b.srcStageMask = mBufferStages[i].srcStage;
+            b.srcAccessMask = src.srcAccessMask;
+            b.dstStageMask = mBufferStages[i].dstStage;
+            b.dstAccessMask = src.dstAccessMask;
+            b.srcQueueFamilyIndex = src.srcQueueFamilyIndex;
+            b.dstQueueFamilyIndex = src.dstQueueFamilyIndex;
+            b.buffer = src.buffer;
+            b.offset = src.offset;
+            b.size = src.size;
+        }
 
-    return this;
-}
+        auto &imageBarriers = mImageBarriers2;
+        imageBarriers.assign(mImageBarriers.size(), VkImageMemoryBarrier2{});
+        for (size_t i = 0; i < mImageBarriers.size(); i++) {
+            const auto &src = mImageBarriers[i];
+            auto &b = imageBarriers[i];
+            b.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+            b.srcStageMask = mImageStages[i].srcStage;
+            b.srcAccessMask = src.srcAccessMask;
+            b.dstStageMask = mImageStages[i].dstStage;
+            b.dstAccessMask = src.dstAccessMask;
+            b.oldLayout = src.oldLayout;
+            b.newLayout = src.newLayout;
+            b.srcQueueFamilyIndex = src.srcQueueFamilyIndex;
+            b.dstQueueFamilyIndex = src.dstQueueFamilyIndex;
+            b.image = src.image;
+            b.subresourceRange = src.subresourceRange;
+        }
 
-CommandBuffer CommandBufferVk::setClearDepthStencil(float depth, uint32_t stencil)
-{
-    GX_ASSERT_S(mIsBegun, "Please call begin first");
+        VkDependencyInfo dependencyInfo{};
+        dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+        dependencyInfo.memoryBarrierCount = (uint32_t) memoryBarriers.size();
+        dependencyInfo.pMemoryBarriers = memoryBarriers.data();
+        dependencyInfo.bufferMemoryBarrierCount = (uint32_t) bufferBarriers.size();
+        dependencyInfo.pBufferMemoryBarriers = bufferBarriers.data();
+        dependencyInfo.imageMemoryBarrierCount = (uint32_t) imageBarriers.size();
+        dependencyInfo.pImageMemoryBarriers = imageBarriers.data();
 
-    uint8_t cmdKey = CommandKey::SetClearDepSte;
-    mCommandBuffer.write(cmdKey);
-    mCommandBuffer.write(depth);
-    mCommandBuffer.write(stencil);
+        vkCmdPipelineBarrier2(cmdBuffer, &dependencyInfo);
 
-    return this;
-}
+        clear();
+        return 1;
+    }
+#endif
 
-CommandBuffer CommandBufferVk::bindRenderTarget(RenderTarget renderTarget)
-{
-    GX_ASSERT_S(mIsBegun, "Please call begin first");
+    VkPipelineStageFlags srcStage = 0;
+    VkPipelineStageFlags dstStage = 0;
+    for (const auto &s : mExecStages) {
+        srcStage |= s.srcStage;
+        dstStage |= s.dstStage;
+    }
+    for (const auto &s : mBufferStages) {
+        srcStage |= s.srcStage;
+        dstStage |= s.dstStage;
+    }
+    for (const auto &s : mImageStages) {
+        srcStage |= s.srcStage;
+        dstStage |= s.dstStage;
+    }
 
-    GX_ASSERT(renderTarget);
-    auto *targetP = dynamic_cast<RenderTarget_P *>(renderTarget);
-    uint8_t cmdKey = CommandKey::BindRenderTarget;
-    mCommandBuffer.write(cmdKey);
-    mCommandBuffer.write(targetP->idx());
+    vkCmdPipelineBarrier(
+            cmdBuffer,
+            srcStage,
+            dstStage,
+            0,
+            0, nullptr,
+            (uint32_t) mBufferBarriers.size(), mBufferBarriers.data(),
+            (uint32_t) mImageBarriers.size(), mImageBarriers.data());
 
-    return this;
+    clear();
+    return 1;
 }
 
-CommandBuffer CommandBufferVk::bindRenderTarget(Frame frame)
+void BarrierBatchVk::clear()
 {
-    GX_ASSERT_S(mIsBegun, "Please call begin first");
-
-    GX_ASSERT(frame);
-    GX_ASSERT(frame->renderTarget());
-    auto *targetP = dynamic_cast<RenderTarget_P *>(frame->renderTarget());
-    uint8_t cmdKey = CommandKey::BindRenderTarget;
-    mCommandBuffer.write(cmdKey);
-    mCommandBuffer.write(targetP->idx());
-
-    return this;
+    mDstStages = 0;
+    mExecStages.clear();
+    mBufferStages.clear();
+    mImageStages.clear();
+    mBufferBarriers.clear();
+    mImageBarriers.clear();
 }
 
-CommandBuffer CommandBufferVk::beginRenderPass(const Rect2D &renderArea, const RenderPassInfo &rpInfo)
-{
-    GX_ASSERT_S(mIsBegun, "Please call begin first");
-
-    uint8_t cmdKey = CommandKey::BeginRenderPass;
-    mCommandBuffer.write(cmdKey);
-    mCommandBuffer.write(renderArea);
-    writeRenderPassInfo(mCommandBuffer, rpInfo);
+/// ============ GpuProfilerVk ============ ///
 
-    return this;
-}
-
-CommandBuffer CommandBufferVk::endRenderPass()
+void GpuProfilerVk::init(ContextVk *context, Profiler *profiler)
 {
-    GX_ASSERT_S(mIsBegun, "Please call begin first");
-
-    uint8_t cmdKey = CommandKey::EndRenderPass;
-    mCommandBuffer.write(cmdKey);
-
-    return this;
+    mContext = context;
+    mProfiler = profiler;
 }
 
-CommandBuffer CommandBufferVk::setGraphicsPipelineState(const GraphicsPipelineStateInfo &pipelineState)
+void GpuProfilerVk::destroy()
 {
-    GX_ASSERT_S(mIsBegun, "Please call begin first");
-
-    uint8_t cmdKey = CommandKey::SetGraphPipelineState;
-    mCommandBuffer.write(cmdKey);
-    mCommandBuffer.write(pipelineState);
-
-    return this;
+    GLockerGuard locker(mMutex);
+    mPending.clear();
+    // 调用前设备已经空闲
+    releaseRetiredPools(UINT64_MAX);
 }
 
-CommandBuffer CommandBufferVk::setVertexLayout(const VertexLayout &vertexLayout)
+bool GpuProfilerVk::isEnabled() const
 {
-    GX_ASSERT_S(mIsBegun, "Please call begin first");
-
-    uint8_t cmdKey = CommandKey::SetVertexLayout;
-    mCommandBuffer.write(cmdKey);
-    mCommandBuffer.write(vertexLayout);
-
-    return this;
+    return mProfiler != nullptr && mProfiler->isGpuEnabled() && mContext->isSupportQueryTimestamp();
 }
 
-CommandBuffer CommandBufferVk::setShaders(const std::vector<Shader> &shaders)
+bool GpuProfilerVk::prepareSlot(QuerySlot &slot, uint32_t queryCount)
 {
-    GX_ASSERT_S(mIsBegun, "Please call begin first");
-
-    uint8_t cmdKey = CommandKey::SetShaders;
-    mCommandBuffer.write(cmdKey);
-    mCommandBuffer.write((uint32_t) shaders.size());
-    for (auto &s : shaders) {
-        mCommandBuffer.write(dynamic_cast<Shader_P *>(s)->idx());
+    slot.queryCount = 0;
+    slot.scopes.reset();
+    if (queryCount == 0) {
+        return false;
     }
 
-    return this;
-}
+    const uint32_t ring = ringSize();
+    if (slot.capacity < queryCount || slot.ringSize != ring) {
+        releaseSlot(slot);
 
-CommandBuffer CommandBufferVk::nextSubpass()
-{
-    GX_ASSERT_S(mIsBegun, "Please call begin first");
+        // 按2的幂扩容，避免标签数量小幅变化时反复重建
+        uint32_t capacity = 16;
+        while (capacity < queryCount) {
+            capacity *= 2;
+        }
 
-    uint8_t cmdKey = CommandKey::NextSubpass;
-    mCommandBuffer.write(cmdKey);
+        VkQueryPoolCreateInfo createInfo{};
+        createInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        createInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        createInfo.queryCount = capacity * ring;
+        VK_CHECK_RESULT(vkCreateQueryPool(mContext->vkContext()->vkDevice(), &createInfo, nullptr, &slot.pool));
+        if (slot.pool == VK_NULL_HANDLE) {
+            return false;
+        }
+        slot.capacity = capacity;
+        slot.ringSize = ring;
+    }
 
-    return this;
+    slot.slice = currentSlice(ring);
+    slot.queryCount = queryCount;
+    slot.scopes = std::make_shared<std::vector<Scope>>();
+    return true;
 }
 
-CommandBuffer CommandBufferVk::setViewport(const Rect2D &viewport, float minDepth, float maxDepth)
+bool GpuProfilerVk::isCurrentSlice(const QuerySlot &slot) const
 {
-    GX_ASSERT_S(mIsBegun, "Please call begin first");
-
-    uint8_t cmdKey = CommandKey::SetViewport;
-    mCommandBuffer.write(cmdKey);
-    mCommandBuffer.write(viewport);
-    mCommandBuffer.write(minDepth);
-    mCommandBuffer.write(maxDepth);
-
-    return this;
+    return slot.queryCount == 0 || slot.slice == currentSlice(slot.ringSize);
 }
 
-CommandBuffer CommandBufferVk::setScissor(const Rect2D &scissor)
+void GpuProfilerVk::releaseSlot(QuerySlot &slot)
 {
-    GX_ASSERT_S(mIsBegun, "Please call begin first");
-
-    uint8_t cmdKey = CommandKey::SetScissor;
-    mCommandBuffer.write(cmdKey);
-    mCommandBuffer.write(scissor);
-
-    return this;
+    if (slot.pool != VK_NULL_HANDLE) {
+        retirePool(slot.pool);
+    }
+    slot.pool = VK_NULL_HANDLE;
+    slot.capacity = 0;
+    slot.ringSize = 0;
+    slot.slice = 0;
+    slot.queryCount = 0;
+    slot.scopes.reset();
 }
 
-CommandBuffer CommandBufferVk::setLineWidth(float lineWidth)
+void GpuProfilerVk::onSubmit(const QuerySlot &slot)
 {
-    GX_ASSERT_S(mIsBegun, "Please call begin first");
-
-    uint8_t cmdKey = CommandKey::SetLineWidth;
-    mCommandBuffer.write(cmdKey);
-    mCommandBuffer.write(lineWidth);
+    if (!slot.scopes || slot.scopes->empty() || !mProfiler->isEnabled()) {
+        return;
+    }
 
-    return this;
+    GLockerGuard locker(mMutex);
+    mPending.push_back({slot.pool, slot.firstQuery(), slot.queryCount, slot.scopes,
+                        mProfiler->frame(), Profiler::now()});
 }
 
-CommandBuffer CommandBufferVk::setStencilCompareMask(StencilFace::Enum face, uint32_t mask)
+void GpuProfilerVk::collect()
 {
-    GX_ASSERT_S(mIsBegun, "Please call begin first");
+    const uint64_t completedSerial = mContext->completedSerial();
 
-    uint8_t cmdKey = CommandKey::SetStencilCompMask;
-    mCommandBuffer.write(cmdKey);
-    mCommandBuffer.write((uint8_t) face);
-    mCommandBuffer.write(mask);
+    GLockerGuard locker(mMutex);
+    const uint64_t frame = mProfiler->frame();
+    const uint64_t latency = mProfiler->latency();
+    size_t keep = 0;
+    for (size_t i = 0; i < mPending.size(); i++) {
+        auto &pending = mPending[i];
+        if (isSuperseded(i)) {
+            continue;
+        }
+        if (pending.frame + latency <= frame) {
+            // 超过延迟帧数仍未完成的结果多等待几帧，之后丢弃
+            if (readResults(pending) || pending.frame + latency * 4 <= frame || !mProfiler->isEnabled()) {
+                continue;
+            }
+        }
+        if (keep != i) {
+            mPending[keep] = std::move(pending);
+        }
+        keep++;
+    }
+    mPending.resize(keep);
 
-    return this;
+    releaseRetiredPools(completedSerial);
 }
 
-CommandBuffer CommandBufferVk::setStencilWriteMask(StencilFace::Enum face, uint32_t mask)
+uint32_t GpuProfilerVk::ringSize() const
 {
-    GX_ASSERT_S(mIsBegun, "Please call begin first");
-
-    uint8_t cmdKey = CommandKey::SetStencilWriteMask;
-    mCommandBuffer.write(cmdKey);
-    mCommandBuffer.write((uint8_t) face);
-    mCommandBuffer.write(mask);
-
-    return this;
+    return mProfiler->latency() + 1;
 }
 
-CommandBuffer CommandBufferVk::setStencilReference(StencilFace::Enum face, uint32_t reference)
+uint32_t GpuProfilerVk::currentSlice(uint32_t ringSize) const
 {
-    GX_ASSERT_S(mIsBegun, "Please call begin first");
-
-    uint8_t cmdKey = CommandKey::SetStencilReference;
-    mCommandBuffer.write(cmdKey);
-    mCommandBuffer.write((uint8_t) face);
-    mCommandBuffer.write(reference);
-
-    return this;
+    return ringSize == 0 ? 0 : (uint32_t) (mProfiler->frame() % ringSize);
 }
 
-CommandBuffer CommandBufferVk::bindResources(ResourceBindPoint::Enum bindPoint,
-                                             const std::vector<ResourceBinder> &binders,
-                                             const std::vector<uint32_t> &dynamicOffsets)
+bool GpuProfilerVk::readResults(const PendingSubmit &pending)
 {
-    GX_ASSERT_S(mIsBegun, "Please call begin first");
-
-    uint8_t cmdKey = CommandKey::BindDescSet;
-    mCommandBuffer.write(cmdKey);
-    mCommandBuffer.write((uint8_t) bindPoint);
-    mCommandBuffer.write((uint32_t)binders.size());
-    for (auto i : binders) {
-        mCommandBuffer.write(dynamic_cast<ResourceBinder_P *>(i)->idx());
+    // 每个查询返回时间戳和可用性两个值，不等待未完成的查询
+    mResults.assign(pending.queryCount * 2, 0);
+    VkResult result = vkGetQueryPoolResults(mContext->vkContext()->vkDevice(), pending.pool,
+                                            pending.firstQuery, pending.queryCount,
+                                            sizeof(uint64_t) * mResults.size(), mResults.data(),
+                                            sizeof(uint64_t) * 2,
+                                            VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+    if (result != VK_SUCCESS && result != VK_NOT_READY) {
+        return false;
     }
-    mCommandBuffer.write((uint32_t)dynamicOffsets.size());
-    mCommandBuffer.write(dynamicOffsets.data(), sizeof(uint32_t) * dynamicOffsets.size());
 
-    return this;
+    uint64_t baseTicks = UINT64_MAX;
+    for (const auto &scope : *pending.scopes) {
+        if (mResults[scope.beginQuery * 2 + 1] == 0 || mResults[scope.endQuery * 2 + 1] == 0) {
+            return false;
+        }
+        baseTicks = std::min(baseTicks, mResults[scope.beginQuery * 2]);
+    }
+
+    // 以提交时的CPU时间作为第一个时间戳的位置
+    const double period = mContext->getTimestampPeriod();
+    for (const auto &scope : *pending.scopes) {
+        uint64_t beginTicks = mResults[scope.beginQuery * 2];
+        uint64_t endTicks = std::max(mResults[scope.endQuery * 2], beginTicks);
+        ProfilerEvent event{
+                scope.name,
+                ProfilerTrack::Gpu,
+                0,
+                scope.depth,
+                pending.frame,
+                pending.submitNs + (uint64_t) ((double) (beginTicks - baseTicks) * period),
+                pending.submitNs + (uint64_t) ((double) (endTicks - baseTicks) * period),
+        };
+        mProfiler->addEvent(std::move(event));
+    }
+    return true;
 }
 
-CommandBuffer CommandBufferVk::bindVertexBuffer(uint32_t firstBinding,
-                                                const std::vector<Buffer> &buffers,
-                                                const std::vector<uint64_t> &offsets)
+bool GpuProfilerVk::isSuperseded(size_t index) const
 {
-    GX_ASSERT_S(mIsBegun, "Please call begin first");
-
-    GX_ASSERT(!buffers.empty());
-    GX_ASSERT(buffers.size() == offsets.size());
-
-    uint8_t size = buffers.size();
-
-    uint8_t cmdKey = CommandKey::BindVertexBuf;
-    mCommandBuffer.write(cmdKey);
-    mCommandBuffer.write(firstBinding);
-    mCommandBuffer.write(size);
-    for (auto &i : buffers) {
-        mCommandBuffer.write(dynamic_cast<Buffer_P *>(i)->idx());
-    }
-    for (uint64_t i : offsets) {
-        mCommandBuffer.write(i);
+    const auto &pending = mPending[index];
+    for (size_t i = index + 1; i < mPending.size(); i++) {
+        if (mPending[i].pool == pending.pool && mPending[i].firstQuery == pending.firstQuery) {
+            return true;
+        }
     }
-
-    return this;
+    return false;
 }
 
-CommandBuffer CommandBufferVk::bindIndexBuffer(Buffer buffer, uint32_t offset, IndexType::Enum indexType)
+void GpuProfilerVk::retirePool(VkQueryPool pool)
 {
-    GX_ASSERT_S(mIsBegun, "Please call begin first");
-
-    GX_ASSERT(buffer);
-    auto *objP = dynamic_cast<Buffer_P *>(buffer);
-    uint8_t cmdKey = CommandKey::BindIndexBuf;
-    mCommandBuffer.write(cmdKey);
-    mCommandBuffer.write(objP->idx());
-    mCommandBuffer.write(offset);
-    mCommandBuffer.write(indexType);
-
-    return this;
+    GLockerGuard locker(mMutex);
+    mRetiredPools.push_back({pool, mContext->submitSerial()});
 }
 
-CommandBuffer CommandBufferVk::draw(uint32_t vertexCount, uint32_t instanceCount,
-                                    uint32_t firstVertex, uint32_t firstInstance)
+void GpuProfilerVk::releaseRetiredPools(uint64_t completedSerial)
 {
-    GX_ASSERT_S(mIsBegun, "Please call begin first");
-
-    uint8_t cmdKey = CommandKey::Draw;
-    mCommandBuffer.write(cmdKey);
-    mCommandBuffer.write(vertexCount);
-    mCommandBuffer.write(instanceCount);
-    mCommandBuffer.write(firstVertex);
-    mCommandBuffer.write(firstInstance);
+    size_t keepPool = 0;
+    for (size_t i = 0; i < mRetiredPools.size(); i++) {
+        const RetiredPool retired = mRetiredPools[i];
+        if (retired.serial > completedSerial) {
+            mRetiredPools[keepPool++] = retired;
+            continue;
+        }
 
-    return this;
+        // 使用该查询池的提交都已执行完成，销毁前读取剩余的结果
+        size_t keep = 0;
+        for (size_t j = 0; j < mPending.size(); j++) {
+            if (mPending[j].pool == retired.pool) {
+                if (mProfiler->isEnabled() && !isSuperseded(j)) {
+                    readResults(mPending[j]);
+                }
+                continue;
+            }
+            if (keep != j) {
+                mPending[keep] = std::move(mPending[j]);
+            }
+            keep++;
+        }
+        mPending.resize(keep);
+        vkDestroyQueryPool(mContext->vkContext()->vkDevice(), retired.pool, nullptr);
+    }
+    mRetiredPools.resize(keepPool);
 }
 
-CommandBuffer CommandBufferVk::drawIndexed(uint32_t indexCount, uint32_t instanceCount,
-                                           uint32_t firstIndex, int32_t vertexOffset,
-                                           uint32_t firstInstance)
-{
-    GX_ASSERT_S(mIsBegun, "Please call begin first");
-
-    uint8_t cmdKey = CommandKey::DrawIndexed;
-    mCommandBuffer.write(cmdKey);
-    mCommandBuffer.write(indexCount);
-    mCommandBuffer.write(instanceCount);
-    mCommandBuffer.write(firstIndex);
-    mCommandBuffer.write(vertexOffset);
-    mCommandBuffer.write(firstInstance);
+/// ============ MemoryBudgetVk ============ ///
 
-    return this;
-}
-
-CommandBuffer CommandBufferVk::drawIndirect(Buffer buffer, uint32_t offset, uint32_t drawCount, uint32_t stride)
+void MemoryBudgetVk::init(ContextVk *context, MemoryTracker *tracker, bool supportBudgetExt)
 {
-    GX_ASSERT_S(mIsBegun, "Please call begin first");
-
-    GX_ASSERT(buffer);
-    auto *objP = dynamic_cast<Buffer_P *>(buffer);
+    mContext = context;
+    mTracker = tracker;
+    mSupportBudgetExt = supportBudgetExt;
+    mMemoryProperties = context->vkContext()->gvkDevice()->deviceMemoryProperties();
 
-    uint8_t cmdKey = CommandKey::DrawIndirect;
-    mCommandBuffer.write(cmdKey);
-    mCommandBuffer.write(objP->idx());
-    mCommandBuffer.write(offset);
-    mCommandBuffer.write(drawCount);
-    mCommandBuffer.write(stride);
+    uint32_t typeHeapIndices[VK_MAX_MEMORY_TYPES];
+    for (uint32_t i = 0; i < mMemoryProperties.memoryTypeCount; i++) {
+        typeHeapIndices[i] = mMemoryProperties.memoryTypes[i].heapIndex;
+    }
+    mTracker->setMemoryTypeHeaps(typeHeapIndices, mMemoryProperties.memoryTypeCount);
 
-    return this;
+    GLockerGuard locker(mMutex);
+    mHeaps.resize(mMemoryProperties.memoryHeapCount);
+    queryHeaps();
 }
 
-CommandBuffer CommandBufferVk::drawIndexedIndirect(Buffer buffer, uint32_t offset, uint32_t drawCount, uint32_t stride)
+void MemoryBudgetVk::setCallback(const MemoryBudgetCallback &callback, float threshold)
 {
-    GX_ASSERT_S(mIsBegun, "Please call begin first");
-
-    GX_ASSERT(buffer);
-    auto *objP = dynamic_cast<Buffer_P *>(buffer);
-
-    uint8_t cmdKey = CommandKey::DrawIndexedIndirect;
-    mCommandBuffer.write(cmdKey);
-    mCommandBuffer.write(objP->idx());
-    mCommandBuffer.write(offset);
-    mCommandBuffer.write(drawCount);
-    mCommandBuffer.write(stride);
-
-    return this;
+    GLockerGuard locker(mMutex);
+    mCallback = callback;
+    mThreshold = threshold > 0.0f ? threshold : 1.0f;
+    // 重新设置后，已经超出预算的内存堆在下一次检查时触发回调
+    for (auto &heap : mHeaps) {
+        heap.overBudget = false;
+    }
 }
 
-CommandBuffer CommandBufferVk::dispatch(uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ)
+bool MemoryBudgetVk::isSupportBudgetExt() const
 {
-    GX_ASSERT_S(mIsBegun, "Please call begin first");
-
-    uint8_t cmdKey = CommandKey::Dispatch;
-    mCommandBuffer.write(cmdKey);
-    mCommandBuffer.write(groupCountX);
-    mCommandBuffer.write(groupCountY);
-    mCommandBuffer.write(groupCountZ);
-
-    return this;
+    return mSupportBudgetExt;
 }
 
-CommandBuffer CommandBufferVk::dispatchIndirect(Buffer buffer, uint32_t offset)
+void MemoryBudgetVk::update()
 {
-    GX_ASSERT_S(mIsBegun, "Please call begin first");
-
-    GX_ASSERT(buffer);
-    auto *objP = dynamic_cast<Buffer_P *>(buffer);
-
-    uint8_t cmdKey = CommandKey::DispatchIndirect;
-    mCommandBuffer.write(cmdKey);
-    mCommandBuffer.write(objP->idx());
-    mCommandBuffer.write(offset);
-
-    return this;
+    std::vector<OverBudgetHeap> overHeaps;
+    {
+        GLockerGuard locker(mMutex);
+        queryHeaps();
+        for (uint32_t i = 0; i < mHeaps.size(); i++) {
+            checkHeap(i, overHeaps);
+        }
+    }
+    notify(overHeaps);
 }
 
-CommandBuffer CommandBufferVk::executeCommands(const std::vector<CommandBuffer> &secondaryCmdBuffers)
+void MemoryBudgetVk::check(uint32_t heapIndex)
 {
-    GX_ASSERT_S(mIsBegun, "Please call begin first");
-
-    if (secondaryCmdBuffers.empty()) {
-        Log("CommandBufferVk::executeCommands secondaryCmdBuffers is empty");
-        return this;
-    }
-
-    for (auto subBuffer : secondaryCmdBuffers) {
-        auto *subBufferVk = dynamic_cast<CommandBufferVk *>(subBuffer);
-        if (subBufferVk->mCommandBuffer.writePos() == 0) {
-            continue;
-        }
-        if (subBufferVk->mIsBegun) {
-            Log("CommandBufferVk::executeCommands secondary command buffer check end failure");
-            continue;
-        }
-        uint8_t cmdKey;
-        GByteArray &cmdBuffer = subBufferVk->mCommandBuffer;
-        cmdBuffer.seekReadPos(SEEK_SET, 0);
-        cmdBuffer.read(cmdKey);
-        if (cmdKey != CommandKey::Begin) {
-            Log("CommandBufferVk::executeCommands secondaryCmdBuffer head is not Begin command");
-            continue;
+    std::vector<OverBudgetHeap> overHeaps;
+    {
+        GLockerGuard locker(mMutex);
+        if (heapIndex >= mHeaps.size()) {
+            return;
         }
-        mCommandBuffer.write(cmdBuffer.data() + cmdBuffer.readPos(),
-                             cmdBuffer.writePos() - sizeof(uint8_t) - cmdBuffer.readPos());
-        cmdBuffer.seekReadPos(SEEK_SET, cmdBuffer.writePos() - sizeof(uint8_t));
-        cmdBuffer.read(cmdKey);
-        GX_ASSERT_S(cmdKey == CommandKey::End, "secondary command buffer check end failure");
+        checkHeap(heapIndex, overHeaps);
     }
-
-    return this;
+    notify(overHeaps);
 }
 
-CommandBuffer CommandBufferVk::pipelineBarrier(PipelineStageMask srcStage, PipelineStageMask dstStage)
+void MemoryBudgetVk::fillStatistics(MemoryStatistics &stats)
 {
-    GX_ASSERT_S(mIsBegun, "Please call begin first");
+    GLockerGuard locker(mMutex);
 
-    uint8_t cmdKey = CommandKey::PipelineBarrier;
-    mCommandBuffer.write(cmdKey);
-    mCommandBuffer.write(srcStage);
-    mCommandBuffer.write(dstStage);
+    stats.budgetFromDriver = mSupportBudgetExt;
 
-    return this;
-}
-
-CommandBuffer CommandBufferVk::bufferMemoryBarrier(Buffer buffer, const BufferBarrierInfo &barrierInfo)
-{
-    GX_ASSERT_S(mIsBegun, "Please call begin first");
+    stats.heaps.resize(mHeaps.size());
+    for (uint32_t i = 0; i < mHeaps.size(); i++) {
+        stats.heaps[i] = heapStatistics(i);
+    }
 
-    GX_ASSERT(buffer);
-    auto *bufferP = dynamic_cast<BufferVk *>(buffer);
+    stats.types.resize(mMemoryProperties.memoryTypeCount);
+    for (uint32_t i = 0; i < mMemoryProperties.memoryTypeCount; i++) {
+        const VkMemoryType &type = mMemoryProperties.memoryTypes[i];
+        stats.types[i].heapIndex = type.heapIndex;
+        stats.types[i].deviceLocal = (type.propertyFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT) != 0;
+        stats.types[i].hostVisible = (type.propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0;
+        stats.types[i].hostCoherent = (type.propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+        stats.types[i].hostCached = (type.propertyFlags & VK_MEMORY_PROPERTY_HOST_CACHED_BIT) != 0;
+    }
 
-    uint8_t cmdKey = CommandKey::BufferBarrier;
-    mCommandBuffer.write(cmdKey);
-    mCommandBuffer.write(bufferP->idx());
-    mCommandBuffer.write(barrierInfo);
+    mTracker->fillStatistics(stats);
 
-    return this;
+    // 资源都从内存块中子分配，设备内存对象数量以分配器和VMA的内存块为准
+    GVkMemoryAllocator *allocator = mContext->memoryAllocator();
+    for (uint32_t i = 0; i < mMemoryProperties.memoryTypeCount; i++) {
+        auto &heap = stats.heaps[mMemoryProperties.memoryTypes[i].heapIndex];
+        heap.deviceMemoryCount += allocator->deviceMemoryCount(i);
+        heap.deviceMemoryBytes += allocator->deviceMemoryBytes(i);
+    }
+#ifdef USE_AMD_VULKAN_MEMORY_ALLOCATOR
+    VmaBudget budgets[VK_MAX_MEMORY_HEAPS];
+    vmaGetHeapBudgets(mContext->getVmaAllocator(), budgets);
+    for (uint32_t i = 0; i < stats.heaps.size(); i++) {
+        stats.heaps[i].deviceMemoryCount += budgets[i].statistics.blockCount;
+        stats.heaps[i].deviceMemoryBytes += budgets[i].statistics.blockBytes;
+    }
+#endif //USE_AMD_VULKAN_MEMORY_ALLOCATOR
 }
 
-CommandBuffer CommandBufferVk::imageMemoryBarrier(Texture texture,
-                                                  ImageLayout::Enum srcLayout,
-                                                  ImageLayout::Enum dstLayout,
-                                                  const ImageSubResourceRange &range)
+void MemoryBudgetVk::queryHeaps()
 {
-    GX_ASSERT_S(mIsBegun, "Please call begin first");
-
-    GX_ASSERT(texture);
-    auto *textureP = dynamic_cast<TextureVk *>(texture);
-
-    uint8_t cmdKey = CommandKey::ImageBarrier;
-    mCommandBuffer.write(cmdKey);
-    mCommandBuffer.write(textureP->idx());
-    mCommandBuffer.write((uint8_t) srcLayout);
-    mCommandBuffer.write((uint8_t) dstLayout);
-    mCommandBuffer.write(range);
-
-    return this;
-}
+    for (uint32_t i = 0; i < mHeaps.size(); i++) {
+        mHeaps[i].trackedBytes = mTracker->heapAllocationBytes(i);
+    }
 
-CommandBuffer CommandBufferVk::copyBuffer(Buffer src, Buffer dst, uint64_t srcOffset, uint64_t dstOffset, uint64_t size)
-{
-    GX_ASSERT_S(mIsBegun, "Please call begin first");
+#if defined(VK_VERSION_1_1)
+    if (mSupportBudgetExt) {
+        VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+        budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
 
-    GX_ASSERT(src);
-    GX_ASSERT(dst);
-    auto *srcP = dynamic_cast<BufferVk *>(src);
-    auto *dstP = dynamic_cast<BufferVk *>(dst);
+        VkPhysicalDeviceMemoryProperties2 properties2{};
+        properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+        properties2.pNext = &budgetProperties;
+        vkGetPhysicalDeviceMemoryProperties2(mContext->vkContext()->gvkDevice()->physicalDevice(), &properties2);
 
-    uint8_t cmdKey = CommandKey::CopyBuffer;
-    mCommandBuffer.write(cmdKey);
-    mCommandBuffer.write(srcP->idx());
-    mCommandBuffer.write(dstP->idx());
-    mCommandBuffer.write(srcOffset);
-    mCommandBuffer.write(dstOffset);
-    mCommandBuffer.write(size);
+        for (uint32_t i = 0; i < mHeaps.size(); i++) {
+            mHeaps[i].budget = budgetProperties.heapBudget[i];
+            mHeaps[i].usage = budgetProperties.heapUsage[i];
+            if (mHeaps[i].budget == 0) {
+                mHeaps[i].budget = mMemoryProperties.memoryHeaps[i].size * 8 / 10;
+            }
+        }
+        return;
+    }
+#endif
 
-    return this;
+    // 与VMA在没有扩展时的估算方式一致
+    for (uint32_t i = 0; i < mHeaps.size(); i++) {
+        mHeaps[i].budget = mMemoryProperties.memoryHeaps[i].size * 8 / 10;
+        mHeaps[i].usage = mHeaps[i].trackedBytes;
+    }
 }
 
-CommandBuffer CommandBufferVk::copyImage(Texture src, Texture dst, const std::vector<ImageCopyInfo> &copyInfos)
+uint64_t MemoryBudgetVk::estimateUsage(uint32_t heapIndex) const
 {
-    GX_ASSERT_S(mIsBegun, "Please call begin first");
-
-    GX_ASSERT(src);
-    GX_ASSERT(dst);
-    auto *srcP = dynamic_cast<TextureVk *>(src);
-    auto *dstP = dynamic_cast<TextureVk *>(dst);
-
-    uint8_t cmdKey = CommandKey::CopyImage;
-    mCommandBuffer.write(cmdKey);
-    mCommandBuffer.write(srcP->idx());
-    mCommandBuffer.write(dstP->idx());
-    mCommandBuffer.write((uint32_t) copyInfos.size());
-    if (!copyInfos.empty()) {
-        for (auto &info : copyInfos) {
-            mCommandBuffer.write(info);
-        }
+    const HeapState &heap = mHeaps[heapIndex];
+    auto delta = (int64_t) (mTracker->heapAllocationBytes(heapIndex) - heap.trackedBytes);
+    if (delta < 0 && (uint64_t) -delta > heap.usage) {
+        return 0;
     }
-
-    return this;
+    return heap.usage + delta;
 }
 
-CommandBuffer CommandBufferVk::copyBufferToImage(Buffer src, Texture dst,
-                                                 const std::vector<BufferImageCopyInfo> &copyInfos)
+void MemoryBudgetVk::checkHeap(uint32_t heapIndex, std::vector<OverBudgetHeap> &overHeaps)
 {
-    GX_ASSERT_S(mIsBegun, "Please call begin first");
-
-    GX_ASSERT(src);
-    GX_ASSERT(dst);
-    auto *srcP = dynamic_cast<BufferVk *>(src);
-    auto *dstP = dynamic_cast<TextureVk *>(dst);
-
-    uint8_t cmdKey = CommandKey::CopyBufferToImage;
-    mCommandBuffer.write(cmdKey);
-    mCommandBuffer.write(srcP->idx());
-    mCommandBuffer.write(dstP->idx());
-    mCommandBuffer.write((uint32_t) copyInfos.size());
-    if (!copyInfos.empty()) {
-        for (auto &info : copyInfos) {
-            mCommandBuffer.write(info);
-        }
+    HeapState &heap = mHeaps[heapIndex];
+    auto limit = (uint64_t) ((double) heap.budget * mThreshold);
+    bool overBudget = estimateUsage(heapIndex) > limit;
+    if (overBudget && !heap.overBudget) {
+        overHeaps.push_back({heapIndex, heapStatistics(heapIndex)});
     }
-
-    return this;
+    heap.overBudget = overBudget;
 }
 
-CommandBuffer CommandBufferVk::copyImageToBuffer(Texture src, Buffer dst,
-                                                 const std::vector<BufferImageCopyInfo> &copyInfos)
+void MemoryBudgetVk::notify(const std::vector<OverBudgetHeap> &overHeaps)
 {
-    GX_ASSERT_S(mIsBegun, "Please call begin first");
-
-    GX_ASSERT(src);
-    GX_ASSERT(dst);
-    auto *srcP = dynamic_cast<TextureVk *>(src);
-    auto *dstP = dynamic_cast<BufferVk *>(dst);
-
-    uint8_t cmdKey = CommandKey::CopyImageToBuffer;
-    mCommandBuffer.write(cmdKey);
-    mCommandBuffer.write(srcP->idx());
-    mCommandBuffer.write(dstP->idx());
-    mCommandBuffer.write((uint32_t) copyInfos.size());
-    if (!copyInfos.empty()) {
-        for (auto &info : copyInfos) {
-            mCommandBuffer.write(info);
+    if (overHeaps.empty()) {
+        return;
+    }
+    MemoryBudgetCallback callback;
+    {
+        GLockerGuard locker(mMutex);
+        callback = mCallback;
+    }
+    for (const auto &over : overHeaps) {
+        Log("Memory heap %u over budget: usage %llu, budget %llu",
+            over.heapIndex, (unsigned long long) over.heap.usage, (unsigned long long) over.heap.budget);
+        if (callback) {
+            callback(over.heapIndex, over.heap);
         }
     }
-
-    return this;
 }
 
-CommandBuffer CommandBufferVk::blitImage(Texture src, Texture dst, const std::vector<ImageBlitInfo> &blitInfos,
-                                         BlitFilter::Enum filter)
+MemoryHeapStatistics MemoryBudgetVk::heapStatistics(uint32_t heapIndex) const
 {
-    GX_ASSERT_S(mIsBegun, "Please call begin first");
-
-    GX_ASSERT(src);
-    GX_ASSERT(dst);
-    auto *srcP = dynamic_cast<TextureVk *>(src);
-    auto *dstP = dynamic_cast<TextureVk *>(dst);
+    MemoryHeapStatistics stats{};
+    stats.size = mMemoryProperties.memoryHeaps[heapIndex].size;
+    stats.budget = mHeaps[heapIndex].budget;
+    stats.usage = estimateUsage(heapIndex);
+    stats.deviceLocal = (mMemoryProperties.memoryHeaps[heapIndex].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+    mTracker->fillHeapStatistics(heapIndex, stats);
+    return stats;
+}
 
-    uint8_t cmdKey = CommandKey::BlitImage;
-    mCommandBuffer.write(cmdKey);
-    mCommandBuffer.write(srcP->idx());
-    mCommandBuffer.write(dstP->idx());
-    mCommandBuffer.write((uint8_t) filter);
-    mCommandBuffer.write((uint32_t) blitInfos.size());
-    if (!blitInfos.empty()) {
-        for (auto &info : blitInfos) {
-            mCommandBuffer.write(info);
-        }
-    }
+/// ============ MappedRangeBatchVk ============ ///
 
-    return this;
+void MappedRangeBatchVk::clear()
+{
+    allocations.clear();
+    offsets.clear();
+    sizes.clear();
 }
 
-CommandBuffer CommandBufferVk::copyRenderTarget(RenderTarget src, RenderTarget dst,
-                                                const std::vector<ImageCopyInfo> &copyInfos,
-                                                uint8_t frameIndex)
+/// ============ CommandBufferVk ============ ///
+
+bool CommandBufferVk::init(Context_T *context, const CreateCommandBufferInfo &createInfo)
 {
-    GX_ASSERT_S(mIsBegun, "Please call begin first");
+    auto *contextP = dynamic_cast<ContextVk *>(context->contextP());
 
-    GX_ASSERT(src);
-    GX_ASSERT(dst);
-    auto *srcP = dynamic_cast<RenderTargetVk *>(src);
-    auto *dstP = dynamic_cast<RenderTargetVk *>(dst);
+    GVkContext *vkContext = contextP->vkContext();
 
-    uint8_t cmdKey = CommandKey::CopyRT;
-    mCommandBuffer.write(cmdKey);
-    mCommandBuffer.write(srcP->idx());
-    mCommandBuffer.write(dstP->idx());
-    mCommandBuffer.write(frameIndex);
-    mCommandBuffer.write((uint32_t) copyInfos.size());
-    if (!copyInfos.empty()) {
-        for (auto &info : copyInfos) {
-            mCommandBuffer.write(info);
-        }
+    GVkQueue *queue;
+    switch (createInfo.queueType) {
+        default:
+        case QueueType::Graphics:
+            queue = vkContext->graphicsQueue();
+            break;
+        case QueueType::Compute:
+            queue = vkContext->computeQueue();
+            break;
+        case QueueType::Transfer:
+            queue = vkContext->transferQueue();
+            break;
     }
 
-    return this;
-}
-
-CommandBuffer CommandBufferVk::blitRenderTarget(RenderTarget src, RenderTarget dst,
-                                                const std::vector<ImageBlitInfo> &blitInfos,
-                                                BlitFilter::Enum filter,
-                                                uint8_t frameIndex)
-{
-    GX_ASSERT_S(mIsBegun, "Please call begin first");
-
-    GX_ASSERT(src);
-    GX_ASSERT(dst);
-    auto *srcP = dynamic_cast<RenderTargetVk *>(src);
-    auto *dstP = dynamic_cast<RenderTargetVk *>(dst);
+    // VkCommandPool需要外部同步，每个CommandBuffer使用独立的池
+    // 重新录制全部指令时通过vkResetCommandPool整体回收，修补后单独重置提交的VkCommandBuffer
+    mVkCommandPool.create(queue, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+    if (!mVkCommandPool.isCreated()) {
+        Log("CommandBufferVk::init create command pool failure");
+        return false;
+    }
 
-    uint8_t cmdKey = CommandKey::BlitRT;
-    mCommandBuffer.write(cmdKey);
-    mCommandBuffer.write(srcP->idx());
-    mCommandBuffer.write(dstP->idx());
-    mCommandBuffer.write((uint8_t) filter);
-    mCommandBuffer.write(frameIndex);
-    mCommandBuffer.write((uint32_t) blitInfos.size());
-    if (!blitInfos.empty()) {
-        for (auto &info : blitInfos) {
-            mCommandBuffer.write(info);
-        }
+    initRecorder(context, createInfo, contextP->commandArena());
+    mCreateBufferCount = createInfo.bufferCount;
+    mAsyncCompile = createInfo.asyncCompile && mLevel == CommandBufferLevel::Primary;
+    auto vkCommandBuffers = mVkCommandPool.allocateCommandBuffers(
+            createInfo.bufferCount,
+            mLevel == CommandBufferLevel::Secondary ? VK_COMMAND_BUFFER_LEVEL_SECONDARY
+                                                    : VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+    mRecordedBuffers.resize(vkCommandBuffers.size());
+    for (size_t i = 0; i < vkCommandBuffers.size(); i++) {
+        mRecordedBuffers[i].vkCommandBuffer = vkCommandBuffers[i];
     }
 
-    return this;
+    return true;
 }
 
-CommandBuffer CommandBufferVk::blitRenderTargetToImage(RenderTarget src, Texture dst,
-                                                       const std::vector<ImageBlitInfo> &blitInfos,
-                                                       BlitFilter::Enum filter,
-                                                       uint8_t attachIndex,
-                                                       uint8_t frameIndex)
+void CommandBufferVk::destroy()
 {
-    GX_ASSERT_S(mIsBegun, "Please call begin first");
+    waitCompile();
 
-    GX_ASSERT(src);
-    GX_ASSERT(dst);
+    // 销毁指令池时会一并释放其中的VkCommandBuffer
+    mVkCommandPool.destroy();
 
-    auto *srcP = dynamic_cast<RenderTargetVk *>(src);
-    auto *dstP = dynamic_cast<TextureVk *>(dst);
-
-    uint8_t cmdKey = CommandKey::BlitRTToImage;
-    mCommandBuffer.write(cmdKey);
-    mCommandBuffer.write(srcP->idx());
-    mCommandBuffer.write(dstP->idx());
-    mCommandBuffer.write((uint8_t) filter);
-    mCommandBuffer.write(attachIndex);
-    mCommandBuffer.write(frameIndex);
-    mCommandBuffer.write((uint32_t) blitInfos.size());
-    if (!blitInfos.empty()) {
-        for (auto &info : blitInfos) {
-            mCommandBuffer.write(info);
-        }
+    auto *contextVk = dynamic_cast<ContextVk *>(mContextT->contextP());
+    for (auto &record : mRecordedBuffers) {
+        releaseRecord(contextVk, record);
     }
-
-    return this;
+    for (auto &record : mSpareBuffers) {
+        releaseRecord(contextVk, record);
+    }
+    mRecordedBuffers.clear();
+    mSpareBuffers.clear();
+    destroyRecorder();
 }
 
-CommandBuffer CommandBufferVk::copyRenderTargetToImage(RenderTarget src, Texture dst,
-                                                       const std::vector<ImageCopyInfo> &copyInfos,
-                                                       uint8_t attachIndex,
-                                                       uint8_t frameIndex)
+VkCommandBuffer CommandBufferVk::getVkCommandBuffer(uint32_t index)
 {
-    GX_ASSERT_S(mIsBegun, "Please call begin first");
-
-    GX_ASSERT(src);
-    GX_ASSERT(dst);
+    index = index % mRecordedBuffers.size();
+    return mRecordedBuffers[index].vkCommandBuffer;
+}
 
-    auto *srcP = dynamic_cast<RenderTargetVk *>(src);
-    auto *dstP = dynamic_cast<TextureVk *>(dst);
+uint32_t CommandBufferVk::bufferCount() const
+{
+    return (uint32_t) mRecordedBuffers.size();
+}
 
-    uint8_t cmdKey = CommandKey::CopyRTToImage;
-    mCommandBuffer.write(cmdKey);
-    mCommandBuffer.write(srcP->idx());
-    mCommandBuffer.write(dstP->idx());
-    mCommandBuffer.write(attachIndex);
-    mCommandBuffer.write(frameIndex);
-    mCommandBuffer.write((uint32_t) copyInfos.size());
-    if (!copyInfos.empty()) {
-        for (auto &info : copyInfos) {
-            mCommandBuffer.write(info);
-        }
+void CommandBufferVk::compile(uint32_t bufferIndex)
+{
+    if (!mIsCompiled) {
+        compileCommand();
+    } else {
+        compileCommand(bufferIndex % mRecordedBuffers.size());
     }
-
-    return this;
 }
 
-CommandBuffer CommandBufferVk::copyRenderTargetToBuffer(RenderTarget src, Buffer dst,
-                                                        const std::vector<BufferImageCopyInfo> &copyInfos,
-                                                        uint8_t attachIndex,
-                                                        uint8_t frameIndex)
+void CommandBufferVk::setSubmitSerial(uint32_t bufferIndex, uint64_t serial)
 {
-    GX_ASSERT_S(mIsBegun, "Please call begin first");
-
-    GX_ASSERT(src);
-    GX_ASSERT(dst);
-
-    auto *srcP = dynamic_cast<RenderTargetVk *>(dst);
-    auto *dstP = dynamic_cast<BufferVk *>(dst);
+    auto &record = mRecordedBuffers[bufferIndex % mRecordedBuffers.size()];
+    record.submitSerial = serial;
+    if (serial == 0) {
+        return;
+    }
 
-    uint8_t cmdKey = CommandKey::CopyRTToBuffer;
-    mCommandBuffer.write(cmdKey);
-    mCommandBuffer.write(srcP->idx());
-    mCommandBuffer.write(dstP->idx());
-    mCommandBuffer.write(attachIndex);
-    mCommandBuffer.write(frameIndex);
-    mCommandBuffer.write((uint32_t) copyInfos.size());
-    if (!copyInfos.empty()) {
-        for (auto &info : copyInfos) {
-            mCommandBuffer.write(info);
+    // 执行的Secondary随主指令缓冲一同执行，重新编译前同样需要等待该提交完成
+    auto *contextVk = dynamic_cast<ContextVk *>(mContextT->contextP());
+    for (const auto &executed : record.secondaries) {
+        auto *secondary = dynamic_cast<CommandBufferVk *>(contextVk->findCommandBufferP(executed.idx));
+        if (secondary != nullptr) {
+            secondary->markSubmitted(executed.vkCommandBuffer, serial);
         }
     }
-
-    return this;
 }
 
-CommandBuffer CommandBufferVk::fillBuffer(Buffer buffer, uint64_t offset, uint64_t size, uint32_t data)
+uint32_t CommandBufferVk::barrierCommandCount() const
 {
-    GX_ASSERT_S(mIsBegun, "Please call begin first");
-    GX_ASSERT(buffer);
-
-    auto *bufferP = dynamic_cast<BufferVk *>(buffer);
-
-    uint8_t cmdKey = CommandKey::FillBuffer;
-    mCommandBuffer.write(cmdKey);
-    mCommandBuffer.write(bufferP->idx());
-    mCommandBuffer.write(offset);
-    mCommandBuffer.write(size);
-    mCommandBuffer.write(data);
-
-    return this;
+    return mBarrierCommandCount;
 }
 
-CommandBuffer CommandBufferVk::beginDebugLabel(const std::string &label)
+uint32_t CommandBufferVk::barrierCount() const
 {
-    GX_ASSERT_S(mIsBegun, "Please call begin first");
-
-    uint8_t cmdKey = CommandKey::BeginDebug;
-    mCommandBuffer.write(cmdKey);
-    mCommandBuffer.write(label);
-
-    return this;
+    return mBarrierCount;
 }
 
-CommandBuffer CommandBufferVk::endDebugLabel()
+uint32_t CommandBufferVk::redundantStateCount() const
 {
-    GX_ASSERT_S(mIsBegun, "Please call begin first");
-
-    uint8_t cmdKey = CommandKey::EndDebug;
-    mCommandBuffer.write(cmdKey);
-
-    return this;
+    return mRedundantStateCount + mElidedStateCount;
 }
 
-CommandBuffer CommandBufferVk::resetQuery(Query query, uint32_t firstQuery, uint32_t queryCount)
+uint32_t CommandBufferVk::mergedDrawCount() const
 {
-    GX_ASSERT_S(mIsBegun, "Please call begin first");
-    GX_ASSERT(query);
-
-    auto *queryP = dynamic_cast<QueryVk *>(query);
-
-    uint8_t cmdKey = CommandKey::ResetQuery;
-    mCommandBuffer.write(cmdKey);
-    mCommandBuffer.write(queryP->idx());
-    mCommandBuffer.write(firstQuery);
-    mCommandBuffer.write(queryCount);
+    return mMergedDrawCount;
+}
 
-    return this;
+uint32_t CommandBufferVk::pipelineBindCount() const
+{
+    return mPipelineBindCount;
 }
 
-CommandBuffer CommandBufferVk::beginQuery(Query query, uint32_t queryIndex, bool precise)
+const GpuProfilerVk::QuerySlot &CommandBufferVk::querySlot(uint32_t index) const
 {
-    GX_ASSERT_S(mIsBegun, "Please call begin first");
-    GX_ASSERT(query);
+    return mRecordedBuffers[index % mRecordedBuffers.size()].querySlot;
+}
 
-    auto *queryP = dynamic_cast<QueryVk *>(query);
+bool CommandBufferVk::isCompiled(uint32_t bufferIndex)
+{
+    waitCompile();
+    if (!mIsCompiled) {
+        return false;
+    }
+    const auto &record = mRecordedBuffers[bufferIndex % mRecordedBuffers.size()];
+    if (record.patchVersion != mPatchVersion) {
+        return false;
+    }
+    if (mLevel == CommandBufferLevel::Primary) {
+        auto &gpuProfiler = dynamic_cast<ContextVk *>(mContextT->contextP())->gpuProfiler();
+        // GPU采样开关变化后需要重新录制以增减时间戳指令
+        if (record.profiled != gpuProfiler.isEnabled()) {
+            return false;
+        }
+        // 时间戳需要写入当前帧对应的查询段，之前的段可能还未读取
+        if (record.profiled && !gpuProfiler.isCurrentSlice(record.querySlot)) {
+            return false;
+        }
+    }
+    auto *contextVk = dynamic_cast<ContextVk *>(mContextT->contextP());
+    if (record.usesStreaming && record.residencyEpoch != contextVk->residencyEpoch()) {
+        return false;
+    }
+    // 执行的Secondary重新录制或重新编译后，需要重新录制以执行新的VkCommandBuffer
+    if (!record.secondaries.empty()) {
+        for (const auto &executed : record.secondaries) {
+            auto *secondary = dynamic_cast<CommandBufferVk *>(contextVk->findCommandBufferP(executed.idx));
+            if (secondary == nullptr || !secondary->isCompiledVersion(executed.compileVersion)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
 
-    uint8_t cmdKey = CommandKey::BeginQuery;
-    mCommandBuffer.write(cmdKey);
-    mCommandBuffer.write(queryP->idx());
-    mCommandBuffer.write(queryIndex);
-    mCommandBuffer.write(precise);
+void CommandBufferVk::waitCompile()
+{
+    std::unique_lock<std::mutex> lock(mCompileMutex);
+    mCompileCond.wait(lock, [this]() {
+        return !mCompilePending;
+    });
+}
 
-    return this;
+void CommandBufferVk::onEnd()
+{
+    if (mAsyncCompile) {
+        {
+            std::lock_guard<std::mutex> lock(mCompileMutex);
+            mCompilePending = true;
+        }
+        dynamic_cast<ContextVk *>(mContextT->contextP())->enqueueCompile(this);
+    }
 }
 
-CommandBuffer CommandBufferVk::endQuery(Query query, uint32_t queryIndex)
+void CommandBufferVk::onPatched()
 {
-    GX_ASSERT_S(mIsBegun, "Please call begin first");
-    GX_ASSERT(query);
+    // 已录制的VkCommandBuffer各自在下一次提交前重新录制，不影响其他仍在执行的VkCommandBuffer
+    mPatchVersion++;
+}
 
-    auto *queryP = dynamic_cast<QueryVk *>(query);
+void CommandBufferVk::prepareRecord(ContextVk *context, uint32_t index)
+{
+    auto &record = mRecordedBuffers[index];
+    const uint64_t completedSerial = context->completedSerial();
+    if (record.submitSerial > completedSerial) {
+        // 上一次提交可能仍在执行，不能重置，换用已执行完成的空闲VkCommandBuffer
+        RecordedBuffer spare{};
+        auto it = std::find_if(mSpareBuffers.begin(), mSpareBuffers.end(), [completedSerial](const RecordedBuffer &b) {
+            return b.submitSerial <= completedSerial;
+        });
+        if (it != mSpareBuffers.end()) {
+            spare = std::move(*it);
+            mSpareBuffers.erase(it);
+        } else {
+            spare.vkCommandBuffer = mVkCommandPool.allocateCommandBuffer(
+                    mLevel == CommandBufferLevel::Secondary ? VK_COMMAND_BUFFER_LEVEL_SECONDARY
+                                                            : VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+        }
+        mSpareBuffers.push_back(std::move(record));
+        record = std::move(spare);
+    }
+    VK_CHECK_RESULT(vkResetCommandBuffer(record.vkCommandBuffer, 0));
+}
 
-    uint8_t cmdKey = CommandKey::EndQuery;
-    mCommandBuffer.write(cmdKey);
-    mCommandBuffer.write(queryP->idx());
-    mCommandBuffer.write(queryIndex);
+void CommandBufferVk::runPendingCompile()
+{
+    compileCommand();
 
-    return this;
+    std::lock_guard<std::mutex> lock(mCompileMutex);
+    mCompilePending = false;
+    mCompileCond.notify_all();
 }
 
-CommandBuffer CommandBufferVk::writeTimestamp(PipelineStage::Enum pipelineStage, Query query, uint32_t queryIndex)
+uint32_t CommandBufferVk::countDrawRun(ContextVk *context, uint8_t drawKey,
+                                       const SortedRegion *sortedRegion, size_t sortedCursor)
 {
-    GX_ASSERT_S(mIsBegun, "Please call begin first");
-    GX_ASSERT(query);
-
-    auto *queryP = dynamic_cast<QueryVk *>(query);
+    if (!context->isSupportMultiDrawIndirect()) {
+        return 0;
+    }
 
-    uint8_t cmdKey = CommandKey::WriteTimestamp;
-    mCommandBuffer.write(cmdKey);
-    mCommandBuffer.write((uint32_t)pipelineStage);
-    mCommandBuffer.write(queryP->idx());
-    mCommandBuffer.write(queryIndex);
+    // Draw和DrawIndexed的参数为varint编码，firstInstance位于末尾
+    const uint32_t fieldCount = drawKey == CommandKey::Draw ? 4 : 5;
+    const bool allowFirstInstance = context->isSupportDrawIndirectFirstInstance();
+    const uint32_t maxCount = context->maxDrawIndirectCount() - 1;
+    const uint64_t endPos = mCommandBuffer.writePos();
 
-    return this;
+    uint64_t pos = mCommandBuffer.readPos();
+    uint32_t count = 0;
+    while (count < maxCount) {
+        if (sortedRegion != nullptr) {
+            if (sortedCursor + count >= sortedRegion->commands.size()) {
+                break;
+            }
+            pos = sortedRegion->commands[sortedCursor + count];
+        }
+        if (pos >= endPos || mCommandBuffer.byteAt(pos) != drawKey) {
+            break;
+        }
+        uint64_t fieldPos = pos + sizeof(uint8_t);
+        uint32_t firstInstance = 0;
+        for (uint32_t f = 0; f < fieldCount; f++) {
+            firstInstance = mCommandBuffer.decodeVarint(fieldPos);
+        }
+        if (!allowFirstInstance && firstInstance != 0) {
+            break;
+        }
+        count++;
+        pos = fieldPos;
+    }
+    return count;
 }
 
-CommandBuffer CommandBufferVk::copyQueryResults(Query query,
-                                                uint32_t firstQuery,
-                                                uint32_t queryCount,
-                                                Buffer dstBuffer,
-                                                uint64_t dstOffset,
-                                                QueryResultFlags resultFlags)
+void *CommandBufferVk::allocIndirect(ContextVk *context, RecordedBuffer &record, VkDeviceSize size,
+                                     VkBuffer &buffer, VkDeviceSize &offset)
 {
-    GX_ASSERT_S(mIsBegun, "Please call begin first");
-    GX_ASSERT(query);
-    GX_ASSERT(dstBuffer);
-
-    auto *queryP = dynamic_cast<QueryVk *>(query);
-    auto *bufferP = dynamic_cast<BufferVk *>(dstBuffer);
+    while (record.indirectChunkIndex < record.indirectChunks.size()) {
+        IndirectChunk &chunk = record.indirectChunks[record.indirectChunkIndex];
+        if (chunk.used + size <= chunk.buffer.size()) {
+            buffer = chunk.buffer.vkBuffer();
+            offset = chunk.used;
+            chunk.used += size;
+            return (uint8_t *) chunk.mapped + offset;
+        }
+        record.indirectChunkIndex++;
+    }
 
-    uint8_t cmdKey = CommandKey::CopyQueryResults;
-    mCommandBuffer.write(cmdKey);
-    mCommandBuffer.write(queryP->idx());
-    mCommandBuffer.write(firstQuery);
-    mCommandBuffer.write(queryCount);
-    mCommandBuffer.write(bufferP->idx());
-    mCommandBuffer.write(dstOffset);
-    mCommandBuffer.write(resultFlags);
+    IndirectChunk chunk;
+    chunk.buffer.create(context->vkContext()->gvkDevice(),
+                        VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                        VK_SHARING_MODE_EXCLUSIVE,
+                        std::max<VkDeviceSize>(INDIRECT_CHUNK_SIZE, size),
+                        nullptr,
+                        context->memoryAllocator());
+    chunk.mapped = chunk.buffer.map();
+    chunk.used = size;
+    chunk.memoryRecord.category = MemoryCategory::Staging;
+    chunk.memoryRecord.memoryType = chunk.buffer.memoryTypeIndex();
+    chunk.memoryRecord.size = chunk.buffer.memorySize();
+    context->trackMemory(chunk.memoryRecord);
+    record.indirectChunks.push_back(chunk);
 
-    return this;
+    buffer = chunk.buffer.vkBuffer();
+    offset = 0;
+    return chunk.mapped;
 }
 
-void CommandBufferVk::resetCommandBuffer()
+void CommandBufferVk::releaseRecord(ContextVk *context, RecordedBuffer &record)
 {
-    mCommandBuffer.reset();
-    mIsCompiled = false;
+    context->gpuProfiler().releaseSlot(record.querySlot);
+    for (auto &chunk : record.indirectChunks) {
+        context->untrackMemory(chunk.memoryRecord);
+        chunk.buffer.destroy();
+    }
+    record.indirectChunks.clear();
 }
 
-void CommandBufferVk::compileCommand(FrameVk *frame)
+void CommandBufferVk::compileCommand(uint32_t bufferIndex)
 {
 //    Log("CommandBufferVk::compileCommand");
     if (mCommandBuffer.writePos() == 0) {
@@ -6235,42 +6573,202 @@ void CommandBufferVk::compileCommand(FrameVk *frame)
         return;
     }
 
+    ProfilerScope zone(mContextT->profiler(), "CommandBufferVk::compileCommand");
+    const uint64_t compileBeginNs = Profiler::now();
+
     ContextVk *contextVk = dynamic_cast<ContextVk *>(mContextT->contextP());
+    const bool fullCompile = bufferIndex == COMPILE_ALL_BUFFERS;
+    mBarrierBatch.setUseSynchronization2(contextVk->isSupportSynchronization2());
+
+    auto &gpuProfiler = contextVk->gpuProfiler();
+    const bool profiled = mLevel == CommandBufferLevel::Primary && gpuProfiler.isEnabled();
+
+    uint32_t beginIndex = bufferIndex;
+    uint32_t endIndex = bufferIndex + 1;
+    if (fullCompile) {
+        mCommandCounts = {};
+        mPipelineBindCount = 0;
+        mBarrierCommandCount = 0;
+        mBarrierCount = 0;
+        mRedundantStateCount = 0;
+        mMergedDrawCount = 0;
+
+        // 只有一个VkCommandBuffer时绑定了多帧缓冲的渲染目标，为每个帧缓冲分别录制，
+        // 提交时按帧序号选择，避免每帧重新录制同一个VkCommandBuffer
+        if (mLevel == CommandBufferLevel::Primary && mCreateBufferCount == 1
+            && mMaxFrameBufferCount > mRecordedBuffers.size()) {
+            auto vkCommandBuffers = mVkCommandPool.allocateCommandBuffers(
+                    mMaxFrameBufferCount - (uint32_t) mRecordedBuffers.size(), VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+            for (auto vkCommandBuffer : vkCommandBuffers) {
+                mRecordedBuffers.emplace_back();
+                mRecordedBuffers.back().vkCommandBuffer = vkCommandBuffer;
+            }
+        }
+        beginIndex = 0;
+        endIndex = (uint32_t) mRecordedBuffers.size();
+    }
+
+    // 所有VkCommandBuffer的提交都已执行完成时整体重置指令池回收内存
+    // 否则逐个准备，仍在执行的VkCommandBuffer及其间接缓冲块保留到提交完成
+    bool resetPool = fullCompile;
+    if (resetPool) {
+        const uint64_t completedSerial = contextVk->completedSerial();
+        for (const auto &record : mRecordedBuffers) {
+            resetPool = resetPool && record.submitSerial <= completedSerial;
+        }
+        for (const auto &record : mSpareBuffers) {
+            resetPool = resetPool && record.submitSerial <= completedSerial;
+        }
+    }
+    if (resetPool) {
+        VK_CHECK_RESULT(vkResetCommandPool(contextVk->vkContext()->vkDevice(), mVkCommandPool, 0));
+    }
 
     uint8_t cmdKey;
-    for (uint32_t i = 0; i < mVkCommandBuffers.size(); i++) {
-        auto vkCmdBuf = mVkCommandBuffers[i];
+    for (uint32_t i = beginIndex; i < endIndex; i++) {
+        if (!resetPool) {
+            prepareRecord(contextVk, i);
+        }
+        auto &record = mRecordedBuffers[i];
+        auto vkCmdBuf = record.vkCommandBuffer;
+        record.patchVersion = mPatchVersion;
+        record.profiled = profiled;
+        // 每个VkCommandBuffer录制的内容相同，只统计一次
+        const bool countStatistics = fullCompile && i == 0;
+
+        // 该VkCommandBuffer上一次录制的指令已不再执行，其间接缓冲块重新分配
+        for (auto &chunk : record.indirectChunks) {
+            chunk.used = 0;
+        }
+        record.indirectChunkIndex = 0;
+        record.secondaries.clear();
+        // 引用流式纹理时记录驻留版本，驻留范围改变后需要重新录制
+        record.usesStreaming = false;
+        record.residencyEpoch = contextVk->residencyEpoch();
+        auto trackTexture = [&record](const TextureVk *texture) {
+            record.usesStreaming = record.usesStreaming || texture->isStreaming();
+        };
+        BoundState &bound = mScratch.bound;
+        bound.reset();
         VkClearValue clearColor{};
         VkClearValue depthStencil{};
 
-        uint32_t frameIndex =
-                mVkCommandBuffers.size() == 1
-                ? (frame == GFX_NULL_HANDLE
-                   ? i : frame->currentFrameIndex()) : i;
+        // 第i个VkCommandBuffer使用渲染目标的第i个帧缓冲
+        const uint32_t frameIndex = i;
 
         std::string debugLabel;
 
+        // 每个调试标签区间使用一对时间戳查询
+        auto &querySlot = record.querySlot;
+        const bool profiling = gpuProfiler.prepareSlot(querySlot, profiled ? mDebugLabelCount * 2 : 0);
+        auto &openScopes = mScratch.openScopes;
+        openScopes.clear();
+
         RenderTargetVk *renderTargetVk = nullptr;
+        RenderPassVk *currentRenderPass = nullptr;
         PipelineLayoutVk *pipelineLayout = nullptr;
         PipelineVk *graphPipeline = nullptr;
         PipelineVk *computePipeline = nullptr;
+        uint32_t subpassContentsIndex = 0;
+        const SortedRegion *sortedRegion = nullptr;
+        size_t sortedCursor = 0;
+
+        // 合并的绘制在无序绘制区间中按排序结果读取，否则紧随当前指令
+        auto seekNextDraw = [&]() {
+            if (sortedRegion != nullptr) {
+                mCommandBuffer.seekReadPos(SEEK_SET, sortedRegion->commands[sortedCursor++]);
+            }
+            uint8_t drawKey;
+            mCommandBuffer.read(drawKey);
+        };
 
         CreateGraphicsPipelineStateInfo createGraphPipelineInfo{};
         CreateComputePipelineStateInfo createComputePipelineInfo{};
 
+        if (mLevel == CommandBufferLevel::Secondary && mInheritance.renderPass != nullptr) {
+            renderTargetVk = mInheritance.renderTarget;
+            currentRenderPass = mInheritance.renderPass;
+            createGraphPipelineInfo.renderPass = mInheritance.renderPass->idx();
+            createGraphPipelineInfo.subpassIndex = mInheritance.subpass;
+        }
+
         mCommandBuffer.seekReadPos(SEEK_SET, 0);
+        mBarrierBatch.clear();
         do {
+            // 无序绘制区间按排序结果跳转读取位置
+            if (sortedRegion != nullptr) {
+                if (sortedCursor < sortedRegion->commands.size()) {
+                    mCommandBuffer.seekReadPos(SEEK_SET, sortedRegion->commands[sortedCursor++]);
+                } else {
+                    mCommandBuffer.seekReadPos(SEEK_SET, sortedRegion->endPos);
+                    sortedRegion = nullptr;
+                }
+            }
+
+            const uint64_t cmdPos = mCommandBuffer.readPos();
             mCommandBuffer.read(cmdKey);
+            if (countStatistics) {
+                mCommandCounts.count(cmdKey);
+            }
+
+            // 被修补过的指令使用修补后的参数
+            const PatchPoint *patchPoint = nullptr;
+            if (!mPatches.empty()) {
+                auto it = std::lower_bound(mPatches.begin(), mPatches.end(), cmdPos,
+                                           [](const PatchPoint &patch, uint64_t pos) {
+                                               return patch.pos < pos;
+                                           });
+                if (it != mPatches.end() && it->pos == cmdPos && it->patched) {
+                    patchPoint = &*it;
+                }
+            }
+
+            // 相邻的Barrier指令合并，遇到其他指令前提交
+            if (cmdKey != CommandKey::PipelineBarrier
+                && cmdKey != CommandKey::BufferBarrier
+                && cmdKey != CommandKey::ImageBarrier
+                && !mBarrierBatch.empty()) {
+                uint32_t count = mBarrierBatch.flush(vkCmdBuf);
+                if (countStatistics) {
+                    mBarrierCount += count;
+                }
+            }
 
             switch (cmdKey) {
                 case CommandKey::Begin: {
                     VkCommandBufferBeginInfo cmdBufferBeginInfo{};
                     cmdBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 
+                    VkCommandBufferInheritanceInfo inheritanceInfo{};
+                    if (mLevel == CommandBufferLevel::Secondary) {
+                        inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+                        if (mInheritance.renderPass != nullptr) {
+                            inheritanceInfo.renderPass = *mInheritance.renderPass->vkRenderPass();
+                            inheritanceInfo.subpass = mInheritance.subpass;
+                            if (i < mInheritance.framebuffers.size()) {
+                                inheritanceInfo.framebuffer = mInheritance.framebuffers[i];
+                            }
+                            cmdBufferBeginInfo.flags |= VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+                        }
+                        if (mInheritance.simultaneousUse) {
+                            cmdBufferBeginInfo.flags |= VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
+                        }
+                        cmdBufferBeginInfo.pInheritanceInfo = &inheritanceInfo;
+                    }
+
                     vkBeginCommandBuffer(vkCmdBuf, &cmdBufferBeginInfo);
+                    if (profiling) {
+                        vkCmdResetQueryPool(vkCmdBuf, querySlot.pool, querySlot.firstQuery(), querySlot.queryCount);
+                    }
                 }
                     break;
                 case CommandKey::End: {
+                    // 未配对结束的区间在指令缓冲末尾结束
+                    while (profiling && !openScopes.empty()) {
+                        vkCmdWriteTimestamp(vkCmdBuf, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, querySlot.pool,
+                                            querySlot.firstQuery() + (*querySlot.scopes)[openScopes.back()].endQuery);
+                        openScopes.pop_back();
+                    }
                     vkEndCommandBuffer(vkCmdBuf);
                 }
                     break;
@@ -6304,7 +6802,7 @@ void CommandBufferVk::compileCommand(FrameVk *frame)
                     GX_ASSERT_S(renderTargetVk != nullptr, "CommandBufferVk::compileCommand we need to bind render target first");
 
                     Rect2D renderArea{};
-                    RenderPassInfo renderPassInfo{};
+                    RenderPassInfo &renderPassInfo = mScratch.renderPassInfo;
 
                     mCommandBuffer.read(renderArea);
                     readRenderPassInfo(mCommandBuffer, renderPassInfo);
@@ -6319,14 +6817,14 @@ void CommandBufferVk::compileCommand(FrameVk *frame)
                     renderArea.width = std::clamp(renderArea.width, 0u, (uint32_t)(rtWidth - renderArea.x));
                     renderArea.height = std::clamp(renderArea.height, 0u, (uint32_t)(rtHeight - renderArea.y));
 
-                    std::vector<VkClearValue> clearValues;
-                    clearValues.reserve(renderPass->colorAttachmentCount()
-                                        + renderTargetVk->hasDepthStencilAttachment());
+                    std::array<VkClearValue, RenderTargetAttachmentFlag::ColorCount + 1> clearValues{};
+                    uint32_t clearValueCount = 0;
+                    GX_ASSERT(renderPass->colorAttachmentCount() <= RenderTargetAttachmentFlag::ColorCount);
                     for (uint32_t x = 0; x < renderPass->colorAttachmentCount(); x++) {
-                        clearValues.push_back(clearColor);
+                        clearValues[clearValueCount++] = clearColor;
                     }
                     if (renderTargetVk->hasDepthStencilAttachment()) {
-                        clearValues.push_back(depthStencil);
+                        clearValues[clearValueCount++] = depthStencil;
                     }
 
                     VkRenderPassBeginInfo renderPassBeginInfo{};
@@ -6334,31 +6832,53 @@ void CommandBufferVk::compileCommand(FrameVk *frame)
                     renderPassBeginInfo.renderPass = *renderPass->vkRenderPass();
                     renderPassBeginInfo.renderArea = {{renderArea.x,     renderArea.y},
                                                       {renderArea.width, renderArea.height}};
-                    renderPassBeginInfo.clearValueCount = clearValues.size();
+                    renderPassBeginInfo.clearValueCount = clearValueCount;
                     renderPassBeginInfo.pClearValues = clearValues.data();
                     renderPassBeginInfo.framebuffer = *(renderTargetVk->getVkFrameBuffer(renderPass, frameIndex));
 
-                    vkCmdBeginRenderPass(vkCmdBuf, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+                    VkSubpassContents contents = subpassContentsIndex < mSubpassContents.size()
+                                                 ? (VkSubpassContents) mSubpassContents[subpassContentsIndex++]
+                                                 : VK_SUBPASS_CONTENTS_INLINE;
+                    vkCmdBeginRenderPass(vkCmdBuf, &renderPassBeginInfo, contents);
 
                     createGraphPipelineInfo.subpassIndex = 0;
                     createGraphPipelineInfo.renderPass = renderPass->idx();
+                    currentRenderPass = renderPass;
                     graphPipeline = nullptr;
                 }
                     break;
                 case CommandKey::EndRenderPass: {
                     vkCmdEndRenderPass(vkCmdBuf);
 
+                    currentRenderPass = nullptr;
                     createGraphPipelineInfo.renderPass = 0;
                     graphPipeline = nullptr;
                 }
                     break;
                 case CommandKey::SetGraphPipelineState: {
-                    mCommandBuffer.read(createGraphPipelineInfo.stateInfo);
+                    GraphicsPipelineStateInfo stateInfo;
+                    readGraphicsPipelineState(mCommandBuffer, stateInfo);
+                    if (stateInfo == createGraphPipelineInfo.stateInfo) {
+                        // 状态未变化，无需重新查找管线
+                        if (countStatistics) {
+                            mRedundantStateCount++;
+                        }
+                        break;
+                    }
+                    createGraphPipelineInfo.stateInfo = stateInfo;
                     graphPipeline = nullptr;
                 }
                     break;
                 case CommandKey::SetVertexLayout: {
-                    mCommandBuffer.read(createGraphPipelineInfo.vertexLayout);
+                    VertexLayout vertexLayout;
+                    readVertexLayout(mCommandBuffer, vertexLayout);
+                    if (vertexLayout == createGraphPipelineInfo.vertexLayout) {
+                        if (countStatistics) {
+                            mRedundantStateCount++;
+                        }
+                        break;
+                    }
+                    createGraphPipelineInfo.vertexLayout = vertexLayout;
                     graphPipeline = nullptr;
                 }
                     break;
@@ -6366,7 +6886,7 @@ void CommandBufferVk::compileCommand(FrameVk *frame)
                     uint32_t size;
                     GfxIdxTy idx;
 
-                    mCommandBuffer.read(size);
+                    mCommandBuffer.readVarint(size);
                     createGraphPipelineInfo.shaderPrograms.resize(size);
                     createComputePipelineInfo.shaderPrograms.resize(size);
                     for (uint32_t k = 0; k < size; k++) {
@@ -6384,7 +6904,10 @@ void CommandBufferVk::compileCommand(FrameVk *frame)
                     createGraphPipelineInfo.subpassIndex++;
                     graphPipeline = nullptr;
 
-                    vkCmdNextSubpass(vkCmdBuf, VK_SUBPASS_CONTENTS_INLINE);
+                    VkSubpassContents contents = subpassContentsIndex < mSubpassContents.size()
+                                                 ? (VkSubpassContents) mSubpassContents[subpassContentsIndex++]
+                                                 : VK_SUBPASS_CONTENTS_INLINE;
+                    vkCmdNextSubpass(vkCmdBuf, contents);
                 }
                     break;
                 case CommandKey::SetViewport: {
@@ -6399,6 +6922,14 @@ void CommandBufferVk::compileCommand(FrameVk *frame)
                     VkViewport vkViewport = {(float) viewport.x, (float) viewport.y,
                                              (float) viewport.width, (float) viewport.height,
                                              minDepth, maxDepth};
+                    if (bound.hasViewport && gx::bitwiseEqual(bound.viewport, vkViewport)) {
+                        if (countStatistics) {
+                            mRedundantStateCount++;
+                        }
+                        break;
+                    }
+                    bound.hasViewport = true;
+                    bound.viewport = vkViewport;
                     vkCmdSetViewport(vkCmdBuf, 0, 1, &vkViewport);
                 }
                     break;
@@ -6407,6 +6938,14 @@ void CommandBufferVk::compileCommand(FrameVk *frame)
                     mCommandBuffer.read(scissor);
                     VkRect2D vkScissor = {{scissor.x,     scissor.y},
                                           {scissor.width, scissor.height}};
+                    if (bound.hasScissor && gx::bitwiseEqual(bound.scissor, vkScissor)) {
+                        if (countStatistics) {
+                            mRedundantStateCount++;
+                        }
+                        break;
+                    }
+                    bound.hasScissor = true;
+                    bound.scissor = vkScissor;
                     vkCmdSetScissor(vkCmdBuf, 0, 1, &vkScissor);
                 }
                     break;
@@ -6470,35 +7009,36 @@ void CommandBufferVk::compileCommand(FrameVk *frame)
                 case CommandKey::BindDescSet: {
                     uint8_t bindPoint;
                     uint32_t binderSize;
-                    std::vector<VkDescriptorSet> vkDescSets;
-                    PipelineLayoutInfo pipelineLayoutInfo;
+                    auto &vkDescSets = mScratch.descSets;
+                    auto &pipelineLayoutInfo = mScratch.pipelineLayoutInfo;
                     uint32_t dynamicOffsetSize;
-                    std::vector<uint32_t> dynamicOffsets;
+                    auto &dynamicOffsets = mScratch.dynamicOffsets;
 
                     mCommandBuffer.read(bindPoint);
-                    mCommandBuffer.read(binderSize);
-                    if (binderSize > 0) {
-                        vkDescSets.resize(binderSize);
-                        pipelineLayoutInfo.layoutInfos.resize(binderSize);
-                        for (uint32_t x = 0; x < binderSize; x++) {
-                            GfxIdxTy idx;
-                            mCommandBuffer.read(idx);
-                            ResourceBinder obj = contextVk->findResourceBinderP(idx);
-                            GX_ASSERT_S(obj, "CommandBufferVk::compileCommand can not find ResourceBinder from idx = %d",
-                                        idx);
-                            auto *objP = dynamic_cast<ResourceBinderVk *>(obj);
-                            objP->bindResources();
-
-                            vkDescSets[x] = objP->getVkDescriptorSet();
-                            pipelineLayoutInfo.layoutInfos[x] = objP->getDescriptorLayoutInfo();
-                        }
+                    mCommandBuffer.readVarint(binderSize);
+                    vkDescSets.resize(binderSize);
+                    pipelineLayoutInfo.layoutInfos.resize(binderSize);
+                    for (uint32_t x = 0; x < binderSize; x++) {
+                        GfxIdxTy idx;
+                        mCommandBuffer.read(idx);
+                        ResourceBinder obj = contextVk->findResourceBinderP(idx);
+                        GX_ASSERT_S(obj, "CommandBufferVk::compileCommand can not find ResourceBinder from idx = %d",
+                                    idx);
+                        auto *objP = dynamic_cast<ResourceBinderVk *>(obj);
+                        objP->bindResources();
+                        record.usesStreaming = record.usesStreaming || objP->hasStreamingTexture();
+
+                        vkDescSets[x] = objP->getVkDescriptorSet();
+                        // 赋值到复用的元素中，沿用其已有容量
+                        pipelineLayoutInfo.layoutInfos[x] = objP->getDescriptorLayoutInfo();
                     }
-                    mCommandBuffer.read(dynamicOffsetSize);
-                    if (dynamicOffsetSize > 0) {
-                        dynamicOffsets.resize(dynamicOffsetSize);
-                        for (uint32_t x = 0; x < dynamicOffsetSize; x++) {
-                            mCommandBuffer.read(dynamicOffsets[x]);
-                        }
+                    mCommandBuffer.readVarint(dynamicOffsetSize);
+                    dynamicOffsets.resize(dynamicOffsetSize);
+                    for (uint32_t x = 0; x < dynamicOffsetSize; x++) {
+                        mCommandBuffer.read(dynamicOffsets[x]);
+                    }
+                    if (patchPoint) {
+                        dynamicOffsets = patchPoint->dynamicOffsets;
                     }
 
                     pipelineLayout = contextVk->getPipelineLayout(pipelineLayoutInfo);
@@ -6513,6 +7053,20 @@ void CommandBufferVk::compileCommand(FrameVk *frame)
                         computePipeline = nullptr;
                     }
 
+                    // 相同布局下绑定相同的描述符集和动态偏移时跳过
+                    auto &boundSets = bound.descSets[bindPoint == ResourceBindPoint::Compute ? 1 : 0];
+                    if (boundSets.layout == pipelineLayout->getVkPipelineLayout()
+                        && boundSets.sets == vkDescSets
+                        && boundSets.dynamicOffsets == dynamicOffsets) {
+                        if (countStatistics) {
+                            mRedundantStateCount++;
+                        }
+                        break;
+                    }
+                    boundSets.layout = pipelineLayout->getVkPipelineLayout();
+                    boundSets.sets = vkDescSets;
+                    boundSets.dynamicOffsets = dynamicOffsets;
+
                     vkCmdBindDescriptorSets(
                             vkCmdBuf,
                             toVkPipelineBindPoint((ResourceBindPoint::Enum) bindPoint),
@@ -6524,8 +7078,8 @@ void CommandBufferVk::compileCommand(FrameVk *frame)
                 case CommandKey::BindVertexBuf: {
                     uint32_t firstBinding;
                     uint8_t size;
-                    std::vector<VkBuffer> buffers;
-                    std::vector<VkDeviceSize> offsets;
+                    auto &buffers = mScratch.buffers;
+                    auto &offsets = mScratch.offsets;
 
                     mCommandBuffer.read(firstBinding);
                     mCommandBuffer.read(size);
@@ -6547,6 +7101,26 @@ void CommandBufferVk::compileCommand(FrameVk *frame)
                         offsets[x] = (VkDeviceSize) offset;
                     }
 
+                    bool redundant = firstBinding + size <= bound.vertexBuffers.size();
+                    for (uint32_t x = 0; redundant && x < size; x++) {
+                        redundant = bound.vertexBuffers[firstBinding + x] == buffers[x]
+                                    && bound.vertexOffsets[firstBinding + x] == offsets[x];
+                    }
+                    if (redundant) {
+                        if (countStatistics) {
+                            mRedundantStateCount++;
+                        }
+                        break;
+                    }
+                    if (firstBinding + size > bound.vertexBuffers.size()) {
+                        bound.vertexBuffers.resize(firstBinding + size, VK_NULL_HANDLE);
+                        bound.vertexOffsets.resize(firstBinding + size, 0);
+                    }
+                    for (uint32_t x = 0; x < size; x++) {
+                        bound.vertexBuffers[firstBinding + x] = buffers[x];
+                        bound.vertexOffsets[firstBinding + x] = offsets[x];
+                    }
+
                     vkCmdBindVertexBuffers(vkCmdBuf, firstBinding, buffers.size(), buffers.data(), offsets.data());
                 }
                     break;
@@ -6557,13 +7131,29 @@ void CommandBufferVk::compileCommand(FrameVk *frame)
                     mCommandBuffer.read(idx);
                     mCommandBuffer.read(offset);
                     mCommandBuffer.read(indexType);
+                    if (patchPoint) {
+                        idx = patchPoint->buffer;
+                        offset = patchPoint->offset;
+                    }
                     Buffer obj = contextVk->findBufferP(idx);
                     GX_ASSERT_S(obj, "CommandBufferVk::compileCommand can not find IndexBuffer from idx = %d", idx);
                     auto *objP = dynamic_cast<BufferVk *>(obj);
                     VkBuffer vkBuffer = objP->vkBuffer();
                     VkDeviceSize vkOffset = offset;
+                    VkIndexType vkIndexType = toVkIndexType(indexType);
+
+                    if (bound.indexBuffer == vkBuffer && bound.indexOffset == vkOffset
+                        && bound.indexType == vkIndexType) {
+                        if (countStatistics) {
+                            mRedundantStateCount++;
+                        }
+                        break;
+                    }
+                    bound.indexBuffer = vkBuffer;
+                    bound.indexOffset = vkOffset;
+                    bound.indexType = vkIndexType;
 
-                    vkCmdBindIndexBuffer(vkCmdBuf, vkBuffer, vkOffset, toVkIndexType(indexType));
+                    vkCmdBindIndexBuffer(vkCmdBuf, vkBuffer, vkOffset, vkIndexType);
                 }
                     break;
                 case CommandKey::Draw: {
@@ -6571,16 +7161,42 @@ void CommandBufferVk::compileCommand(FrameVk *frame)
                     uint32_t instanceCount;
                     uint32_t firstVertex;
                     uint32_t firstInstance;
-                    mCommandBuffer.read(vertexCount);
-                    mCommandBuffer.read(instanceCount);
-                    mCommandBuffer.read(firstVertex);
-                    mCommandBuffer.read(firstInstance);
+                    mCommandBuffer.readVarint(vertexCount);
+                    mCommandBuffer.readVarint(instanceCount);
+                    mCommandBuffer.readVarint(firstVertex);
+                    mCommandBuffer.readVarint(firstInstance);
 
                     computePipeline = nullptr;
-                    graphPipeline = bindGraphPipeline(contextVk, vkCmdBuf, createGraphPipelineInfo, graphPipeline);
+                    graphPipeline = bindGraphPipeline(contextVk, vkCmdBuf, createGraphPipelineInfo, graphPipeline, bound);
                     GX_ASSERT_S(graphPipeline != nullptr, "bind graphics pipeline failure");
 
-                    vkCmdDraw(vkCmdBuf, vertexCount, instanceCount, firstVertex, firstInstance);
+                    uint32_t runCount = 1;
+                    if (firstInstance == 0 || contextVk->isSupportDrawIndirectFirstInstance()) {
+                        runCount += countDrawRun(contextVk, cmdKey, sortedRegion, sortedCursor);
+                    }
+                    if (runCount < MULTI_DRAW_MIN_COUNT) {
+                        vkCmdDraw(vkCmdBuf, vertexCount, instanceCount, firstVertex, firstInstance);
+                        break;
+                    }
+
+                    // 连续的绘制之间没有状态变化，合并为一次多重间接绘制
+                    VkBuffer indirectBuffer;
+                    VkDeviceSize indirectOffset;
+                    auto *drawCmds = (DrawIndirectCommand *) allocIndirect(
+                            contextVk, record, sizeof(DrawIndirectCommand) * runCount, indirectBuffer, indirectOffset);
+                    drawCmds[0] = {vertexCount, instanceCount, firstVertex, firstInstance};
+                    if (countStatistics) {
+                        mMergedDrawCount += runCount - 1;
+                    }
+                    for (uint32_t k = 1; k < runCount; k++) {
+                        DrawIndirectCommand &drawCmd = drawCmds[k];
+                        seekNextDraw();
+                        mCommandBuffer.readVarint(drawCmd.vertexCount);
+                        mCommandBuffer.readVarint(drawCmd.instanceCount);
+                        mCommandBuffer.readVarint(drawCmd.firstVertex);
+                        mCommandBuffer.readVarint(drawCmd.firstInstance);
+                    }
+                    vkCmdDrawIndirect(vkCmdBuf, indirectBuffer, indirectOffset, runCount, sizeof(DrawIndirectCommand));
                 }
                     break;
                 case CommandKey::DrawIndexed: {
@@ -6589,17 +7205,45 @@ void CommandBufferVk::compileCommand(FrameVk *frame)
                     uint32_t firstIndex;
                     int32_t vertexOffset;
                     uint32_t firstInstance;
-                    mCommandBuffer.read(indexCount);
-                    mCommandBuffer.read(instanceCount);
-                    mCommandBuffer.read(firstIndex);
-                    mCommandBuffer.read(vertexOffset);
-                    mCommandBuffer.read(firstInstance);
+                    mCommandBuffer.readVarint(indexCount);
+                    mCommandBuffer.readVarint(instanceCount);
+                    mCommandBuffer.readVarint(firstIndex);
+                    mCommandBuffer.readVarint(vertexOffset);
+                    mCommandBuffer.readVarint(firstInstance);
 
                     computePipeline = nullptr;
-                    graphPipeline = bindGraphPipeline(contextVk, vkCmdBuf, createGraphPipelineInfo, graphPipeline);
+                    graphPipeline = bindGraphPipeline(contextVk, vkCmdBuf, createGraphPipelineInfo, graphPipeline, bound);
                     GX_ASSERT_S(graphPipeline != nullptr, "bind graphics pipeline failure");
 
-                    vkCmdDrawIndexed(vkCmdBuf, indexCount, instanceCount, firstIndex, vertexOffset, firstInstance);
+                    uint32_t runCount = 1;
+                    if (firstInstance == 0 || contextVk->isSupportDrawIndirectFirstInstance()) {
+                        runCount += countDrawRun(contextVk, cmdKey, sortedRegion, sortedCursor);
+                    }
+                    if (runCount < MULTI_DRAW_MIN_COUNT) {
+                        vkCmdDrawIndexed(vkCmdBuf, indexCount, instanceCount, firstIndex, vertexOffset, firstInstance);
+                        break;
+                    }
+
+                    VkBuffer indirectBuffer;
+                    VkDeviceSize indirectOffset;
+                    auto *drawCmds = (DrawIndexedIndirectCommand *) allocIndirect(
+                            contextVk, record, sizeof(DrawIndexedIndirectCommand) * runCount,
+                            indirectBuffer, indirectOffset);
+                    drawCmds[0] = {indexCount, instanceCount, firstIndex, vertexOffset, firstInstance};
+                    if (countStatistics) {
+                        mMergedDrawCount += runCount - 1;
+                    }
+                    for (uint32_t k = 1; k < runCount; k++) {
+                        DrawIndexedIndirectCommand &drawCmd = drawCmds[k];
+                        seekNextDraw();
+                        mCommandBuffer.readVarint(drawCmd.indexCount);
+                        mCommandBuffer.readVarint(drawCmd.instanceCount);
+                        mCommandBuffer.readVarint(drawCmd.firstIndex);
+                        mCommandBuffer.readVarint(drawCmd.vertexOffset);
+                        mCommandBuffer.readVarint(drawCmd.firstInstance);
+                    }
+                    vkCmdDrawIndexedIndirect(vkCmdBuf, indirectBuffer, indirectOffset, runCount,
+                                             sizeof(DrawIndexedIndirectCommand));
                 }
                     break;
                 case CommandKey::DrawIndirect: {
@@ -6612,6 +7256,10 @@ void CommandBufferVk::compileCommand(FrameVk *frame)
                     mCommandBuffer.read(offset);
                     mCommandBuffer.read(drawCount);
                     mCommandBuffer.read(stride);
+                    if (patchPoint) {
+                        idx = patchPoint->buffer;
+                        offset = patchPoint->offset;
+                    }
 
                     Buffer obj = contextVk->findBufferP(idx);
                     GX_ASSERT_S(obj, "CommandBufferVk::compileCommand can not find buffer from idx = %d", idx);
@@ -6620,7 +7268,7 @@ void CommandBufferVk::compileCommand(FrameVk *frame)
                     VkDeviceSize vkOffset = offset;
 
                     computePipeline = nullptr;
-                    graphPipeline = bindGraphPipeline(contextVk, vkCmdBuf, createGraphPipelineInfo, graphPipeline);
+                    graphPipeline = bindGraphPipeline(contextVk, vkCmdBuf, createGraphPipelineInfo, graphPipeline, bound);
                     GX_ASSERT_S(graphPipeline != nullptr, "bind graphics pipeline failure");
 
                     vkCmdDrawIndirect(vkCmdBuf, vkBuffer, vkOffset, drawCount, stride);
@@ -6636,6 +7284,10 @@ void CommandBufferVk::compileCommand(FrameVk *frame)
                     mCommandBuffer.read(offset);
                     mCommandBuffer.read(drawCount);
                     mCommandBuffer.read(stride);
+                    if (patchPoint) {
+                        idx = patchPoint->buffer;
+                        offset = patchPoint->offset;
+                    }
 
                     Buffer obj = contextVk->findBufferP(idx);
                     GX_ASSERT_S(obj, "CommandBufferVk::compileCommand can not find buffer from idx = %d", idx);
@@ -6644,7 +7296,7 @@ void CommandBufferVk::compileCommand(FrameVk *frame)
                     VkDeviceSize vkOffset = offset;
 
                     computePipeline = nullptr;
-                    graphPipeline = bindGraphPipeline(contextVk, vkCmdBuf, createGraphPipelineInfo, graphPipeline);
+                    graphPipeline = bindGraphPipeline(contextVk, vkCmdBuf, createGraphPipelineInfo, graphPipeline, bound);
                     GX_ASSERT_S(graphPipeline != nullptr, "bind graphics pipeline failure");
 
                     vkCmdDrawIndexedIndirect(vkCmdBuf, vkBuffer, vkOffset, drawCount, stride);
@@ -6660,7 +7312,7 @@ void CommandBufferVk::compileCommand(FrameVk *frame)
 
                     graphPipeline = nullptr;
                     computePipeline = bindComputePipeline(contextVk, vkCmdBuf, createComputePipelineInfo,
-                                                          computePipeline);
+                                                          computePipeline, bound);
                     GX_ASSERT_S(computePipeline != nullptr, "bind compute pipeline failure");
 
                     vkCmdDispatch(vkCmdBuf, groupCountX, groupCountY, groupCountZ);
@@ -6672,6 +7324,10 @@ void CommandBufferVk::compileCommand(FrameVk *frame)
 
                     mCommandBuffer.read(idx);
                     mCommandBuffer.read(offset);
+                    if (patchPoint) {
+                        idx = patchPoint->buffer;
+                        offset = patchPoint->offset;
+                    }
 
                     Buffer obj = contextVk->findBufferP(idx);
                     GX_ASSERT_S(obj, "CommandBufferVk::compileCommand can not find buffer from idx = %d", idx);
@@ -6681,7 +7337,7 @@ void CommandBufferVk::compileCommand(FrameVk *frame)
 
                     graphPipeline = nullptr;
                     computePipeline = bindComputePipeline(contextVk, vkCmdBuf, createComputePipelineInfo,
-                                                          computePipeline);
+                                                          computePipeline, bound);
                     GX_ASSERT_S(computePipeline != nullptr, "bind compute pipeline failure");
 
                     vkCmdDispatchIndirect(vkCmdBuf, vkBuffer, vkOffset);
@@ -6694,14 +7350,17 @@ void CommandBufferVk::compileCommand(FrameVk *frame)
                     mCommandBuffer.read(srcStage);
                     mCommandBuffer.read(dstStage);
 
-                    vkCmdPipelineBarrier(
-                            vkCmdBuf,
-                            toVkPipelineStageFlags(srcStage),
-                            toVkPipelineStageFlags(dstStage),
-                            0,
-                            0, nullptr,
-                            0, nullptr,
-                            0, nullptr);
+                    if (mBarrierBatch.isChained(toVkPipelineStageFlags(srcStage))) {
+                        uint32_t count = mBarrierBatch.flush(vkCmdBuf);
+                        if (countStatistics) {
+                            mBarrierCount += count;
+                        }
+                    }
+                    mBarrierBatch.addExecutionBarrier(toVkPipelineStageFlags(srcStage),
+                                                      toVkPipelineStageFlags(dstStage));
+                    if (countStatistics) {
+                        mBarrierCommandCount++;
+                    }
                 }
                     break;
                 case CommandKey::BufferBarrier: {
@@ -6724,14 +7383,19 @@ void CommandBufferVk::compileCommand(FrameVk *frame)
                     bufferBarrier.srcQueueFamilyIndex = contextVk->getQueueIndex(barrierInfo.srcQueue);
                     bufferBarrier.dstQueueFamilyIndex = contextVk->getQueueIndex(barrierInfo.dstQueue);
 
-                    vkCmdPipelineBarrier(
-                            vkCmdBuf,
-                            toVkPipelineStageFlags(barrierInfo.srcStage),
-                            toVkPipelineStageFlags(barrierInfo.dstStage),
-                            0,
-                            0, nullptr,
-                            1, &bufferBarrier,
-                            0, nullptr);
+                    if (mBarrierBatch.isConflict(bufferBarrier.buffer)
+                        || mBarrierBatch.isChained(toVkPipelineStageFlags(barrierInfo.srcStage))) {
+                        uint32_t count = mBarrierBatch.flush(vkCmdBuf);
+                        if (countStatistics) {
+                            mBarrierCount += count;
+                        }
+                    }
+                    mBarrierBatch.addBufferBarrier(toVkPipelineStageFlags(barrierInfo.srcStage),
+                                                   toVkPipelineStageFlags(barrierInfo.dstStage),
+                                                   bufferBarrier);
+                    if (countStatistics) {
+                        mBarrierCommandCount++;
+                    }
                 }
                     break;
                 case CommandKey::ImageBarrier: {
@@ -6749,9 +7413,27 @@ void CommandBufferVk::compileCommand(FrameVk *frame)
                     GX_ASSERT_S(texture, "CommandBufferVk::compileCommand can not find src texture from idx = %lld",
                                 idx);
                     auto *textureP = dynamic_cast<TextureVk *>(texture);
+                    trackTexture(textureP);
+
+                    VkImageMemoryBarrier imageBarrier{};
+                    VkPipelineStageFlags srcStage = 0;
+                    VkPipelineStageFlags dstStage = 0;
+                    if (!textureP->getImageMemoryBarrier((ImageLayout::Enum) srcLayout, (ImageLayout::Enum) dstLayout,
+                                                         subResRange, imageBarrier, srcStage, dstStage)) {
+                        // 范围内的mip都未驻留
+                        break;
+                    }
 
-                    textureP->imageMemoryBarrier(vkCmdBuf, (ImageLayout::Enum) srcLayout, (ImageLayout::Enum) dstLayout,
-                                                 subResRange);
+                    if (mBarrierBatch.isConflict(imageBarrier) || mBarrierBatch.isChained(srcStage)) {
+                        uint32_t count = mBarrierBatch.flush(vkCmdBuf);
+                        if (countStatistics) {
+                            mBarrierCount += count;
+                        }
+                    }
+                    mBarrierBatch.addImageBarrier(srcStage, dstStage, imageBarrier);
+                    if (countStatistics) {
+                        mBarrierCommandCount++;
+                    }
                 }
                     break;
                 case CommandKey::CopyBuffer: {
@@ -6792,7 +7474,8 @@ void CommandBufferVk::compileCommand(FrameVk *frame)
                     GfxIdxTy srcIdx;
                     GfxIdxTy dstIdx;
                     uint32_t copyInfoSize;
-                    std::vector<ImageCopyInfo> copyInfos;
+                    auto &copyInfos = mScratch.copyInfos;
+                    copyInfos.clear();
                     mCommandBuffer.read(srcIdx);
                     mCommandBuffer.read(dstIdx);
                     mCommandBuffer.read(copyInfoSize);
@@ -6801,16 +7484,20 @@ void CommandBufferVk::compileCommand(FrameVk *frame)
                     GX_ASSERT_S(src, "CommandBufferVk::compileCommand can not find src texture from idx = %lld",
                                 srcIdx);
                     auto *srcP = dynamic_cast<TextureVk *>(src);
+                    trackTexture(srcP);
 
                     auto *dst = contextVk->findTextureP(dstIdx);
                     GX_ASSERT_S(dst, "CommandBufferVk::compileCommand can not find dst texture from idx = %lld",
                                 dstIdx);
                     auto *dstP = dynamic_cast<TextureVk *>(dst);
+                    trackTexture(dstP);
 
                     if (copyInfoSize > 0) {
                         copyInfos.resize(copyInfoSize);
                         for (uint32_t x = 0; x < copyInfoSize; x++) {
                             mCommandBuffer.read(copyInfos[x]);
+                            copyInfos[x].srcMipLevel = srcP->residentMipLevel(copyInfos[x].srcMipLevel);
+                            copyInfos[x].dstMipLevel = dstP->residentMipLevel(copyInfos[x].dstMipLevel);
                         }
                     }
 
@@ -6821,7 +7508,8 @@ void CommandBufferVk::compileCommand(FrameVk *frame)
                     GfxIdxTy srcIdx;
                     GfxIdxTy dstIdx;
                     uint32_t copyInfoSize;
-                    std::vector<VkBufferImageCopy> vkCopyInfos;
+                    auto &vkCopyInfos = mScratch.bufferImageCopies;
+                    vkCopyInfos.clear();
                     mCommandBuffer.read(srcIdx);
                     mCommandBuffer.read(dstIdx);
                     mCommandBuffer.read(copyInfoSize);
@@ -6833,6 +7521,7 @@ void CommandBufferVk::compileCommand(FrameVk *frame)
                     auto *dst = contextVk->findTextureP(dstIdx);
                     GX_ASSERT_S(dst, "CommandBufferVk::compileCommand can not find dst texture from idx = %d", dstIdx);
                     auto *dstP = dynamic_cast<TextureVk *>(dst);
+                    trackTexture(dstP);
 
                     if (copyInfoSize > 0) {
                         vkCopyInfos.resize(copyInfoSize);
@@ -6845,7 +7534,7 @@ void CommandBufferVk::compileCommand(FrameVk *frame)
                             vkCopyInfos[x].imageSubresource.aspectMask =
                                     tempInfo.aspectMask == 0 ? toVkAspectFlags(dstP->aspect())
                                                              : toVkAspectFlags(tempInfo.aspectMask);
-                            vkCopyInfos[x].imageSubresource.mipLevel = tempInfo.mipLevel;
+                            vkCopyInfos[x].imageSubresource.mipLevel = dstP->residentMipLevel(tempInfo.mipLevel);
                             vkCopyInfos[x].imageSubresource.baseArrayLayer = tempInfo.baseArrayLayer;
                             vkCopyInfos[x].imageSubresource.layerCount =
                                     tempInfo.layerCount == 0 ? 1 : tempInfo.layerCount;
@@ -6871,7 +7560,8 @@ void CommandBufferVk::compileCommand(FrameVk *frame)
                     GfxIdxTy srcIdx;
                     GfxIdxTy dstIdx;
                     uint32_t copyInfoSize;
-                    std::vector<VkBufferImageCopy> vkCopyInfos;
+                    auto &vkCopyInfos = mScratch.bufferImageCopies;
+                    vkCopyInfos.clear();
                     mCommandBuffer.read(srcIdx);
                     mCommandBuffer.read(dstIdx);
                     mCommandBuffer.read(copyInfoSize);
@@ -6879,6 +7569,7 @@ void CommandBufferVk::compileCommand(FrameVk *frame)
                     auto *src = contextVk->findTextureP(srcIdx);
                     GX_ASSERT_S(src, "CommandBufferVk::compileCommand can not find src texture from idx = %d", srcIdx);
                     auto *srcP = dynamic_cast<TextureVk *>(src);
+                    trackTexture(srcP);
 
                     auto *dst = contextVk->findBufferP(dstIdx);
                     GX_ASSERT_S(dst, "CommandBufferVk::compileCommand can not find dst buffer from idx = %d", dstIdx);
@@ -6895,7 +7586,7 @@ void CommandBufferVk::compileCommand(FrameVk *frame)
                             vkCopyInfos[x].imageSubresource.aspectMask =
                                     tempInfo.aspectMask == 0 ? toVkAspectFlags(srcP->aspect())
                                                              : toVkAspectFlags(tempInfo.aspectMask);
-                            vkCopyInfos[x].imageSubresource.mipLevel = tempInfo.mipLevel;
+                            vkCopyInfos[x].imageSubresource.mipLevel = srcP->residentMipLevel(tempInfo.mipLevel);
                             vkCopyInfos[x].imageSubresource.baseArrayLayer = tempInfo.baseArrayLayer;
                             vkCopyInfos[x].imageSubresource.layerCount =
                                     tempInfo.layerCount == 0 ? 1 : tempInfo.layerCount;
@@ -6922,7 +7613,8 @@ void CommandBufferVk::compileCommand(FrameVk *frame)
                     GfxIdxTy dstIdx;
                     uint8_t filter;
                     uint32_t blitInfoSize;
-                    std::vector<ImageBlitInfo> blitInfos;
+                    auto &blitInfos = mScratch.blitInfos;
+                    blitInfos.clear();
                     mCommandBuffer.read(srcIdx);
                     mCommandBuffer.read(dstIdx);
                     mCommandBuffer.read(filter);
@@ -6931,15 +7623,19 @@ void CommandBufferVk::compileCommand(FrameVk *frame)
                     auto *src = contextVk->findTextureP(srcIdx);
                     GX_ASSERT_S(src, "CommandBufferVk::compileCommand can not find src texture from idx = %d", srcIdx);
                     auto *srcP = dynamic_cast<TextureVk *>(src);
+                    trackTexture(srcP);
 
                     auto *dst = contextVk->findTextureP(dstIdx);
                     GX_ASSERT_S(dst, "CommandBufferVk::compileCommand can not find dst texture from idx = %d", dstIdx);
                     auto *dstP = dynamic_cast<TextureVk *>(dst);
+                    trackTexture(dstP);
 
                     if (blitInfoSize > 0) {
                         blitInfos.resize(blitInfoSize);
                         for (uint32_t x = 0; x < blitInfoSize; x++) {
                             mCommandBuffer.read(blitInfos[x]);
+                            blitInfos[x].srcMipLevel = srcP->residentMipLevel(blitInfos[x].srcMipLevel);
+                            blitInfos[x].dstMipLevel = dstP->residentMipLevel(blitInfos[x].dstMipLevel);
                         }
                     }
 
@@ -6952,7 +7648,8 @@ void CommandBufferVk::compileCommand(FrameVk *frame)
                     GfxIdxTy dstIdx;
                     uint8_t vFrameIndex;
                     uint32_t copyInfoSize;
-                    std::vector<ImageCopyInfo> copyInfos;
+                    auto &copyInfos = mScratch.copyInfos;
+                    copyInfos.clear();
                     mCommandBuffer.read(srcIdx);
                     mCommandBuffer.read(dstIdx);
                     mCommandBuffer.read(vFrameIndex);
@@ -7050,7 +7747,8 @@ void CommandBufferVk::compileCommand(FrameVk *frame)
                     uint8_t filter;
                     uint8_t vFrameIndex;
                     uint32_t blitInfoSize;
-                    std::vector<ImageBlitInfo> blitInfos;
+                    auto &blitInfos = mScratch.blitInfos;
+                    blitInfos.clear();
                     mCommandBuffer.read(srcIdx);
                     mCommandBuffer.read(dstIdx);
                     mCommandBuffer.read(filter);
@@ -7150,7 +7848,8 @@ void CommandBufferVk::compileCommand(FrameVk *frame)
                     uint8_t attachIndex;
                     uint8_t vFrameIndex;
                     uint32_t blitInfoSize;
-                    std::vector<ImageBlitInfo> blitInfos;
+                    auto &blitInfos = mScratch.blitInfos;
+                    blitInfos.clear();
                     mCommandBuffer.read(srcIdx);
                     mCommandBuffer.read(dstIdx);
                     mCommandBuffer.read(filter);
@@ -7166,11 +7865,13 @@ void CommandBufferVk::compileCommand(FrameVk *frame)
                     auto *dst = contextVk->findTextureP(dstIdx);
                     GX_ASSERT_S(dst, "CommandBufferVk::compileCommand can not find dst texture from idx = %d", dstIdx);
                     auto *dstP = dynamic_cast<TextureVk *>(dst);
+                    trackTexture(dstP);
 
                     if (blitInfoSize > 0) {
                         blitInfos.resize(blitInfoSize);
                         for (uint32_t x = 0; x < blitInfoSize; x++) {
                             mCommandBuffer.read(blitInfos[x]);
+                            blitInfos[x].dstMipLevel = dstP->residentMipLevel(blitInfos[x].dstMipLevel);
                         }
                     }
 
@@ -7202,7 +7903,8 @@ void CommandBufferVk::compileCommand(FrameVk *frame)
                     uint8_t attachIndex;
                     uint8_t vFrameIndex;
                     uint32_t copyInfoSize;
-                    std::vector<ImageCopyInfo> copyInfos;
+                    auto &copyInfos = mScratch.copyInfos;
+                    copyInfos.clear();
                     mCommandBuffer.read(srcIdx);
                     mCommandBuffer.read(dstIdx);
                     mCommandBuffer.read(attachIndex);
@@ -7217,11 +7919,13 @@ void CommandBufferVk::compileCommand(FrameVk *frame)
                     auto *dst = contextVk->findTextureP(dstIdx);
                     GX_ASSERT_S(dst, "CommandBufferVk::compileCommand can not find Texture from idx = %d", dstIdx);
                     auto *dstP = dynamic_cast<TextureVk *>(dst);
+                    trackTexture(dstP);
 
                     if (copyInfoSize > 0) {
                         copyInfos.resize(copyInfoSize);
                         for (uint32_t x = 0; x < copyInfoSize; x++) {
                             mCommandBuffer.read(copyInfos[x]);
+                            copyInfos[x].dstMipLevel = dstP->residentMipLevel(copyInfos[x].dstMipLevel);
                         }
                     }
 
@@ -7253,7 +7957,8 @@ void CommandBufferVk::compileCommand(FrameVk *frame)
                     uint8_t attachIndex;
                     uint8_t vFrameIndex;
                     uint32_t copyInfoSize;
-                    std::vector<VkBufferImageCopy> vkCopyInfos;
+                    auto &vkCopyInfos = mScratch.bufferImageCopies;
+                    vkCopyInfos.clear();
                     mCommandBuffer.read(srcIdx);
                     mCommandBuffer.read(dstIdx);
                     mCommandBuffer.read(attachIndex);
@@ -7346,11 +8051,26 @@ void CommandBufferVk::compileCommand(FrameVk *frame)
                             {0, 1, 0, 1},
                     };
                     vkd::vkCmdBeginDebugUtilsLabel(vkCmdBuf, &labelInfo);
+
+                    if (profiling) {
+                        auto &scopes = *querySlot.scopes;
+                        auto scopeIndex = (uint32_t) scopes.size();
+                        scopes.push_back({debugLabel, (uint32_t) openScopes.size(), scopeIndex * 2, scopeIndex * 2 + 1});
+                        openScopes.push_back(scopeIndex);
+                        vkCmdWriteTimestamp(vkCmdBuf, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, querySlot.pool,
+                                            querySlot.firstQuery() + scopes.back().beginQuery);
+                    }
                 }
                     break;
                 case CommandKey::EndDebug: {
                     debugLabel.clear();
                     vkd::vkCmdEndDebugUtilsLabel(vkCmdBuf);
+
+                    if (profiling && !openScopes.empty()) {
+                        vkCmdWriteTimestamp(vkCmdBuf, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, querySlot.pool,
+                                            querySlot.firstQuery() + (*querySlot.scopes)[openScopes.back()].endQuery);
+                        openScopes.pop_back();
+                    }
                 }
                     break;
                 case CommandKey::ResetQuery: {
@@ -7449,19 +8169,176 @@ void CommandBufferVk::compileCommand(FrameVk *frame)
                                               toVkQueryResultFlags(resultFlags));
                 }
                     break;
+                case CommandKey::ExecuteCommands: {
+                    uint32_t count;
+                    mCommandBuffer.readVarint(count);
+
+                    auto &secondaries = mScratch.secondaries;
+                    secondaries.resize(count);
+                    for (uint32_t k = 0; k < count; k++) {
+                        GfxIdxTy idx;
+                        mCommandBuffer.read(idx);
+                        auto *obj = contextVk->findCommandBufferP(idx);
+                        GX_ASSERT_S(obj, "CommandBufferVk::compileCommand can not find CommandBuffer from idx = %d", idx);
+                        secondaries[k] = dynamic_cast<CommandBufferVk *>(obj);
+                    }
+
+                    // 每个VkCommandBuffer所处的RenderPass状态相同，Secondary只需在第一个中检查一次
+                    // 未改变的Secondary不重新编译，其他主指令缓冲可能仍在执行
+                    if (i == beginIndex) {
+                        compileSecondaryCommands(secondaries, renderTargetVk, currentRenderPass,
+                                                 createGraphPipelineInfo.subpassIndex);
+                    }
+
+                    auto &vkSecondaries = mScratch.vkSecondaries;
+                    vkSecondaries.resize(count);
+                    for (uint32_t k = 0; k < count; k++) {
+                        uint64_t compileVersion;
+                        vkSecondaries[k] = secondaries[k]->getExecutedBuffer(i, compileVersion);
+                        record.secondaries.push_back({secondaries[k]->idx(), vkSecondaries[k], compileVersion});
+                    }
+                    vkCmdExecuteCommands(vkCmdBuf, count, vkSecondaries.data());
+
+                    // 执行次级指令后主指令缓冲中绑定的状态失效
+                    graphPipeline = nullptr;
+                    computePipeline = nullptr;
+                    bound.reset();
+                }
+                    break;
+                case CommandKey::BeginSortedDraws: {
+                    const SortedRegion *region = findSortedRegion(cmdPos);
+                    GX_ASSERT_S(region, "CommandBufferVk::compileCommand can not find sorted region at %d",
+                                (int) cmdPos);
+                    if (region && region->sorted) {
+                        sortedRegion = region;
+                        sortedCursor = 0;
+                    }
+                }
+                    break;
+                case CommandKey::EndSortedDraws:
+                    break;
                 default:
                     GX_ASSERT_S(cmdKey > CommandKey::None && cmdKey < CommandKey::Count,
                                 "CommandBufferVk::compileCommand unknown command(%d)", cmdKey);
             }
         } while (cmdKey != CommandKey::End);
+
+        if (countStatistics) {
+            // 合并的绘制在编译时被连续读取，不经过上面的统计
+            mCommandCounts.commandCount += mMergedDrawCount;
+            mCommandCounts.drawCount += mMergedDrawCount;
+            mPipelineBindCount = bound.pipelineBindCount;
+        }
     }
     mIsCompiled = true;
+    mCompileVersion++;
+
+    // Secondary在主指令缓冲编译期间编译，耗时已包含在主指令缓冲中
+    if (mLevel == CommandBufferLevel::Primary) {
+        auto &counters = mContextT->counters();
+        counters.compileCount++;
+        counters.compileTimeNs += Profiler::now() - compileBeginNs;
+    }
+}
+
+void CommandBufferVk::compileSecondaryCommands(const std::vector<CommandBufferVk *> &secondaries,
+                                               RenderTargetVk *renderTarget, RenderPassVk *renderPass,
+                                               uint32_t subpass)
+{
+    const auto primaryCount = (uint32_t) mRecordedBuffers.size();
+
+    // 同一个Secondary可以在一次执行中出现多次，只编译一次，避免在多个线程中同时编译
+    auto &uniqueSecondaries = mScratch.uniqueSecondaries;
+    uniqueSecondaries.clear();
+    for (auto *secondary : secondaries) {
+        if (std::find(uniqueSecondaries.begin(), uniqueSecondaries.end(), secondary) == uniqueSecondaries.end()) {
+            uniqueSecondaries.push_back(secondary);
+        }
+    }
+
+    auto &inheritances = mScratch.inheritances;
+    inheritances.resize(uniqueSecondaries.size());
+    for (size_t k = 0; k < uniqueSecondaries.size(); k++) {
+        auto *secondary = uniqueSecondaries[k];
+        auto &inheritance = inheritances[k];
+        inheritance.renderTarget = renderTarget;
+        inheritance.renderPass = renderPass;
+        inheritance.subpass = subpass;
+        // 重复执行的Secondary需要同时使用
+        inheritance.simultaneousUse = secondary->mRecordedBuffers.size() != primaryCount
+                                      || std::count(secondaries.begin(), secondaries.end(), secondary) > 1;
+        inheritance.framebuffers.clear();
+
+        // 帧缓冲可能在首次获取时才创建，在当前线程中提前获取
+        if (renderTarget != nullptr && renderPass != nullptr && !inheritance.simultaneousUse) {
+            for (uint32_t j = 0; j < primaryCount; j++) {
+                inheritance.framebuffers.push_back(*(renderTarget->getVkFrameBuffer(renderPass, j)));
+            }
+        }
+    }
+
+    // 每个Secondary拥有独立的指令池，在编译线程池中并行编译
+    ContextVk *contextVk = dynamic_cast<ContextVk *>(mContextT->contextP());
+    contextVk->parallelCompile((uint32_t) uniqueSecondaries.size(),
+                               [&uniqueSecondaries, &inheritances](uint32_t index) {
+                                   uniqueSecondaries[index]->compileSecondary(inheritances[index]);
+                               });
+}
+
+void CommandBufferVk::compileSecondary(const Inheritance &inheritance)
+{
+    std::lock_guard<std::mutex> lock(mCompileMutex);
+    if (matchCompiledVersion(mCompileVersion) && mInheritance == inheritance) {
+        return;
+    }
+    mInheritance = inheritance;
+    compileCommand();
+}
+
+bool CommandBufferVk::isCompiledVersion(uint64_t compileVersion)
+{
+    std::lock_guard<std::mutex> lock(mCompileMutex);
+    return matchCompiledVersion(compileVersion);
+}
+
+bool CommandBufferVk::matchCompiledVersion(uint64_t compileVersion)
+{
+    if (!mIsCompiled || mCompileVersion != compileVersion) {
+        return false;
+    }
+    const uint64_t residencyEpoch = dynamic_cast<ContextVk *>(mContextT->contextP())->residencyEpoch();
+    return std::all_of(mRecordedBuffers.begin(), mRecordedBuffers.end(), [&](const RecordedBuffer &record) {
+        return record.patchVersion == mPatchVersion
+               && (!record.usesStreaming || record.residencyEpoch == residencyEpoch);
+    });
+}
+
+VkCommandBuffer CommandBufferVk::getExecutedBuffer(uint32_t index, uint64_t &compileVersion)
+{
+    std::lock_guard<std::mutex> lock(mCompileMutex);
+    compileVersion = mCompileVersion;
+    return mRecordedBuffers[index % mRecordedBuffers.size()].vkCommandBuffer;
+}
+
+void CommandBufferVk::markSubmitted(VkCommandBuffer vkCommandBuffer, uint64_t serial)
+{
+    std::lock_guard<std::mutex> lock(mCompileMutex);
+    // 主指令缓冲录制后Secondary可能已换用空闲的VkCommandBuffer，按句柄查找
+    for (auto *buffers : {&mRecordedBuffers, &mSpareBuffers}) {
+        for (auto &record : *buffers) {
+            if (record.vkCommandBuffer == vkCommandBuffer) {
+                record.submitSerial = std::max(record.submitSerial, serial);
+                return;
+            }
+        }
+    }
 }
 
 void CommandBufferVk::doCopyImage(VkCommandBuffer cmdBuffer, GVkImage *src, GVkImage *dst,
                                   const std::vector<ImageCopyInfo> &copyInfos)
 {
-    std::vector<VkImageCopy> vkCopyInfos;
+    auto &vkCopyInfos = mScratch.imageCopies;
+    vkCopyInfos.clear();
     if (!copyInfos.empty()) {
         vkCopyInfos.resize(copyInfos.size());
         for (uint32_t x = 0; x < copyInfos.size(); x++) {
@@ -7501,7 +8378,8 @@ void CommandBufferVk::doCopyImage(VkCommandBuffer cmdBuffer, GVkImage *src, GVkI
 void CommandBufferVk::doBlitImage(VkCommandBuffer cmdBuffer, GVkImage *src, GVkImage *dst,
                                   const std::vector<ImageBlitInfo> &blitInfos, BlitFilter::Enum filter)
 {
-    std::vector<VkImageBlit> vkBlitInfos;
+    auto &vkBlitInfos = mScratch.imageBlits;
+    vkBlitInfos.clear();
     if (!blitInfos.empty()) {
         vkBlitInfos.resize(blitInfos.size());
         for (uint32_t x = 0; x < blitInfos.size(); x++) {
@@ -7538,25 +8416,34 @@ void CommandBufferVk::doBlitImage(VkCommandBuffer cmdBuffer, GVkImage *src, GVkI
 
 PipelineVk *CommandBufferVk::bindGraphPipeline(ContextVk *context, VkCommandBuffer cmdBuffer,
                                                const CreateGraphicsPipelineStateInfo &createInfo,
-                                               PipelineVk *pipeline)
+                                               PipelineVk *pipeline, BoundState &bound)
 {
     if (pipeline != nullptr) {
         return pipeline;
     }
     pipeline = context->getGraphicsPipeline(createInfo);
-    vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->vkPipeline());
+    // 状态改变后可能查找到与当前绑定相同的管线
+    if (pipeline != bound.graphPipeline) {
+        vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline->vkPipeline());
+        bound.graphPipeline = pipeline;
+        bound.pipelineBindCount++;
+    }
     return pipeline;
 }
 
 PipelineVk *CommandBufferVk::bindComputePipeline(ContextVk *context, VkCommandBuffer cmdBuffer,
                                                  const CreateComputePipelineStateInfo &createInfo,
-                                                 PipelineVk *pipeline)
+                                                 PipelineVk *pipeline, BoundState &bound)
 {
     if (pipeline != nullptr) {
         return pipeline;
     }
     pipeline = context->getComputePipeline(createInfo);
-    vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline->vkPipeline());
+    if (pipeline != bound.computePipeline) {
+        vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline->vkPipeline());
+        bound.computePipeline = pipeline;
+        bound.pipelineBindCount++;
+    }
     return pipeline;
 }
 
@@ -7568,6 +8455,7 @@ bool QueryVk::init(Context_T *context, const CreateQueryInfo &createInfo)
     mHash = hashOf(createInfo);
     mQueryType = createInfo.queryType;
     mQueryCount = createInfo.queryCount;
+    mPipelineStatistics = createInfo.pipelineStatistics;
 
     VkQueryPoolCreateInfo queryPoolCreateInfo{};
     queryPoolCreateInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
@@ -7604,35 +8492,52 @@ size_t QueryVk::hash()
 
 void QueryVk::getQueryResults(std::vector<uint64_t> &results, QueryResultFlags flags)
 {
-    results.resize(mQueryCount);
+    getQueryResults(results, 0, mQueryCount, flags);
+}
+
+void QueryVk::getQueryResults(std::vector<uint64_t> &results, uint32_t firstQuery, uint32_t queryCount,
+                              QueryResultFlags flags)
+{
     auto *contextVk = dynamic_cast<ContextVk *>(mContextT->contextP());
     auto *gvkContext = contextVk->vkContext();
 
-    if (mQueryType == QueryType::Occlusion) {
-        vkGetQueryPoolResults(
-                gvkContext->vkDevice(),
-                mVkQuery,
-                0, mQueryCount, sizeof(uint64_t) * mQueryCount, results.data(), sizeof(uint64_t),
-                toVkQueryResultFlags(flags)
-        );
-    } else if (mQueryType == QueryType::PipelineStatistics) {
+    // 带可用性时每个查询的结果后紧跟一个可用性值
+    const bool withAvailability = flags & QueryResultFlag::WithAvailability;
+    const uint32_t valueCount = withAvailability ? 2 : 1;
+
+    if (mQueryType == QueryType::PipelineStatistics) {
+        // 一次查询返回全部开启的统计值
+        results.assign(mQueryCount + (withAvailability ? 1 : 0), 0);
         vkGetQueryPoolResults(
                 gvkContext->vkDevice(),
                 mVkQuery,
-                0, 1, sizeof(uint64_t) * mQueryCount, results.data(), sizeof(uint64_t),
+                0, 1, sizeof(uint64_t) * results.size(), results.data(), sizeof(uint64_t) * results.size(),
                 toVkQueryResultFlags(flags)
         );
-    } else if (mQueryType == QueryType::Timestamp) {
-        if (contextVk->isSupportQueryTimestamp()) {
-            vkGetQueryPoolResults(
-                    gvkContext->vkDevice(),
-                    mVkQuery,
-                    0, mQueryCount, sizeof(uint64_t) * mQueryCount, results.data(), sizeof(uint64_t),
-                    toVkQueryResultFlags(flags)
-            );
-            for (auto &i : results) {
-                i *= contextVk->getTimestampPeriod();
-            }
+        return;
+    }
+
+    firstQuery = std::min(firstQuery, mQueryCount);
+    queryCount = std::min(queryCount, mQueryCount - firstQuery);
+    results.assign(queryCount * valueCount, 0);
+    if (queryCount == 0) {
+        return;
+    }
+    if (mQueryType == QueryType::Timestamp && !contextVk->isSupportQueryTimestamp()) {
+        return;
+    }
+
+    vkGetQueryPoolResults(
+            gvkContext->vkDevice(),
+            mVkQuery,
+            firstQuery, queryCount, sizeof(uint64_t) * results.size(), results.data(),
+            sizeof(uint64_t) * valueCount,
+            toVkQueryResultFlags(flags)
+    );
+
+    if (mQueryType == QueryType::Timestamp) {
+        for (uint32_t i = 0; i < queryCount; i++) {
+            results[i * valueCount] = (uint64_t) ((double) results[i * valueCount] * contextVk->getTimestampPeriod());
         }
     }
 }
@@ -0,0 +1,266 @@
+/*
+ * Copyright (c) 2023 Gxin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <gfx/gfx_profiler.h>
+#include "gfx_profiler_impl.h"
+#include "gfx_context.h"
+
+#include <gx/debug.h>
+#include <gx/gtime.h>
+
+#include <cstdio>
+
+
+namespace gfx
+{
+
+namespace
+{
+
+/**
+ * 当前线程未结束的CPU区间，不同Context的区间可以交错
+ */
+struct OpenZone
+{
+    Profiler *profiler;
+    const char *name;
+    uint64_t beginNs;
+};
+
+thread_local std::vector<OpenZone> tOpenZones;
+
+uint32_t currentThreadId()
+{
+    static std::atomic<uint32_t> sNextThreadId{1};
+    thread_local uint32_t threadId = sNextThreadId.fetch_add(1, std::memory_order_relaxed);
+    return threadId;
+}
+
+std::string escapeJson(const std::string &str)
+{
+    std::string out;
+    out.reserve(str.size());
+    for (char c : str) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if ((unsigned char) c < 0x20) {
+            char buf[8];
+            snprintf(buf, sizeof(buf), "\\u%04x", c);
+            out += buf;
+        } else {
+            out += c;
+        }
+    }
+    return out;
+}
+
+}
+
+/// ============ Profiler ============ ///
+
+bool Profiler::enable(const ProfilerInfo &info)
+{
+    {
+        GLockerGuard locker(mEventMutex);
+        mLatency = std::max(info.latency, 1u);
+        mMaxEvents = std::max(info.maxEvents, 1u);
+        mEvents.clear();
+    }
+    mGpuEnabled.store(info.gpuTimestamps, std::memory_order_relaxed);
+    mEnabled.store(true, std::memory_order_release);
+    return true;
+}
+
+void Profiler::disable()
+{
+    mEnabled.store(false, std::memory_order_release);
+    mGpuEnabled.store(false, std::memory_order_relaxed);
+}
+
+void Profiler::nextFrame()
+{
+    mFrame.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Profiler::beginZone(const char *name)
+{
+    if (!isEnabled()) {
+        return;
+    }
+    tOpenZones.push_back({this, name, now()});
+}
+
+void Profiler::endZone()
+{
+    uint64_t endNs = now();
+    uint32_t depth = 0;
+    for (auto it = tOpenZones.rbegin(); it != tOpenZones.rend(); ++it) {
+        if (it->profiler != this) {
+            continue;
+        }
+        for (auto d = it + 1; d != tOpenZones.rend(); ++d) {
+            depth += d->profiler == this ? 1 : 0;
+        }
+        OpenZone zone = *it;
+        tOpenZones.erase(std::next(it).base());
+
+        if (isEnabled()) {
+            addEvent({zone.name, ProfilerTrack::Cpu, currentThreadId(), depth, frame(), zone.beginNs, endNs});
+        }
+        return;
+    }
+}
+
+void Profiler::addEvent(ProfilerEvent &&event)
+{
+    GLockerGuard locker(mEventMutex);
+    if (mEvents.size() >= mMaxEvents) {
+        mEvents.pop_front();
+    }
+    mEvents.push_back(std::move(event));
+}
+
+void Profiler::takeEvents(std::vector<ProfilerEvent> &events)
+{
+    GLockerGuard locker(mEventMutex);
+    events.assign(std::make_move_iterator(mEvents.begin()), std::make_move_iterator(mEvents.end()));
+    mEvents.clear();
+}
+
+uint64_t Profiler::now()
+{
+    return (uint64_t) GTime::currentSteadyTime().nanosecond();
+}
+
+/// ============ ContextCounters ============ ///
+
+ContextStatistics ContextCounters::snapshot() const
+{
+    ContextStatistics stats{};
+    stats.submitCount = submitCount.load(std::memory_order_relaxed);
+    stats.compileCount = compileCount.load(std::memory_order_relaxed);
+    stats.compileTime = compileTimeNs.load(std::memory_order_relaxed) / 1000;
+    stats.pipelineCacheHitCount = pipelineCacheHitCount.load(std::memory_order_relaxed);
+    stats.pipelineCacheMissCount = pipelineCacheMissCount.load(std::memory_order_relaxed);
+    stats.pipelineCreateTime = pipelineCreateTimeNs.load(std::memory_order_relaxed) / 1000;
+    stats.descriptorSetUpdateCount = descriptorSetUpdateCount.load(std::memory_order_relaxed);
+    stats.descriptorSetAllocCount = descriptorSetAllocCount.load(std::memory_order_relaxed);
+    stats.uploadBytes = uploadBytes.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void ContextCounters::fillFrameStatistics(FrameStatistics &stats, const ContextStatistics &current,
+                                          const ContextStatistics &last)
+{
+    stats.compileCount = (uint32_t) (current.compileCount - last.compileCount);
+    stats.compileTime = current.compileTime - last.compileTime;
+    stats.pipelineCacheHitCount = (uint32_t) (current.pipelineCacheHitCount - last.pipelineCacheHitCount);
+    stats.pipelineCacheMissCount = (uint32_t) (current.pipelineCacheMissCount - last.pipelineCacheMissCount);
+    stats.pipelineCreateTime = current.pipelineCreateTime - last.pipelineCreateTime;
+    stats.descriptorSetUpdateCount = (uint32_t) (current.descriptorSetUpdateCount - last.descriptorSetUpdateCount);
+    stats.descriptorSetAllocCount = (uint32_t) (current.descriptorSetAllocCount - last.descriptorSetAllocCount);
+    stats.uploadBytes = current.uploadBytes - last.uploadBytes;
+}
+
+/// ============ API ============ ///
+
+bool enableProfiler(Context context, const ProfilerInfo &info)
+{
+    auto *contextT = dynamic_cast<Context_T *>(context);
+    GX_ASSERT(contextT);
+    return contextT->profiler().enable(info);
+}
+
+void disableProfiler(Context context)
+{
+    auto *contextT = dynamic_cast<Context_T *>(context);
+    GX_ASSERT(contextT);
+    contextT->profiler().disable();
+}
+
+bool isProfilerEnabled(Context context)
+{
+    auto *contextT = dynamic_cast<Context_T *>(context);
+    GX_ASSERT(contextT);
+    return contextT->profiler().isEnabled();
+}
+
+void beginProfileZone(Context context, const char *name)
+{
+    auto *contextT = dynamic_cast<Context_T *>(context);
+    GX_ASSERT(contextT);
+    contextT->profiler().beginZone(name);
+}
+
+void endProfileZone(Context context)
+{
+    auto *contextT = dynamic_cast<Context_T *>(context);
+    GX_ASSERT(contextT);
+    contextT->profiler().endZone();
+}
+
+void takeProfilerEvents(Context context, std::vector<ProfilerEvent> &events)
+{
+    auto *contextT = dynamic_cast<Context_T *>(context);
+    GX_ASSERT(contextT);
+    contextT->contextP()->collectProfilerEvents();
+    contextT->profiler().takeEvents(events);
+}
+
+bool writeChromeTrace(const std::vector<ProfilerEvent> &events, const std::string &path)
+{
+    FILE *file = fopen(path.c_str(), "wb");
+    if (!file) {
+        Log("writeChromeTrace: open %s failure", path.c_str());
+        return false;
+    }
+
+    // GPU区间放在tid为0的轨道上，CPU区间按线程编号分轨道
+    fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n", file);
+    fputs(R"({"name":"thread_name","ph":"M","pid":1,"tid":0,"args":{"name":"GPU"}})", file);
+
+    uint64_t baseNs = UINT64_MAX;
+    for (const auto &e : events) {
+        baseNs = std::min(baseNs, e.beginNs);
+    }
+
+    for (const auto &e : events) {
+        fprintf(file,
+                ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,"
+                "\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"frame\":%llu,\"depth\":%u}}",
+                escapeJson(e.name).c_str(),
+                e.track == ProfilerTrack::Gpu ? "gpu" : "cpu",
+                e.track == ProfilerTrack::Gpu ? 0u : e.threadId,
+                (double) (e.beginNs - baseNs) / 1000.0,
+                (double) (e.endNs > e.beginNs ? e.endNs - e.beginNs : 0) / 1000.0,
+                (unsigned long long) e.frame,
+                e.depth);
+    }
+
+    fputs("\n]}\n", file);
+    bool ok = ferror(file) == 0;
+    fclose(file);
+    return ok;
+}
+
+}
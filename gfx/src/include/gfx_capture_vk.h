@@ -0,0 +1,156 @@
+/*
+ * Copyright (c) 2023 Gxin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef GX_GFX_CAPTURE_VK_H
+#define GX_GFX_CAPTURE_VK_H
+
+#include <gfx/gfx_capture.h>
+#include "gfx_private.h"
+
+#include <atomic>
+#include <cstdio>
+#include <unordered_set>
+
+
+namespace gfx
+{
+namespace vk
+{
+
+class ContextVk;
+
+class CommandBufferVk;
+
+class BufferVk;
+
+class TextureVk;
+
+class SamplerVk;
+
+class ShaderVk;
+
+class QueryVk;
+
+class RenderTargetVk;
+
+class ResourceBinderVk;
+
+#define GFX_CAPTURE_MAGIC 0x43584647u       // "GFXC"
+#define GFX_CAPTURE_VERSION 4u
+
+/**
+ * 捕获文件中的数据块类型
+ * 文件头之后为连续的数据块，每块以类型开头，元素块在第一次被引用它的指令缓冲块之前写入
+ */
+struct CaptureChunk
+{
+    enum Enum : uint8_t
+    {
+        End = 0,
+        Buffer,
+        Texture,
+        Sampler,
+        Shader,
+        Query,
+        RenderTarget,
+        ResourceBinder,
+        CommandBuffer,      // 指令流及编译需要的附加信息，每次提交时重新写入
+        Submit,
+        FrameEnd,
+
+        Count
+    };
+};
+
+/**
+ * 指令流捕获与回放的Vulkan实现
+ */
+class CaptureVk
+{
+public:
+    explicit CaptureVk(ContextVk *context);
+
+    ~CaptureVk();
+
+    bool begin(const std::string &path);
+
+    bool end();
+
+    bool isActive() const;
+
+    /**
+     * 在指令缓冲提交前调用，写入指令流及其引用的元素
+     *
+     * @param cmdBuffer
+     * @param bufferIndex   提交的VkCommandBuffer序号
+     */
+    void recordSubmit(CommandBufferVk *cmdBuffer, uint32_t bufferIndex);
+
+    void recordFrameEnd();
+
+    static bool replay(ContextVk *context, const std::string &path,
+                       const CaptureReplayInfo &info, CaptureReplayResult &result);
+
+private:
+    void writeElement(GfxIdxTy idx);
+
+    void writeHandle(ElementHandle *obj);
+
+    void writeBuffer(BufferVk *buffer);
+
+    void writeTexture(TextureVk *texture);
+
+    void writeSampler(SamplerVk *sampler);
+
+    void writeShader(ShaderVk *shader);
+
+    void writeQuery(QueryVk *query);
+
+    void writeRenderTarget(RenderTargetVk *renderTarget);
+
+    void writeResourceBinder(ResourceBinderVk *binder);
+
+    void writeCommandBuffer(CommandBufferVk *cmdBuffer, std::unordered_set<GfxIdxTy> &writtenCmdBuffers);
+
+    /**
+     * 通过暂存缓冲回读Buffer的内容
+     */
+    bool readBufferContents(BufferVk *buffer, std::vector<uint8_t> &data);
+
+    void flush();
+
+private:
+    ContextVk *mContext;
+
+    GMutex mMutex;
+    std::atomic<bool> mActive{false};
+    FILE *mFile = nullptr;
+
+    CommandStream mStream;                          // 待写入文件的数据
+    std::unordered_set<GfxIdxTy> mWrittenElements;  // 已写入的元素，只在第一次引用时写入
+    bool mDeviceIdle = false;                       // 本次提交中是否已等待设备空闲
+};
+
+}
+}
+
+#endif //GX_GFX_CAPTURE_VK_H
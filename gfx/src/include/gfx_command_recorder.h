@@ -0,0 +1,416 @@
+/*
+ * Copyright (c) 2023 Gxin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef GX_GFX_COMMAND_RECORDER_H
+#define GX_GFX_COMMAND_RECORDER_H
+
+#include "gfx_element.h"
+
+#include <sstream>
+#include <unordered_map>
+
+
+namespace gfx
+{
+
+/**
+ * 编译时统计的指令数量
+ */
+struct CommandCounts
+{
+    uint32_t commandCount = 0;
+    uint32_t drawCount = 0;
+    uint32_t dispatchCount = 0;
+    uint32_t renderPassCount = 0;
+
+    void count(uint8_t cmdKey);
+};
+
+/**
+ * 指令缓冲的录制层，与后端无关
+ * 将CommandBuffer接口的调用编码到指令流，并在录制时跟踪状态、消除冗余状态指令、收集无序绘制和可修补指令，
+ * 后端在此基础上实现指令流的编译与提交
+ */
+class CommandRecorder : public CommandBuffer_P
+{
+public:
+    explicit CommandRecorder(GfxIdxTy idx)
+            : CommandBuffer_P(idx)
+    {}
+
+    Context_T *context() override;
+
+public:
+    CommandBufferLevel::Enum level() const;
+
+    /**
+     * 等待后台编译结束，指令流在编译期间不能修改
+     */
+    virtual void waitCompile();
+
+    std::string dump();
+
+    /**
+     * 最近一次编译中统计的指令数量
+     */
+    const CommandCounts &commandCounts() const;
+
+    /**
+     * 遍历指令流，收集所有元素idx在指令流中的位置
+     *
+     * @param stream
+     * @param positions
+     * @param counts        不为空时同时统计指令数量
+     */
+    static void collectElementPositions(CommandStream &stream, std::vector<uint64_t> &positions,
+                                        CommandCounts *counts = nullptr);
+
+public:
+    CommandBuffer begin() override;
+
+    void end() override;
+
+    CommandBuffer setClearColor(const ClearColor &clearColor) override;
+
+    CommandBuffer setClearDepthStencil(float depth, uint32_t stencil) override;
+
+    CommandBuffer bindRenderTarget(RenderTarget renderTarget) override;
+
+    CommandBuffer bindRenderTarget(Frame frame) override;
+
+    CommandBuffer beginRenderPass(const Rect2D &renderArea, const RenderPassInfo &rpInfo) override;
+
+    CommandBuffer endRenderPass() override;
+
+    CommandBuffer setGraphicsPipelineState(const GraphicsPipelineStateInfo &pipelineState) override;
+
+    CommandBuffer setVertexLayout(const VertexLayout &vertexLayout) override;
+
+    CommandBuffer setShaders(const std::vector<Shader> &shaders) override;
+
+    CommandBuffer nextSubpass() override;
+
+    CommandBuffer setViewport(const Rect2D &viewport, float minDepth, float maxDepth) override;
+
+    CommandBuffer setScissor(const Rect2D &scissor) override;
+
+    CommandBuffer setLineWidth(float lineWidth) override;
+
+    CommandBuffer setStencilCompareMask(StencilFace::Enum face, uint32_t mask) override;
+
+    CommandBuffer setStencilWriteMask(StencilFace::Enum face, uint32_t mask) override;
+
+    CommandBuffer setStencilReference(StencilFace::Enum face, uint32_t reference) override;
+
+    CommandBuffer bindResources(ResourceBindPoint::Enum bindPoint,
+                                const std::vector<ResourceBinder> &binders,
+                                const std::vector<uint32_t> &dynamicOffsets) override;
+
+    CommandBuffer bindVertexBuffer(uint32_t firstBinding,
+                                   const std::vector<Buffer> &buffers,
+                                   const std::vector<uint64_t> &offsets) override;
+
+    CommandBuffer bindIndexBuffer(Buffer buffer, uint32_t offset, IndexType::Enum indexType) override;
+
+    CommandBuffer draw(uint32_t vertexCount, uint32_t instanceCount,
+                       uint32_t firstVertex, uint32_t firstInstance) override;
+
+    CommandBuffer drawIndexed(uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, int32_t vertexOffset,
+                              uint32_t firstInstance) override;
+
+    CommandBuffer drawIndirect(Buffer buffer, uint32_t offset, uint32_t drawCount, uint32_t stride) override;
+
+    CommandBuffer drawIndexedIndirect(Buffer buffer, uint32_t offset, uint32_t drawCount, uint32_t stride) override;
+
+    CommandBuffer dispatch(uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ) override;
+
+    CommandBuffer dispatchIndirect(Buffer buffer, uint32_t offset) override;
+
+    CommandBuffer beginSortedDraws() override;
+
+    CommandBuffer endSortedDraws() override;
+
+    CommandBuffer executeCommands(const std::vector<CommandBuffer> &secondaryCmdBuffers) override;
+
+    CommandBuffer pipelineBarrier(PipelineStageMask srcStage, PipelineStageMask dstStage) override;
+
+    CommandBuffer bufferMemoryBarrier(Buffer buffer, const BufferBarrierInfo &barrierInfo) override;
+
+    CommandBuffer imageMemoryBarrier(Texture texture,
+                                     ImageLayout::Enum srcLayout,
+                                     ImageLayout::Enum dstLayout,
+                                     const ImageSubResourceRange &range) override;
+
+    CommandBuffer copyBuffer(Buffer src, Buffer dst, uint64_t srcOffset, uint64_t dstOffset, uint64_t size) override;
+
+    CommandBuffer copyImage(Texture src, Texture dst, const std::vector<ImageCopyInfo> &copyInfos) override;
+
+    CommandBuffer copyBufferToImage(Buffer src, Texture dst,
+                                    const std::vector<BufferImageCopyInfo> &copyInfos) override;
+
+    CommandBuffer copyImageToBuffer(Texture src, Buffer dst,
+                                    const std::vector<BufferImageCopyInfo> &copyInfos) override;
+
+    CommandBuffer blitImage(Texture src, Texture dst, const std::vector<ImageBlitInfo> &blitInfos,
+                            BlitFilter::Enum filter) override;
+
+    CommandBuffer copyRenderTarget(RenderTarget src, RenderTarget dst,
+                                   const std::vector<ImageCopyInfo> &copyInfos,
+                                   uint8_t frameIndex) override;
+
+    CommandBuffer blitRenderTarget(RenderTarget src, RenderTarget dst,
+                                   const std::vector<ImageBlitInfo> &blitInfos,
+                                   BlitFilter::Enum filter,
+                                   uint8_t frameIndex) override;
+
+    CommandBuffer blitRenderTargetToImage(RenderTarget src, Texture dst,
+                                          const std::vector<ImageBlitInfo> &blitInfos,
+                                          BlitFilter::Enum filter,
+                                          uint8_t attachIndex,
+                                          uint8_t frameIndex) override;
+
+    CommandBuffer copyRenderTargetToImage(RenderTarget src, Texture dst,
+                                          const std::vector<ImageCopyInfo> &copyInfos,
+                                          uint8_t attachIndex,
+                                          uint8_t frameIndex) override;
+
+    CommandBuffer copyRenderTargetToBuffer(RenderTarget src, Buffer dst,
+                                           const std::vector<BufferImageCopyInfo> &copyInfos,
+                                           uint8_t attachIndex,
+                                           uint8_t frameIndex) override;
+
+    CommandBuffer fillBuffer(Buffer buffer, uint64_t offset, uint64_t size, uint32_t data) override;
+
+    CommandBuffer beginDebugLabel(const std::string &label) override;
+
+    CommandBuffer endDebugLabel() override;
+
+    CommandBuffer resetQuery(Query query, uint32_t firstQuery, uint32_t queryCount) override;
+
+    CommandBuffer beginQuery(Query query, uint32_t queryIndex, bool precise) override;
+
+    CommandBuffer endQuery(Query query, uint32_t queryIndex) override;
+
+    CommandBuffer writeTimestamp(PipelineStage::Enum pipelineStage, Query query, uint32_t queryIndex) override;
+
+    CommandBuffer copyQueryResults(Query query,
+                                   uint32_t firstQuery, uint32_t queryCount,
+                                   Buffer dstBuffer, uint64_t dstOffset,
+                                   QueryResultFlags resultFlags) override;
+
+    CommandPatch markPatch() override;
+
+    void patchDynamicOffsets(CommandPatch patch, const std::vector<uint32_t> &dynamicOffsets) override;
+
+    void patchBuffer(CommandPatch patch, Buffer buffer, uint32_t offset) override;
+
+    bool isValid() override;
+
+protected:
+    /**
+     * Subpass的内容类型，数值与VkSubpassContents一致
+     */
+    struct SubpassContents
+    {
+        enum Enum : uint8_t
+        {
+            Inline = 0,
+            SecondaryCommandBuffers,
+        };
+    };
+
+    /**
+     * 录制时跟踪的状态槽，记录最近一次设置该状态的指令位置
+     */
+    struct StateSlot
+    {
+        enum Enum : uint8_t
+        {
+            GraphPipelineState = 0,
+            VertexLayout,
+            Shaders,
+            Viewport,
+            Scissor,
+            LineWidth,
+            StencilCompMaskFront,
+            StencilCompMaskBack,
+            StencilWriteMaskFront,
+            StencilWriteMaskBack,
+            StencilReferenceFront,
+            StencilReferenceBack,
+            GraphicsDescSet,
+            ComputeDescSet,
+            IndexBuffer,
+
+            Count       // 之后为各顶点缓冲绑定点
+        };
+    };
+
+    struct TrackedState
+    {
+        uint64_t pos = UINT64_MAX;      // UINT64_MAX表示未设置
+        uint64_t endPos = 0;
+        size_t hash = 0;
+        bool hashed = false;
+    };
+
+    /**
+     * 无序绘制区间中的一次绘制
+     */
+    struct SortedDraw
+    {
+        size_t pipelineKey;
+        size_t binderKey;
+        size_t bufferKey;
+        uint32_t order;
+        uint64_t drawPos;
+        uint32_t stateOffset;           // 绘制时各状态槽的指令位置在mSortedDrawStates中的起始位置
+        uint32_t stateCount;
+    };
+
+    /**
+     * 无序绘制区间的排序结果
+     */
+    struct SortedRegion
+    {
+        uint64_t beginPos;
+        uint64_t endPos;
+        bool sorted;
+        std::vector<uint64_t> commands; // 排序后依次编译的指令位置
+    };
+
+    /**
+     * 可修补的指令参数
+     */
+    struct PatchPoint
+    {
+        uint64_t pos = 0;                   // 指令在指令流中的起始位置
+        uint64_t endPos = 0;
+        uint8_t cmdKey = 0;
+        uint32_t dynamicOffsetCount = 0;
+
+        bool patched = false;
+        std::vector<uint32_t> dynamicOffsets;
+        GfxIdxTy buffer = 0;
+        uint32_t offset = 0;
+    };
+
+protected:
+    /**
+     * 初始化录制状态，指令流的内存块从arena获取
+     */
+    void initRecorder(Context_T *context, const CreateCommandBufferInfo &createInfo, CommandArena &arena);
+
+    void destroyRecorder();
+
+    /**
+     * end()录制完成后调用，后端可在此开始编译
+     */
+    virtual void onEnd();
+
+    /**
+     * 修补指令参数后调用，默认在下一次提交时重新编译
+     */
+    virtual void onPatched();
+
+    void resetCommandBuffer();
+
+    /**
+     * 更新录制的状态跟踪，无序绘制区间中同时收集绘制
+     */
+    void trackCommand(uint64_t cmdPos, uint8_t cmdKey);
+
+    void setTrackedState(uint32_t slot, uint64_t cmdPos);
+
+    /**
+     * 刚录制的状态指令与当前生效的状态完全相同时将其从指令流中移除
+     *
+     * @return 是否已移除
+     */
+    bool elideRedundantState(uint64_t cmdPos, uint8_t cmdKey);
+
+    size_t trackedStateHash(uint32_t slot);
+
+    /**
+     * 对无序绘制区间中的绘制排序，生成编译顺序
+     */
+    bool sortDraws(SortedRegion &region);
+
+    const SortedRegion *findSortedRegion(uint64_t beginPos) const;
+
+    /**
+     * 输出一条指令的参数，读取位置需位于指令键之后
+     */
+    void dumpCommand(std::ostringstream &out, uint8_t cmdKey, uint64_t cmdPos);
+
+    /**
+     * 写入元素的idx，bundle同时记录引用关系
+     */
+    void writeElement(ElementHandle *obj);
+
+    /**
+     * 记录刚写入的指令为可修补的候选
+     */
+    void setPatchCandidate(uint64_t pos, uint8_t cmdKey, uint32_t dynamicOffsetCount = 0);
+
+protected:
+    Context_T *mContextT = GFX_NULL_HANDLE;
+
+    CommandStream mCommandBuffer;
+
+    uint32_t mElidedStateCount = 0;     // 录制时移除的冗余状态指令数量
+    uint32_t mDebugLabelCount = 0;      // 录制的调试标签数量
+    CommandCounts mCommandCounts;       // 由后端在编译时统计
+
+    CommandBufferLevel::Enum mLevel = CommandBufferLevel::Primary;
+    QueueType::Enum mQueueType = QueueType::Graphics;
+
+    // 按录制顺序记录每个Subpass的内容类型
+    std::vector<SubpassContents::Enum> mSubpassContents;
+    bool mInRenderPass = false;
+
+    PatchPoint mPatchCandidate{};
+    bool mHasPatchCandidate = false;
+    std::vector<PatchPoint> mPatches;       // 按pos递增排列
+
+    uint32_t mMaxFrameBufferCount = 0;      // 录制中绑定的渲染目标的最大帧缓冲数量
+
+    bool mIsBundle = false;
+    std::unordered_map<GfxIdxTy, ElementHandle *> mReferences;
+    uint64_t mValidatedEpoch = 0;
+    bool mIsValid = true;
+
+    std::vector<TrackedState> mTrackedStates;
+    std::vector<SortedDraw> mSortedDraws;
+    std::vector<uint64_t> mSortedDrawStates;
+    std::vector<SortedRegion> mSortedRegions;   // 按beginPos递增排列
+    bool mInSortedDraws = false;
+    bool mSortedDrawsSortable = true;           // 区间内是否只有可排序的指令
+    uint64_t mSortedLastEndPos = 0;
+
+    bool mIsCompiled = false;
+    bool mIsBegun = false;
+};
+
+}
+
+#endif //GX_GFX_COMMAND_RECORDER_H
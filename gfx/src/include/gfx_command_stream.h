@@ -0,0 +1,191 @@
+/*
+ * Copyright (c) 2023 Gxin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef GX_GFX_COMMAND_STREAM_H
+#define GX_GFX_COMMAND_STREAM_H
+
+#include <gfx/gfx_base.h>
+#include <gx/gmutex.h>
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <type_traits>
+
+
+namespace gfx
+{
+
+#define CMD_CHUNK_SHIFT 16
+#define CMD_CHUNK_SIZE (1ull << CMD_CHUNK_SHIFT)    // 64KB
+#define CMD_CHUNK_MASK (CMD_CHUNK_SIZE - 1)
+
+/**
+ * 指令内存池
+ * 缓存固定大小的指令块，指令流销毁时归还，新建或增长的指令流优先复用缓存的指令块
+ */
+class CommandArena
+{
+public:
+    ~CommandArena();
+
+    /**
+     * 获取一个CMD_CHUNK_SIZE大小的指令块
+     *
+     * @return
+     */
+    uint8_t *acquire();
+
+    void release(uint8_t *chunk);
+
+    /**
+     * 释放缓存的所有指令块
+     */
+    void clear();
+
+private:
+    GMutex mMutex;
+    std::vector<uint8_t *> mFreeChunks;
+};
+
+/**
+ * 指令流
+ * 由内存池中的指令块串联而成，写满一块后追加新块，已写入的内容不会移动，
+ * reset后保留已获取的指令块，计数、绘制参数等小整数使用varint编码
+ */
+class CommandStream
+{
+public:
+    ~CommandStream();
+
+    void init(CommandArena *arena);
+
+    void destroy();
+
+public:
+    template<typename T>
+    void write(const T &value)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "CommandStream can only write trivially copyable type");
+        write(&value, sizeof(T));
+    }
+
+    void write(const void *data, uint64_t size);
+
+    void write(const std::string &str);
+
+    /**
+     * 追加另一个指令流中[pos, pos + size)的内容
+     */
+    void write(const CommandStream &src, uint64_t pos, uint64_t size);
+
+    template<typename T>
+    void read(T &value)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "CommandStream can only read trivially copyable type");
+        read(&value, sizeof(T));
+    }
+
+    void read(void *data, uint64_t size);
+
+    void read(std::string &str);
+
+    void writeVarint(uint32_t value);
+
+    void readVarint(uint32_t &value);
+
+    /**
+     * 有符号整数使用zigzag编码后写入
+     */
+    void writeVarint(int32_t value);
+
+    void readVarint(int32_t &value);
+
+    /**
+     * 从pos处解码varint，pos移动到其后
+     */
+    uint32_t decodeVarint(uint64_t &pos) const;
+
+    /**
+     * 随机读取，不移动读取位置
+     */
+    void copy(uint64_t pos, void *data, uint64_t size) const;
+
+    uint8_t byteAt(uint64_t pos) const
+    {
+        return mChunks[pos >> CMD_CHUNK_SHIFT][pos & CMD_CHUNK_MASK];
+    }
+
+    /**
+     * 比较两段内容是否相同
+     */
+    bool equal(uint64_t posA, uint64_t posB, uint64_t size) const;
+
+    /**
+     * 内容的哈希值，与内容跨越的指令块无关
+     */
+    size_t hash(uint64_t pos, uint64_t size) const;
+
+    /**
+     * 按指令块依次访问[pos, pos + size)的内容
+     *
+     * @param func  void(const uint8_t *data, uint64_t size)
+     */
+    template<typename Func>
+    void visit(uint64_t pos, uint64_t size, Func &&func) const
+    {
+        while (size > 0) {
+            const uint64_t offset = pos & CMD_CHUNK_MASK;
+            const uint64_t n = std::min<uint64_t>(size, CMD_CHUNK_SIZE - offset);
+            func(mChunks[pos >> CMD_CHUNK_SHIFT] + offset, n);
+            pos += n;
+            size -= n;
+        }
+    }
+
+    void seekReadPos(int whence, int64_t pos);
+
+    uint64_t readPos() const;
+
+    uint64_t writePos() const;
+
+    /**
+     * 清空内容，保留已获取的指令块
+     */
+    void reset();
+
+    /**
+     * 丢弃pos之后写入的内容
+     */
+    void truncate(uint64_t pos);
+
+private:
+    CommandArena *mArena = nullptr;
+    std::vector<uint8_t *> mChunks;
+    uint64_t mWritePos = 0;
+    uint64_t mReadPos = 0;
+};
+
+}
+
+#endif //GX_GFX_COMMAND_STREAM_H
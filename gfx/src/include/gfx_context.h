@@ -27,6 +27,8 @@
 #include "gfx_private.h"
 #include "gfx_instance.h"
 #include "gfx_p.h"
+#include "gfx_profiler_impl.h"
+#include "gfx_memory_tracker.h"
 
 #include <unordered_map>
 
@@ -95,11 +97,31 @@ public:
 
     std::string dumpCommandBuffer(CommandBuffer commandBuffer) override;
 
+    ContextStatistics getStatistics() override;
+
+    MemoryStatistics getMemoryStatistics() override;
+
+    void setMemoryBudgetCallback(const MemoryBudgetCallback &callback, float threshold) override;
+
 public:
     Context_P *contextP();
 
     Instance_T *instanceT();
 
+    Profiler &profiler();
+
+    ContextCounters &counters();
+
+    MemoryTracker &memoryTracker();
+
+    /**
+     * 在后端常驻的工作线程上并行执行count个任务，全部完成后返回
+     *
+     * @param count
+     * @param task      参数为任务序号
+     */
+    void parallelCompile(uint32_t count, const std::function<void(uint32_t)> &task);
+
     Fence createFence(bool signaled);
 
     void destroyFence(Fence obj);
@@ -110,15 +132,15 @@ public:
 
     RenderTarget createRenderTarget(const CreateRenderTargetInfo &createInfo);
 
-    void destroyRenderTarget(RenderTarget obj);
+    void destroyRenderTarget(RenderTarget obj, bool deferred = false);
 
     Buffer createBuffer(const CreateBufferInfo &createInfo);
 
-    void destroyBuffer(Buffer obj);
+    void destroyBuffer(Buffer obj, bool deferred = false);
 
     Texture createTexture(const CreateTextureInfo &createInfo);
 
-    void destroyTexture(Texture obj);
+    void destroyTexture(Texture obj, bool deferred = false);
 
     Sampler createSampler(const CreateSamplerInfo &createInfo);
 
@@ -130,7 +152,7 @@ public:
 
     ResourceBinder createResourceBinder(const ResourceLayoutInfo &layoutInfo);
 
-    void destroyResourceBinder(ResourceBinder obj);
+    void destroyResourceBinder(ResourceBinder obj, bool deferred = false);
 
     CommandBuffer createCommandBuffer(const CreateCommandBufferInfo &createInfo);
 
@@ -145,6 +167,10 @@ private:
     Instance_T *mInstanceT = GFX_NULL_HANDLE;
 
     uint32_t mDeviceIndex = 0;
+
+    Profiler mProfiler;
+    ContextCounters mCounters;
+    MemoryTracker mMemoryTracker;
 };
 
 }
@@ -36,8 +36,10 @@ struct AttachmentDesc
         struct
         {
             Format::Enum format: 8;
-            bool clear: 4;
-            bool discard: 4;
+            bool clear: 2;
+            bool discard: 2;
+            bool discardEnd: 2;     // 结束时不写回内存
+            bool transient: 2;      // 瞬态附件，内容从不写回内存
             ImageLayout::Enum initLayout: 4;
             ImageLayout::Enum finalLayout: 4;
             ImageLayout::Enum subPassLayout: 8;
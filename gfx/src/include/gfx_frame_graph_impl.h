@@ -0,0 +1,196 @@
+/*
+ * Copyright (c) 2023 Gxin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef GX_GFX_FRAME_GRAPH_IMPL_H
+#define GX_GFX_FRAME_GRAPH_IMPL_H
+
+#include <gfx/gfx_frame_graph.h>
+#include "gfx_private.h"
+
+
+namespace gfx
+{
+
+GFX_API_IMPL(FrameGraph)
+{
+public:
+    bool init(Context context);
+
+    void destroy();
+
+public:
+    FrameGraphResource createTexture(const std::string &name, const CreateTextureInfo &createInfo) override;
+
+    FrameGraphResource importTexture(const std::string &name, Texture texture, ImageLayout::Enum layout) override;
+
+    FrameGraphResource importFrame(const std::string &name, Frame frame) override;
+
+    FrameGraphPass addPass(const FrameGraphPassInfo &passInfo, const FrameGraphExecuteCallback &execute) override;
+
+    void read(FrameGraphPass pass, FrameGraphResource resource, FrameGraphAccess::Enum access) override;
+
+    void write(FrameGraphPass pass, FrameGraphResource resource, FrameGraphAccess::Enum access) override;
+
+    void writeColor(FrameGraphPass pass, FrameGraphResource resource, uint8_t index, bool clear) override;
+
+    void writeDepthStencil(FrameGraphPass pass, FrameGraphResource resource, bool clear) override;
+
+    bool compile() override;
+
+    void execute(CommandBuffer cmdBuffer, bool parallel) override;
+
+    void reset() override;
+
+    Texture getTexture(FrameGraphResource resource) override;
+
+    bool isPassCulled(FrameGraphPass pass) override;
+
+    std::string dump() override;
+
+private:
+    struct ResourceKind
+    {
+        enum Enum : uint8_t
+        {
+            Transient = 0,
+            Imported,
+            Frame,
+        };
+    };
+
+    struct ResourceNode
+    {
+        std::string name;
+        ResourceKind::Enum kind;
+        CreateTextureInfo createInfo{};
+
+        Texture texture = GFX_NULL_HANDLE;      // 导入的纹理或分配的实际纹理
+        Frame frame = GFX_NULL_HANDLE;
+        ImageLayout::Enum importLayout = ImageLayout::Undefined;
+
+        uint32_t firstPass = FRAME_GRAPH_INVALID_ID;
+        uint32_t lastPass = FRAME_GRAPH_INVALID_ID;
+    };
+
+    struct ResourceAccess
+    {
+        FrameGraphResource resource;
+        FrameGraphAccess::Enum access;
+        bool isWrite;
+        bool clear;
+        uint8_t index;
+    };
+
+    struct LayoutBarrier
+    {
+        Texture texture;
+        ImageLayout::Enum srcLayout;
+        ImageLayout::Enum dstLayout;
+    };
+
+    struct PassNode
+    {
+        FrameGraphPassInfo info;
+        FrameGraphExecuteCallback execute;
+        std::vector<ResourceAccess> accesses;
+
+        bool culled = false;
+
+        // 编译结果
+        std::vector<LayoutBarrier> barriers;
+        RenderTarget renderTarget = GFX_NULL_HANDLE;
+        Frame frame = GFX_NULL_HANDLE;
+        RenderPassInfo rpInfo{};
+        Rect2D renderArea{};
+    };
+
+    /**
+     * 纹理池中的纹理，跨帧保留
+     */
+    struct PooledTexture
+    {
+        CreateTextureInfo createInfo;
+        Texture texture;
+        ImageLayout::Enum layout;       // 帧图开始执行时纹理所处的布局
+        uint32_t busyUntilPass;         // 本次编译中被占用到的Pass
+        uint64_t lastUsedCompile;
+    };
+
+    struct CachedRenderTarget
+    {
+        std::vector<Texture> colors;
+        Texture depthStencil;
+        RenderTarget renderTarget;
+        uint64_t lastUsedCompile;
+    };
+
+    struct TextureState
+    {
+        ImageLayout::Enum layout;
+        ImageLayout::Enum finalLayout;
+        bool written;                   // 上一次访问是否为写入
+    };
+
+private:
+    bool checkPass(FrameGraphPass pass) const;
+
+    bool checkResource(FrameGraphResource resource) const;
+
+    void cullPasses();
+
+    bool allocateTextures();
+
+    bool buildPasses();
+
+    RenderTarget getRenderTarget(const std::vector<Texture> &colors, Texture depthStencil);
+
+    /**
+     * 并行录制时Pass使用的指令缓冲，Graphics Pass为Secondary，其余为Primary
+     */
+    CommandBuffer getPassCmdBuffer(uint32_t pass);
+
+    void releaseIdleResources();
+
+    static ImageLayout::Enum getAccessLayout(FrameGraphAccess::Enum access, FrameGraphPassType::Enum passType,
+                                             Texture texture);
+
+    static bool isSameTextureInfo(const CreateTextureInfo &a, const CreateTextureInfo &b);
+
+private:
+    Context mContext = GFX_NULL_HANDLE;
+
+    std::vector<ResourceNode> mResources;
+    std::vector<PassNode> mPasses;
+    std::vector<LayoutBarrier> mFinalBarriers;
+
+    std::vector<PooledTexture> mTexturePool;
+    std::vector<CachedRenderTarget> mRenderTargetCache;
+    std::vector<CommandBuffer> mPassCmdBuffers;         // 并行录制非Graphics Pass的Primary指令缓冲
+    std::vector<CommandBuffer> mPassSecondaryBuffers;   // 并行录制Graphics Pass的Secondary指令缓冲
+
+    uint64_t mCompileCount = 0;
+    bool mIsCompiled = false;
+};
+
+}
+
+#endif //GX_GFX_FRAME_GRAPH_IMPL_H
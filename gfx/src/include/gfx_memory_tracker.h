@@ -0,0 +1,156 @@
+/*
+ * Copyright (c) 2023 Gxin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef GX_GFX_MEMORY_TRACKER_H
+#define GX_GFX_MEMORY_TRACKER_H
+
+#include <gfx/gfx_def.h>
+
+#include <atomic>
+
+
+namespace gfx
+{
+
+/**
+ * 内存统计中的资源类别
+ * Buffer类别的顺序与BufferMemoryUsage一致
+ */
+struct MemoryCategory
+{
+    enum Enum : uint8_t
+    {
+        GpuOnlyBuffer = 0,
+        CpuOnlyBuffer,
+        CpuToGpuBuffer,
+        GpuToCpuBuffer,
+        Texture,
+        Attachment,
+        Staging,
+
+        Count
+    };
+
+    static Enum ofBuffer(BufferTypeFlags type, BufferMemoryUsage::Enum memoryUsage);
+
+    static Enum ofTexture(TextureUsageFlags usage);
+};
+
+static_assert(MemoryCategory::GpuToCpuBuffer + 1 == BufferMemoryUsage::Count,
+              "MemoryCategory buffer entries must match BufferMemoryUsage");
+
+/**
+ * 一个资源的内存分配记录，由资源持有，释放时交还给MemoryTracker
+ */
+struct MemoryRecord
+{
+    /// 无对应设备内存类型(如Null后端)
+    static constexpr uint32_t NO_MEMORY_TYPE = UINT32_MAX;
+
+    MemoryCategory::Enum category = MemoryCategory::Count;
+    uint32_t memoryType = NO_MEMORY_TYPE;
+    uint64_t size = 0;
+
+    bool isValid() const
+    {
+        return category != MemoryCategory::Count;
+    }
+};
+
+/**
+ * 按资源类别、内存类型和内存堆累计已分配的内存，可在任意线程更新
+ */
+class MemoryTracker
+{
+public:
+    static constexpr uint32_t MAX_MEMORY_TYPES = 32;
+    static constexpr uint32_t MAX_MEMORY_HEAPS = 16;
+
+public:
+    /**
+     * 设置各内存类型所属的内存堆，需在分配任何资源前调用
+     *
+     * @param typeHeapIndices
+     * @param typeCount
+     */
+    void setMemoryTypeHeaps(const uint32_t *typeHeapIndices, uint32_t typeCount);
+
+    /**
+     * 记录一次分配
+     *
+     * @param record
+     * @return 分配所在的内存堆编号，无对应内存堆时返回 MAX_MEMORY_HEAPS
+     */
+    uint32_t allocate(const MemoryRecord &record);
+
+    /**
+     * 记录一次释放并清空record，对无效的record不做处理
+     *
+     * @param record
+     */
+    void free(MemoryRecord &record);
+
+    uint64_t heapAllocationBytes(uint32_t heapIndex) const;
+
+    /**
+     * 填写内存堆上的资源分配统计
+     *
+     * @param heapIndex
+     * @param heap
+     */
+    void fillHeapStatistics(uint32_t heapIndex, MemoryHeapStatistics &heap) const;
+
+    /**
+     * 填写资源类别的统计，以及各内存类型和内存堆上的分配统计
+     * stats.heaps 和 stats.types 需已按设备的内存属性填写
+     *
+     * @param stats
+     */
+    void fillStatistics(MemoryStatistics &stats) const;
+
+private:
+    struct Counter
+    {
+        std::atomic<uint64_t> count{0};
+        std::atomic<uint64_t> bytes{0};
+
+        void add(uint64_t size);
+
+        void sub(uint64_t size);
+
+        MemoryResourceStatistics load() const;
+    };
+
+    uint32_t heapOf(uint32_t memoryType) const;
+
+private:
+    uint32_t mTypeCount = 0;
+    uint32_t mTypeHeapIndices[MAX_MEMORY_TYPES]{};
+
+    Counter mCategories[MemoryCategory::Count];
+    Counter mTypes[MAX_MEMORY_TYPES];
+    Counter mHeaps[MAX_MEMORY_HEAPS];
+};
+
+}
+
+#endif //GX_GFX_MEMORY_TRACKER_H
@@ -24,6 +24,7 @@
 #define GX_GFX_P_H
 
 #include <gfx/gfx_core.h>
+#include <gfx/gfx_capture.h>
 
 #include "gfx_private.h"
 
@@ -112,6 +113,32 @@ GFX_P_API(Context)
 
     GFX_API_FUNC(std::string dumpCommandBuffer(CommandBuffer commandBuffer));
 
+    GFX_API_FUNC(bool beginCapture(const std::string &path));
+
+    GFX_API_FUNC(bool endCapture());
+
+    GFX_API_FUNC(bool isCapturing());
+
+    GFX_API_FUNC(bool replayCapture(const std::string &path, const CaptureReplayInfo &info,
+                                    CaptureReplayResult &result));
+
+    /**
+     * 以非阻塞方式读取已执行完成的GPU时间戳，交给Context的性能分析器
+     */
+    GFX_API_FUNC(void collectProfilerEvents());
+
+    /**
+     * 在上下文常驻的工作线程上并行执行count个任务，调用线程同时参与执行，全部完成后返回
+     *
+     * @param count
+     * @param task      参数为任务序号
+     */
+    GFX_API_FUNC(void parallelCompile(uint32_t count, const std::function<void(uint32_t)> &task));
+
+    GFX_API_FUNC(MemoryStatistics getMemoryStatistics());
+
+    GFX_API_FUNC(void setMemoryBudgetCallback(const MemoryBudgetCallback &callback, float threshold));
+
     GFX_API_FUNC(Fence_P *createFenceP(bool signaled));
 
     GFX_API_FUNC(void destroyFenceP(Fence obj));
@@ -172,6 +199,29 @@ GFX_P_API(Context)
     GFX_API_FUNC(void destroyQueryP(Query obj));
 
     GFX_API_FUNC(Query_P *findQueryP(GfxIdxTy idx));
+
+    /**
+     * 将元素加入延迟销毁队列，待GPU执行完此前提交的指令后再销毁
+     *
+     * @param obj
+     */
+    GFX_API_FUNC(void deferDestroyP(ElementHandle *obj));
+
+    /**
+     * 元素销毁计数，每销毁(或延迟销毁)一个元素加一
+     *
+     * @return
+     */
+    GFX_API_FUNC(uint64_t elementEpoch() const);
+
+    /**
+     * 判断元素是否仍在元素表中(未被销毁)
+     *
+     * @param idx
+     * @param obj
+     * @return
+     */
+    GFX_API_FUNC(bool isElementAlive(GfxIdxTy idx, ElementHandle *obj));
 };
 
 
@@ -186,8 +236,8 @@ extern Instance_P *createInstanceP();            \
 extern void destroyInstanceP(Instance_P *);      \
 }
 
-//GFX_P_INTERFACE(none)
 GFX_P_INTERFACE(vk)
+GFX_P_INTERFACE(none)
 
 #undef GFX_P_INTERFACE
 
@@ -202,8 +252,8 @@ struct PInstanceCDFuncs
  */
 static PInstanceCDFuncs gfxPInstanceCDFuncs[] =
         {
-//                {none::createInstanceP, none::destroyInstanceP},
-                {vk::createInstanceP,   vk::destroyInstanceP}
+                {vk::createInstanceP,   vk::destroyInstanceP},
+                {none::createInstanceP, none::destroyInstanceP}
         };
 static_assert(ARRAY_LEN(gfxPInstanceCDFuncs) == TargetApiType::Count, "gfxPInstanceCDFuncs array size error");
 
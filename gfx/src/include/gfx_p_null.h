@@ -0,0 +1,728 @@
+/*
+ * Copyright (c) 2023 Gxin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef GX_GFX_P_NULL_H
+#define GX_GFX_P_NULL_H
+
+#include "gfx_p.h"
+
+#include "gfx_element.h"
+#include "gfx_private.h"
+#include "gfx_command_recorder.h"
+#include "gfx_memory_tracker.h"
+
+#include <gx/gid_allocator.h>
+#include <gx/gtime.h>
+#include <gx/gmutex.h>
+
+#include <unordered_map>
+#include <atomic>
+#include <mutex>
+
+
+namespace gfx
+{
+namespace none
+{
+
+template<uint16_t MaxNum>
+using IDAllocator = gx::GIDAllocator<uint16_t, MaxNum, std::mutex>;
+
+class CommandBufferNull;
+
+/**
+ * Instance的Null实现
+ * 不调用任何图形API，只提供一个CPU设备
+ */
+GFX_P_API_IMPL(Instance, Null)
+{
+public:
+    bool init(const CreateInstanceInfo &createInfo) override;
+
+    void destroy();
+
+public:
+    uint32_t deviceCount() override;
+
+    DeviceInfo deviceInfo(uint32_t deviceIndex) override;
+
+    bool isCreated() override;
+
+    Context_P *createContextP() override;
+
+    void destroyContextP(Context_P *obj) override;
+
+private:
+    bool mIsCreated = false;
+
+    IDAllocator<0xfffu> mCtxIDAllocator;
+};
+
+
+/**
+ * Context的Null实现
+ * 元素管理与指令录制和Vulkan后端一致，提交时只遍历指令流，不产生任何GPU工作
+ */
+GFX_P_API_IMPL(Context, Null)
+{
+public:
+    explicit ContextNull(uint16_t idx)
+            : mIdx(idx)
+    {}
+
+    bool init(Instance_P *instance, Context_T *context, const CreateContextInfo &createInfo) override;
+
+    void destroy();
+
+    uint16_t idx()
+    {
+        return mIdx;
+    }
+
+public:
+    Format::Enum getSupportedDepthFormat() override;
+
+    std::vector<Format::Enum> formatSupported(const std::vector<Format::Enum> &formats,
+                                              FormatFeatureFlags featureFlags) override;
+
+    size_t uniformBufferOffsetAlignment(size_t dataSize) override;
+
+    size_t storageBufferOffsetAlignment(size_t dataSize) override;
+
+    size_t texelBufferOffsetAlignment(size_t dataSize) override;
+
+    SampleCountFlag::Enum maxRenderTargetSampleCount() override;
+
+    uint32_t maxTextureDimension1D() override;
+
+    uint32_t maxTextureDimension2D() override;
+
+    uint32_t maxTextureDimension3D() override;
+
+    uint32_t maxTextureDimensionCube() override;
+
+    uint32_t maxTextureArrayLayers() override;
+
+    bool isSupportTextureCubeArray() override;
+
+    uint32_t maxPerStageShaderSamplersCount() override;
+
+    uint32_t maxPerStageShaderUniformBuffersCount() override;
+
+    uint32_t maxPerStageShaderStorageBuffersCount() override;
+
+    uint32_t maxPerStageShaderSampledImagesCount() override;
+
+    uint32_t maxPerStageShaderStorageImagesCount() override;
+
+    void waitIdle() override;
+
+    void submitCommandBlock(CommandBuffer cmdBuffer, uint32_t bufferIndex) override;
+
+    void submitCommand(CommandBuffer cmdBuffer, uint32_t bufferIndex, Fence fence) override;
+
+    void queueWaitIdle(QueueType::Enum queueType) override;
+
+    std::string dumpCommandBuffer(CommandBuffer commandBuffer) override;
+
+    bool beginCapture(const std::string &path) override;
+
+    bool endCapture() override;
+
+    bool isCapturing() override;
+
+    bool replayCapture(const std::string &path, const CaptureReplayInfo &info,
+                       CaptureReplayResult &result) override;
+
+    void collectProfilerEvents() override;
+
+    void parallelCompile(uint32_t count, const std::function<void(uint32_t)> &task) override;
+
+    MemoryStatistics getMemoryStatistics() override;
+
+    void setMemoryBudgetCallback(const MemoryBudgetCallback &callback, float threshold) override;
+
+    Fence_P *createFenceP(bool signaled) override;
+
+    void destroyFenceP(Fence obj) override;
+
+    Fence_P *findFenceP(GfxIdxTy idx) override;
+
+    Frame_P *createFrameP(const CreateFrameInfo &createInfo) override;
+
+    void destroyFrameP(Frame obj) override;
+
+    Frame_P *findFrameP(GfxIdxTy idx) override;
+
+    RenderTarget_P *createRenderTargetP(const CreateRenderTargetInfo &createInfo) override;
+
+    void destroyRenderTargetP(RenderTarget obj) override;
+
+    RenderTarget_P *findRenderTargetP(GfxIdxTy idx) override;
+
+    Texture_P *createTextureP(const CreateTextureInfo &createInfo, SampleCountFlag::Enum sample) override;
+
+    void destroyTextureP(Texture obj) override;
+
+    Texture_P *findTextureP(GfxIdxTy idx) override;
+
+    Sampler_P *createSamplerP(const CreateSamplerInfo &createInfo) override;
+
+    void destroySamplerP(Sampler obj) override;
+
+    Sampler_P *findSamplerP(GfxIdxTy idx) override;
+
+    Buffer_P *createBufferP(const CreateBufferInfo &createInfo) override;
+
+    void destroyBufferP(Buffer obj) override;
+
+    Buffer_P *findBufferP(GfxIdxTy idx) override;
+
+    Shader_P *createShaderP(const CreateShaderInfo &createInfo) override;
+
+    void destroyShaderP(Shader obj) override;
+
+    Shader_P *findShaderP(GfxIdxTy idx) override;
+
+    ResourceBinder_P *createResourceBinderP(const ResourceLayoutInfo &layoutInfo) override;
+
+    void destroyResourceBinderP(ResourceBinder obj) override;
+
+    ResourceBinder_P *findResourceBinderP(GfxIdxTy idx) override;
+
+    CommandBuffer_P *createCommandBufferP(const CreateCommandBufferInfo &createInfo) override;
+
+    void destroyCommandBufferP(CommandBuffer obj) override;
+
+    CommandBuffer_P *findCommandBufferP(GfxIdxTy idx) override;
+
+    Query_P *createQueryP(const CreateQueryInfo &createInfo) override;
+
+    void destroyQueryP(Query obj) override;
+
+    Query_P *findQueryP(GfxIdxTy idx) override;
+
+    /**
+     * 没有GPU执行中的指令，延迟销毁的元素直接销毁
+     *
+     * @param obj
+     */
+    void deferDestroyP(ElementHandle *obj) override;
+
+    uint64_t elementEpoch() const override;
+
+    bool isElementAlive(GfxIdxTy idx, ElementHandle *obj) override;
+
+public:
+    /**
+     * 指令缓冲录制使用的内存池，由所有指令缓冲共享
+     *
+     * @return
+     */
+    CommandArena &commandArena();
+
+    /**
+     * 检查并"编译"一次提交的指令缓冲，返回指令缓冲以便统计
+     *
+     * @param cmdBuffer
+     * @return
+     */
+    CommandBufferNull *prepareSubmit(CommandBuffer cmdBuffer);
+
+private:
+    bool containElementMap(GfxIdxTy idx);
+
+    void insertElementMap(ElementHandle *obj);
+
+    void removeElementMap(GfxIdxTy idx, ElementHandle *obj);
+
+    void destroyElement(ElementHandle *obj);
+
+    ElementHandle *findElement(ElementType::Enum type, GfxIdxTy idx);
+
+    void checkLeak();
+
+private:
+    uint16_t mIdx;
+
+    Context_T *mParentCtx = GFX_NULL_HANDLE;
+
+    GMutex mElementMapMutex;
+    std::unordered_map<GfxIdxTy, ElementHandle *> mElementMap;
+
+    IDAllocator<GFX_MAX_FENCES> mFenceIDAlloc;
+    IDAllocator<GFX_MAX_FRAMES> mFrameIDAlloc;
+    IDAllocator<GFX_MAX_RENDER_TARGETS> mRenderTargetIDAlloc;
+    IDAllocator<GFX_MAX_BUFFERS> mBufferIDAlloc;
+    IDAllocator<GFX_MAX_TEXTURES> mTextureIDAlloc;
+    IDAllocator<GFX_MAX_SAMPLERS> mSamplerIDAlloc;
+    IDAllocator<GFX_MAX_SHADERS> mShaderIDAlloc;
+    IDAllocator<GFX_MAX_DESC_SET_BINDERS> mDescSetBinderIDAlloc;
+    IDAllocator<GFX_MAX_COMMAND_BUFFERS> mCommandBufferIDAlloc;
+    IDAllocator<GFX_MAX_QUERY> mQueryIDAlloc;
+
+    std::atomic<uint64_t> mElementEpoch{0};
+
+    CommandArena mCommandArena;
+};
+
+
+GFX_P_API_IMPL(Fence, Null)
+{
+public:
+    explicit FenceNull(GfxIdxTy idx)
+            : Fence_P(idx)
+    {}
+
+    bool init(Context_T *context, bool signaled);
+
+    void destroy() override;
+
+    Context_T *context() override;
+
+    FenceWaitRet::Enum wait(uint64_t timeout) override;
+
+    void reset() override;
+
+    bool isSignaled() override;
+
+public:
+    void signal();
+
+private:
+    Context_T *mContextT = GFX_NULL_HANDLE;
+
+    std::atomic<bool> mSignaled{false};
+};
+
+
+class RenderTargetNull;
+
+class TextureNull;
+
+/**
+ * Frame的Null实现
+ * SwapChain类型的Frame使用离屏纹理代替交换链图像，endFrame不做呈现
+ */
+GFX_P_API_IMPL(Frame, Null)
+{
+public:
+    explicit FrameNull(GfxIdxTy idx)
+            : Frame_P(idx)
+    {}
+
+    bool init(Context_T *context, const CreateFrameInfo &createInfo);
+
+    void destroy() override;
+
+public:
+    bool reset(uint32_t width, uint32_t height, bool vSync, bool enforce) override;
+
+    bool beginFrame() override;
+
+    void submit(CommandBuffer commandBuffer) override;
+
+    void endFrame(bool waitQueue) override;
+
+    void waitGraphicsQueueIdle() override;
+
+    void setSwapChainErrorCallback(const FrameSwapChainErrorCallback &callback) override;
+
+    uint32_t frameBufferCount() override;
+
+    uint32_t currentFrameIndex() override;
+
+    RenderTarget renderTarget() override;
+
+    uint32_t width() override;
+
+    uint32_t height() override;
+
+    Format::Enum getSwapChainDepthFormat() override;
+
+    Format::Enum getSwapChainColorFormat() override;
+
+    uint64_t getFrameTime() override;
+
+    FrameStatistics getFrameStatistics() override;
+
+    Context_T *context() override;
+
+private:
+    bool initSwapChainTarget();
+
+    void destroySwapChainTarget();
+
+    void updateFrameState();
+
+private:
+    /// 代替交换链的离屏缓冲数量
+    static constexpr uint32_t SWAP_CHAIN_BUFFER_COUNT = 3;
+
+    Context_T *mContextT = GFX_NULL_HANDLE;
+
+    std::vector<Texture> mColorTextures;
+    Texture mDepthTexture = GFX_NULL_HANDLE;
+
+    Format::Enum mColorFormat = Format::Undefined;
+    Format::Enum mDepthFormat = Format::Undefined;
+
+    RenderTarget mRenderTarget = GFX_NULL_HANDLE;
+
+    uint32_t mCurrentFrameIndex = 0;
+
+    FrameTargetType::Enum mRenderTargetType = FrameTargetType::SwapChain;
+    bool mVSync = false;
+    uint32_t mWidth = 0;
+    uint32_t mHeight = 0;
+
+    struct
+    {
+        GTime time;
+        uint64_t frameTime = 0;
+
+        FrameStatistics statistics{};       // 上一帧的统计结果
+        FrameStatistics current{};          // 当前帧正在累计的统计
+        ContextStatistics contextStats{};   // 上一帧开始时Context的累计统计
+    } mFrameState;
+
+    FrameSwapChainErrorCallback mSwapChainErrorCb = nullptr;
+};
+
+
+GFX_P_API_IMPL(RenderTarget, Null)
+{
+public:
+    explicit RenderTargetNull(GfxIdxTy idx)
+            : RenderTarget_P(idx)
+    {}
+
+    bool init(Context_T *context, const CreateRenderTargetInfo &createInfo);
+
+    void destroy() override;
+
+public:
+    uint32_t width() override;
+
+    uint32_t height() override;
+
+    uint8_t frameBufferCount() override;
+
+    uint8_t colorAttachmentCount() override;
+
+    bool hasDepthStencil() override;
+
+    Attachment getColorAttachment(uint8_t frameIndex, uint8_t attachIndex) override;
+
+    Attachment getDepthStencilAttachment() override;
+
+public:
+    Context_T *context() override;
+
+private:
+    static uint32_t valueForLevel(uint8_t level, uint32_t baseLevelValue);
+
+private:
+    Context_T *mContextT = GFX_NULL_HANDLE;
+
+    uint32_t mWidth = 0;
+    uint32_t mHeight = 0;
+
+    uint8_t mFrameCount = 1;
+    uint8_t mColorCount = 0;
+    bool mHasDepth = false;
+
+    std::vector<std::vector<Attachment>> mAttachColors;
+    Attachment mAttachDepth{};
+};
+
+
+/**
+ * Buffer的Null实现
+ * 可映射的Buffer在主机内存中保留一份数据，GpuOnly的Buffer不分配内存
+ */
+GFX_P_API_IMPL(Buffer, Null)
+{
+public:
+    explicit BufferNull(GfxIdxTy idx)
+            : Buffer_P(idx)
+    {}
+
+    bool init(Context_T *context, const CreateBufferInfo &createInfo);
+
+    void destroy() override;
+
+    Context_T *context() override;
+
+public:
+    uint64_t size() override;
+
+    void *map() override;
+
+    void flush() override;
+
+    void flush(uint64_t offset, uint64_t size) override;
+
+    void invalidate(uint64_t offset, uint64_t size) override;
+
+    void markDirty(uint64_t offset, uint64_t size) override;
+
+    void unmap() override;
+
+private:
+    Context_T *mContextT = GFX_NULL_HANDLE;
+
+    BufferTypeFlags mType = 0;
+    BufferMemoryUsage::Enum mMemoryUsage = BufferMemoryUsage::GpuOnly;
+    uint64_t mSize = 0;
+
+    std::vector<uint8_t> mData;
+    MemoryRecord mMemoryRecord;
+};
+
+
+/**
+ * Texture的Null实现，只记录创建参数，不保存纹理内容
+ */
+GFX_P_API_IMPL(Texture, Null)
+{
+public:
+    explicit TextureNull(GfxIdxTy idx)
+            : Texture_P(idx)
+    {}
+
+    bool init(Context_T *context, const CreateTextureInfo &createInfo, SampleCountFlag::Enum sample);
+
+    void destroy() override;
+
+    Context_T *context() override;
+
+    size_t hash() override;
+
+public:
+    TextureType::Enum type() override;
+
+    Format::Enum format() override;
+
+    TextureUsageFlags usage() override;
+
+    TextureAspectFlags aspect() override;
+
+    uint32_t width() override;
+
+    uint32_t height() override;
+
+    uint32_t depth() override;
+
+    uint32_t layerCount() override;
+
+    uint32_t mipLevels() override;
+
+    uint64_t size() override;
+
+    void setData(const void *data, uint64_t size, Fence fence) override;
+
+    void setMipData(uint32_t mipLevel, uint32_t baseLayer, uint32_t layerCount,
+                    const void *data, uint64_t size, Fence fence) override;
+
+    void updateRegions(const void *data, uint64_t size,
+                       const std::vector<TextureUpdateRegion> &regions, Fence fence) override;
+
+    uint32_t residentBaseMip() override;
+
+    uint64_t residentSize(uint32_t baseMip) override;
+
+    bool setResidentBaseMip(uint32_t baseMip, Fence fence) override;
+
+    void genMipmap(Fence fence) override;
+
+private:
+    Context_T *mContextT = GFX_NULL_HANDLE;
+
+    size_t mHash = 0;
+
+    bool mStreaming = false;
+    uint32_t mResidentBaseMip = 0;
+
+    TextureType::Enum mType = TextureType::Texture2D;
+    Format::Enum mFormat = Format::Undefined;
+    TextureUsageFlags mUsage = 0;
+    TextureAspectFlags mAspect = 0;
+    uint32_t mWidth = 0;
+    uint32_t mHeight = 0;
+    uint32_t mDepth = 0;
+    uint32_t mLayerCount = 0;
+    uint32_t mMipLevels = 0;
+    SampleCountFlag::Enum mSample = SampleCountFlag::SampleCount_1;
+
+    MemoryRecord mMemoryRecord;
+};
+
+
+GFX_P_API_IMPL(Sampler, Null)
+{
+public:
+    explicit SamplerNull(GfxIdxTy idx)
+            : Sampler_P(idx)
+    {}
+
+    bool init(Context_T *context, const CreateSamplerInfo &createInfo);
+
+    void destroy() override;
+
+    Context_T *context() override;
+
+private:
+    Context_T *mContextT = GFX_NULL_HANDLE;
+
+    CreateSamplerInfo mCreateInfo{};
+};
+
+
+GFX_P_API_IMPL(Shader, Null)
+{
+public:
+    explicit ShaderNull(GfxIdxTy idx)
+            : Shader_P(idx)
+    {}
+
+    bool init(Context_T *context, const CreateShaderInfo &createInfo);
+
+    void destroy() override;
+
+    Context_T *context() override;
+
+    size_t hash() override;
+
+private:
+    Context_T *mContextT = GFX_NULL_HANDLE;
+    size_t mHash = 0;
+    std::string mTag;
+    ShaderType::Enum mType = ShaderType::Vertex;
+};
+
+
+/**
+ * ResourceBinder的Null实现，只记录绑定的资源
+ */
+GFX_P_API_IMPL(ResourceBinder, Null)
+{
+public:
+    explicit ResourceBinderNull(GfxIdxTy idx)
+            : ResourceBinder_P(idx)
+    {}
+
+    bool init(Context_T *context, const ResourceLayoutInfo &layoutInfo);
+
+    void destroy() override;
+
+    Context_T *context() override;
+
+    void bindBuffer(uint32_t binding, Buffer buffer) override;
+
+    void bindBufferRange(uint32_t binding, Buffer buffer, uint64_t offset, uint64_t range) override;
+
+    void bindTexelBuffer(uint32_t binding, Buffer buffer,
+                         Format::Enum format, uint64_t offset, uint64_t range) override;
+
+    void bindTexture(uint32_t binding, Texture texture, Sampler sampler, const TextureBindRange &range) override;
+
+    void bindInputAttachment(uint32_t binding, Texture texture, const TextureBindRange &range) override;
+
+private:
+    struct BindInfo
+    {
+        Buffer buffer;
+        Texture texture;
+        Sampler sampler;
+        uint64_t offset;
+        uint64_t range;
+    };
+
+private:
+    Context_T *mContextT = GFX_NULL_HANDLE;
+
+    ResourceLayoutInfo mLayoutInfo;
+    std::vector<BindInfo> mBindInfos;   // 以binding为下标
+};
+
+
+/**
+ * CommandBuffer的Null实现
+ * 录制完全由CommandRecorder完成，编译只遍历一次指令流
+ */
+class CommandBufferNull : public CommandRecorder
+{
+public:
+    explicit CommandBufferNull(GfxIdxTy idx)
+            : CommandRecorder(idx)
+    {}
+
+    bool init(Context_T *context, const CreateCommandBufferInfo &createInfo);
+
+    void destroy() override;
+
+public:
+    void compile();
+
+    bool isCompiled() const;
+
+    uint32_t redundantStateCount() const;
+
+private:
+    std::vector<uint64_t> mElementPositions;    // 编译时遍历指令流的结果，复用内存
+};
+
+
+GFX_P_API_IMPL(Query, Null)
+{
+public:
+    explicit QueryNull(GfxIdxTy idx)
+            : Query_P(idx)
+    {}
+
+    bool init(Context_T *context, const CreateQueryInfo &createInfo);
+
+    void destroy() override;
+
+    Context_T *context() override;
+
+    size_t hash() override;
+
+    void getQueryResults(std::vector<uint64_t> &results, QueryResultFlags flags) override;
+
+    void getQueryResults(std::vector<uint64_t> &results, uint32_t firstQuery, uint32_t queryCount,
+                         QueryResultFlags flags) override;
+
+private:
+    Context_T *mContextT = GFX_NULL_HANDLE;
+
+    size_t mHash = 0;
+
+    QueryType::Enum mQueryType = QueryType::Occlusion;
+    uint32_t mQueryCount = 0;
+};
+
+}
+}
+
+#endif //GX_GFX_P_NULL_H
@@ -27,6 +27,9 @@
 
 #include "gfx_element.h"
 #include "gfx_private.h"
+#include "gfx_command_recorder.h"
+#include "gfx_memory_tracker.h"
+#include "gfx_profiler_impl.h"
 #include "gfx_def_vk.h"
 
 #include <gfx/vulkan.h>
@@ -37,6 +40,7 @@
 #include <gfx/gvk_framebuffer.h>
 #include <gfx/gvk_image.h>
 #include <gfx/gvk_buffer.h>
+#include <gfx/gvk_memory_allocator.h>
 #include <gfx/gvk_sampler.h>
 #include <gfx/gvk_fence.h>
 #include <gfx/gvk_semaphore.h>
@@ -48,9 +52,14 @@
 
 #include <functional>
 #include <unordered_set>
+#include <deque>
+#include <atomic>
 
 #include <gx/gmutex.h>
 #include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 #ifdef USE_AMD_VULKAN_MEMORY_ALLOCATOR
 #ifndef VMA_IMPLEMENTATION
@@ -92,6 +101,18 @@ namespace vk
 
 #define MAX_DESC_SETS 1024
 
+// 连续相同状态的绘制达到该数量时合并为一次多重间接绘制
+#define MULTI_DRAW_MIN_COUNT 4
+
+// 合并绘制使用的间接缓冲块大小
+#define INDIRECT_CHUNK_SIZE 65536
+
+// 后台编译线程池的最大线程数
+#define MAX_COMPILE_THREADS 4
+
+// Buffer记录的写入区间达到该数量时先合并一次
+#define MAX_DIRTY_RANGES 64
+
 /// ============ TransFuncs ============ ///
 
 extern VkFormat toVkFormat(Format::Enum format);
@@ -185,12 +206,240 @@ class RenderPassVk;
 
 class TextureVk;
 
+class BufferVk;
+
 class DescriptorLayoutVk;
 
 class PipelineLayoutVk;
 
 class PipelineVk;
 
+class CaptureVk;
+
+class ContextVk;
+
+/**
+ * GPU时间戳采样
+ * 编译主指令缓冲时在调试标签区间的开始和结束写入时间戳，提交后延迟若干帧以非阻塞方式读取结果
+ */
+class GpuProfilerVk
+{
+public:
+    struct Scope
+    {
+        std::string name;
+        uint32_t depth;
+        uint32_t beginQuery;
+        uint32_t endQuery;
+    };
+
+    /**
+     * 每个VkCommandBuffer独占的查询池，编译时按调试标签数量扩容
+     * 查询池分为latency+1段按帧轮转，录制时写入当前帧对应的一段，读取前不会被之后的提交重置
+     */
+    struct QuerySlot
+    {
+        VkQueryPool pool = VK_NULL_HANDLE;
+        uint32_t capacity = 0;          // 每段的查询数量
+        uint32_t ringSize = 0;
+        uint32_t slice = 0;             // 录制时写入的段
+        uint32_t queryCount = 0;
+        std::shared_ptr<std::vector<Scope>> scopes;     // 待读取的提交共享，重新编译时替换
+
+        uint32_t firstQuery() const
+        {
+            return slice * capacity;
+        }
+    };
+
+public:
+    void init(ContextVk *context, Profiler *profiler);
+
+    void destroy();
+
+    /**
+     * 是否需要在编译时写入时间戳
+     */
+    bool isEnabled() const;
+
+    /**
+     * 编译前准备查询池，选择当前帧对应的段，容量不足时重新创建
+     *
+     * @param slot
+     * @param queryCount    为0时清空slot，不进行采样
+     * @return 是否可以采样
+     */
+    bool prepareSlot(QuerySlot &slot, uint32_t queryCount);
+
+    /**
+     * slot录制时写入的段是否就是当前帧对应的段，不是时需要重新录制
+     */
+    bool isCurrentSlice(const QuerySlot &slot) const;
+
+    /**
+     * 释放slot的查询池，查询池在此前的提交执行完成后才销毁
+     */
+    void releaseSlot(QuerySlot &slot);
+
+    /**
+     * 提交slot所属的VkCommandBuffer时调用，记录待读取的查询，结果只在collect中读取
+     *
+     * @param slot
+     */
+    void onSubmit(const QuerySlot &slot);
+
+    /**
+     * 读取提交已超过延迟帧数的结果，不等待GPU，并销毁已不再使用的查询池
+     */
+    void collect();
+
+private:
+    struct PendingSubmit
+    {
+        VkQueryPool pool;
+        uint32_t firstQuery;
+        uint32_t queryCount;
+        std::shared_ptr<std::vector<Scope>> scopes;
+        uint64_t frame;
+        uint64_t submitNs;
+    };
+
+    /**
+     * 等待销毁的查询池，serial为释放时最后一次提交的序号
+     */
+    struct RetiredPool
+    {
+        VkQueryPool pool;
+        uint64_t serial;
+    };
+
+    uint32_t ringSize() const;
+
+    uint32_t currentSlice(uint32_t ringSize) const;
+
+    /**
+     * 读取一次提交的结果，全部可用时转换为事件交给分析器
+     *
+     * @return 是否读取成功
+     */
+    bool readResults(const PendingSubmit &pending);
+
+    /**
+     * 同一段被之后的提交重新写入时，较早的提交无法再读取
+     */
+    bool isSuperseded(size_t index) const;
+
+    void retirePool(VkQueryPool pool);
+
+    /**
+     * 销毁提交已执行完成的查询池，之前读取仍在其中的结果
+     *
+     * @param completedSerial
+     */
+    void releaseRetiredPools(uint64_t completedSerial);
+
+private:
+    ContextVk *mContext = nullptr;
+    Profiler *mProfiler = nullptr;
+
+    GMutex mMutex;
+    std::vector<PendingSubmit> mPending;
+    std::vector<RetiredPool> mRetiredPools;
+    std::vector<uint64_t> mResults;
+};
+
+/**
+ * 设备内存预算
+ * 支持VK_EXT_memory_budget时预算和占用来自驱动，否则按内存堆大小的80%作为预算，按已分配资源估算占用
+ * 两次查询之间新分配的资源按增量累加到上次查询的占用上
+ */
+class MemoryBudgetVk
+{
+public:
+    void init(ContextVk *context, MemoryTracker *tracker, bool supportBudgetExt);
+
+    void setCallback(const MemoryBudgetCallback &callback, float threshold);
+
+    bool isSupportBudgetExt() const;
+
+    /**
+     * 重新查询各内存堆的预算和占用，并检查是否超出预算
+     */
+    void update();
+
+    /**
+     * 在内存堆上分配资源后调用，使用上次查询的结果估算占用并检查是否超出预算
+     *
+     * @param heapIndex
+     */
+    void check(uint32_t heapIndex);
+
+    /**
+     * 填写内存堆和内存类型的属性、预算和占用
+     *
+     * @param stats
+     */
+    void fillStatistics(MemoryStatistics &stats);
+
+private:
+    struct HeapState
+    {
+        uint64_t budget = 0;
+        uint64_t usage = 0;             // 上次查询时的占用
+        uint64_t trackedBytes = 0;      // 上次查询时MemoryTracker记录的分配字节数
+        bool overBudget = false;
+    };
+
+    struct OverBudgetHeap
+    {
+        uint32_t heapIndex;
+        MemoryHeapStatistics heap;
+    };
+
+    void queryHeaps();
+
+    uint64_t estimateUsage(uint32_t heapIndex) const;
+
+    /**
+     * 检查内存堆是否超出预算，刚超出时将其加入overHeaps
+     */
+    void checkHeap(uint32_t heapIndex, std::vector<OverBudgetHeap> &overHeaps);
+
+    /**
+     * 在锁外调用回调，回调中可以继续查询统计或释放资源
+     */
+    void notify(const std::vector<OverBudgetHeap> &overHeaps);
+
+    MemoryHeapStatistics heapStatistics(uint32_t heapIndex) const;
+
+private:
+    ContextVk *mContext = nullptr;
+    MemoryTracker *mTracker = nullptr;
+    bool mSupportBudgetExt = false;
+    VkPhysicalDeviceMemoryProperties mMemoryProperties{};
+
+    GMutex mMutex;
+    std::vector<HeapState> mHeaps;
+    MemoryBudgetCallback mCallback = nullptr;
+    float mThreshold = 1.0f;
+};
+
+/**
+ * 一次刷新调用中提交的多个映射内存区间
+ */
+struct MappedRangeBatchVk
+{
+#ifdef USE_AMD_VULKAN_MEMORY_ALLOCATOR
+    std::vector<VmaAllocation> allocations;
+#else
+    std::vector<const GVkMemoryAllocation *> allocations;
+#endif //USE_AMD_VULKAN_MEMORY_ALLOCATOR
+    std::vector<VkDeviceSize> offsets;
+    std::vector<VkDeviceSize> sizes;
+
+    void clear();
+};
+
 /**
  * Instance的Vulkan实现
  */
@@ -298,6 +547,21 @@ public:
 
     std::string dumpCommandBuffer(CommandBuffer commandBuffer) override;
 
+    bool beginCapture(const std::string &path) override;
+
+    bool endCapture() override;
+
+    bool isCapturing() override;
+
+    bool replayCapture(const std::string &path, const CaptureReplayInfo &info,
+                       CaptureReplayResult &result) override;
+
+    void collectProfilerEvents() override;
+
+    MemoryStatistics getMemoryStatistics() override;
+
+    void setMemoryBudgetCallback(const MemoryBudgetCallback &callback, float threshold) override;
+
     Fence_P *createFenceP(bool signaled) override;
 
     void destroyFenceP(Fence obj) override;
@@ -382,9 +646,25 @@ public:
 
     Query_P *findQueryP(GfxIdxTy idx) override;
 
+    void deferDestroyP(ElementHandle *obj) override;
+
 public:
     GVkContext *vkContext();
 
+    uint64_t elementEpoch() const override;
+
+    bool isElementAlive(GfxIdxTy idx, ElementHandle *obj) override;
+
+    /**
+     * 流式纹理驻留范围的版本，任意流式纹理调整驻留范围后递增
+     * 引用了流式纹理的VkCommandBuffer在版本变化后重新录制，不再使用被替换的图像和图像视图
+     *
+     * @return
+     */
+    uint64_t residencyEpoch() const;
+
+    void onResidencyChanged();
+
 #ifdef USE_AMD_VULKAN_MEMORY_ALLOCATOR
     VmaAllocator getVmaAllocator();
 #endif
@@ -393,6 +673,14 @@ public:
 
     float maxSamplerAnisotropy();
 
+    /**
+     * 将各向异性级别限制在设备支持的范围内，不支持各向异性过滤时返回0
+     *
+     * @param anisotropyLog2
+     * @return
+     */
+    uint32_t clampSamplerAnisotropyLog2(uint32_t anisotropyLog2);
+
     VkDescriptorSet allocVkDescriptorSet(VkDescriptorSetLayout vkLayout,
                                          VkDescriptorPool &pool);
 
@@ -404,10 +692,116 @@ public:
 
     float getTimestampPeriod() const;
 
+    bool isSupportSynchronization2() const;
+
+    bool isSupportMultiDrawIndirect() const;
+
+    bool isSupportDrawIndirectFirstInstance() const;
+
+    uint32_t maxDrawIndirectCount() const;
+
+    bool isCaptureEnabled() const;
+
+    /**
+     * 正在捕获时返回捕获器，否则返回nullptr
+     *
+     * @return
+     */
+    CaptureVk *activeCapture();
+
+    GpuProfilerVk &gpuProfiler();
+
+    MemoryBudgetVk &memoryBudget();
+
+    /**
+     * 设备内存块分配器，纹理(以及未使用VMA时的Buffer)从中子分配
+     *
+     * @return
+     */
+    GVkMemoryAllocator *memoryAllocator();
+
+    /**
+     * 记录资源的内存分配，并检查所在内存堆是否超出预算
+     *
+     * @param record
+     */
+    void trackMemory(const MemoryRecord &record);
+
+    void untrackMemory(MemoryRecord &record);
+
+    /**
+     * 记录有待刷新写入区间的Buffer，在下次提交指令前统一刷新
+     *
+     * @param buffer
+     */
+    void addDirtyBuffer(BufferVk *buffer);
+
+    void removeDirtyBuffer(BufferVk *buffer);
+
+    /**
+     * 合并所有Buffer记录的写入区间，通过一次刷新调用提交，在提交指令前调用
+     */
+    void flushDirtyBuffers();
+
+    /**
+     * 指令缓冲录制使用的内存池，由所有指令缓冲共享
+     *
+     * @return
+     */
+    CommandArena &commandArena();
+
+    /**
+     * 将指令缓冲加入后台编译队列，编译线程在首次调用时启动
+     *
+     * @param cmdBuffer
+     */
+    void enqueueCompile(CommandBufferVk *cmdBuffer);
+
+    /**
+     * 在编译线程池中并行执行count个任务，调用线程同时参与执行，全部完成后返回
+     * 线程池繁忙时任务全部由调用线程执行，可以在编译线程中调用
+     *
+     * @param count
+     * @param task      参数为任务序号
+     */
+    void parallelCompile(uint32_t count, const std::function<void(uint32_t)> &task) override;
+
+    /**
+     * 获取下一个提交序号，每次向队列提交指令时调用
+     *
+     * @return
+     */
+    uint64_t nextSubmitSerial();
+
+    /**
+     * 获取最后一次提交的序号
+     *
+     * @return
+     */
+    uint64_t submitSerial() const;
+
+    /**
+     * 获取已确认执行完成的提交序号
+     *
+     * @return
+     */
+    uint64_t completedSerial();
+
+    /**
+     * 标记序号completedSerial及之前的提交已经执行完成，并销毁可以销毁的延迟对象
+     *
+     * @param completedSerial
+     */
+    void releaseDeferredObjects(uint64_t completedSerial);
+
 private:
     static VkPhysicalDeviceFeatures getVkDeviceFeatures(uint32_t deviceIndex, InstanceVk *instance);
 
-    static std::vector<const char *> transDeviceExt(const std::vector<DeviceEXT> &exts);
+    static bool querySynchronization2(uint32_t deviceIndex, InstanceVk *instance);
+
+    static bool queryDeviceExtension(uint32_t deviceIndex, InstanceVk *instance, const char *extName);
+
+    static std::vector<const char *> transDeviceExt(const std::vector<DeviceEXT> &exts, bool enableMemoryBudget);
 
 #ifdef USE_AMD_VULKAN_MEMORY_ALLOCATOR
     void initVma();
@@ -487,16 +881,66 @@ private:
     GMutex mRwCPMapMutex;
     GMutex mRwDLMapMutex;
     GMutex mRwPLMapMutex;
+    GMutex mRwSamplerMapMutex;
 
     std::unordered_map<GetRenderPassInfo, GfxIdxTy> mRenderPassMap;
     std::unordered_map<QueryGraphicsPipelineStateInfo, GfxIdxTy> mGraphPipelineMap;
     std::unordered_map<QueryComputePipelineStateInfo, GfxIdxTy> mCompPipelineMap;
     std::unordered_map<ResourceLayoutInfo, GfxIdxTy> mDescriptorLayoutMap;
     std::unordered_map<PipelineLayoutInfo, GfxIdxTy> mPipelineLayoutMap;
+    // 相同参数的采样器共享一个VkSampler，以CreateSamplerInfo::t为键
+    std::unordered_map<uint32_t, GfxIdxTy> mSamplerMap;
 
     bool mEnableValidation = false;
     bool mSupportQueryTimestamp = false;
     float mTimestampPeriod = 1;
+    bool mSupportSynchronization2 = false;
+    bool mSupportMultiDrawIndirect = false;
+    bool mSupportDrawIndirectFirstInstance = false;
+    uint32_t mMaxDrawIndirectCount = 1;
+
+    bool mEnableCapture = false;
+    CaptureVk *mCapture = nullptr;
+
+    GpuProfilerVk mGpuProfiler;
+    GVkMemoryAllocator mMemoryAllocator;
+    MemoryBudgetVk mMemoryBudget;
+
+    GMutex mDirtyBufferMutex;
+    std::vector<BufferVk *> mDirtyBuffers;
+    MappedRangeBatchVk mDirtyRangeBatch;
+
+    friend class CaptureVk;
+
+    /**
+     * 延迟销毁的元素，serial为加入队列时最后一次提交的序号
+     */
+    struct DeferredDestroyItem
+    {
+        ElementHandle *obj;
+        uint64_t serial;
+    };
+
+    std::atomic<uint64_t> mElementEpoch{0};
+    std::atomic<uint64_t> mResidencyEpoch{0};
+
+    std::atomic<uint64_t> mSubmitSerial{0};
+    uint64_t mCompletedSerial = 0;
+    GMutex mDeferredDestroyMutex;
+    std::deque<DeferredDestroyItem> mDeferredDestroyQueue;
+
+    CommandArena mCommandArena;
+
+    // 后台编译线程池，异步编译和Secondary并行编译共用
+    void startCompileThreads();
+
+    void compileThreadLoop();
+
+    std::vector<std::thread> mCompileThreads;
+    std::mutex mCompileMutex;
+    std::condition_variable mCompileCond;
+    std::deque<std::function<void()>> mCompileQueue;
+    bool mCompileThreadExit = false;
 };
 
 
@@ -607,6 +1051,8 @@ public:
 
     uint64_t getFrameTime() override;
 
+    FrameStatistics getFrameStatistics() override;
+
     Context_T *context() override;
 
 private:
@@ -618,14 +1064,27 @@ private:
 
     void updateFrameState();
 
+    /**
+     * 销毁reset时保留的旧交换链资源
+     *
+     * @param force 为true时不检查提交序号直接销毁
+     */
+    void releaseRetiredSwapChain(bool force);
+
 private:
     Context_T *mContextT = GFX_NULL_HANDLE;
 
     VkSurfaceKHR mVkSurface = VK_NULL_HANDLE;
     GVkBaseSwapChain *mVkSwapChain = GFX_NULL_HANDLE;
     std::vector<GVkFence> mFences;
+    std::vector<uint64_t> mFenceSerials;    // 每个Fence最后一次关联的提交序号
     GVkSemaphore mRenderSemaphore;
 
+    // reset时保留的旧资源，在序号mRetireSerial的提交完成、并且新交换链的图像轮换一周后销毁
+    std::vector<GVkSemaphore> mRetiredSemaphores;
+    uint64_t mRetireSerial = 0;
+    uint32_t mRetireAcquireCount = 0;       // reset后在新交换链上获取图像的次数
+
     std::vector<TextureVk *> mColorTextures;
     TextureVk *mDepthTexture = nullptr;
 
@@ -645,6 +1104,10 @@ private:
     {
         GTime time;
         uint64_t frameTime = 0;
+
+        FrameStatistics statistics{};       // 上一帧的统计结果
+        FrameStatistics current{};          // 当前帧正在累计的统计
+        ContextStatistics contextStats{};   // 上一帧开始时Context的累计统计
     } mFrameState;
 
     FrameSwapChainErrorCallback mSwapChainErrorCb = nullptr;
@@ -720,11 +1183,30 @@ private:
     Attachment mAttachDepth{};
 
     std::vector<std::vector<VkImageView>> mFBViews;
+    // 多个编译线程可能同时获取帧缓冲
+    GMutex mFBCacheMutex;
     std::unordered_map<GfxIdxTy, std::vector<GVkFrameBuffer *>> mFBCache;
     GetRenderPassInfo mGetRenderPassBase{};
 
+    /**
+     * RenderPassInfo到RenderPass的缓存，避免每次开始RenderPass时复制mGetRenderPassBase
+     * RenderPass由上下文持有直到上下文销毁
+     */
+    struct CachedRenderPass
+    {
+        RenderPassInfo rpInfo;
+        RenderPassVk *renderPass;
+    };
+
+    mutable GMutex mRenderPassCacheMutex;
+    mutable std::vector<CachedRenderPass> mRenderPassCache;
+
     Texture mMsaaColorTexture = GFX_NULL_HANDLE;
     Texture mMsaaDepthTexture = GFX_NULL_HANDLE;
+
+    SampleCountFlag::Enum mSample = SampleCountFlag::SampleCount_1;
+
+    friend class CaptureVk;
 };
 
 
@@ -748,10 +1230,23 @@ public:
 
     void flush() override;
 
+    void flush(uint64_t offset, uint64_t size) override;
+
+    void invalidate(uint64_t offset, uint64_t size) override;
+
+    void markDirty(uint64_t offset, uint64_t size) override;
+
     void unmap() override;
 
     VkBuffer vkBuffer();
 
+    /**
+     * 取出合并后的写入区间加入batch，由ContextVk::flushDirtyBuffers调用
+     *
+     * @param batch
+     */
+    void collectDirtyRanges(MappedRangeBatchVk &batch);
+
     VkDescriptorBufferInfo getVkDescriptorBufferInfo(uint64_t offset = 0, uint64_t range = VK_WHOLE_SIZE);
 
     VkBufferView getVkBufferView(Format::Enum format, uint64_t offset, uint64_t size);
@@ -759,6 +1254,13 @@ public:
 private:
     ContextVk *getContextVk();
 
+    void unmapMemory();
+
+    /**
+     * 排序并合并重叠或相邻的写入区间，需持有mDirtyMutex
+     */
+    void coalesceDirtyRanges();
+
 #ifdef USE_AMD_VULKAN_MEMORY_ALLOCATOR
     bool initByVMA(const CreateBufferInfo &createInfo);
 #else
@@ -771,6 +1273,13 @@ private:
     BufferTypeFlags mType = 0;
     BufferMemoryUsage::Enum mMemoryUsage = BufferMemoryUsage::GpuOnly;
     uint64_t mSize = 0;
+    BufferMapFlags mMapFlags = 0;
+    bool mNonCoherent = false;
+
+    // 写入区间[begin, end)
+    GMutex mDirtyMutex;
+    std::vector<std::pair<uint64_t, uint64_t>> mDirtyRanges;
+    bool mDirtyRegistered = false;
 
 #ifdef USE_AMD_VULKAN_MEMORY_ALLOCATOR
     VkBuffer mBuffer = VK_NULL_HANDLE;
@@ -781,7 +1290,11 @@ private:
     GVkBuffer mGVkBuffer;
 #endif //USE_AMD_VULKAN_MEMORY_ALLOCATOR
 
+    MemoryRecord mMemoryRecord;
+
     std::unordered_map<CreateBufferViewInfo, VkBufferView> mVkBufferViews;
+
+    friend class CaptureVk;
 };
 
 
@@ -824,6 +1337,18 @@ public:
 
     void setData(const void *data, uint64_t size, Fence fence) override;
 
+    void setMipData(uint32_t mipLevel, uint32_t baseLayer, uint32_t layerCount,
+                    const void *data, uint64_t size, Fence fence) override;
+
+    void updateRegions(const void *data, uint64_t size,
+                       const std::vector<TextureUpdateRegion> &regions, Fence fence) override;
+
+    uint32_t residentBaseMip() override;
+
+    uint64_t residentSize(uint32_t baseMip) override;
+
+    bool setResidentBaseMip(uint32_t baseMip, Fence fence) override;
+
     void genMipmap(Fence fence) override;
 
 public:
@@ -831,6 +1356,18 @@ public:
 
     GVkImage *vkImage();
 
+    /**
+     * 将mip等级转换为驻留图像中的mip等级，非流式纹理原样返回
+     */
+    uint32_t residentMipLevel(uint32_t mipLevel) const;
+
+    bool isStreaming() const;
+
+    /**
+     * 驻留范围每次改变时递增，资源绑定据此判断描述符中的图像视图是否过期
+     */
+    uint32_t residencyVersion() const;
+
     VkImageView createImageView(const TextureBindRange &range, bool isAttachment);
 
     VkDescriptorImageInfo getDescriptor(VkImageView imageView, VkSampler sampler) const;
@@ -840,9 +1377,46 @@ public:
                             ImageLayout::Enum dstLayout,
                             const ImageSubResourceRange &subResRange);
 
+    /**
+     * 生成图像Barrier信息但不录制，同时更新图像的布局记录
+     *
+     * @return 范围内没有驻留的mip时返回false，不生成Barrier
+     */
+    bool getImageMemoryBarrier(ImageLayout::Enum srcLayout,
+                               ImageLayout::Enum dstLayout,
+                               const ImageSubResourceRange &subResRange,
+                               VkImageMemoryBarrier &imageBarrier,
+                               VkPipelineStageFlags &srcStage,
+                               VkPipelineStageFlags &dstStage);
+
     static ImageLayout::Enum getUsageImageLayout(TextureUsageFlags usage, TextureAspectFlags aspect);
 
 private:
+    /**
+     * 将子资源范围与驻留范围求交并转换为驻留图像中的范围
+     *
+     * @return 交集为空时返回false
+     */
+    bool toResidentRange(const ImageSubResourceRange &subResRange, VkImageSubresourceRange &vkSubResRange) const;
+
+    /**
+     * 新创建的图像实际处于Undefined布局，首次由纹理自身上传时整体转换到用途对应的布局
+     * 之后所有更新都从该布局转换，以保留已有内容
+     */
+    void initImageLayout(CommandBuffer cmdBuffer);
+
+    /**
+     * 异步提交的指令缓冲在GPU执行完成后销毁
+     */
+    void retireCommandBuffer(CommandBuffer cmdBuffer);
+
+    /**
+     * 释放GPU已不再使用的延迟资源
+     *
+     * @param force 为true时全部释放
+     */
+    void releaseRetiredResources(bool force);
+
     bool initVkTexture(const CreateTextureInfo &createInfo,
                        SampleCountFlag::Enum sample,
                        GVkImage *image);
@@ -863,10 +1437,14 @@ private:
 private:
     friend class RenderTargetVk;
 
+    friend class CaptureVk;
+
     Context_T *mContextT = GFX_NULL_HANDLE;
     GVkImage *mVkImage = nullptr;
+    MemoryRecord mMemoryRecord;
 
     bool mIsFromImage = false;
+    bool mLayoutInitialized = false;
 
     uint32_t mWidth = 0;
     uint32_t mHeight = 0;
@@ -878,9 +1456,36 @@ private:
     uint32_t mMipLevels = 0;
     uint32_t mLayerCount = 0;
     TextureSwizzleMapping mSwizzleMapping{};
+    SampleCountFlag::Enum mSample = SampleCountFlag::SampleCount_1;
 
+    // 多个编译线程可能同时创建图像视图
+    GMutex mImageViewCacheMutex;
     std::unordered_map<CreateImageViewInfo, VkImageView> mImageViewCache;
 
+    // 流式纹理：图像只包含[mResidentBaseMip, mMipLevels)，重新分配时使用创建时的图像参数
+    bool mStreaming = false;
+    uint32_t mResidentBaseMip = 0;
+    uint32_t mResidencyVersion = 0;
+    VkImageType mVkImageType = VK_IMAGE_TYPE_2D;
+    VkImageUsageFlags mVkImageUsage = 0;
+    VkImageAspectFlags mVkImageAspect = 0;
+    VkImageLayout mVkImageLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+    /**
+     * 等待GPU执行完成后释放的资源：驻留范围改变后被替换的图像、异步上传的指令缓冲
+     * serial为加入时最后一次提交的序号
+     */
+    struct RetiredResource
+    {
+        GVkImage *image = nullptr;
+        std::vector<VkImageView> views;
+        MemoryRecord memoryRecord;
+        GVkCommandPool *cmdPool = nullptr;
+        CommandBuffer cmdBuffer = GFX_NULL_HANDLE;
+        uint64_t serial = 0;
+    };
+    std::vector<RetiredResource> mRetiredResources;
+
     size_t mHash = 0;
 };
 
@@ -901,10 +1506,21 @@ public:
 public:
     GVkSampler *vkSampler();
 
+    const CreateSamplerInfo &createInfo() const;
+
+    /**
+     * 共享该采样器的句柄数量，由ContextVk在mRwSamplerMapMutex下维护
+     */
+    uint32_t &refCount();
+
 private:
     Context_T *mContextT = GFX_NULL_HANDLE;
 
     GVkSampler mVkSampler;
+    CreateSamplerInfo mCreateInfo{};
+    uint32_t mRefCount = 1;
+
+    friend class CaptureVk;
 };
 
 
@@ -941,8 +1557,12 @@ private:
     VkShaderStageFlagBits mVkShaderStage = VK_SHADER_STAGE_VERTEX_BIT;
     size_t mHash = 0;
     std::string mTag;
+    ShaderType::Enum mType = ShaderType::Vertex;
+    std::vector<uint8_t> mCode;         // 上下文允许捕获时保留的着色器代码
 
     std::unordered_set<GfxIdxTy> mPipelineRef;
+
+    friend class CaptureVk;
 };
 
 
@@ -1007,12 +1627,14 @@ public:
 public:
     GVkContext *vkContext();
 
-    ResourceLayoutInfo getDescriptorLayoutInfo() const;
+    const ResourceLayoutInfo &getDescriptorLayoutInfo() const;
 
     VkDescriptorSet getVkDescriptorSet() const;
 
     void bindResources();
 
+    bool hasStreamingTexture() const;
+
 private:
     bool initBindInfo();
 
@@ -1023,6 +1645,7 @@ private:
     VkDescriptorSet mDescSet = VK_NULL_HANDLE;
     DescriptorLayoutVk *mDescLayout = nullptr;
     VkDescriptorPool mPool = VK_NULL_HANDLE;
+    GMutex mBindMutex;      // 保护编译时的描述符更新
 
     struct BindBufferInfo
     {
@@ -1041,6 +1664,7 @@ private:
         Sampler sampler;
         TextureBindRange range;
         bool updated;
+        uint32_t residencyVersion;
         VkDescriptorImageInfo writeInfo;
     };
 
@@ -1058,7 +1682,10 @@ private:
     using BindDescInfo = std::variant<BindBufferInfo, BindSamplerInfo, BindTexelBufferInfo>;
 
     bool mAllUpdated = true;                       // 是否所有资源都是更新状态
+    bool mHasStreamingTexture = false;             // 是否绑定过流式纹理，需要在更新时检查驻留范围
     std::vector<BindDescInfo> mBindDescInfo;       // 资源绑定关联表，一个数组，表示关系为：[binding]
+
+    friend class CaptureVk;
 };
 
 
@@ -1118,192 +1745,399 @@ private:
 };
 
 
-GFX_P_API_IMPL(CommandBuffer, Vk)
+/**
+ * Barrier批处理
+ * 收集相邻的Barrier指令，合并为一次vkCmdPipelineBarrier(2)调用
+ */
+class BarrierBatchVk
 {
 public:
-    explicit CommandBufferVk(GfxIdxTy idx)
-            : CommandBuffer_P(idx)
-    {}
+    void setUseSynchronization2(bool use);
 
-    bool init(Context_T *context, const CreateCommandBufferInfo &createInfo);
-
-    void destroy() override;
-
-    Context_T *context() override;
-
-public:
-    VkCommandBuffer getVkCommandBuffer(uint32_t index);
-
-    void compile(FrameVk *frame = GFX_NULL_HANDLE);
+    void addExecutionBarrier(VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage);
 
-    bool isCompiled() const;
-
-    std::string dump();
-
-public:
-    CommandBuffer begin() override;
+    void addBufferBarrier(VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage,
+                          const VkBufferMemoryBarrier &barrier);
 
-    void end() override;
+    void addImageBarrier(VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage,
+                         const VkImageMemoryBarrier &barrier);
 
-    CommandBuffer setClearColor(const ClearColor &clearColor) override;
-
-    CommandBuffer setClearDepthStencil(float depth, uint32_t stencil) override;
-
-    CommandBuffer bindRenderTarget(RenderTarget renderTarget) override;
+    /**
+     * 同一资源的重叠区域不能放在同一次调用中(调用内的Barrier之间没有顺序保证)
+     * 如果冲突，需要先flush
+     */
+    bool isConflict(VkBuffer buffer) const;
 
-    CommandBuffer bindRenderTarget(Frame frame) override;
+    bool isConflict(const VkImageMemoryBarrier &barrier) const;
 
-    CommandBuffer beginRenderPass(const Rect2D &renderArea, const RenderPassInfo &rpInfo) override;
+    /**
+     * synchronization2下合并的Barrier各自保留阶段掩码，彼此之间不形成执行依赖链
+     * 源阶段与已缓存Barrier的目标阶段相交时，需要先flush
+     */
+    bool isChained(VkPipelineStageFlags srcStage) const;
 
-    CommandBuffer endRenderPass() override;
+    bool empty() const;
 
-    CommandBuffer setGraphicsPipelineState(const GraphicsPipelineStateInfo &pipelineState) override;
+    /**
+     * 录制所有缓存的Barrier
+     *
+     * @return 返回实际产生的Barrier调用次数
+     */
+    uint32_t flush(VkCommandBuffer cmdBuffer);
 
-    CommandBuffer setVertexLayout(const VertexLayout &vertexLayout) override;
+    void clear();
 
-    CommandBuffer setShaders(const std::vector<Shader> &shaders) override;
+private:
+    struct StageMask
+    {
+        VkPipelineStageFlags srcStage;
+        VkPipelineStageFlags dstStage;
+    };
 
-    CommandBuffer nextSubpass() override;
+    bool mUseSynchronization2 = false;
+    VkPipelineStageFlags mDstStages = 0;    // 已缓存Barrier目标阶段的并集
 
-    CommandBuffer setViewport(const Rect2D &viewport, float minDepth, float maxDepth) override;
+    std::vector<StageMask> mExecStages;
+    std::vector<StageMask> mBufferStages;
+    std::vector<StageMask> mImageStages;
 
-    CommandBuffer setScissor(const Rect2D &scissor) override;
+    std::vector<VkBufferMemoryBarrier> mBufferBarriers;
+    std::vector<VkImageMemoryBarrier> mImageBarriers;
 
-    CommandBuffer setLineWidth(float lineWidth) override;
+#if defined(VK_VERSION_1_3)
+    // synchronization2提交时使用的临时数组，跨flush复用容量
+    std::vector<VkMemoryBarrier2> mMemoryBarriers2;
+    std::vector<VkBufferMemoryBarrier2> mBufferBarriers2;
+    std::vector<VkImageMemoryBarrier2> mImageBarriers2;
+#endif
+};
 
-    CommandBuffer setStencilCompareMask(StencilFace::Enum face, uint32_t mask) override;
 
-    CommandBuffer setStencilWriteMask(StencilFace::Enum face, uint32_t mask) override;
+class CommandBufferVk : public CommandRecorder
+{
+public:
+    explicit CommandBufferVk(GfxIdxTy idx)
+            : CommandRecorder(idx)
+    {}
 
-    CommandBuffer setStencilReference(StencilFace::Enum face, uint32_t reference) override;
+    bool init(Context_T *context, const CreateCommandBufferInfo &createInfo);
 
-    CommandBuffer bindResources(ResourceBindPoint::Enum bindPoint,
-                                const std::vector<ResourceBinder> &binders,
-                                const std::vector<uint32_t> &dynamicOffsets) override;
+    void destroy() override;
 
-    CommandBuffer bindVertexBuffer(uint32_t firstBinding,
-                                   const std::vector<Buffer> &buffers,
-                                   const std::vector<uint64_t> &offsets) override;
+public:
+    VkCommandBuffer getVkCommandBuffer(uint32_t index);
 
-    CommandBuffer bindIndexBuffer(Buffer buffer, uint32_t offset, IndexType::Enum indexType) override;
+    uint32_t bufferCount() const;
 
-    CommandBuffer draw(uint32_t vertexCount, uint32_t instanceCount,
-                       uint32_t firstVertex, uint32_t firstInstance) override;
+    /**
+     * 编译提交编号为bufferIndex的VkCommandBuffer前需要的指令
+     * 录制后第一次编译时编译全部VkCommandBuffer，修补或切换GPU采样后只重新录制bufferIndex对应的一个
+     *
+     * @param bufferIndex
+     */
+    void compile(uint32_t bufferIndex);
 
-    CommandBuffer drawIndexed(uint32_t indexCount, uint32_t instanceCount, uint32_t firstIndex, int32_t vertexOffset,
-                              uint32_t firstInstance) override;
+    /**
+     * 编号为bufferIndex的VkCommandBuffer是否可以直接提交，有后台编译时先等待其结束
+     *
+     * @param bufferIndex
+     * @return
+     */
+    bool isCompiled(uint32_t bufferIndex);
 
-    CommandBuffer drawIndirect(Buffer buffer, uint32_t offset, uint32_t drawCount, uint32_t stride) override;
+    /**
+     * 记录编号为bufferIndex的VkCommandBuffer最后一次提交的序号，重新录制前据此判断是否仍在执行
+     * 其中执行的Secondary指令缓冲同样记录该序号
+     *
+     * @param bufferIndex
+     * @param serial
+     */
+    void setSubmitSerial(uint32_t bufferIndex, uint64_t serial);
 
-    CommandBuffer drawIndexedIndirect(Buffer buffer, uint32_t offset, uint32_t drawCount, uint32_t stride) override;
+    void waitCompile() override;
 
-    CommandBuffer dispatch(uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ) override;
+    /**
+     * 最近一次编译中录制的Barrier指令数量
+     */
+    uint32_t barrierCommandCount() const;
 
-    CommandBuffer dispatchIndirect(Buffer buffer, uint32_t offset) override;
+    /**
+     * 最近一次编译中实际生成的Barrier调用数量
+     */
+    uint32_t barrierCount() const;
 
-    CommandBuffer executeCommands(const std::vector<CommandBuffer> &secondaryCmdBuffers) override;
+    /**
+     * 最近一次编译中被消除的冗余状态指令数量
+     */
+    uint32_t redundantStateCount() const;
 
-    CommandBuffer pipelineBarrier(PipelineStageMask srcStage, PipelineStageMask dstStage) override;
+    /**
+     * 最近一次编译中被合并到多重间接绘制的绘制指令数量
+     */
+    uint32_t mergedDrawCount() const;
 
-    CommandBuffer bufferMemoryBarrier(Buffer buffer, const BufferBarrierInfo &barrierInfo) override;
+    /**
+     * 最近一次编译中实际绑定管线的次数
+     */
+    uint32_t pipelineBindCount() const;
 
-    CommandBuffer imageMemoryBarrier(Texture texture,
-                                     ImageLayout::Enum srcLayout,
-                                     ImageLayout::Enum dstLayout,
-                                     const ImageSubResourceRange &range) override;
+    /**
+     * 获取编号为index的VkCommandBuffer使用的时间戳查询池
+     */
+    const GpuProfilerVk::QuerySlot &querySlot(uint32_t index) const;
 
-    CommandBuffer copyBuffer(Buffer src, Buffer dst, uint64_t srcOffset, uint64_t dstOffset, uint64_t size) override;
+private:
+    /**
+     * Secondary指令缓冲编译时继承的状态
+     */
+    struct Inheritance
+    {
+        RenderTargetVk *renderTarget = nullptr;
+        RenderPassVk *renderPass = nullptr;
+        uint32_t subpass = 0;
+        std::vector<VkFramebuffer> framebuffers;    // 每个VkCommandBuffer对应的帧缓冲，为空时不指定
+        bool simultaneousUse = false;               // 是否会被多个主指令缓冲同时使用
+
+        bool operator==(const Inheritance &other) const
+        {
+            return renderTarget == other.renderTarget && renderPass == other.renderPass
+                   && subpass == other.subpass && framebuffers == other.framebuffers
+                   && simultaneousUse == other.simultaneousUse;
+        }
+    };
 
-    CommandBuffer copyImage(Texture src, Texture dst, const std::vector<ImageCopyInfo> &copyInfos) override;
+    /**
+     * 编译时VkCommandBuffer中已绑定的状态，用于消除冗余的状态指令
+     */
+    struct BoundState
+    {
+        PipelineVk *graphPipeline = nullptr;
+        PipelineVk *computePipeline = nullptr;
+        uint32_t pipelineBindCount = 0;     // 实际调用vkCmdBindPipeline的次数
+
+        bool hasViewport = false;
+        VkViewport viewport{};
+        bool hasScissor = false;
+        VkRect2D scissor{};
+
+        std::vector<VkBuffer> vertexBuffers;
+        std::vector<VkDeviceSize> vertexOffsets;
+
+        VkBuffer indexBuffer = VK_NULL_HANDLE;
+        VkDeviceSize indexOffset = 0;
+        VkIndexType indexType = VK_INDEX_TYPE_MAX_ENUM;
+
+        struct DescSets
+        {
+            VkPipelineLayout layout = VK_NULL_HANDLE;
+            std::vector<VkDescriptorSet> sets;
+            std::vector<uint32_t> dynamicOffsets;
+        } descSets[2];      // 0: Graphics, 1: Compute
+
+        /**
+         * 清空绑定状态，保留数组容量
+         */
+        void reset()
+        {
+            graphPipeline = nullptr;
+            computePipeline = nullptr;
+            pipelineBindCount = 0;
+            hasViewport = false;
+            hasScissor = false;
+            vertexBuffers.clear();
+            vertexOffsets.clear();
+            indexBuffer = VK_NULL_HANDLE;
+            indexOffset = 0;
+            indexType = VK_INDEX_TYPE_MAX_ENUM;
+            for (auto &sets : descSets) {
+                sets.layout = VK_NULL_HANDLE;
+                sets.sets.clear();
+                sets.dynamicOffsets.clear();
+            }
+        }
+    };
 
-    CommandBuffer copyBufferToImage(Buffer src, Texture dst,
-                                    const std::vector<BufferImageCopyInfo> &copyInfos) override;
+    /**
+     * 编译指令时使用的临时数据
+     * 作为成员跨编译复用容量，预热后逐条指令编译不再分配内存
+     */
+    struct CompileScratch
+    {
+        BoundState bound;
+        RenderPassInfo renderPassInfo;
+        PipelineLayoutInfo pipelineLayoutInfo;
+        std::vector<VkDescriptorSet> descSets;
+        std::vector<uint32_t> dynamicOffsets;
+        std::vector<VkBuffer> buffers;
+        std::vector<VkDeviceSize> offsets;
+        std::vector<ImageCopyInfo> copyInfos;
+        std::vector<ImageBlitInfo> blitInfos;
+        std::vector<VkBufferImageCopy> bufferImageCopies;
+        std::vector<VkImageCopy> imageCopies;
+        std::vector<VkImageBlit> imageBlits;
+        std::vector<CommandBufferVk *> secondaries;
+        std::vector<CommandBufferVk *> uniqueSecondaries;
+        std::vector<Inheritance> inheritances;
+        std::vector<VkCommandBuffer> vkSecondaries;
+        std::vector<uint32_t> openScopes;       // 未结束的GPU采样区间
+    };
 
-    CommandBuffer copyImageToBuffer(Texture src, Buffer dst,
-                                    const std::vector<BufferImageCopyInfo> &copyInfos) override;
+    struct IndirectChunk
+    {
+        GVkBuffer buffer;
+        MemoryRecord memoryRecord;
+        void *mapped = nullptr;
+        VkDeviceSize used = 0;
+    };
 
-    CommandBuffer blitImage(Texture src, Texture dst, const std::vector<ImageBlitInfo> &blitInfos,
-                            BlitFilter::Enum filter) override;
+    /**
+     * 主指令缓冲录制时执行的Secondary指令缓冲
+     */
+    struct ExecutedSecondary
+    {
+        GfxIdxTy idx;
+        VkCommandBuffer vkCommandBuffer;
+        uint64_t compileVersion;                // 录制时Secondary的编译版本
+    };
 
-    CommandBuffer copyRenderTarget(RenderTarget src, RenderTarget dst,
-                                   const std::vector<ImageCopyInfo> &copyInfos,
-                                   uint8_t frameIndex) override;
+    /**
+     * 一个VkCommandBuffer及其录制状态
+     * 合并绘制的间接参数写入各自的间接缓冲块，重新录制时GPU不会读到被覆盖的参数
+     */
+    struct RecordedBuffer
+    {
+        VkCommandBuffer vkCommandBuffer = VK_NULL_HANDLE;
+        GpuProfilerVk::QuerySlot querySlot;     // GPU时间戳采样使用的查询池
+        std::vector<IndirectChunk> indirectChunks;
+        size_t indirectChunkIndex = 0;
+        std::vector<ExecutedSecondary> secondaries;
+        bool usesStreaming = false;             // 录制时是否引用了流式纹理
+        uint64_t residencyEpoch = 0;            // 录制时的流式纹理驻留版本
+        uint64_t submitSerial = 0;              // 最后一次提交的序号
+        uint64_t patchVersion = 0;              // 录制时已应用的修补版本
+        bool profiled = false;                  // 录制时是否开启了GPU采样
+    };
 
-    CommandBuffer blitRenderTarget(RenderTarget src, RenderTarget dst,
-                                   const std::vector<ImageBlitInfo> &blitInfos,
-                                   BlitFilter::Enum filter,
-                                   uint8_t frameIndex) override;
+    void onEnd() override;
 
-    CommandBuffer blitRenderTargetToImage(RenderTarget src, Texture dst,
-                                          const std::vector<ImageBlitInfo> &blitInfos,
-                                          BlitFilter::Enum filter,
-                                          uint8_t attachIndex,
-                                          uint8_t frameIndex) override;
+    void onPatched() override;
 
-    CommandBuffer copyRenderTargetToImage(RenderTarget src, Texture dst,
-                                          const std::vector<ImageCopyInfo> &copyInfos,
-                                          uint8_t attachIndex,
-                                          uint8_t frameIndex) override;
+    /**
+     * 统计当前绘制之后可以合并的连续绘制指令数量
+     */
+    uint32_t countDrawRun(ContextVk *context, uint8_t drawKey,
+                          const SortedRegion *sortedRegion, size_t sortedCursor);
 
-    CommandBuffer copyRenderTargetToBuffer(RenderTarget src, Buffer dst,
-                                           const std::vector<BufferImageCopyInfo> &copyInfos,
-                                           uint8_t attachIndex,
-                                           uint8_t frameIndex) override;
+    /**
+     * 从record的间接缓冲块中分配合并绘制使用的空间
+     *
+     * @return 映射的内存地址
+     */
+    void *allocIndirect(ContextVk *context, RecordedBuffer &record, VkDeviceSize size,
+                        VkBuffer &buffer, VkDeviceSize &offset);
 
-    CommandBuffer fillBuffer(Buffer buffer, uint64_t offset, uint64_t size, uint32_t data) override;
+    /**
+     * 销毁record的查询池和间接缓冲块，VkCommandBuffer随指令池销毁
+     */
+    void releaseRecord(ContextVk *context, RecordedBuffer &record);
 
-    CommandBuffer beginDebugLabel(const std::string &label) override;
+    /**
+     * 编译Gfx指令到Vulkan指令
+     *
+     * @param bufferIndex   为COMPILE_ALL_BUFFERS时录制全部VkCommandBuffer，
+     *                      否则只重新录制该VkCommandBuffer
+     */
+    void compileCommand(uint32_t bufferIndex = COMPILE_ALL_BUFFERS);
 
-    CommandBuffer endDebugLabel() override;
+    /**
+     * 准备重新录制编号为index的VkCommandBuffer，其上一次提交未确认完成时换用空闲的VkCommandBuffer
+     */
+    void prepareRecord(ContextVk *context, uint32_t index);
 
-    CommandBuffer resetQuery(Query query, uint32_t firstQuery, uint32_t queryCount) override;
+    /**
+     * 在后台编译线程中执行
+     */
+    void runPendingCompile();
 
-    CommandBuffer beginQuery(Query query, uint32_t queryIndex, bool precise) override;
+    /**
+     * 以当前RenderPass状态为继承信息编译Secondary指令缓冲
+     */
+    void compileSecondaryCommands(const std::vector<CommandBufferVk *> &secondaries,
+                                  RenderTargetVk *renderTarget, RenderPassVk *renderPass, uint32_t subpass);
 
-    CommandBuffer endQuery(Query query, uint32_t queryIndex) override;
+    /**
+     * 作为Secondary按inheritance编译，录制内容、修补和继承状态都未改变时保留已编译的VkCommandBuffer
+     */
+    void compileSecondary(const Inheritance &inheritance);
 
-    CommandBuffer writeTimestamp(PipelineStage::Enum pipelineStage, Query query, uint32_t queryIndex) override;
+    /**
+     * 是否仍是编译版本为compileVersion时的VkCommandBuffer，且之后没有重新录制或修补
+     */
+    bool isCompiledVersion(uint64_t compileVersion);
 
-    CommandBuffer copyQueryResults(Query query,
-                                   uint32_t firstQuery, uint32_t queryCount,
-                                   Buffer dstBuffer, uint64_t dstOffset,
-                                   QueryResultFlags resultFlags) override;
+    /**
+     * 同isCompiledVersion，调用时需持有mCompileMutex
+     */
+    bool matchCompiledVersion(uint64_t compileVersion);
 
-private:
-    void resetCommandBuffer();
+    /**
+     * 作为Secondary被主指令缓冲的第index个VkCommandBuffer执行时，获取对应的VkCommandBuffer及其编译版本
+     */
+    VkCommandBuffer getExecutedBuffer(uint32_t index, uint64_t &compileVersion);
 
     /**
-     * 编译Gfx指令到Vulkan指令
+     * 作为Secondary随主指令缓冲提交时调用，记录vkCommandBuffer所在提交的序号
      */
-    void compileCommand(FrameVk *frame);
+    void markSubmitted(VkCommandBuffer vkCommandBuffer, uint64_t serial);
 
-    static void doCopyImage(VkCommandBuffer cmdBuffer, GVkImage *src, GVkImage *dst,
+    void doCopyImage(VkCommandBuffer cmdBuffer, GVkImage *src, GVkImage *dst,
                             const std::vector<ImageCopyInfo> &copyInfos);
 
-    static void doBlitImage(VkCommandBuffer cmdBuffer, GVkImage *src, GVkImage *dst,
+    void doBlitImage(VkCommandBuffer cmdBuffer, GVkImage *src, GVkImage *dst,
                             const std::vector<ImageBlitInfo> &blitInfos, BlitFilter::Enum filter);
 
     static PipelineVk *bindGraphPipeline(ContextVk *context, VkCommandBuffer cmdBuffer,
                                          const CreateGraphicsPipelineStateInfo &createInfo,
-                                         PipelineVk *pipeline);
+                                         PipelineVk *pipeline, BoundState &bound);
 
     static PipelineVk *bindComputePipeline(ContextVk *context, VkCommandBuffer cmdBuffer,
                                            const CreateComputePipelineStateInfo &createInfo,
-                                           PipelineVk *pipeline);
+                                           PipelineVk *pipeline, BoundState &bound);
 
 private:
     friend class ContextVk;
 
-    Context_T *mContextT = GFX_NULL_HANDLE;
-
-    GVkCommandPool *mVkCommandPool = nullptr;
-
-    std::vector<VkCommandBuffer> mVkCommandBuffers;
-
-    GByteArray mCommandBuffer;
-
-    bool mIsCompiled = false;
-    bool mIsBegun = false;
+    friend class CaptureVk;
+
+    static constexpr uint32_t COMPILE_ALL_BUFFERS = UINT32_MAX;
+
+    // 每个CommandBuffer独占的指令池，不同线程可同时编译不同的CommandBuffer
+    GVkCommandPool mVkCommandPool;
+
+    std::vector<RecordedBuffer> mRecordedBuffers;
+    uint32_t mCreateBufferCount = 0;        // 创建时指定的VkCommandBuffer数量
+    // 重新录制时被替换下来的VkCommandBuffer，所在提交完成后复用
+    std::vector<RecordedBuffer> mSpareBuffers;
+    uint64_t mPatchVersion = 0;             // 每次修补后递增
+
+    BarrierBatchVk mBarrierBatch;
+    CompileScratch mScratch;
+    uint32_t mBarrierCommandCount = 0;
+    uint32_t mBarrierCount = 0;
+    uint32_t mRedundantStateCount = 0;
+    uint32_t mMergedDrawCount = 0;
+    uint32_t mPipelineBindCount = 0;
+
+    Inheritance mInheritance;
+    // 每次编译后递增，主指令缓冲据此判断执行的Secondary是否已重新编译
+    std::atomic<uint64_t> mCompileVersion{0};
+
+    // end()时交给后台线程编译
+    // Secondary可能被多个主指令缓冲在不同的编译线程中同时编译，其编译和提交序号的记录也由mCompileMutex互斥
+    bool mAsyncCompile = false;
+    std::mutex mCompileMutex;
+    std::condition_variable mCompileCond;
+    bool mCompilePending = false;
 };
 
 
@@ -1324,6 +2158,9 @@ public:
 
     void getQueryResults(std::vector<uint64_t> &results, QueryResultFlags flags) override;
 
+    void getQueryResults(std::vector<uint64_t> &results, uint32_t firstQuery, uint32_t queryCount,
+                         QueryResultFlags flags) override;
+
 public:
     VkQueryPool getVkQueryPool() const;
 
@@ -1336,6 +2173,9 @@ private:
 
     QueryType::Enum mQueryType = QueryType::Occlusion;
     uint32_t mQueryCount = 0;
+    QueryPipelineStatisticsFlags mPipelineStatistics = 0;
+
+    friend class CaptureVk;
 };
 
 }
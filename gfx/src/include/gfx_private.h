@@ -25,6 +25,7 @@
 
 #include <gfx/gfx_base.h>
 #include <gx/gbytearray.h>
+#include "gfx_command_stream.h"
 
 #include <gfx/gfx_stl_template.h>
 #include <atomic>
@@ -53,8 +54,6 @@ public:         \
 #define GFX_P_API_IMPL(CLASS_NAME, P_TYPE) class CLASS_NAME##P_TYPE : public CLASS_NAME##_P
 
 
-#define CMD_BUFFER_SIZE 65536
-
 struct ElementType
 {
     enum Enum : uint8_t
@@ -156,6 +155,11 @@ struct CommandKey
         WriteTimestamp,
         CopyQueryResults,
 
+        ExecuteCommands,
+
+        BeginSortedDraws,
+        EndSortedDraws,
+
         Count
     };
 };
@@ -211,6 +215,11 @@ constexpr const char *const CommandKeyStr[] = {
         "EndQuery",
         "WriteTimestamp",
         "CopyQueryResults",
+
+        "ExecuteCommands",
+
+        "BeginSortedDraws",
+        "EndSortedDraws",
 };
 
 static_assert(ARRAY_LEN(CommandKeyStr) == CommandKey::Count,
@@ -294,21 +303,21 @@ inline uint8_t getElementTypeIdx(uint32_t elementIdx)
 
 /// ============ Serialization and deserialization ============ ///
 
-static void writeSubPassInfo(GByteArray &buffer, const SubPassInfo &info)
+static void writeSubPassInfo(CommandStream &buffer, const SubPassInfo &info)
 {
     // subPassDescs
     uint32_t vSize = info.subPassDescs.size();
-    buffer.write(vSize);
+    buffer.writeVarint(vSize);
     if (vSize > 0) {
         for (auto &desc : info.subPassDescs) {
             buffer.write(desc.useDepthStencil);
             uint32_t size = desc.colorAttachments.size();
-            buffer.write(size);
+            buffer.writeVarint(size);
             if (size > 0) {
                 buffer.write(desc.colorAttachments.data(), desc.colorAttachments.size() * sizeof(uint32_t));
             }
             size = desc.inputAttachments.size();
-            buffer.write(size);
+            buffer.writeVarint(size);
             if (size > 0) {
                 buffer.write(desc.inputAttachments.data(), desc.inputAttachments.size() * sizeof(uint32_t));
             }
@@ -317,60 +326,174 @@ static void writeSubPassInfo(GByteArray &buffer, const SubPassInfo &info)
 
     // subPassDepends
     vSize = info.subPassDepends.size();
-    buffer.write(vSize);
+    buffer.writeVarint(vSize);
     if (vSize > 0) {
         buffer.write(info.subPassDepends.data(), vSize * sizeof(SubPassDependency));
     }
 }
 
-static void readSubPassInfo(GByteArray &buffer, SubPassInfo &info)
+static void readSubPassInfo(CommandStream &buffer, SubPassInfo &info)
 {
+    // 直接resize复用info中已有的数组容量
     // subPassDescs
     uint32_t vSize;
-    buffer.read(vSize);
-    info.subPassDescs.clear();
-    if (vSize > 0) {
-        info.subPassDescs.resize(vSize);
-        for (auto &desc : info.subPassDescs) {
-            buffer.read(desc.useDepthStencil);
-            uint32_t size;
-            buffer.read(size);
-            if (size > 0) {
-                desc.colorAttachments.resize(size);
-                buffer.read(desc.colorAttachments.data(), desc.colorAttachments.size() * sizeof(uint32_t));
-            }
+    buffer.readVarint(vSize);
+    info.subPassDescs.resize(vSize);
+    for (auto &desc : info.subPassDescs) {
+        buffer.read(desc.useDepthStencil);
+        uint32_t size;
+        buffer.readVarint(size);
+        desc.colorAttachments.resize(size);
+        if (size > 0) {
+            buffer.read(desc.colorAttachments.data(), desc.colorAttachments.size() * sizeof(uint32_t));
+        }
 
-            buffer.read(size);
-            if (size > 0) {
-                desc.inputAttachments.resize(size);
-                buffer.read(desc.inputAttachments.data(), desc.inputAttachments.size() * sizeof(uint32_t));
-            }
+        buffer.readVarint(size);
+        desc.inputAttachments.resize(size);
+        if (size > 0) {
+            buffer.read(desc.inputAttachments.data(), desc.inputAttachments.size() * sizeof(uint32_t));
         }
     }
 
     // subPassDepends
-    buffer.read(vSize);
-    info.subPassDepends.clear();
+    buffer.readVarint(vSize);
+    info.subPassDepends.resize(vSize);
     if (vSize > 0) {
-        info.subPassDepends.resize(vSize);
         buffer.read(info.subPassDepends.data(), vSize * sizeof(SubPassDependency));
     }
 }
 
-static void writeRenderPassInfo(GByteArray &buffer, const RenderPassInfo &info)
+static void writeRenderPassInfo(CommandStream &buffer, const RenderPassInfo &info)
 {
     buffer.write(info.clear);
     buffer.write(info.discard);
+    buffer.write(info.discardEnd);
     writeSubPassInfo(buffer, info.subPassInfo);
 }
 
-static void readRenderPassInfo(GByteArray &buffer, RenderPassInfo &info)
+static void readRenderPassInfo(CommandStream &buffer, RenderPassInfo &info)
 {
     buffer.read(info.clear);
     buffer.read(info.discard);
+    buffer.read(info.discardEnd);
     readSubPassInfo(buffer, info.subPassInfo);
 }
 
+/**
+ * 管线状态的光栅化状态固定写入8字节，参数值按组写入非默认的部分，前面附带8位的分组掩码
+ */
+static void writeGraphicsPipelineState(CommandStream &buffer, const GraphicsPipelineStateInfo &state)
+{
+    static const StencilOpState defaultStencilOp{};
+    const PipelineParamValueInfo &param = state.paramValueInfo;
+
+    uint8_t mask = 0;
+    if (param.depthBiasConstantFactor != 0 || param.depthBiasClamp != 0 || param.depthBiasSlopeFactor != 0) {
+        mask |= 0x1;
+    }
+    if (memcmp(&param.frontStencilOp, &defaultStencilOp, sizeof(StencilOpState)) != 0
+        || memcmp(&param.backStencilOp, &defaultStencilOp, sizeof(StencilOpState)) != 0) {
+        mask |= 0x2;
+    }
+    if (param.tessellationPatchControlPoints != 0) {
+        mask |= 0x4;
+    }
+
+    buffer.write(mask);
+    buffer.write(state.rasterStateInfo);
+    if (mask & 0x1) {
+        buffer.write(param.depthBiasConstantFactor);
+        buffer.write(param.depthBiasClamp);
+        buffer.write(param.depthBiasSlopeFactor);
+    }
+    if (mask & 0x2) {
+        buffer.write(param.frontStencilOp);
+        buffer.write(param.backStencilOp);
+    }
+    if (mask & 0x4) {
+        buffer.writeVarint(param.tessellationPatchControlPoints);
+    }
+}
+
+static void readGraphicsPipelineState(CommandStream &buffer, GraphicsPipelineStateInfo &state)
+{
+    state = GraphicsPipelineStateInfo{};
+    PipelineParamValueInfo &param = state.paramValueInfo;
+
+    uint8_t mask;
+    buffer.read(mask);
+    buffer.read(state.rasterStateInfo);
+    if (mask & 0x1) {
+        buffer.read(param.depthBiasConstantFactor);
+        buffer.read(param.depthBiasClamp);
+        buffer.read(param.depthBiasSlopeFactor);
+    }
+    if (mask & 0x2) {
+        buffer.read(param.frontStencilOp);
+        buffer.read(param.backStencilOp);
+    }
+    if (mask & 0x4) {
+        buffer.readVarint(param.tessellationPatchControlPoints);
+    }
+}
+
+/**
+ * 顶点布局只写入使用中的绑定和属性，前面附带16位的使用掩码
+ */
+static void writeVertexLayout(CommandStream &buffer, const VertexLayout &layout)
+{
+    static_assert(GFX_MAX_VERTEX_ATTRIBUTE_COUNT <= 16, "vertex layout mask is 16 bits");
+    static const VertexInputBindingInfo emptyBinding{};
+    static const VertexInputAttributeDescInfo emptyAttribute{};
+
+    uint16_t mask = 0;
+    for (uint32_t i = 0; i < GFX_MAX_VERTEX_ATTRIBUTE_COUNT; i++) {
+        if (memcmp(&layout.vertexInputBindingInfos[i], &emptyBinding, sizeof(VertexInputBindingInfo)) != 0) {
+            mask |= (uint16_t) (1u << i);
+        }
+    }
+    buffer.write(mask);
+    for (uint32_t i = 0; i < GFX_MAX_VERTEX_ATTRIBUTE_COUNT; i++) {
+        if (mask & (1u << i)) {
+            buffer.write(&layout.vertexInputBindingInfos[i], sizeof(VertexInputBindingInfo));
+        }
+    }
+
+    mask = 0;
+    for (uint32_t i = 0; i < GFX_MAX_VERTEX_ATTRIBUTE_COUNT; i++) {
+        if (memcmp(&layout.vertexInputAttributeDescInfos[i], &emptyAttribute,
+                   sizeof(VertexInputAttributeDescInfo)) != 0) {
+            mask |= (uint16_t) (1u << i);
+        }
+    }
+    buffer.write(mask);
+    for (uint32_t i = 0; i < GFX_MAX_VERTEX_ATTRIBUTE_COUNT; i++) {
+        if (mask & (1u << i)) {
+            buffer.write(&layout.vertexInputAttributeDescInfos[i], sizeof(VertexInputAttributeDescInfo));
+        }
+    }
+}
+
+static void readVertexLayout(CommandStream &buffer, VertexLayout &layout)
+{
+    layout = VertexLayout{};
+
+    uint16_t mask;
+    buffer.read(mask);
+    for (uint32_t i = 0; i < GFX_MAX_VERTEX_ATTRIBUTE_COUNT; i++) {
+        if (mask & (1u << i)) {
+            buffer.read(&layout.vertexInputBindingInfos[i], sizeof(VertexInputBindingInfo));
+        }
+    }
+
+    buffer.read(mask);
+    for (uint32_t i = 0; i < GFX_MAX_VERTEX_ATTRIBUTE_COUNT; i++) {
+        if (mask & (1u << i)) {
+            buffer.read(&layout.vertexInputAttributeDescInfos[i], sizeof(VertexInputAttributeDescInfo));
+        }
+    }
+}
+
 }
 
 #endif //GX_GFX_PRIVATE_H
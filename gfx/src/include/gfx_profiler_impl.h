@@ -0,0 +1,156 @@
+/*
+ * Copyright (c) 2023 Gxin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef GX_GFX_PROFILER_IMPL_H
+#define GX_GFX_PROFILER_IMPL_H
+
+#include <gfx/gfx_profiler.h>
+
+#include <gx/gmutex.h>
+
+#include <atomic>
+#include <deque>
+
+
+namespace gfx
+{
+
+/**
+ * Context持有的性能分析器，与后端无关
+ * 记录CPU区间，并接收后端读取到的GPU区间
+ */
+class Profiler
+{
+public:
+    bool enable(const ProfilerInfo &info);
+
+    void disable();
+
+    bool isEnabled() const
+    {
+        return mEnabled.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * 是否需要在编译指令缓冲时写入GPU时间戳
+     */
+    bool isGpuEnabled() const
+    {
+        return isEnabled() && mGpuEnabled.load(std::memory_order_relaxed);
+    }
+
+    uint32_t latency() const
+    {
+        return mLatency;
+    }
+
+    uint64_t frame() const
+    {
+        return mFrame.load(std::memory_order_relaxed);
+    }
+
+    void nextFrame();
+
+    void beginZone(const char *name);
+
+    void endZone();
+
+    void addEvent(ProfilerEvent &&event);
+
+    void takeEvents(std::vector<ProfilerEvent> &events);
+
+    /**
+     * 当前稳定时钟时间(纳秒)，所有事件使用同一时间基准
+     */
+    static uint64_t now();
+
+private:
+    std::atomic<bool> mEnabled{false};
+    std::atomic<bool> mGpuEnabled{false};
+    std::atomic<uint64_t> mFrame{0};
+    uint32_t mLatency = 3;
+    uint32_t mMaxEvents = 0;
+
+    GMutex mEventMutex;
+    std::deque<ProfilerEvent> mEvents;
+};
+
+/**
+ * 内部操作的CPU区间，分析器未开启时只读取一次开关
+ */
+class ProfilerScope
+{
+public:
+    ProfilerScope(Profiler &profiler, const char *name)
+            : mProfiler(profiler.isEnabled() ? &profiler : nullptr)
+    {
+        if (mProfiler) {
+            mProfiler->beginZone(name);
+        }
+    }
+
+    ~ProfilerScope()
+    {
+        if (mProfiler) {
+            mProfiler->endZone();
+        }
+    }
+
+    ProfilerScope(const ProfilerScope &) = delete;
+
+    ProfilerScope &operator=(const ProfilerScope &) = delete;
+
+private:
+    Profiler *mProfiler;
+};
+
+/**
+ * Context上的累计计数，可在任意线程更新
+ */
+struct ContextCounters
+{
+    std::atomic<uint64_t> submitCount{0};
+    std::atomic<uint64_t> compileCount{0};
+    std::atomic<uint64_t> compileTimeNs{0};
+    std::atomic<uint64_t> pipelineCacheHitCount{0};
+    std::atomic<uint64_t> pipelineCacheMissCount{0};
+    std::atomic<uint64_t> pipelineCreateTimeNs{0};
+    std::atomic<uint64_t> descriptorSetUpdateCount{0};
+    std::atomic<uint64_t> descriptorSetAllocCount{0};
+    std::atomic<uint64_t> uploadBytes{0};
+
+    ContextStatistics snapshot() const;
+
+    /**
+     * 将两次快照之间的增量写入帧统计
+     *
+     * @param stats
+     * @param current
+     * @param last
+     */
+    static void fillFrameStatistics(FrameStatistics &stats, const ContextStatistics &current,
+                                    const ContextStatistics &last);
+};
+
+}
+
+#endif //GX_GFX_PROFILER_IMPL_H
@@ -0,0 +1,768 @@
+/*
+ * Copyright (c) 2023 Gxin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * 无窗口的基准测试工具，渲染到FrameTargetType::RenderTarget类型的离屏Frame，可运行在任意Vulkan驱动(包括CPU软件驱动)上
+ * 用法: gfx-bench [-d device index] [-n iterations] [-o output file] [--null] [--check-allocs]
+ * 结果以JSON格式输出到标准输出或指定文件，用于对比不同版本间的性能变化
+ * 重新编译时每个绘制产生堆分配时返回2
+ * --check-allocs只运行堆分配测试，没有可用的设备时返回77(ctest按跳过处理)
+ */
+
+#include <gfx/gfx.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <vector>
+
+
+/**
+ * 统计堆分配次数，用于检查编译时逐条指令的内存分配
+ * 替换全局operator new对动态库内的分配同样生效(Windows的DLL除外，需要静态链接)
+ */
+static std::atomic<uint64_t> sAllocCount{0};
+
+void *operator new(size_t size)
+{
+    sAllocCount.fetch_add(1, std::memory_order_relaxed);
+    void *ptr = malloc(size == 0 ? 1 : size);
+    if (!ptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void operator delete(void *ptr) noexcept
+{
+    free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept
+{
+    free(ptr);
+}
+
+
+using namespace gfx;
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+
+constexpr uint32_t BENCH_WIDTH = 256;
+constexpr uint32_t BENCH_HEIGHT = 256;
+
+constexpr uint32_t DRAW_COUNT = 10000;          // 录制/编译测试的绘制数量
+constexpr uint32_t PIPELINE_COUNT = 512;        // 管线查找测试的管线状态数量，不能超过uniqueState可生成的数量
+constexpr uint32_t BINDER_COUNT = 1024;         // 描述符更新测试的资源绑定器数量
+constexpr uint32_t UPLOAD_SIZE = 1024;          // 上传测试的纹理宽高
+constexpr uint32_t SUBMIT_COUNT = 100;          // 提交开销测试每次迭代的提交次数
+constexpr uint32_t STATE_VARIANT_COUNT = 4;     // 堆分配测试中每种绑定状态轮换使用的数量
+
+constexpr uint64_t UNIFORM_RANGE = 256;
+constexpr uint64_t UNIFORM_BUFFER_SIZE = UNIFORM_RANGE * 256;
+
+/**
+ * 顶点着色器，输出固定位置，不读取任何顶点属性
+ */
+const uint32_t VERTEX_SHADER_CODE[] = {
+        0x07230203, 0x00010000, 0x00000000, 0x0000000c, 0x00000000, 0x00020011,
+        0x00000001, 0x0003000e, 0x00000000, 0x00000001, 0x0006000f, 0x00000000,
+        0x00000001, 0x6e69616d, 0x00000000, 0x00000002, 0x00040047, 0x00000002,
+        0x0000000b, 0x00000000, 0x00020013, 0x00000003, 0x00030021, 0x00000004,
+        0x00000003, 0x00030016, 0x00000005, 0x00000020, 0x00040017, 0x00000006,
+        0x00000005, 0x00000004, 0x00040020, 0x00000007, 0x00000003, 0x00000006,
+        0x0004003b, 0x00000007, 0x00000002, 0x00000003, 0x0004002b, 0x00000005,
+        0x00000008, 0x00000000, 0x0004002b, 0x00000005, 0x00000009, 0x3f800000,
+        0x0007002c, 0x00000006, 0x0000000a, 0x00000008, 0x00000008, 0x00000008,
+        0x00000009, 0x00050036, 0x00000003, 0x00000001, 0x00000000, 0x00000004,
+        0x000200f8, 0x0000000b, 0x0003003e, 0x00000002, 0x0000000a, 0x000100fd,
+        0x00010038,
+};
+
+/**
+ * 片元着色器，向location 0输出固定颜色
+ */
+const uint32_t FRAGMENT_SHADER_CODE[] = {
+        0x07230203, 0x00010000, 0x00000000, 0x0000000c, 0x00000000, 0x00020011,
+        0x00000001, 0x0003000e, 0x00000000, 0x00000001, 0x0006000f, 0x00000004,
+        0x00000001, 0x6e69616d, 0x00000000, 0x00000002, 0x00030010, 0x00000001,
+        0x00000007, 0x00040047, 0x00000002, 0x0000001e, 0x00000000, 0x00020013,
+        0x00000003, 0x00030021, 0x00000004, 0x00000003, 0x00030016, 0x00000005,
+        0x00000020, 0x00040017, 0x00000006, 0x00000005, 0x00000004, 0x00040020,
+        0x00000007, 0x00000003, 0x00000006, 0x0004003b, 0x00000007, 0x00000002,
+        0x00000003, 0x0004002b, 0x00000005, 0x00000008, 0x00000000, 0x0004002b,
+        0x00000005, 0x00000009, 0x3f800000, 0x0007002c, 0x00000006, 0x0000000a,
+        0x00000008, 0x00000008, 0x00000008, 0x00000009, 0x00050036, 0x00000003,
+        0x00000001, 0x00000000, 0x00000004, 0x000200f8, 0x0000000b, 0x0003003e,
+        0x00000002, 0x0000000a, 0x000100fd, 0x00010038,
+};
+
+/**
+ * 所有测试共用的离屏渲染环境
+ */
+struct BenchEnv
+{
+    Context context = GFX_NULL_HANDLE;
+    Texture colorTexture = GFX_NULL_HANDLE;
+    Texture depthTexture = GFX_NULL_HANDLE;
+    RenderTarget renderTarget = GFX_NULL_HANDLE;
+    Frame frame = GFX_NULL_HANDLE;
+    Shader vertexShader = GFX_NULL_HANDLE;
+    Shader fragmentShader = GFX_NULL_HANDLE;
+    Buffer uniformBuffer = GFX_NULL_HANDLE;
+    ResourceBinder binder = GFX_NULL_HANDLE;
+};
+
+/**
+ * 一项测试的结果，指标按添加顺序输出
+ */
+struct BenchResult
+{
+    std::string name;
+    std::vector<std::pair<std::string, double>> metrics;
+
+    void add(const std::string &key, double value)
+    {
+        metrics.emplace_back(key, value);
+    }
+};
+
+inline uint64_t elapsedNs(Clock::time_point begin)
+{
+    return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - begin).count();
+}
+
+double median(std::vector<uint64_t> values)
+{
+    if (values.empty()) {
+        return 0;
+    }
+    std::sort(values.begin(), values.end());
+    return (double) values[values.size() / 2];
+}
+
+inline double nsToUs(double ns)
+{
+    return ns / 1000.0;
+}
+
+/**
+ * 由序号生成互不相同的管线状态，最多可生成2048种
+ */
+GraphicsPipelineStateInfo uniqueState(uint32_t index)
+{
+    GraphicsPipelineStateInfo state{};
+    state.rasterStateInfo.depthCompareOp = (CompareOp::Enum) (index % 8);
+    state.rasterStateInfo.colorWriteMask = (index / 8) % 16;
+    state.rasterStateInfo.frontFace = (FrontFace::Enum) ((index / 128) % 2);
+    state.rasterStateInfo.depthWriteEnable = ((index / 256) % 2) == 0;
+    state.rasterStateInfo.cullMode = (CullMode::Enum) ((index / 512) % 4);
+    return state;
+}
+
+bool initEnv(Context context, BenchEnv &env)
+{
+    env.context = context;
+
+    env.colorTexture = createTexture(context, {
+            TextureType::Texture2D,
+            Format::R8G8B8A8_UNorm,
+            TextureUsage::Attachment | TextureUsage::Sampled,
+            TextureAspect::AspectColor,
+            BENCH_WIDTH, BENCH_HEIGHT, 1, 1, 1
+    });
+    env.depthTexture = createTexture(context, {
+            TextureType::Texture2D,
+            context->getSupportedDepthFormat(),
+            TextureUsage::Attachment,
+            TextureAspect::AspectDepth | TextureAspect::AspectStencil,
+            BENCH_WIDTH, BENCH_HEIGHT, 1, 1, 1
+    });
+    if (env.colorTexture == GFX_NULL_HANDLE || env.depthTexture == GFX_NULL_HANDLE) {
+        return false;
+    }
+
+    CreateRenderTargetInfo rtInfo{};
+    rtInfo.colorAttachments = {{{env.colorTexture, 0, 0}}};
+    rtInfo.depthStencilAttachment = {env.depthTexture, 0, 0};
+    env.renderTarget = createRenderTarget(context, rtInfo);
+    if (env.renderTarget == GFX_NULL_HANDLE) {
+        return false;
+    }
+
+    env.frame = createFrame(context, {
+            FrameTargetType::RenderTarget,
+            env.renderTarget,
+            BENCH_WIDTH,
+            BENCH_HEIGHT,
+            false
+    });
+
+    env.vertexShader = createShader(context, {
+            ShaderType::Vertex, VERTEX_SHADER_CODE, sizeof(VERTEX_SHADER_CODE), "bench.vert"
+    });
+    env.fragmentShader = createShader(context, {
+            ShaderType::Fragment, FRAGMENT_SHADER_CODE, sizeof(FRAGMENT_SHADER_CODE), "bench.frag"
+    });
+
+    env.uniformBuffer = createBuffer(context, {
+            BufferType::Uniform, BufferMemoryUsage::CpuToGpu, UNIFORM_BUFFER_SIZE
+    });
+    env.binder = createResourceBinder(context, {{{ResourceType::UniformBuffer, ShaderType::Vertex}}});
+    if (env.binder != GFX_NULL_HANDLE) {
+        env.binder->bindBufferRange(0, env.uniformBuffer, 0, UNIFORM_RANGE);
+    }
+
+    return env.frame != GFX_NULL_HANDLE
+           && env.vertexShader != GFX_NULL_HANDLE
+           && env.fragmentShader != GFX_NULL_HANDLE
+           && env.uniformBuffer != GFX_NULL_HANDLE
+           && env.binder != GFX_NULL_HANDLE;
+}
+
+void destroyEnv(BenchEnv &env)
+{
+    if (env.context == GFX_NULL_HANDLE) {
+        return;
+    }
+    env.context->waitIdle();
+
+    if (env.binder) destroyResourceBinder(env.binder);
+    if (env.uniformBuffer) destroyBuffer(env.uniformBuffer);
+    if (env.fragmentShader) destroyShader(env.fragmentShader);
+    if (env.vertexShader) destroyShader(env.vertexShader);
+    if (env.frame) destroyFrame(env.frame);
+    if (env.renderTarget) destroyRenderTarget(env.renderTarget);
+    if (env.depthTexture) destroyTexture(env.depthTexture);
+    if (env.colorTexture) destroyTexture(env.colorTexture);
+    env = {};
+}
+
+CommandBuffer createFrameCommandBuffer(const BenchEnv &env)
+{
+    return createCommandBuffer(env.context, {QueueType::Graphics, env.frame->frameBufferCount()});
+}
+
+/**
+ * 开始录制一个清屏的RenderPass，并设置绘制需要的公共状态
+ */
+void beginDrawPass(CommandBuffer cmdBuffer, const BenchEnv &env)
+{
+    RenderPassInfo rpInfo{};
+    rpInfo.clear = RenderTargetAttachmentFlag::Color0 | RenderTargetAttachmentFlag::Depth;
+
+    cmdBuffer->begin()
+            ->bindRenderTarget(env.frame)
+            ->setClearColor({0, 0, 0, 1})
+            ->setClearDepthStencil(1.0f, 0)
+            ->beginRenderPass({0, 0, UINT32_MAX, UINT32_MAX}, rpInfo)
+            ->setShaders({env.vertexShader, env.fragmentShader})
+            ->setVertexLayout({})
+            ->setViewport({0, 0, BENCH_WIDTH, BENCH_HEIGHT}, 0.0f, 1.0f)
+            ->setScissor({0, 0, BENCH_WIDTH, BENCH_HEIGHT});
+}
+
+void endDrawPass(CommandBuffer cmdBuffer)
+{
+    cmdBuffer->endRenderPass()
+            ->end();
+}
+
+/**
+ * 通过Frame提交并等待执行完成，返回耗时
+ */
+uint64_t submitFrame(const BenchEnv &env, CommandBuffer cmdBuffer)
+{
+    auto begin = Clock::now();
+    if (env.frame->beginFrame()) {
+        env.frame->submit(cmdBuffer);
+        env.frame->endFrame(true);
+    }
+    return elapsedNs(begin);
+}
+
+/**
+ * 绘制指令的录制耗时和编译耗时
+ * 编译耗时为首次提交(编译+执行)与再次提交已编译指令缓冲(只执行)的差值
+ */
+BenchResult benchRecordCompile(const BenchEnv &env, uint32_t iterations)
+{
+    BenchResult result{"record_compile"};
+
+    CommandBuffer cmdBuffer = createFrameCommandBuffer(env);
+    GraphicsPipelineStateInfo state{};
+
+    std::vector<uint64_t> recordTimes;
+    std::vector<uint64_t> compileTimes;
+    std::vector<uint64_t> executeTimes;
+
+    for (uint32_t i = 0; i < iterations; i++) {
+        auto begin = Clock::now();
+        beginDrawPass(cmdBuffer, env);
+        cmdBuffer->bindResources(ResourceBindPoint::Graphics, {env.binder}, {});
+        for (uint32_t d = 0; d < DRAW_COUNT; d++) {
+            cmdBuffer->setGraphicsPipelineState(state)
+                    ->draw(3, 1, 0, d);
+        }
+        endDrawPass(cmdBuffer);
+        recordTimes.push_back(elapsedNs(begin));
+
+        uint64_t first = submitFrame(env, cmdBuffer);
+        uint64_t again = submitFrame(env, cmdBuffer);
+        compileTimes.push_back(first > again ? first - again : 0);
+        executeTimes.push_back(again);
+    }
+
+    destroyCommandBuffer(cmdBuffer);
+
+    double recordNs = median(recordTimes);
+    double compileNs = median(compileTimes);
+    result.add("draw_count", DRAW_COUNT);
+    result.add("record_us", nsToUs(recordNs));
+    result.add("record_ns_per_draw", recordNs / DRAW_COUNT);
+    result.add("compile_us", nsToUs(compileNs));
+    result.add("compile_ns_per_draw", compileNs / DRAW_COUNT);
+    result.add("execute_us", nsToUs(median(executeTimes)));
+    return result;
+}
+
+/**
+ * 重新编译时每个绘制的堆分配次数，编译使用的临时数据预热后应为0
+ * 每个绘制前轮换资源绑定器、顶点缓冲、视口和管线状态，使每条状态指令都不会被省略，绘制也不会被合并
+ * 分别录制两种数量的绘制并各编译两次，第二次编译的分配次数之差按绘制数量平均，排除提交本身的固定分配
+ */
+BenchResult benchCompileAllocations(const BenchEnv &env, double &allocsPerDraw)
+{
+    BenchResult result{"compile_allocations"};
+
+    std::vector<ResourceBinder> binders(STATE_VARIANT_COUNT);
+    for (uint32_t i = 0; i < STATE_VARIANT_COUNT; i++) {
+        binders[i] = createResourceBinder(env.context, {{{ResourceType::UniformBuffer, ShaderType::Vertex}}});
+        binders[i]->bindBufferRange(0, env.uniformBuffer, i * UNIFORM_RANGE, UNIFORM_RANGE);
+    }
+    Buffer vertexBuffer = createBuffer(env.context, {
+            BufferType::Vertex, BufferMemoryUsage::GpuOnly, UNIFORM_RANGE * STATE_VARIANT_COUNT
+    });
+
+    auto record = [&env, &binders, vertexBuffer](CommandBuffer cmdBuffer, uint32_t drawCount) {
+        beginDrawPass(cmdBuffer, env);
+        for (uint32_t d = 0; d < drawCount; d++) {
+            const uint32_t v = d % STATE_VARIANT_COUNT;
+            cmdBuffer->bindResources(ResourceBindPoint::Graphics, {binders[v]}, {})
+                    ->bindVertexBuffer(0, {vertexBuffer}, {v * UNIFORM_RANGE})
+                    ->setViewport({0, 0, BENCH_WIDTH - v, BENCH_HEIGHT}, 0.0f, 1.0f)
+                    ->setGraphicsPipelineState(uniqueState(v))
+                    ->draw(3, 1, 0, d);
+        }
+        endDrawPass(cmdBuffer);
+    };
+
+    const uint32_t drawCounts[2] = {DRAW_COUNT / 2, DRAW_COUNT};
+    uint64_t allocs[2] = {};
+    for (uint32_t i = 0; i < 2; i++) {
+        CommandBuffer cmdBuffer = createFrameCommandBuffer(env);
+        record(cmdBuffer, drawCounts[i]);
+        submitFrame(env, cmdBuffer);
+
+        // 录制不计入，只统计提交时的重新编译
+        record(cmdBuffer, drawCounts[i]);
+        uint64_t begin = sAllocCount.load();
+        submitFrame(env, cmdBuffer);
+        allocs[i] = sAllocCount.load() - begin;
+
+        destroyCommandBuffer(cmdBuffer);
+    }
+
+    env.context->waitIdle();
+    destroyBuffer(vertexBuffer);
+    for (auto &binder : binders) {
+        destroyResourceBinder(binder);
+    }
+
+    allocsPerDraw = allocs[1] > allocs[0]
+                    ? (double) (allocs[1] - allocs[0]) / (drawCounts[1] - drawCounts[0]) : 0.0;
+    result.add("draw_count", DRAW_COUNT);
+    result.add("compile_allocs", (double) allocs[1]);
+    result.add("allocs_per_draw", allocsPerDraw);
+    return result;
+}
+
+/**
+ * 编译时管线查找的未命中(创建管线)与命中耗时
+ * 每次绘制使用不同的管线状态，未命中只能测量一次，命中使用新的指令缓冲重新录制以强制重新编译
+ */
+BenchResult benchPipelineLookup(const BenchEnv &env, uint32_t iterations)
+{
+    BenchResult result{"pipeline_lookup"};
+
+    auto record = [&env](CommandBuffer cmdBuffer) {
+        beginDrawPass(cmdBuffer, env);
+        cmdBuffer->bindResources(ResourceBindPoint::Graphics, {env.binder}, {});
+        for (uint32_t i = 0; i < PIPELINE_COUNT; i++) {
+            cmdBuffer->setGraphicsPipelineState(uniqueState(i))
+                    ->draw(3, 1, 0, 0);
+        }
+        endDrawPass(cmdBuffer);
+    };
+
+    CommandBuffer cmdBuffer = createFrameCommandBuffer(env);
+    record(cmdBuffer);
+    uint64_t missTime = submitFrame(env, cmdBuffer);
+    uint64_t executeTime = submitFrame(env, cmdBuffer);
+    destroyCommandBuffer(cmdBuffer);
+
+    std::vector<uint64_t> hitTimes;
+    for (uint32_t i = 0; i < iterations; i++) {
+        cmdBuffer = createFrameCommandBuffer(env);
+        record(cmdBuffer);
+        hitTimes.push_back(submitFrame(env, cmdBuffer));
+        destroyCommandBuffer(cmdBuffer);
+    }
+
+    double missNs = missTime > executeTime ? (double) (missTime - executeTime) : 0;
+    double hitNs = std::max(median(hitTimes) - (double) executeTime, 0.0);
+    result.add("pipeline_count", PIPELINE_COUNT);
+    result.add("miss_us_per_pipeline", nsToUs(missNs / PIPELINE_COUNT));
+    result.add("hit_ns_per_lookup", hitNs / PIPELINE_COUNT);
+    return result;
+}
+
+/**
+ * 描述符更新速率
+ * 对比修改和不修改绑定内容时录制+编译的耗时，差值为更新BINDER_COUNT个描述符集的耗时
+ */
+BenchResult benchDescriptorUpdate(const BenchEnv &env, uint32_t iterations)
+{
+    BenchResult result{"descriptor_update"};
+
+    std::vector<ResourceBinder> binders(BINDER_COUNT);
+    for (auto &binder : binders) {
+        binder = createResourceBinder(env.context, {{{ResourceType::UniformBuffer, ShaderType::Vertex}}});
+        binder->bindBufferRange(0, env.uniformBuffer, 0, UNIFORM_RANGE);
+    }
+
+    CommandBuffer cmdBuffer = createFrameCommandBuffer(env);
+    GraphicsPipelineStateInfo state{};
+
+    auto run = [&](uint32_t offsetIndex) {
+        auto begin = Clock::now();
+        uint64_t offset = (offsetIndex % (UNIFORM_BUFFER_SIZE / UNIFORM_RANGE)) * UNIFORM_RANGE;
+        for (auto &binder : binders) {
+            binder->bindBufferRange(0, env.uniformBuffer, offset, UNIFORM_RANGE);
+        }
+        beginDrawPass(cmdBuffer, env);
+        cmdBuffer->setGraphicsPipelineState(state);
+        for (auto &binder : binders) {
+            cmdBuffer->bindResources(ResourceBindPoint::Graphics, {binder}, {})
+                    ->draw(3, 1, 0, 0);
+        }
+        endDrawPass(cmdBuffer);
+        uint64_t recordTime = elapsedNs(begin);
+        return recordTime + submitFrame(env, cmdBuffer);
+    };
+
+    std::vector<uint64_t> updateTimes;
+    std::vector<uint64_t> unchangedTimes;
+    for (uint32_t i = 0; i < iterations; i++) {
+        updateTimes.push_back(run(i + 1));
+        unchangedTimes.push_back(run(i + 1));
+    }
+
+    destroyCommandBuffer(cmdBuffer);
+    env.context->waitIdle();
+    for (auto &binder : binders) {
+        destroyResourceBinder(binder);
+    }
+
+    double updateNs = std::max(median(updateTimes) - median(unchangedTimes), 0.0);
+    result.add("binder_count", BINDER_COUNT);
+    result.add("update_ns_per_binder", updateNs / BINDER_COUNT);
+    result.add("updates_per_sec", updateNs > 0 ? BINDER_COUNT / (updateNs / 1e9) : 0);
+    return result;
+}
+
+/**
+ * Texture::setData的上传带宽
+ */
+BenchResult benchUpload(const BenchEnv &env, uint32_t iterations)
+{
+    BenchResult result{"upload"};
+
+    Texture texture = createTexture(env.context, {
+            TextureType::Texture2D,
+            Format::R8G8B8A8_UNorm,
+            TextureUsage::Sampled,
+            TextureAspect::AspectColor,
+            UPLOAD_SIZE, UPLOAD_SIZE, 1, 1, 1
+    });
+    uint64_t dataSize = (uint64_t) UPLOAD_SIZE * UPLOAD_SIZE * 4;
+    std::vector<uint8_t> data(dataSize, 0x7f);
+
+    std::vector<uint64_t> times;
+    for (uint32_t i = 0; i < iterations; i++) {
+        auto begin = Clock::now();
+        texture->setData(data.data(), dataSize, GFX_NULL_HANDLE);
+        times.push_back(elapsedNs(begin));
+    }
+
+    destroyTexture(texture);
+
+    double ns = median(times);
+    result.add("bytes", (double) dataSize);
+    result.add("upload_us", nsToUs(ns));
+    result.add("mb_per_sec", ns > 0 ? (double) dataSize / (ns / 1e9) / (1024.0 * 1024.0) : 0);
+    return result;
+}
+
+/**
+ * 渲染目标回读延迟，从提交复制指令到主机端拿到数据
+ */
+BenchResult benchReadback(const BenchEnv &env, uint32_t iterations)
+{
+    BenchResult result{"readback"};
+
+    uint64_t dataSize = (uint64_t) BENCH_WIDTH * BENCH_HEIGHT * 4;
+    Buffer buffer = createBuffer(env.context, {BufferType::Staging, BufferMemoryUsage::GpuToCpu, dataSize});
+    std::vector<uint8_t> hostData(dataSize);
+
+    BufferImageCopyInfo copyInfo{};
+    copyInfo.layerCount = 1;
+    copyInfo.imageWidth = BENCH_WIDTH;
+    copyInfo.imageHeight = BENCH_HEIGHT;
+    copyInfo.imageDepth = 1;
+
+    RenderPassInfo rpInfo{};
+    rpInfo.clear = RenderTargetAttachmentFlag::Color0 | RenderTargetAttachmentFlag::Depth;
+
+    CommandBuffer cmdBuffer = createCommandBuffer(env.context, {QueueType::Graphics, 1});
+    cmdBuffer->begin()
+            ->bindRenderTarget(env.renderTarget)
+            ->setClearColor({0, 1, 0, 1})
+            ->beginRenderPass({0, 0, UINT32_MAX, UINT32_MAX}, rpInfo)
+            ->endRenderPass()
+            ->copyRenderTargetToBuffer(env.renderTarget, buffer, {copyInfo}, 0, 0)
+            ->end();
+
+    // 先提交一次完成编译
+    env.context->submitCommandBlock(cmdBuffer, 0);
+
+    std::vector<uint64_t> times;
+    for (uint32_t i = 0; i < iterations; i++) {
+        auto begin = Clock::now();
+        env.context->submitCommandBlock(cmdBuffer, 0);
+        void *mapped = buffer->map();
+        if (mapped) {
+            buffer->invalidate(0, dataSize);
+            memcpy(hostData.data(), mapped, dataSize);
+        }
+        buffer->unmap();
+        times.push_back(elapsedNs(begin));
+    }
+
+    destroyCommandBuffer(cmdBuffer);
+    destroyBuffer(buffer);
+
+    result.add("bytes", (double) dataSize);
+    result.add("latency_us", nsToUs(median(times)));
+    return result;
+}
+
+/**
+ * 提交一个已编译的空RenderPass指令缓冲的CPU开销，不包括等待执行完成
+ */
+BenchResult benchSubmit(const BenchEnv &env, uint32_t iterations)
+{
+    BenchResult result{"submit"};
+
+    CommandBuffer cmdBuffer = createFrameCommandBuffer(env);
+    beginDrawPass(cmdBuffer, env);
+    endDrawPass(cmdBuffer);
+    submitFrame(env, cmdBuffer);
+
+    std::vector<uint64_t> times;
+    for (uint32_t i = 0; i < iterations * SUBMIT_COUNT; i++) {
+        if (!env.frame->beginFrame()) {
+            continue;
+        }
+        auto begin = Clock::now();
+        env.frame->submit(cmdBuffer);
+        times.push_back(elapsedNs(begin));
+        env.frame->endFrame(true);
+    }
+
+    destroyCommandBuffer(cmdBuffer);
+
+    result.add("submit_count", (double) times.size());
+    result.add("submit_us", nsToUs(median(times)));
+    return result;
+}
+
+std::string escapeJson(const std::string &str)
+{
+    std::string out;
+    out.reserve(str.size());
+    for (char c : str) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if ((unsigned char) c < 0x20) {
+            char buf[8];
+            snprintf(buf, sizeof(buf), "\\u%04x", c);
+            out += buf;
+        } else {
+            out += c;
+        }
+    }
+    return out;
+}
+
+std::string toJson(const std::string &backend, const DeviceInfo &deviceInfo, uint32_t iterations,
+                   const std::vector<BenchResult> &results)
+{
+    std::string json;
+    char buf[64];
+
+    json += "{\n";
+    json += "  \"backend\": \"" + backend + "\",\n";
+    json += "  \"device\": \"" + escapeJson(deviceInfo.deviceName) + "\",\n";
+    json += "  \"device_type\": " + std::to_string((int) deviceInfo.deviceType) + ",\n";
+    json += "  \"iterations\": " + std::to_string(iterations) + ",\n";
+    json += "  \"benchmarks\": {\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const auto &r = results[i];
+        json += "    \"" + r.name + "\": {\n";
+        for (size_t j = 0; j < r.metrics.size(); j++) {
+            snprintf(buf, sizeof(buf), "%.3f", r.metrics[j].second);
+            json += "      \"" + r.metrics[j].first + "\": " + buf;
+            json += j + 1 < r.metrics.size() ? ",\n" : "\n";
+        }
+        json += i + 1 < results.size() ? "    },\n" : "    }\n";
+    }
+    json += "  }\n";
+    json += "}\n";
+    return json;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t deviceIndex = 0;
+    uint32_t iterations = 10;
+    bool useNull = false;
+    bool checkAllocs = false;
+    const char *outPath = nullptr;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+            deviceIndex = (uint32_t) atoi(argv[++i]);
+        } else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            iterations = (uint32_t) std::max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc) {
+            outPath = argv[++i];
+        } else if (strcmp(argv[i], "--null") == 0) {
+            useNull = true;
+        } else if (strcmp(argv[i], "--check-allocs") == 0) {
+            checkAllocs = true;
+        } else {
+            printf("Usage: %s [-d device index] [-n iterations] [-o output file] [--null] [--check-allocs]\n",
+                   argv[0]);
+            return 1;
+        }
+    }
+
+    TargetApiType::Enum apiType = useNull ? TargetApiType::Null : TargetApiType::Vulkan;
+    // 检查模式下没有可用的驱动或设备时按跳过处理
+    const int unavailableCode = checkAllocs ? 77 : 1;
+    Instance instance = createInstance({"gfx-bench", apiType, {}, false});
+    if (instance == GFX_NULL_HANDLE) {
+        fprintf(stderr, "Create instance failure\n");
+        return unavailableCode;
+    }
+    if (deviceIndex >= instance->deviceCount()) {
+        fprintf(stderr, "Invalid device index: %u\n", deviceIndex);
+        destroyInstance(instance);
+        return unavailableCode;
+    }
+
+    Context context = createContext(instance, {deviceIndex, {}});
+    if (context == GFX_NULL_HANDLE) {
+        fprintf(stderr, "Create context failure\n");
+        destroyInstance(instance);
+        return unavailableCode;
+    }
+
+    BenchEnv env{};
+    if (!initEnv(context, env)) {
+        fprintf(stderr, "Create bench resources failure\n");
+        destroyEnv(env);
+        destroyContext(context);
+        destroyInstance(instance);
+        return 1;
+    }
+
+    double allocsPerDraw = 0;
+    std::vector<BenchResult> results;
+    if (checkAllocs) {
+        results.push_back(benchCompileAllocations(env, allocsPerDraw));
+    } else {
+        results.push_back(benchRecordCompile(env, iterations));
+        results.push_back(benchCompileAllocations(env, allocsPerDraw));
+        results.push_back(benchPipelineLookup(env, iterations));
+        results.push_back(benchDescriptorUpdate(env, iterations));
+        results.push_back(benchUpload(env, iterations));
+        results.push_back(benchReadback(env, iterations));
+        results.push_back(benchSubmit(env, iterations));
+    }
+
+    std::string json = toJson(useNull ? "null" : "vulkan", context->deviceInfo(), iterations, results);
+
+    destroyEnv(env);
+    destroyContext(context);
+    destroyInstance(instance);
+
+    if (outPath) {
+        FILE *file = fopen(outPath, "wb");
+        if (!file) {
+            fprintf(stderr, "Open %s failure\n", outPath);
+            return 1;
+        }
+        fwrite(json.data(), 1, json.size(), file);
+        fclose(file);
+    } else {
+        fputs(json.c_str(), stdout);
+    }
+
+    if (allocsPerDraw > 0) {
+        fprintf(stderr, "Recompile allocates %.3f times per draw, expected 0\n", allocsPerDraw);
+        return 2;
+    }
+    return 0;
+}
@@ -0,0 +1,489 @@
+/*
+ * Copyright (c) 2023 Gxin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * 指令录制层的测试，运行在Null后端上，不需要任何图形驱动
+ * 通过Context::dumpCommandBuffer的输出检查无序绘制排序后的顺序、冗余状态的省略以及修补点
+ * 用法: gfx-recorder-test
+ * 全部通过时返回0，否则返回1
+ */
+
+#include <gfx/gfx.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <vector>
+
+
+using namespace gfx;
+
+namespace
+{
+
+constexpr uint32_t TEST_WIDTH = 64;
+constexpr uint32_t TEST_HEIGHT = 64;
+constexpr uint32_t SORTED_DRAW_COUNT = 6;
+
+uint32_t sFailureCount = 0;
+
+#define TEST_CHECK(COND, ...)                                   \
+    do {                                                        \
+        if (!(COND)) {                                          \
+            sFailureCount++;                                    \
+            fprintf(stderr, "%s:%d check failed: %s\n    ",     \
+                    __FUNCTION__, __LINE__, #COND);             \
+            fprintf(stderr, __VA_ARGS__);                       \
+            fprintf(stderr, "\n");                              \
+        }                                                       \
+    } while (0)
+
+/**
+ * 所有测试共用的资源
+ */
+struct TestEnv
+{
+    Context context = GFX_NULL_HANDLE;
+    Texture colorTexture = GFX_NULL_HANDLE;
+    RenderTarget renderTarget = GFX_NULL_HANDLE;
+    Buffer uniformBuffer = GFX_NULL_HANDLE;
+    ResourceBinder binder = GFX_NULL_HANDLE;
+};
+
+bool initEnv(Context context, TestEnv &env)
+{
+    env.context = context;
+
+    env.colorTexture = createTexture(context, {
+            TextureType::Texture2D,
+            Format::R8G8B8A8_UNorm,
+            TextureUsage::Attachment | TextureUsage::Sampled,
+            TextureAspect::AspectColor,
+            TEST_WIDTH, TEST_HEIGHT, 1, 1, 1
+    });
+    if (env.colorTexture == GFX_NULL_HANDLE) {
+        return false;
+    }
+
+    CreateRenderTargetInfo rtInfo{};
+    rtInfo.colorAttachments = {{{env.colorTexture, 0, 0}}};
+    env.renderTarget = createRenderTarget(context, rtInfo);
+
+    env.uniformBuffer = createBuffer(context, {BufferType::Uniform, BufferMemoryUsage::CpuToGpu, 1024});
+    env.binder = createResourceBinder(context, {{{ResourceType::UniformBufferDynamic, ShaderType::Vertex}}});
+    if (env.binder != GFX_NULL_HANDLE) {
+        env.binder->bindBufferRange(0, env.uniformBuffer, 0, 256);
+    }
+
+    return env.renderTarget != GFX_NULL_HANDLE
+           && env.uniformBuffer != GFX_NULL_HANDLE
+           && env.binder != GFX_NULL_HANDLE;
+}
+
+void destroyEnv(TestEnv &env)
+{
+    if (env.context == GFX_NULL_HANDLE) {
+        return;
+    }
+    env.context->waitIdle();
+
+    if (env.binder) destroyResourceBinder(env.binder);
+    if (env.uniformBuffer) destroyBuffer(env.uniformBuffer);
+    if (env.renderTarget) destroyRenderTarget(env.renderTarget);
+    if (env.colorTexture) destroyTexture(env.colorTexture);
+    env = {};
+}
+
+std::vector<std::string> splitLines(const std::string &str)
+{
+    std::vector<std::string> lines;
+    std::istringstream in(str);
+    std::string line;
+    while (std::getline(in, line)) {
+        lines.push_back(line);
+    }
+    return lines;
+}
+
+/**
+ * 统计指令流中某类指令的数量(不包括排序列表中的重复输出)
+ */
+uint32_t countCommand(const std::string &dump, const std::string &name)
+{
+    uint32_t count = 0;
+    for (auto &line : splitLines(dump)) {
+        if (line == name) {
+            count++;
+        }
+    }
+    return count;
+}
+
+/**
+ * 取出第一个无序绘制区间排序后的执行顺序，每项为"指令名 参数"
+ */
+std::vector<std::string> sortedListing(const std::string &dump)
+{
+    std::vector<std::string> entries;
+    bool inRegion = false;
+    for (auto &line : splitLines(dump)) {
+        if (!inRegion) {
+            inRegion = line == "BeginSortedDraws";
+            continue;
+        }
+        if (line.rfind("    > ", 0) == 0) {
+            entries.push_back(line.substr(6));
+        } else if (line.rfind("    {", 0) == 0) {
+            if (!entries.empty()) {
+                entries.back() += " " + line.substr(4);
+            }
+        } else {
+            break;
+        }
+    }
+    return entries;
+}
+
+bool startsWith(const std::string &str, const std::string &prefix)
+{
+    return str.rfind(prefix, 0) == 0;
+}
+
+/**
+ * 从排序列表的Draw项中取出firstInstance，不是Draw时返回-1
+ */
+int drawInstance(const std::string &entry)
+{
+    const std::string key = "firstInstance: ";
+    size_t pos = entry.find(key);
+    if (!startsWith(entry, "Draw ") || pos == std::string::npos) {
+        return -1;
+    }
+    return atoi(entry.c_str() + pos + key.size());
+}
+
+std::string cullModeStr(CullMode::Enum cullMode)
+{
+    return "cullMode: " + std::to_string((int) cullMode);
+}
+
+void beginPass(CommandBuffer cmdBuffer, const TestEnv &env)
+{
+    RenderPassInfo rpInfo{};
+    rpInfo.clear = RenderTargetAttachmentFlag::Color0;
+
+    cmdBuffer->bindRenderTarget(env.renderTarget)
+            ->beginRenderPass({0, 0, TEST_WIDTH, TEST_HEIGHT}, rpInfo);
+}
+
+/**
+ * 在RenderPass中录制一个无序绘制区间，绘制d使用的管线状态为states[(d + shift) % 2]
+ */
+void recordSortedPass(CommandBuffer cmdBuffer, const TestEnv &env, const GraphicsPipelineStateInfo states[2],
+                      uint32_t shift)
+{
+    beginPass(cmdBuffer, env);
+    cmdBuffer->bindResources(ResourceBindPoint::Graphics, {env.binder}, {0})
+            ->beginSortedDraws();
+    for (uint32_t d = 0; d < SORTED_DRAW_COUNT; d++) {
+        cmdBuffer->setGraphicsPipelineState(states[(d + shift) % 2])
+                ->draw(3, 1, 0, d);
+    }
+    cmdBuffer->endSortedDraws()
+            ->endRenderPass();
+}
+
+/**
+ * 相同管线状态的绘制相邻且保持录制顺序，区间结束时的状态与按录制顺序执行时相同
+ */
+void testSortOrder(const TestEnv &env)
+{
+    GraphicsPipelineStateInfo states[2]{};
+    states[1].setCullMode(CullMode::Back);
+
+    bool reemitted = false;
+    for (uint32_t shift = 0; shift < 2; shift++) {
+        CommandBuffer cmdBuffer = createCommandBuffer(env.context, {QueueType::Graphics, 1});
+        cmdBuffer->begin();
+        recordSortedPass(cmdBuffer, env, states, shift);
+        cmdBuffer->end();
+
+        std::string dump = env.context->dumpCommandBuffer(cmdBuffer);
+        std::vector<std::string> listing = sortedListing(dump);
+        TEST_CHECK(dump.find("sorted: true") != std::string::npos, "region is not sorted:\n%s", dump.c_str());
+
+        std::vector<int> instances;
+        std::string currentState;
+        size_t lastDraw = 0;
+        for (size_t k = 0; k < listing.size(); k++) {
+            int instance = drawInstance(listing[k]);
+            if (startsWith(listing[k], "SetGraphPipelineState ")) {
+                currentState = listing[k];
+            } else if (instance >= 0) {
+                // 每个绘制执行时使用的是录制时为它设置的管线状态
+                const std::string cull = cullModeStr(states[(instance + shift) % 2].rasterStateInfo.cullMode);
+                TEST_CHECK(currentState.find(cull) != std::string::npos,
+                           "draw %d uses a wrong pipeline state:\n%s", instance, dump.c_str());
+                instances.push_back(instance);
+                lastDraw = k;
+            }
+        }
+
+        // 两组绘制各自保持录制顺序，组的先后由状态哈希决定
+        const std::vector<int> evenFirst = {0, 2, 4, 1, 3, 5};
+        const std::vector<int> oddFirst = {1, 3, 5, 0, 2, 4};
+        TEST_CHECK(instances == evenFirst || instances == oddFirst, "unexpected draw order:\n%s", dump.c_str());
+
+        // 最后录制的绘制没有排在最后时，区间末尾重新设置最后录制的管线状态
+        const int lastInstance = (int) SORTED_DRAW_COUNT - 1;
+        const std::string lastCull = cullModeStr(states[(lastInstance + shift) % 2].rasterStateInfo.cullMode);
+        TEST_CHECK(currentState.find(lastCull) != std::string::npos,
+                   "final pipeline state is not the last recorded one:\n%s", dump.c_str());
+        if (lastDraw + 1 < listing.size()) {
+            reemitted = true;
+            TEST_CHECK(!instances.empty() && instances.back() != lastInstance,
+                       "final state re-emitted although the last recorded draw is last:\n%s", dump.c_str());
+        }
+
+        destroyCommandBuffer(cmdBuffer);
+    }
+    TEST_CHECK(reemitted, "neither recording order needed the final state to be re-emitted");
+}
+
+/**
+ * 某个状态只在部分绘制前设置时保持录制顺序
+ */
+void testPartialStateBailOut(const TestEnv &env)
+{
+    CommandBuffer cmdBuffer = createCommandBuffer(env.context, {QueueType::Graphics, 1});
+    cmdBuffer->begin();
+    beginPass(cmdBuffer, env);
+    cmdBuffer->setGraphicsPipelineState({})
+            ->beginSortedDraws()
+            ->draw(3, 1, 0, 0)
+            ->setViewport({0, 0, TEST_WIDTH, TEST_HEIGHT}, 0.0f, 1.0f)
+            ->draw(3, 1, 0, 1)
+            ->endSortedDraws()
+            ->endRenderPass()
+            ->end();
+
+    std::string dump = env.context->dumpCommandBuffer(cmdBuffer);
+    TEST_CHECK(dump.find("sorted: false") != std::string::npos, "partial state was sorted:\n%s", dump.c_str());
+    TEST_CHECK(sortedListing(dump).empty(), "unsorted region has a sorted listing:\n%s", dump.c_str());
+
+    destroyCommandBuffer(cmdBuffer);
+}
+
+/**
+ * 拼接Primary指令缓冲时排序结果中的位置随之平移
+ */
+void testSpliceRelocation(const TestEnv &env)
+{
+    GraphicsPipelineStateInfo states[2]{};
+    states[1].setCullMode(CullMode::Back);
+
+    CommandBuffer subBuffer = createCommandBuffer(env.context, {QueueType::Graphics, 1});
+    subBuffer->begin();
+    recordSortedPass(subBuffer, env, states, 0);
+    subBuffer->end();
+    std::vector<std::string> subListing = sortedListing(env.context->dumpCommandBuffer(subBuffer));
+
+    CommandBuffer cmdBuffer = createCommandBuffer(env.context, {QueueType::Graphics, 1});
+    cmdBuffer->begin()
+            ->pipelineBarrier(PipelineStage::AllCommands, PipelineStage::AllCommands)
+            ->bindResources(ResourceBindPoint::Compute, {env.binder}, {0})
+            ->executeCommands({subBuffer})
+            ->end();
+
+    std::string dump = env.context->dumpCommandBuffer(cmdBuffer);
+    TEST_CHECK(dump.find("sorted: true") != std::string::npos, "spliced region is not sorted:\n%s", dump.c_str());
+    TEST_CHECK(!subListing.empty() && sortedListing(dump) == subListing,
+               "spliced sorted order differs from the source:\n%s", dump.c_str());
+
+    destroyCommandBuffer(cmdBuffer);
+    destroyCommandBuffer(subBuffer);
+}
+
+/**
+ * 与当前状态相同的状态指令在录制时省略，可修补的绑定指令保留
+ */
+void testElisionCounts(const TestEnv &env)
+{
+    const Rect2D viewportA{0, 0, TEST_WIDTH, TEST_HEIGHT};
+    const Rect2D viewportB{0, 0, TEST_WIDTH / 2, TEST_HEIGHT / 2};
+
+    CommandBuffer cmdBuffer = createCommandBuffer(env.context, {QueueType::Graphics, 1});
+    cmdBuffer->begin();
+    beginPass(cmdBuffer, env);
+    cmdBuffer->setViewport(viewportA)
+            ->setViewport(viewportA)
+            ->setViewport(viewportA)
+            ->draw(3, 1, 0, 0)
+            ->setViewport(viewportA)
+            ->setViewport(viewportB)
+            ->setViewport(viewportB)
+            ->setScissor(viewportA)
+            ->setScissor(viewportA)
+            ->bindResources(ResourceBindPoint::Graphics, {env.binder}, {0})
+            ->bindResources(ResourceBindPoint::Graphics, {env.binder}, {0})
+            ->draw(3, 1, 0, 1)
+            ->endRenderPass()
+            ->end();
+
+    std::string dump = env.context->dumpCommandBuffer(cmdBuffer);
+    TEST_CHECK(countCommand(dump, "SetViewport") == 2, "SetViewport count %d", countCommand(dump, "SetViewport"));
+    TEST_CHECK(countCommand(dump, "SetScissor") == 1, "SetScissor count %d", countCommand(dump, "SetScissor"));
+    TEST_CHECK(countCommand(dump, "BindDescSet") == 2, "BindDescSet count %d", countCommand(dump, "BindDescSet"));
+    TEST_CHECK(countCommand(dump, "Draw") == 2, "Draw count %d", countCommand(dump, "Draw"));
+
+    destroyCommandBuffer(cmdBuffer);
+}
+
+/**
+ * 重复的绑定指令仍可标记修补，省略的状态指令不能作为修补目标
+ */
+void testPatchAfterElision(const TestEnv &env)
+{
+    const Rect2D viewport{0, 0, TEST_WIDTH, TEST_HEIGHT};
+
+    CommandBuffer cmdBuffer = createCommandBuffer(env.context, {QueueType::Graphics, 1});
+    cmdBuffer->begin();
+    beginPass(cmdBuffer, env);
+    cmdBuffer->setViewport(viewport)
+            ->bindResources(ResourceBindPoint::Graphics, {env.binder}, {0})
+            ->draw(3, 1, 0, 0)
+            ->bindResources(ResourceBindPoint::Graphics, {env.binder}, {0});
+    CommandPatch patch = cmdBuffer->markPatch();
+    TEST_CHECK(patch != COMMAND_PATCH_INVALID, "repeated bindResources can not be patched");
+
+    // 被省略的setViewport之后上一条指令不再是bindResources
+    cmdBuffer->setViewport(viewport);
+    TEST_CHECK(cmdBuffer->markPatch() == COMMAND_PATCH_INVALID, "elided setViewport was treated as patchable");
+
+    cmdBuffer->draw(3, 1, 0, 1)
+            ->endRenderPass()
+            ->end();
+    if (patch != COMMAND_PATCH_INVALID) {
+        cmdBuffer->patchDynamicOffsets(patch, {256});
+    }
+
+    std::string dump = env.context->dumpCommandBuffer(cmdBuffer);
+    std::vector<std::string> lines = splitLines(dump);
+    int lastBind = -1;
+    int patched = -1;
+    uint32_t patchedCount = 0;
+    for (size_t k = 0; k < lines.size(); k++) {
+        if (lines[k] == "BindDescSet") {
+            lastBind = (int) k;
+        } else if (lines[k].find("patched: offsets = [256]") != std::string::npos) {
+            patched = (int) k;
+            patchedCount++;
+        }
+    }
+    TEST_CHECK(patchedCount == 1 && lastBind >= 0 && patched == lastBind + 2,
+               "patch is not applied to the second bindResources:\n%s", dump.c_str());
+
+    destroyCommandBuffer(cmdBuffer);
+}
+
+/**
+ * 拼接前应用在Primary指令缓冲上的修补在拼接结果中生效，拼接后录制的修补点不受影响
+ */
+void testPatchAfterSplice(const TestEnv &env)
+{
+    CommandBuffer subBuffer = createCommandBuffer(env.context, {QueueType::Graphics, 1});
+    subBuffer->begin()
+            ->bindResources(ResourceBindPoint::Compute, {env.binder}, {0});
+    CommandPatch subPatch = subBuffer->markPatch();
+    subBuffer->end();
+    TEST_CHECK(subPatch != COMMAND_PATCH_INVALID, "bindResources can not be patched");
+    if (subPatch != COMMAND_PATCH_INVALID) {
+        subBuffer->patchDynamicOffsets(subPatch, {256});
+    }
+
+    CommandBuffer cmdBuffer = createCommandBuffer(env.context, {QueueType::Graphics, 1});
+    cmdBuffer->begin()
+            ->pipelineBarrier(PipelineStage::AllCommands, PipelineStage::AllCommands)
+            ->executeCommands({subBuffer})
+            ->bindResources(ResourceBindPoint::Compute, {env.binder}, {0});
+    CommandPatch patch = cmdBuffer->markPatch();
+    cmdBuffer->end();
+    TEST_CHECK(patch != COMMAND_PATCH_INVALID, "bindResources after executeCommands can not be patched");
+    if (patch != COMMAND_PATCH_INVALID) {
+        cmdBuffer->patchDynamicOffsets(patch, {512});
+    }
+
+    std::string dump = env.context->dumpCommandBuffer(cmdBuffer);
+    size_t spliced = dump.find("patched: offsets = [256]");
+    size_t own = dump.find("patched: offsets = [512]");
+    TEST_CHECK(spliced != std::string::npos && own != std::string::npos && spliced < own,
+               "patches do not survive executeCommands:\n%s", dump.c_str());
+    TEST_CHECK(countCommand(dump, "BindDescSet") == 2, "BindDescSet count %d", countCommand(dump, "BindDescSet"));
+
+    destroyCommandBuffer(cmdBuffer);
+    destroyCommandBuffer(subBuffer);
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    Instance instance = createInstance({"gfx-recorder-test", TargetApiType::Null, {}, false});
+    if (instance == GFX_NULL_HANDLE) {
+        fprintf(stderr, "Create instance failure\n");
+        return 1;
+    }
+    Context context = createContext(instance, {0, {}});
+    if (context == GFX_NULL_HANDLE) {
+        fprintf(stderr, "Create context failure\n");
+        destroyInstance(instance);
+        return 1;
+    }
+
+    TestEnv env{};
+    if (!initEnv(context, env)) {
+        fprintf(stderr, "Create test resources failure\n");
+        destroyEnv(env);
+        destroyContext(context);
+        destroyInstance(instance);
+        return 1;
+    }
+
+    testSortOrder(env);
+    testPartialStateBailOut(env);
+    testSpliceRelocation(env);
+    testElisionCounts(env);
+    testPatchAfterElision(env);
+    testPatchAfterSplice(env);
+
+    destroyEnv(env);
+    destroyContext(context);
+    destroyInstance(instance);
+
+    if (sFailureCount > 0) {
+        fprintf(stderr, "%u checks failed\n", sFailureCount);
+        return 1;
+    }
+    printf("All checks passed\n");
+    return 0;
+}
@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2023 Gxin
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * 捕获文件回放工具
+ * 用法: gfx-replay <capture file> [loop count] [device index]
+ */
+
+#include <gfx/gfx.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+
+using namespace gfx;
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2) {
+        printf("Usage: %s <capture file> [loop count] [device index]\n", argv[0]);
+        return 1;
+    }
+
+    CaptureReplayInfo replayInfo{};
+    if (argc > 2) {
+        replayInfo.loopCount = std::max(1, atoi(argv[2]));
+    }
+    uint32_t deviceIndex = argc > 3 ? (uint32_t) atoi(argv[3]) : 0;
+
+    Instance instance = createInstance({"gfx-replay", TargetApiType::Vulkan, {}, false});
+    if (instance == GFX_NULL_HANDLE) {
+        printf("Create instance failure\n");
+        return 1;
+    }
+    if (deviceIndex >= instance->deviceCount()) {
+        printf("Invalid device index: %u\n", deviceIndex);
+        destroyInstance(instance);
+        return 1;
+    }
+
+    Context context = createContext(instance, {deviceIndex, {}});
+    if (context == GFX_NULL_HANDLE) {
+        printf("Create context failure\n");
+        destroyInstance(instance);
+        return 1;
+    }
+
+    CaptureReplayResult result{};
+    bool success = replayCapture(context, argv[1], replayInfo, result);
+
+    printf("Device:   %s\n", context->deviceInfo().deviceName);
+    printf("Frames:   %u\n", result.frameCount);
+    printf("Submits:  %u\n", result.submitCount);
+    printf("Elements: %u\n", result.elementCount);
+    printf("Load:     %.3f ms\n", (double) result.loadTime / 1000.0);
+    printf("Compile:  %.3f ms\n", (double) result.compileTime / 1000.0);
+
+    if (!result.frameTimes.empty()) {
+        uint64_t total = 0;
+        uint64_t minTime = UINT64_MAX;
+        uint64_t maxTime = 0;
+        for (uint64_t time : result.frameTimes) {
+            total += time;
+            minTime = std::min(minTime, time);
+            maxTime = std::max(maxTime, time);
+        }
+        printf("Frame:    min %.3f ms, avg %.3f ms, max %.3f ms (%zu frames)\n",
+               (double) minTime / 1000.0,
+               (double) total / (double) result.frameTimes.size() / 1000.0,
+               (double) maxTime / 1000.0,
+               result.frameTimes.size());
+    }
+
+    destroyContext(context);
+    destroyInstance(instance);
+
+    if (!success) {
+        printf("Replay %s failure\n", argv[1]);
+        return 1;
+    }
+    return 0;
+}